@@ -12,6 +12,9 @@ PB_BIND(GuiStatus, GuiStatus, AUTO)
 PB_BIND(ControllerStatus, ControllerStatus, AUTO)
 
 
+PB_BIND(SampleBatch, SampleBatch, AUTO)
+
+
 PB_BIND(VentParams, VentParams, AUTO)
 
 
@@ -22,6 +22,22 @@ typedef enum _VentMode {
 } VentMode;
 
 /* Struct definitions */
+typedef struct _SampleBatch {
+    uint64_t first_sample_uptime_us;
+    uint32_t sample_period_us;
+    uint64_t first_breath_id;
+    pb_size_t patient_pressure_count;
+    int32_t patient_pressure[16];
+    pb_size_t flow_count;
+    int32_t flow[16];
+    pb_size_t volume_count;
+    int32_t volume[16];
+    pb_size_t pressure_setpoint_count;
+    int32_t pressure_setpoint[16];
+    pb_size_t breath_id_count;
+    int32_t breath_id[16];
+} SampleBatch;
+
 typedef struct _SensorsProto {
     float patient_pressure_cm_h2o;
     float volume_ml;
@@ -50,6 +66,7 @@ typedef struct _ControllerStatus {
     SensorsProto sensor_readings;
     float pressure_setpoint_cm_h2o;
     float fan_power;
+    SampleBatch samples;
 } ControllerStatus;
 
 typedef struct _GuiStatus {
@@ -66,15 +83,25 @@ typedef struct _GuiStatus {
 
 /* Initializer values for message structs */
 #define GuiStatus_init_default                   {0, VentParams_init_default}
-#define ControllerStatus_init_default            {0, VentParams_init_default, SensorsProto_init_default, 0, 0}
+#define ControllerStatus_init_default            {0, VentParams_init_default, SensorsProto_init_default, 0, 0, SampleBatch_init_default}
+#define SampleBatch_init_default                 {0, 0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}}
 #define VentParams_init_default                  {_VentMode_MIN, 0, 0, 0, 0, 0, 0, 0}
 #define SensorsProto_init_default                {0, 0, 0, 0, 0, 0, 0, 0}
 #define GuiStatus_init_zero                      {0, VentParams_init_zero}
-#define ControllerStatus_init_zero               {0, VentParams_init_zero, SensorsProto_init_zero, 0, 0}
+#define ControllerStatus_init_zero               {0, VentParams_init_zero, SensorsProto_init_zero, 0, 0, SampleBatch_init_zero}
+#define SampleBatch_init_zero                    {0, 0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}}
 #define VentParams_init_zero                     {_VentMode_MIN, 0, 0, 0, 0, 0, 0, 0}
 #define SensorsProto_init_zero                   {0, 0, 0, 0, 0, 0, 0, 0}
 
 /* Field tags (for use in manual encoding/decoding) */
+#define SampleBatch_first_sample_uptime_us_tag   1
+#define SampleBatch_sample_period_us_tag         2
+#define SampleBatch_first_breath_id_tag          3
+#define SampleBatch_patient_pressure_tag         4
+#define SampleBatch_flow_tag                     5
+#define SampleBatch_volume_tag                   6
+#define SampleBatch_pressure_setpoint_tag        7
+#define SampleBatch_breath_id_tag                8
 #define SensorsProto_patient_pressure_cm_h2o_tag 1
 #define SensorsProto_volume_ml_tag               2
 #define SensorsProto_flow_ml_per_min_tag         3
@@ -82,7 +109,7 @@ typedef struct _GuiStatus {
 #define SensorsProto_outflow_pressure_diff_cm_h2o_tag 5
 #define SensorsProto_breath_id_tag               6
 #define SensorsProto_flow_correction_ml_per_min_tag 7
-#define SensorsProto_fio2_tag 8
+#define SensorsProto_fio2_tag                    8
 #define VentParams_mode_tag                      1
 #define VentParams_peep_cm_h2o_tag               3
 #define VentParams_breaths_per_min_tag           4
@@ -96,6 +123,7 @@ typedef struct _GuiStatus {
 #define ControllerStatus_sensor_readings_tag     3
 #define ControllerStatus_pressure_setpoint_cm_h2o_tag 5
 #define ControllerStatus_fan_power_tag           6
+#define ControllerStatus_samples_tag             7
 #define GuiStatus_uptime_ms_tag                  1
 #define GuiStatus_desired_params_tag             2
 
@@ -112,11 +140,25 @@ X(a, STATIC,   REQUIRED, UINT64,   uptime_ms,         1) \
 X(a, STATIC,   REQUIRED, MESSAGE,  active_params,     2) \
 X(a, STATIC,   REQUIRED, MESSAGE,  sensor_readings,   3) \
 X(a, STATIC,   REQUIRED, FLOAT,    pressure_setpoint_cm_h2o,   5) \
-X(a, STATIC,   REQUIRED, FLOAT,    fan_power,         6)
+X(a, STATIC,   REQUIRED, FLOAT,    fan_power,         6) \
+X(a, STATIC,   REQUIRED, MESSAGE,  samples,           7)
 #define ControllerStatus_CALLBACK NULL
 #define ControllerStatus_DEFAULT NULL
 #define ControllerStatus_active_params_MSGTYPE VentParams
 #define ControllerStatus_sensor_readings_MSGTYPE SensorsProto
+#define ControllerStatus_samples_MSGTYPE SampleBatch
+
+#define SampleBatch_FIELDLIST(X, a) \
+X(a, STATIC,   REQUIRED, UINT64,   first_sample_uptime_us,   1) \
+X(a, STATIC,   REQUIRED, UINT32,   sample_period_us,   2) \
+X(a, STATIC,   REQUIRED, UINT64,   first_breath_id,   3) \
+X(a, STATIC,   REPEATED, SINT32,   patient_pressure,   4) \
+X(a, STATIC,   REPEATED, SINT32,   flow,              5) \
+X(a, STATIC,   REPEATED, SINT32,   volume,            6) \
+X(a, STATIC,   REPEATED, SINT32,   pressure_setpoint,   7) \
+X(a, STATIC,   REPEATED, SINT32,   breath_id,         8)
+#define SampleBatch_CALLBACK NULL
+#define SampleBatch_DEFAULT NULL
 
 #define VentParams_FIELDLIST(X, a) \
 X(a, STATIC,   REQUIRED, UENUM,    mode,              1) \
@@ -137,27 +179,30 @@ X(a, STATIC,   REQUIRED, FLOAT,    flow_ml_per_min,   3) \
 X(a, STATIC,   REQUIRED, FLOAT,    inflow_pressure_diff_cm_h2o,   4) \
 X(a, STATIC,   REQUIRED, FLOAT,    outflow_pressure_diff_cm_h2o,   5) \
 X(a, STATIC,   REQUIRED, UINT64,   breath_id,         6) \
-X(a, STATIC,   REQUIRED, FLOAT,    flow_correction_ml_per_min,   7)\
-X(a, STATIC,   REQUIRED, FLOAT,    fio2,   8)
+X(a, STATIC,   REQUIRED, FLOAT,    flow_correction_ml_per_min,   7) \
+X(a, STATIC,   REQUIRED, FLOAT,    fio2,              8)
 #define SensorsProto_CALLBACK NULL
 #define SensorsProto_DEFAULT NULL
 
 extern const pb_msgdesc_t GuiStatus_msg;
 extern const pb_msgdesc_t ControllerStatus_msg;
+extern const pb_msgdesc_t SampleBatch_msg;
 extern const pb_msgdesc_t VentParams_msg;
 extern const pb_msgdesc_t SensorsProto_msg;
 
 /* Defines for backwards compatibility with code written before nanopb-0.4.0 */
 #define GuiStatus_fields &GuiStatus_msg
 #define ControllerStatus_fields &ControllerStatus_msg
+#define SampleBatch_fields &SampleBatch_msg
 #define VentParams_fields &VentParams_msg
 #define SensorsProto_fields &SensorsProto_msg
 
 /* Maximum encoded size of messages (where known) */
 #define GuiStatus_size                           55
-#define ControllerStatus_size                    108
+#define ControllerStatus_size                    624
+#define SampleBatch_size                         508
 #define VentParams_size                          42
-#define SensorsProto_size                        45
+#define SensorsProto_size                        46
 
 #ifdef __cplusplus
 } /* extern "C" */
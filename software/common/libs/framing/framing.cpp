@@ -0,0 +1,101 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "framing.h"
+
+#include "checksum.h"
+
+static bool needs_escape(uint8_t byte) { return byte == FramingMark || byte == FramingEscape; }
+
+uint32_t encode_frame(const uint8_t *payload, uint32_t length, uint8_t *frame,
+                      uint32_t frame_size) {
+  if (length == 0) return 0;
+
+  uint32_t i = 0;
+  // Appends a byte to the frame, escaping it if necessary.
+  // Returns false if the frame buffer is full.
+  auto append = [&](uint8_t byte) {
+    if (needs_escape(byte)) {
+      if (i + 2 > frame_size) return false;
+      frame[i++] = FramingEscape;
+      frame[i++] = static_cast<uint8_t>(byte ^ FramingEscapeXor);
+    } else {
+      if (i + 1 > frame_size) return false;
+      frame[i++] = byte;
+    }
+    return true;
+  };
+
+  if (frame_size < 1) return 0;
+  frame[i++] = FramingMark;
+
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t j = 0; j < length; ++j) {
+    crc = crc32_single(crc, payload[j]);
+    if (!append(payload[j])) return 0;
+  }
+  // CRC is sent most significant byte first, as expected by crc_ok().
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    if (!append(static_cast<uint8_t>(crc >> shift))) return 0;
+  }
+
+  if (i + 1 > frame_size) return 0;
+  frame[i++] = FramingMark;
+  return i;
+}
+
+uint32_t decode_frame(const uint8_t *frame, uint32_t length, uint8_t *payload,
+                      uint32_t payload_size) {
+  // Strip the frame marks
+  while (length > 0 && frame[0] == FramingMark) {
+    ++frame;
+    --length;
+  }
+  while (length > 0 && frame[length - 1] == FramingMark) --length;
+
+  // Unescaped bytes go through a 4 bytes delay line, so that when we reach the
+  // end of the frame it holds the CRC, and everything that came out of it is
+  // the payload.  This allows decoding to a payload buffer that is just large
+  // enough for the payload, or in place.
+  uint8_t delay[FrameCrcSize];
+  uint32_t unescaped = 0;
+  uint32_t out = 0;
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t i = 0; i < length; ++i) {
+    uint8_t byte = frame[i];
+    if (byte == FramingMark) return 0;
+    if (byte == FramingEscape) {
+      if (++i >= length) return 0;
+      byte = static_cast<uint8_t>(frame[i] ^ FramingEscapeXor);
+      if (!needs_escape(byte)) return 0;
+    }
+
+    if (unescaped >= FrameCrcSize) {
+      uint8_t oldest = delay[unescaped % FrameCrcSize];
+      if (out >= payload_size) return 0;
+      payload[out++] = oldest;
+      crc = crc32_single(crc, oldest);
+    }
+    delay[unescaped % FrameCrcSize] = byte;
+    ++unescaped;
+  }
+  if (out == 0) return 0;
+
+  uint32_t received_crc = 0;
+  for (uint32_t i = 0; i < FrameCrcSize; ++i) {
+    received_crc = received_crc << 8 | delay[(unescaped + i) % FrameCrcSize];
+  }
+  return received_crc == crc ? out : 0;
+}
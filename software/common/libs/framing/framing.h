@@ -0,0 +1,66 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Framing of the messages exchanged between the controller and the GUI.
+//
+// A frame is made of the message (the payload) followed by its CRC32 (see
+// checksum.h), sent most significant byte first, the whole thing being escaped
+// and delimited by FramingMark bytes:
+//
+//   FramingMark | escaped(payload | CRC32) | FramingMark
+//
+// Escaping replaces each FramingMark or FramingEscape byte within the frame by
+// FramingEscape followed by the original byte XOR'ed with FramingEscapeXor, so
+// that FramingMark can only appear at frame boundaries.  A receiver can
+// therefore resynchronize on the next FramingMark whatever it missed, and
+// detect the end of a frame without knowing its length in advance (the STM32
+// UART does this in hardware using its character match feature).
+
+constexpr uint8_t FramingMark{0xE2};
+constexpr uint8_t FramingEscape{0x27};
+constexpr uint8_t FramingEscapeXor{0x20};
+
+// Size of the frame CRC, in bytes.
+constexpr uint32_t FrameCrcSize{4};
+
+// Largest possible size of the frame of a payload of the given length, which
+// is reached when every byte needs to be escaped.
+constexpr uint32_t max_encoded_frame_size(uint32_t payload_length) {
+  return 2 + 2 * (payload_length + FrameCrcSize);
+}
+
+// Encodes payload into a frame.
+// @param payload - data to frame
+// @param length - length of the payload
+// @param frame - destination buffer
+// @param frame_size - size of the destination buffer
+// @returns length of the frame, or 0 if it doesn't fit in frame_size bytes
+uint32_t encode_frame(const uint8_t *payload, uint32_t length, uint8_t *frame, uint32_t frame_size);
+
+// Decodes a frame into its payload, checking its CRC.  Leading and trailing
+// FramingMark bytes are optional, but the frame may not contain any other.
+// Decoding can be done in place (frame == payload).
+// @param frame - received data
+// @param length - length of the received data
+// @param payload - destination buffer
+// @param payload_size - size of the destination buffer
+// @returns length of the payload, or 0 if the frame is invalid (bad escape
+// sequence, bad CRC or no payload) or doesn't fit in payload_size bytes
+uint32_t decode_frame(const uint8_t *frame, uint32_t length, uint8_t *payload,
+                      uint32_t payload_size);
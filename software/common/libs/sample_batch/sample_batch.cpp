@@ -0,0 +1,117 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "sample_batch.h"
+
+#include <cmath>
+
+static_assert(pb_arraysize(SampleBatch, flow) == SampleBatchCapacity);
+static_assert(pb_arraysize(SampleBatch, volume) == SampleBatchCapacity);
+static_assert(pb_arraysize(SampleBatch, pressure_setpoint) == SampleBatchCapacity);
+static_assert(pb_arraysize(SampleBatch, breath_id) == SampleBatchCapacity);
+
+// Quantized values are limited to +/-2^30, so that the difference between any
+// two of them fits in an int32_t.  That's far beyond anything we can measure.
+static constexpr float MaxQuantized{1 << 30};
+
+static int32_t quantize(float value, float step) {
+  float steps = std::round(value / step);
+  // Comparisons are false for NaN, which then ends up as 0.
+  if (steps > MaxQuantized) return static_cast<int32_t>(MaxQuantized);
+  if (steps < -MaxQuantized) return -static_cast<int32_t>(MaxQuantized);
+  if (steps == steps) return static_cast<int32_t>(steps);
+  return 0;
+}
+
+static float dequantize(int32_t value, float step) { return static_cast<float>(value) * step; }
+
+uint32_t pack_samples(const WaveformSample *samples, uint32_t count,
+                      uint64_t first_sample_uptime_us, uint32_t sample_period_us,
+                      SampleBatch *batch) {
+  if (count > SampleBatchCapacity) count = SampleBatchCapacity;
+
+  batch->first_sample_uptime_us = first_sample_uptime_us;
+  batch->sample_period_us = sample_period_us;
+  batch->first_breath_id = count > 0 ? samples[0].breath_id : 0;
+
+  int32_t pressure = 0;
+  int32_t flow = 0;
+  int32_t volume = 0;
+  int32_t setpoint = 0;
+  uint64_t breath_id = batch->first_breath_id;
+  for (uint32_t i = 0; i < count; ++i) {
+    const WaveformSample &sample = samples[i];
+    // Deltas are taken between quantized values, so that quantization errors
+    // don't add up when unpacking.
+    int32_t next = quantize(sample.patient_pressure_cm_h2o, SampleBatchPressureStepCmH2O);
+    batch->patient_pressure[i] = next - pressure;
+    pressure = next;
+
+    next = quantize(sample.flow_ml_per_min, SampleBatchFlowStepMlPerMin);
+    batch->flow[i] = next - flow;
+    flow = next;
+
+    next = quantize(sample.volume_ml, SampleBatchVolumeStepMl);
+    batch->volume[i] = next - volume;
+    volume = next;
+
+    next = quantize(sample.pressure_setpoint_cm_h2o, SampleBatchPressureStepCmH2O);
+    batch->pressure_setpoint[i] = next - setpoint;
+    setpoint = next;
+
+    // Breath ids only ever change by small amounts from one cycle to the next,
+    // or at worst by the time of a breath in microseconds.
+    batch->breath_id[i] = static_cast<int32_t>(sample.breath_id - breath_id);
+    breath_id = sample.breath_id;
+  }
+
+  auto size = static_cast<pb_size_t>(count);
+  batch->patient_pressure_count = size;
+  batch->flow_count = size;
+  batch->volume_count = size;
+  batch->pressure_setpoint_count = size;
+  batch->breath_id_count = size;
+  return count;
+}
+
+uint32_t unpack_samples(const SampleBatch &batch, WaveformSample *samples, uint32_t size) {
+  pb_size_t count = batch.patient_pressure_count;
+  if (batch.flow_count != count || batch.volume_count != count ||
+      batch.pressure_setpoint_count != count || batch.breath_id_count != count) {
+    return 0;
+  }
+  if (count > size) count = static_cast<pb_size_t>(size);
+
+  int32_t pressure = 0;
+  int32_t flow = 0;
+  int32_t volume = 0;
+  int32_t setpoint = 0;
+  uint64_t breath_id = batch.first_breath_id;
+  for (uint32_t i = 0; i < count; ++i) {
+    pressure += batch.patient_pressure[i];
+    flow += batch.flow[i];
+    volume += batch.volume[i];
+    setpoint += batch.pressure_setpoint[i];
+    breath_id += static_cast<uint64_t>(static_cast<int64_t>(batch.breath_id[i]));
+    samples[i] = {
+        .patient_pressure_cm_h2o = dequantize(pressure, SampleBatchPressureStepCmH2O),
+        .flow_ml_per_min = dequantize(flow, SampleBatchFlowStepMlPerMin),
+        .volume_ml = dequantize(volume, SampleBatchVolumeStepMl),
+        .pressure_setpoint_cm_h2o = dequantize(setpoint, SampleBatchPressureStepCmH2O),
+        .breath_id = breath_id,
+    };
+  }
+  return count;
+}
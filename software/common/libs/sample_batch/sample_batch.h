@@ -0,0 +1,53 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "network_protocol.pb.h"
+
+// Packing and unpacking of SampleBatch (see network_protocol.proto), which
+// carries the waveforms sampled on every control loop cycle from the
+// controller to the GUI.
+
+// One control loop cycle worth of waveforms.
+struct WaveformSample {
+  float patient_pressure_cm_h2o;
+  float flow_ml_per_min;
+  float volume_ml;
+  float pressure_setpoint_cm_h2o;
+  uint64_t breath_id;
+};
+
+// Maximum number of samples in a SampleBatch.
+constexpr uint32_t SampleBatchCapacity{pb_arraysize(SampleBatch, patient_pressure)};
+
+// Quantization steps of the SampleBatch fields, see network_protocol.proto.
+constexpr float SampleBatchPressureStepCmH2O{0.01f};
+constexpr float SampleBatchFlowStepMlPerMin{10.0f};
+constexpr float SampleBatchVolumeStepMl{0.1f};
+
+// Packs the first samples (as many as fit) into batch, replacing its contents.
+// samples are taken every sample_period_us, starting at first_sample_uptime_us.
+// Returns the number of samples packed.
+uint32_t pack_samples(const WaveformSample *samples, uint32_t count,
+                      uint64_t first_sample_uptime_us, uint32_t sample_period_us,
+                      SampleBatch *batch);
+
+// Unpacks the samples held by batch, up to size of them.
+// Returns the number of samples unpacked, which is 0 if the batch is malformed
+// (i.e. its fields don't hold the same number of samples).
+uint32_t unpack_samples(const SampleBatch &batch, WaveformSample *samples, uint32_t size);
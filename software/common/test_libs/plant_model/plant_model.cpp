@@ -0,0 +1,159 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "plant_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Internally, the model works with plain floats in "clinical" units:
+// pressures in cmH2O, flows in l/s, volumes in ml and times in seconds.
+
+// Fraction of oxygen in ambient air
+static constexpr float AirFio2{0.21f};
+
+// Wye-piece pressure solver tolerance (cmH2O) and iteration limit.
+static constexpr float SolverTolerance{1e-4f};
+static constexpr int SolverMaxIterations{40};
+
+PlantModel::PlantModel(const PatientParams &patient, const PneumaticParams &pneumatics)
+    : patient_(patient), pneumatics_(pneumatics) {}
+
+void PlantModel::advance(Duration dt, const PlantInputs &inputs, Duration step_size) {
+  while (dt > microseconds(0)) {
+    Duration step_dt = std::min(dt, step_size);
+    step(step_dt.seconds(), inputs);
+    now_ = now_ + step_dt;
+    dt = dt - step_dt;
+  }
+}
+
+Pressure PlantModel::venturi_pressure_delta(VolumetricFlow flow) const {
+  auto area = [](Length diameter) {
+    return static_cast<float>(M_PI) / 4.0f * diameter.meters() * diameter.meters();
+  };
+  float port = area(pneumatics_.venturi_port_diameter);
+  float choke = area(pneumatics_.venturi_choke_diameter);
+  // Inverse of Q = Cd * A1 * A2 / sqrt(A1^2 - A2^2) * sqrt(2 * dP / rho)
+  float velocity = pneumatics_.venturi_discharge_coefficient * port * choke /
+                   std::sqrt(port * port - choke * choke);
+  float q = flow.cubic_m_per_sec() / velocity;
+  float pascals = pneumatics_.air_density / 2.0f * q * q;
+  return kPa(std::copysign(pascals / 1000.0f, q));
+}
+
+float PlantModel::rohrer_flow(float k1, float k2, float dp) {
+  // Solve k2 * Q^2 + k1 * Q - |dp| = 0 for Q >= 0, using the numerically
+  // stable form of the quadratic root.
+  float q = 2.0f * std::abs(dp) / (k1 + std::sqrt(k1 * k1 + 4.0f * k2 * std::abs(dp)));
+  return std::copysign(q, dp);
+}
+
+float PlantModel::rohrer_conductance(float k1, float k2, float dp) {
+  return 1.0f / std::sqrt(k1 * k1 + 4.0f * k2 * std::abs(dp));
+}
+
+Pressure PlantModel::muscle_pressure() const {
+  if (patient_.effort_amplitude.cmH2O() <= 0 || patient_.effort_breaths_per_min <= 0) {
+    return cmH2O(0);
+  }
+  float period = 60.0f / patient_.effort_breaths_per_min;
+  float phase = std::fmod((now_ - microsSinceStartup(0)).seconds(), period);
+  float duration = patient_.effort_duration.seconds();
+  if (phase >= duration) return cmH2O(0);
+  // Half-sine pulse of inspiratory effort.
+  return patient_.effort_amplitude * std::sin(static_cast<float>(M_PI) * phase / duration);
+}
+
+void PlantModel::step(float dt, const PlantInputs &inputs) {
+  // Actuator dynamics.
+  float blower_alpha = std::min(1.0f, dt / pneumatics_.blower_time_constant.seconds());
+  blower_speed_ += (std::clamp(inputs.blower_power, 0.0f, 1.0f) - blower_speed_) * blower_alpha;
+
+  float max_valve_travel = dt / pneumatics_.valve_travel_time.seconds();
+  auto move_valve = [&](float position, float command) {
+    return position + std::clamp(std::clamp(command, 0.0f, 1.0f) - position, -max_valve_travel,
+                                 max_valve_travel);
+  };
+  blower_valve_ = move_valve(blower_valve_, inputs.blower_valve);
+  exhale_valve_ = move_valve(exhale_valve_, inputs.exhale_valve);
+
+  float source = pneumatics_.blower_max_pressure.cmH2O() * blower_speed_;
+  // The blower fan curve droop is lumped with the linear term of the
+  // inspiratory path.
+  float insp_k1 = pneumatics_.inspiratory_k1 + pneumatics_.blower_max_pressure.cmH2O() /
+                                                   pneumatics_.blower_max_flow.liters_per_sec();
+  float insp_k2 = pneumatics_.inspiratory_k2;
+  float exp_k1 = pneumatics_.expiratory_k1;
+  float exp_k2 = pneumatics_.expiratory_k2;
+  float oxygen =
+      std::clamp(inputs.fio2_valve, 0.0f, 1.0f) * pneumatics_.psol_max_flow.liters_per_sec();
+
+  float resistance = patient_.resistance_cmH2O_per_lps;
+  float lung = lung_volume_ml_ / patient_.compliance_ml_per_cmH2O - muscle_pressure().cmH2O();
+
+  // Net flow into the wye-piece as a function of its pressure.  This is
+  // strictly decreasing, so it has a single root which I find with a Newton
+  // iteration safeguarded by bisection.
+  auto net_flow = [&](float p) {
+    return blower_valve_ * rohrer_flow(insp_k1, insp_k2, source - p) + oxygen -
+           (p - lung) / resistance - exhale_valve_ * rohrer_flow(exp_k1, exp_k2, p);
+  };
+  auto net_flow_slope = [&](float p) {
+    return -blower_valve_ * rohrer_conductance(insp_k1, insp_k2, source - p) - 1.0f / resistance -
+           exhale_valve_ * rohrer_conductance(exp_k1, exp_k2, p);
+  };
+  // At low, every path flows into the wye-piece; at high, oxygen flow alone is
+  // not enough to balance what flows out through the patient.
+  float low = std::min({lung, 0.0f, source});
+  float high = std::max({lung, 0.0f, source}) + oxygen * resistance;
+  float p = std::clamp(wye_pressure_cmH2O_, low, high);
+  for (int i = 0; i < SolverMaxIterations && high - low > SolverTolerance; ++i) {
+    float f = net_flow(p);
+    if (f > 0) {
+      low = p;
+    } else {
+      high = p;
+    }
+    float next = p - f / net_flow_slope(p);
+    if (next <= low || next >= high) next = (low + high) / 2.0f;
+    if (std::abs(next - p) < SolverTolerance) {
+      p = next;
+      break;
+    }
+    p = next;
+  }
+  wye_pressure_cmH2O_ = p;
+
+  float inflow = blower_valve_ * rohrer_flow(insp_k1, insp_k2, source - p);
+  float outflow = exhale_valve_ * rohrer_flow(exp_k1, exp_k2, p);
+  float patient_flow = (p - lung) / resistance;
+  lung_volume_ml_ += patient_flow * 1000.0f * dt;
+
+  // Oxygen fraction of the fresh gas reaching the wye-piece.  When nothing
+  // flows in, keep the last value, as the sensor would.
+  float fresh_air = std::max(inflow, 0.0f);
+  if (fresh_air + oxygen > 0) {
+    outputs_.fio2 = (AirFio2 * fresh_air + oxygen) / (fresh_air + oxygen);
+  }
+
+  outputs_.patient_pressure = cmH2O(p);
+  outputs_.lung_pressure = cmH2O(lung_volume_ml_ / patient_.compliance_ml_per_cmH2O);
+  outputs_.lung_volume = ml(lung_volume_ml_);
+  outputs_.air_inflow = liters_per_sec(inflow);
+  outputs_.oxygen_inflow = liters_per_sec(oxygen);
+  outputs_.outflow = liters_per_sec(outflow);
+  outputs_.patient_flow = liters_per_sec(patient_flow);
+}
@@ -0,0 +1,165 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "units.h"
+
+// This module is a lumped-parameter model of the pneumatic system (the "plant")
+// that the controller drives, so that the controller can be run in closed loop
+// on a PC, much faster than real time.
+//
+// The model is made of:
+//
+//  - a blower, modeled as a pressure source whose pressure is proportional to
+//    its (first-order lagged) power, with an internal resistance representing
+//    the droop of its fan curve,
+//  - the inspiratory pinch valve, between the blower and the patient
+//    wye-piece,
+//  - the oxygen proportional solenoid, modeled as a flow source fed from a
+//    regulated supply much higher than patient pressure,
+//  - the expiratory pinch valve, between the wye-piece and ambient,
+//  - a single compartment lung, with a linear airway resistance and compliance,
+//    and optionally a spontaneous inspiratory effort (muscle pressure).
+//
+// Pinch valves are rate limited to mimic the stepper motion and each of their
+// flow paths follows Rohrer's equation (dP = K1 * Q + K2 * Q^2) when fully
+// open, with flow scaled by the valve command.  This mirrors the pinch valve
+// calibration table in the controller, which linearizes flow vs command.
+//
+// The wye-piece has no compliance: at each integration step I solve for the
+// pressure that balances the flows going in and out of it, then integrate lung
+// volume.  This keeps the model non-stiff, so it can take large steps.
+//
+// Venturi differential pressures are computed from the flows using the ideal
+// Bernoulli equation, scaled by a discharge coefficient, so that tests can
+// feed them through the controller's actual flow sensor conversion.
+
+// Physical description of the simulated patient.
+struct PatientParams {
+  // Lung compliance, in ml/cmH2O (typically 10 for stiff lungs to 100 for
+  // very compliant ones).
+  float compliance_ml_per_cmH2O{50.0f};
+  // Airway resistance, in cmH2O/(l/s) (typically 5 to 50).
+  float resistance_cmH2O_per_lps{5.0f};
+  // Peak amplitude of the inspiratory muscle pressure, 0 for a sedated patient.
+  Pressure effort_amplitude{cmH2O(0.0f)};
+  // Spontaneous breathing rate, only relevant with a non-zero effort.
+  float effort_breaths_per_min{0.0f};
+  // Duration of the muscle pressure pulse at the start of each spontaneous
+  // breath.
+  Duration effort_duration{milliseconds(500)};
+};
+
+// Physical description of the ventilator pneumatics.
+struct PneumaticParams {
+  // Blower output pressure at full power and no flow.
+  Pressure blower_max_pressure{cmH2O(60.0f)};
+  // Blower flow at full power and zero output pressure.
+  VolumetricFlow blower_max_flow{liters_per_sec(3.0f)};
+  // Time constant of the blower speed response to power commands.
+  Duration blower_time_constant{milliseconds(100)};
+
+  // Rohrer coefficients of the fully open inspiratory path (pinch valve,
+  // venturi and tubing), in cmH2O/(l/s) and cmH2O/(l/s)^2.
+  float inspiratory_k1{2.0f};
+  float inspiratory_k2{4.0f};
+  // Rohrer coefficients of the fully open expiratory path.
+  float expiratory_k1{2.0f};
+  float expiratory_k2{4.0f};
+  // Time it takes a pinch valve to travel from fully closed to fully open.
+  Duration valve_travel_time{milliseconds(25)};
+
+  // Oxygen flow through the fully open proportional solenoid.
+  VolumetricFlow psol_max_flow{liters_per_sec(2.0f)};
+
+  // Venturi geometry, used to compute their differential pressure.
+  Length venturi_port_diameter{millimeters(15.05f)};
+  Length venturi_choke_diameter{millimeters(5.5f)};
+  float venturi_discharge_coefficient{0.97f};
+  float air_density{1.225f};  // kg/m^3
+};
+
+// Actuator commands fed into the plant, all in [0, 1].  This intentionally
+// mirrors the controller's ActuatorsState without depending on it, so that the
+// model stays a leaf library.
+struct PlantInputs {
+  float blower_power{0.0f};
+  float blower_valve{0.0f};
+  float exhale_valve{1.0f};
+  float fio2_valve{0.0f};
+};
+
+// Instantaneous physical state of the plant.
+struct PlantOutputs {
+  // Pressure at the patient wye-piece, which is where the controller's patient
+  // pressure sensor sits.
+  Pressure patient_pressure{cmH2O(0.0f)};
+  // Alveolar pressure, not observable by the controller.
+  Pressure lung_pressure{cmH2O(0.0f)};
+  // Lung volume above functional residual capacity.
+  Volume lung_volume{ml(0.0f)};
+  // Flows through each venturi (positive toward ambient for the outflow), and
+  // into the patient airway.
+  VolumetricFlow air_inflow{ml_per_sec(0.0f)};
+  VolumetricFlow oxygen_inflow{ml_per_sec(0.0f)};
+  VolumetricFlow outflow{ml_per_sec(0.0f)};
+  VolumetricFlow patient_flow{ml_per_sec(0.0f)};
+  // Oxygen fraction of the gas delivered to the patient wye-piece.
+  float fio2{0.21f};
+};
+
+class PlantModel {
+ public:
+  // Default integration step.  Patient time constants are R*C >= 50 ms, and
+  // valve travel is 25 ms, so 1 ms keeps the explicit integration well within
+  // its stability region.
+  static constexpr Duration DefaultStep{milliseconds(1)};
+
+  explicit PlantModel(const PatientParams &patient, const PneumaticParams &pneumatics = {});
+
+  // Advance the simulation by dt, holding the given actuator commands.  dt is
+  // subdivided into steps of at most step_size.
+  void advance(Duration dt, const PlantInputs &inputs, Duration step_size = DefaultStep);
+
+  const PlantOutputs &outputs() const { return outputs_; }
+  Time now() const { return now_; }
+
+  // Differential pressure that the venturi pressure sensor would read for the
+  // given flow.  The sign of the pressure follows the sign of the flow.
+  Pressure venturi_pressure_delta(VolumetricFlow flow) const;
+
+ private:
+  void step(float dt_sec, const PlantInputs &inputs);
+  Pressure muscle_pressure() const;
+
+  // Flow (l/s) through a Rohrer path with coefficients k1, k2 under pressure
+  // difference dp (cmH2O), and its derivative with respect to dp.
+  static float rohrer_flow(float k1, float k2, float dp);
+  static float rohrer_conductance(float k1, float k2, float dp);
+
+  PatientParams patient_;
+  PneumaticParams pneumatics_;
+  Time now_{microsSinceStartup(0)};
+
+  // States
+  float blower_speed_{0.0f};
+  float blower_valve_{0.0f};
+  float exhale_valve_{1.0f};
+  float lung_volume_ml_{0.0f};
+  float wye_pressure_cmH2O_{0.0f};
+
+  PlantOutputs outputs_;
+};
@@ -245,6 +245,16 @@ elif [ "$1" == "test" ]; then
   # Make sure integration tests build
   run_integration_tests
 
+  # Tests of concurrent code, with the thread sanitizer
+  clean_all
+  pio test -e native-tsan
+
+  # Native tests at the other control loop rates
+  for rate in 250 500 1000; do
+    clean_all
+    pio test -e native-${rate}hz
+  done
+
   # Controller unit tests on native
   # This must be the last thing built
   clean_all
@@ -18,6 +18,7 @@ static constexpr Duration Delay{milliseconds(1000)};
 
 void RunTest() {
   hal.Init();
+  hal.StepperMotorInit(/*keep_state=*/false);
   PinchValve pinch_valve(MotorIndex, "any", " for whatever");
   pinch_valve.Home();
 
@@ -20,6 +20,7 @@ static constexpr Duration Delay{milliseconds(1000)};
 
 void RunTest() {
   hal.Init();
+  hal.StepperMotorInit(/*keep_state=*/false);
 
   // Configure stepper
   StepMotor *stepper_motor = StepMotor::GetStepper(MotorIndex);
@@ -15,6 +15,10 @@ limitations under the License.
 
 #include "actuators.h"
 
+#include <algorithm>
+#include <array>
+#include <iterator>
+
 #include "hal.h"
 #include "pinch_valve.h"
 
@@ -46,3 +50,27 @@ void ActuatorsExecute(const ActuatorsState &desired_state) {
 
 // Return true if all actuators are enabled and ready for action
 bool AreActuatorsReady() { return blower_pinch.IsReady() && exhale_pinch.IsReady(); }
+
+static_assert(PinchValve::CalibrationSize == NVParams::WarmStart::PinchCalibrationSize);
+
+void ActuatorsSaveCalibration(NVParams::WarmStart *params) {
+  std::copy(blower_pinch.calibration().begin(), blower_pinch.calibration().end(),
+            params->blower_pinch_calibration);
+  std::copy(exhale_pinch.calibration().begin(), exhale_pinch.calibration().end(),
+            params->exhale_pinch_calibration);
+}
+
+bool ActuatorsWarmStart(const NVParams::WarmStart &params) {
+  std::array<float, PinchValve::CalibrationSize> table;
+  std::copy(std::begin(params.blower_pinch_calibration), std::end(params.blower_pinch_calibration),
+            table.begin());
+  blower_pinch.set_calibration(table);
+  std::copy(std::begin(params.exhale_pinch_calibration), std::end(params.exhale_pinch_calibration),
+            table.begin());
+  exhale_pinch.set_calibration(table);
+
+  // Try both valves, so that only those which need it are homed.
+  bool blower_restored = blower_pinch.RestoreHome();
+  bool exhale_restored = exhale_pinch.RestoreHome();
+  return blower_restored && exhale_restored;
+}
@@ -20,6 +20,8 @@ limitations under the License.
 
 #include <optional>
 
+#include "nvparams.h"
+
 struct ActuatorsState {
   // Valve setting for the FIO2 proportional solenoid
   // Range 0 to 1 where 0 is fully closed and 1 is fully open.
@@ -46,3 +48,13 @@ void ActuatorsExecute(const ActuatorsState &desired_state);
 // if they aren't (for example pinch valves are homing).
 // The system should be kept in a safe state until this returns true.
 bool AreActuatorsReady();
+
+// Copies the calibrations of the actuators to params, to be saved for warm
+// starts.
+void ActuatorsSaveCalibration(NVParams::WarmStart *params);
+
+// Restores the calibrations of the actuators from params, and gets the
+// actuators ready without going through their usual startup (homing the pinch
+// valves), if they kept their state through a warm reset.  Returns false if
+// some didn't, which then need to go through their usual startup.
+bool ActuatorsWarmStart(const NVParams::WarmStart &params);
@@ -16,6 +16,7 @@ limitations under the License.
 #include "blower_fsm.h"
 
 #include <algorithm>
+#include <cmath>
 
 #include "controller.h"
 #include "vars.h"
@@ -37,20 +38,28 @@ static Debug::Variable::Float dbg_pa_min_expire_ms(
     "before we're eligible to trigger a breath");
 
 // fast_flow_avg_alpha and slow_flow_avg_alpha were tuned for a control loop
-// that runs at a particular frequency.
+// running at 100Hz.
 //
-// In theory if the control loop gets slower, the alpha terms should get
-// bigger, placing more weight on newer readings, and similarly if the control
-// loop gets faster, the alpha terms should get smaller.  We've tried to encode
-// this here, although it remains to be seen if it actually works.
+// An exponentially-weighted average with coefficient alpha, updated every
+// loop period T, has a time constant of -T / ln(1 - alpha).  To keep the same
+// time constants (and therefore the same trigger sensitivity) whatever the
+// loop rate, the tuned alphas are rescaled to the actual loop period: after
+// n = TunedPeriod / T updates at the new rate, the old readings must have the
+// same weight as after one update at the tuned rate, i.e.
+//
+//   (1 - alpha)^n = 1 - tuned_alpha
+//
+static constexpr Duration TunedPeriod{milliseconds(10)};
+static float AlphaForLoopPeriod(float tuned_alpha) {
+  return 1.0f - std::pow(1.0f - tuned_alpha, Controller::GetLoopPeriod() / TunedPeriod);
+}
+
 static Debug::Variable::Float dbg_fast_flow_avg_alpha(
-    "fast_flow_avg_alpha", Debug::Variable::Access::ReadWrite,
-    0.2f * (Controller::GetLoopPeriod() / milliseconds(10)), "",
+    "fast_flow_avg_alpha", Debug::Variable::Access::ReadWrite, AlphaForLoopPeriod(0.2f), "",
     "alpha term in pressure assist mode's fast-updating "
     "exponentially-weighted average of flow");
 static Debug::Variable::Float dbg_slow_flow_avg_alpha(
-    "slow_flow_avg_alpha", Debug::Variable::Access::ReadWrite,
-    0.01f * (Controller::GetLoopPeriod() / milliseconds(10)), "",
+    "slow_flow_avg_alpha", Debug::Variable::Access::ReadWrite, AlphaForLoopPeriod(0.01f), "",
     "alpha term in pressure assist mode's slow-updating "
     "exponentially-weighted average of flow");
 
@@ -4,133 +4,64 @@
 #include <pb_decode.h>
 #include <pb_encode.h>
 
-#include <algorithm>
-#include <optional>
-
+#include "framed_uart.h"
 #include "hal.h"
 
-// Our outgoing (serialized) ControllerStatus proto is stored in tx_buffer.  We
-// then transmit it a few bytes at a time, as the serial port becomes
-// available.
+// Messages are exchanged with the GUI as frames (see framing.h), which the
+// HAL sends and receives through DMA (see framed_uart.h), so all we have to
+// do here is (de)serialize protos.
+static_assert(ControllerStatus_size <= FramedUart::MaxPayloadSize);
+static_assert(GuiStatus_size <= FramedUart::MaxPayloadSize);
+
+// We send a ControllerStatus whenever the serial port is ready to take one,
+// which means that the link to the GUI is kept busy: one frame is being sent
+// while the next one waits.  A ControllerStatus takes 10 to 20ms to send at
+// 115200 bauds, so the status the GUI receives can be up to about two of
+// those old: the time it waited behind the previous frame, plus its own.
 //
-// This isn't a circular buffer; the beginning of the proto is always at the
-// beginning of the buffer.
-static uint8_t tx_buffer[ControllerStatus_size];
-// Index of the next byte to transmit.
-static uint16_t tx_idx = 0;
-// Number of bytes remaining to transmit. tx_idx + tx_bytes_remaining equals
-// the size of the serialized ControllerStatus proto.
-static uint16_t tx_bytes_remaining = 0;
-
-// Time when we started sending the last ControllerStatus.
-static std::optional<Time> last_tx;
-
-// Our incoming (serialized) GuiStatus proto is incrementally buffered in
-// rx_buffer until it's complete and we can deserialize it to a proto.
-//
-// Like tx_buffer, this isn't a circular buffer; the beginning of the proto is
-// always at the beginning of the buffer.
-static uint8_t rx_buffer[GuiStatus_size];
-static uint16_t rx_idx = 0;
-static Time last_rx = hal.Now();
-static bool rx_in_progress = false;
-
-// We currently lack proper message framing, so we use a timeout to determine
-// when the GUI is done sending us its message.
-static constexpr Duration RxTimeout = milliseconds(1);
-
-// We send a ControllerStatus every TX_INTERVAL_MS.
-
-// In Alpha build we use synchronized communication initiated by GUI cycle
-// controller. Since both ControllerStatus and GuiStatus take roughly 300+
-// bytes, we need at least 1/115200.*10*300=26ms to transmit.
-static constexpr Duration TxInterval = milliseconds(30);
-
-void CommsInit() {}
-
-static bool IsTimeToProcessPacket() { return hal.Now() - last_rx > RxTimeout; }
-
-// NOTE this is work in progress.
-// Proper framing incomming. Afproto will be used to encode data to form that
-// can be safely sent over wire - with packet start/end markers and CRC
-
-// TODO add frame markers
-// TODO add marker escaping in contents
-// TODO add CRC to whole packet
-
-// TODO run this via DMA to free up resources for control loops
-static void ProcessTx(const ControllerStatus &controller_status) {
-  auto bytes_avail = hal.SerialBytesAvailableForWrite();
-  if (bytes_avail == 0) {
+// Each status also carries the waveform samples recorded since the previous
+// one, which are typically a handful: they are small enough that the link
+// keeps up with the control loop, except at 1kHz (see WaveformRecorder).
+static void ProcessTx(const ControllerStatus &controller_status, WaveformRecorder *waveforms) {
+  if (!rpi_uart.ready_to_send()) {
     return;
   }
 
-  // Serialize our current state into the buffer if
-  //  - we're not currently transmitting,
-  //  - we can transmit at least one byte now, and
-  //  - it's been a while since we last transmitted.
-  if (tx_bytes_remaining == 0 && (last_tx == std::nullopt || hal.Now() - *last_tx > TxInterval)) {
-    // Serialize current status into output buffer.
-    //
-    // TODO: Frame the message bytes.
-    // TODO: Add a checksum to the message.
-    pb_ostream_t stream = pb_ostream_from_buffer(tx_buffer, sizeof(tx_buffer));
-    if (!pb_encode(&stream, ControllerStatus_fields, &controller_status)) {
-      // TODO: Serialization failure; log an error or raise an alert.
-      return;
-    }
-    tx_idx = 0;
-    tx_bytes_remaining = static_cast<uint16_t>(stream.bytes_written);
-    last_tx = hal.Now();
+  ControllerStatus status = controller_status;
+  waveforms->take(&status.samples);
+
+  uint8_t tx_buffer[ControllerStatus_size];
+  pb_ostream_t stream = pb_ostream_from_buffer(tx_buffer, sizeof(tx_buffer));
+  if (!pb_encode(&stream, ControllerStatus_fields, &status)) {
+    // TODO: Serialization failure; log an error or raise an alert.
+    return;
   }
+  (void)rpi_uart.send(tx_buffer, static_cast<uint32_t>(stream.bytes_written));
 
   // TODO: Alarm if we haven't been able to send a status in a certain amount
   // of time.
-
-  // Send bytes over the wire if any are in our buffer.
-  if (tx_bytes_remaining > 0) {
-    // TODO(jlebar): Change SerialWrite to take a uint8* instead of a char*, so
-    // it matches nanopb.
-    uint16_t bytes_written = hal.SerialWrite(reinterpret_cast<char *>(tx_buffer) + tx_idx,
-                                             std::min(bytes_avail, tx_bytes_remaining));
-    // TODO: How paranoid should we be about this underflowing?  Perhaps we
-    // should reset the device if this or other invariants are violated?
-    tx_bytes_remaining = static_cast<uint16_t>(tx_bytes_remaining - bytes_written);
-    tx_idx = static_cast<uint16_t>(tx_idx + bytes_written);
-  }
 }
 
 static void ProcessRx(GuiStatus *gui_status) {
-  while (hal.SerialBytesAvailableForRead() > 0) {
-    rx_in_progress = true;
-    char b;
-    uint16_t bytes_read = hal.SerialRead(&b, 1);
-    if (bytes_read == 1) {
-      rx_buffer[rx_idx++] = (uint8_t)b;
-      if (rx_idx >= sizeof(rx_buffer)) {
-        rx_idx = 0;
-        break;
-      }
-      last_rx = hal.Now();
-    }
+  uint8_t rx_buffer[GuiStatus_size];
+  uint32_t length = rpi_uart.receive(rx_buffer, sizeof(rx_buffer));
+  if (length == 0) {
+    return;
   }
 
-  // TODO do away with timeout-based reception once we have framing in place,
-  // but it will work for Alpha build for now
-  if (rx_in_progress && IsTimeToProcessPacket()) {
-    pb_istream_t stream = pb_istream_from_buffer(rx_buffer, rx_idx);
-    GuiStatus new_gui_status = GuiStatus_init_zero;
-    if (pb_decode(&stream, GuiStatus_fields, &new_gui_status)) {
-      *gui_status = new_gui_status;
-    } else {
-      // TODO: Log an error.
-    }
-    rx_idx = 0;
-    rx_in_progress = false;
+  pb_istream_t stream = pb_istream_from_buffer(rx_buffer, length);
+  GuiStatus new_gui_status = GuiStatus_init_zero;
+  if (pb_decode(&stream, GuiStatus_fields, &new_gui_status)) {
+    *gui_status = new_gui_status;
+  } else {
+    // TODO: Log an error.
   }
 }
 
-void CommsHandler(const ControllerStatus &controller_status, GuiStatus *gui_status) {
-  ProcessTx(controller_status);
+void CommsInit() {}
+
+void CommsHandler(const ControllerStatus &controller_status, WaveformRecorder *waveforms,
+                  GuiStatus *gui_status) {
+  ProcessTx(controller_status, waveforms);
   ProcessRx(gui_status);
 }
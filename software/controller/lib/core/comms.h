@@ -18,6 +18,7 @@ limitations under the License.
 #include <stdint.h>
 
 #include "network_protocol.pb.h"
+#include "waveform_recorder.h"
 
 // This module periodically sends messages to the GUI device and receives
 // messages from the GUI.  The only way it communicates with other modules is
@@ -26,6 +27,8 @@ limitations under the License.
 void CommsInit();
 
 // `controller_status` should be the controller's current status.  It's sent
-// periodically to the GUI.  When we receive a message from the GUI, we update
-// gui_status accordingly.
-void CommsHandler(const ControllerStatus &controller_status, GuiStatus *gui_status);
+// periodically to the GUI, along with the waveform samples recorded since the
+// previous one.  When we receive a message from the GUI, we update gui_status
+// accordingly.
+void CommsHandler(const ControllerStatus &controller_status, WaveformRecorder *waveforms,
+                  GuiStatus *gui_status);
@@ -17,9 +17,7 @@ limitations under the License.
 
 #include <math.h>
 
-static constexpr Duration LoopPeriod = milliseconds(10);
-
-/*static*/ Duration Controller::GetLoopPeriod() { return LoopPeriod; }
+/*static*/ Duration Controller::GetLoopPeriod() { return ControlLoopPeriod; }
 
 std::pair<ActuatorsState, ControllerState> Controller::Run(Time now, const VentParams &params,
                                                            const SensorReadings &sensor_readings) {
@@ -17,8 +17,11 @@ limitations under the License.
 
 #include "vars.h"
 
-// TODO: VolumeIntegrationInterval was not chosen carefully.
-static constexpr Duration VolumeIntegrationInterval = milliseconds(5);
+// Volume is integrated on every control loop cycle.  Half a loop period
+// leaves room for the jitter of the loop timer, while ignoring extra samples
+// if AddFlow is ever called more often.
+static constexpr Duration VolumeIntegrationInterval =
+    microseconds(ControlLoopPeriod.microseconds() / 2);
 
 FlowIntegrator::FlowIntegrator() = default;
 
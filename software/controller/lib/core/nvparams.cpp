@@ -41,22 +41,56 @@ static Debug::Variable::UInt32 dbg_serial("0_ventilator_serial_number",
                                           Debug::Variable::Access::ReadWrite, 0, "",
                                           "Serial number of the ventilator, in EEPROM");
 
+static Debug::Variable::UInt32 dbg_warm_start(
+    "warm_start", Debug::Variable::Access::ReadWrite, 0, "",
+    "Set to 1 to skip homing and calibration after a watchdog or software reset, reusing those of"
+    " the last cold start");
+
 static Debug::Variable::UInt32 dbg_nvparams("nvparams_address", Debug::Variable::Access::ReadOnly,
                                             0, "", "Address of nv_params");
 
 namespace NVParams {
 
+bool WarmStart::plausible() const {
+  if (calibrated != 1) return false;
+  // Sensors output between 0 and the A/D reference.
+  for (float zero : sensor_zeros) {
+    if (!(zero >= 0 && zero <= 3.3f)) return false;
+  }
+  for (const float *table : {blower_pinch_calibration, exhale_pinch_calibration}) {
+    if (!(table[0] >= 0 && table[PinchCalibrationSize - 1] <= 1)) return false;
+    for (size_t i = 1; i < PinchCalibrationSize; ++i) {
+      if (!(table[i] >= table[i - 1])) return false;
+    }
+  }
+  return true;
+}
+
 // Size of the parameter block including the header
 static constexpr uint32_t Size{sizeof(Structure)};
 
-// Calculate the CRC of the params at this address
-static uint32_t CRC(Structure *param) {
+// Calculate the CRC of the params at this address, given the size of their version
+static uint32_t CRC(Structure *param, uint32_t size = Size) {
   uint8_t *ptr = reinterpret_cast<uint8_t *>(param);
-  return soft_crc32(ptr + sizeof(uint32_t), Size - sizeof(uint32_t));
+  return soft_crc32(ptr + sizeof(uint32_t), size - static_cast<uint32_t>(sizeof(uint32_t)));
 }
 
-// Checks whether a param is valid (through its checksum)
-static bool IsValid(Structure *param) { return param->crc == CRC(param); };
+// Checks whether a param is valid (through its checksum), in the current
+// version or a previous one which can be migrated.
+static bool IsValid(Structure *param) {
+  switch (param->version) {
+    case 0:
+      return param->crc == CRC(param, sizeof(StructureV0));
+    case Version:
+      return param->crc == CRC(param);
+    default:
+      return false;
+  }
+}
+
+// Params of version 0 are read into a Structure, so the fields they had must stay where they were.
+static_assert(offsetof(StructureV0, version) == offsetof(Structure, version));
+static_assert(offsetof(StructureV0, last_settings) == offsetof(Structure, last_settings));
 
 // One time init of non-volatile parameter area.
 // This must not be done when a watchdog is enabled, as it blocks
@@ -105,6 +139,9 @@ void Handler::Init(I2Ceeprom *eeprom) {
     nv_param_.reinit = 1;
     linked_to_eeprom_ = false;
   }
+  if (nv_param_.reinit != 1 && nv_param_.version != Version) {
+    Migrate();
+  }
   if (nv_param_.reinit == 1) {
     // Write the correct structure with init values to both sides in case
     // a reinit is needed (debug-user request or no valid params found)
@@ -119,12 +156,32 @@ void Handler::Init(I2Ceeprom *eeprom) {
   // handler to reset those to their default values in nv_params
   dbg_reinit.set(nv_param_.reinit);
   dbg_serial.set(nv_param_.vent_serial_number);
+  dbg_warm_start.set(nv_param_.warm_start.enabled);
   // increase power cycles counter in nv_params
   uint32_t counter = nv_param_.power_cycles + 1;
   Set(offsetof(Structure, power_cycles), &counter, 4);
 }
 
-bool Handler::Set(uint16_t offset, void *value, uint8_t len) {
+// Converts params of a previous version to the current one, keeping the serial
+// number, counters and last settings, while the parameters added since then
+// get their init values.  Both sides are rewritten, so that they are valid in
+// the current version, and more recent than the old params.
+void Handler::Migrate() {
+  Structure migrated;
+  migrated.count = static_cast<uint8_t>(nv_param_.count + 1);
+  migrated.vent_serial_number = nv_param_.vent_serial_number;
+  migrated.power_cycles = nv_param_.power_cycles;
+  migrated.cumulated_service = nv_param_.cumulated_service;
+  migrated.last_settings = nv_param_.last_settings;
+  migrated.crc = CRC(&migrated);
+  nv_param_ = migrated;
+  if (linked_to_eeprom_) {
+    WriteFullParams(Address::Flip);
+    WriteFullParams(Address::Flop);
+  }
+}
+
+bool Handler::Set(uint16_t offset, void *value, uint16_t len) {
   // Make sure the passed pointer is pointing to somewhere
   // in the structure and isn't in the reserved first 6 bytes
   if ((offset < 6) || ((offset + len) > Size)) return false;
@@ -159,7 +216,7 @@ bool Handler::Set(uint16_t offset, void *value, uint8_t len) {
   return true;
 }
 
-bool Handler::Get(uint16_t offset, void *value, uint8_t len) {
+bool Handler::Get(uint16_t offset, void *value, uint16_t len) {
 #ifndef TEST_MODE  // in test mode I need to be able to access any byte
   // Make sure the passed pointer is pointing to somewhere
   // in the structure and isn't in the reserved first 6 bytes
@@ -205,6 +262,10 @@ void Handler::Update(const Time now, VentParams *params) {
   if (serial != nv_param_.vent_serial_number) {
     Set(offsetof(Structure, vent_serial_number), &serial, 4);
   }
+  uint8_t warm_start = static_cast<uint8_t>(dbg_warm_start.get());
+  if (warm_start != nv_param_.warm_start.enabled) {
+    Set(offsetof(Structure, warm_start.enabled), &warm_start, 1);
+  }
 }
 
 // This method must not be called when a watchdog is looking as it blocks
@@ -19,18 +19,45 @@ limitations under the License.
 #include <stdint.h>
 
 #include "eeprom.h"
+#include "flow_table.h"
 #include "network_protocol.pb.h"
 #include "units.h"
 
 namespace NVParams {
 
+// Calibrations made on a cold start, which let the controller skip them when it restarts after a
+// watchdog or software reset (a warm start, see BackgroundLoop in main.cpp).
+struct WarmStart {
+  static constexpr size_t NumSensorZeros{5};         // Keep in sync with Sensor in sensors.h
+  static constexpr size_t PinchCalibrationSize{11};  // Keep in sync with PinchValve
+
+  uint8_t enabled{0};  // Warm starts are optional: set through the warm_start debug variable.
+  // Set once the calibrations below are made, and cleared at the start of each cold start so that
+  // a reset during calibration doesn't leave stale ones behind.
+  uint8_t calibrated{0};
+  uint8_t reserved[2] = {};
+
+  float sensor_zeros[NumSensorZeros] = {};  // Volts, in the order of the Sensor enum
+  float blower_pinch_calibration[PinchCalibrationSize] = {};
+  float exhale_pinch_calibration[PinchCalibrationSize] = {};
+
+  // Returns true if the calibrations are there and make sense: sensor zeros within the A/D range,
+  // and pinch valve tables within [0, 1] and not decreasing.
+  bool plausible() const;
+};
+
+// Version of the layout below.  Bump it whenever the layout changes, and migrate the params of
+// the previous versions in Handler::Init, so that units in the field keep their serial number and
+// counters.
+inline constexpr uint8_t Version{1};
+
 // This structure defines the layout of the non-volatile
 // parameter info stored in the I²C EEPROM.
 struct Structure {
   // Header info used to keep track of parameter info
-  uint32_t crc{0};     // 32-bit CRC of remaining structure
-  uint8_t count{0};    // Incremented on each write.
-  uint8_t version{0};  // Version of the structure.
+  uint32_t crc{0};           // 32-bit CRC of remaining structure
+  uint8_t count{0};          // Incremented on each write.
+  uint8_t version{Version};  // Version of the structure.
 
   uint8_t reinit{0};  // Write to 1 (through dbg_reinit) to request for a reinit
                       // on next boot. This should prove useful if our system
@@ -44,6 +71,27 @@ struct Structure {
   uint32_t cumulated_service{0};  // Cumulated power-ON time, stored in seconds.
                                   // May rollover after 136 years
   VentParams last_settings = VentParams_init_default;  // Last settings seen by the vent
+
+  // Calibrated flow tables of the venturis of this unit (see Sensors::load_flow_tables)
+  FlowTable air_influx_flow_table;
+  FlowTable oxygen_influx_flow_table;
+  FlowTable outflow_flow_table;
+
+  WarmStart warm_start;
+};
+
+// Layout of version 0 of the structure, before the flow tables and warm start calibrations were
+// added.  Only used to migrate params of that version.
+struct StructureV0 {
+  uint32_t crc{0};
+  uint8_t count{0};
+  uint8_t version{0};
+  uint8_t reinit{0};
+  uint8_t reserved{0};
+  uint32_t vent_serial_number{0};
+  uint32_t power_cycles{0};
+  uint32_t cumulated_service{0};
+  VentParams last_settings = VentParams_init_default;
 };
 
 // We are reserving the first 8 kB out of our 32kB eeprom for nv params.
@@ -63,8 +111,8 @@ class Handler {
  public:
   Handler() = default;
   void Init(I2Ceeprom *eeprom);
-  bool Set(uint16_t offset, void *value, uint8_t len);
-  bool Get(uint16_t offset, void *value, uint8_t len);
+  bool Set(uint16_t offset, void *value, uint16_t len);
+  bool Get(uint16_t offset, void *value, uint16_t len);
   void Update(Time now, VentParams *params);
 
  private:
@@ -80,6 +128,7 @@ class Handler {
                                   // data to the eeprom, even if we will still
                                   // update contents in our internal memory.
 
+  void Migrate();
   void WriteFullParams(Address address);
   bool ReadFullParams(Address address, Structure *param, I2Ceeprom *eeprom);
 };
@@ -17,8 +17,6 @@ limitations under the License.
 
 #include <algorithm>
 #include <array>
-#include <cfloat>
-#include <cmath>
 
 #include "hal.h"
 
@@ -84,6 +82,38 @@ void PinchValve::Disable() {
   mtr->HardDisable();
 }
 
+bool PinchValve::RestoreHome() {
+  StepMotor *mtr = StepMotor::GetStepper(motor_index_);
+  if (!mtr) return false;
+
+  // The driver's outputs are disabled from the time it's reset until
+  // the valve is homed, and on faults.
+  StepperStatus status;
+  if (mtr->GetStatus(&status) != StepMtrErr::Ok) return false;
+  if (!status.enabled || status.thermal_shutdown || status.over_current) return false;
+
+  // The motor may have been moving when the controller was reset, and the
+  // driver keeps running a streamed move (see StepMotor::StreamPos) until
+  // told otherwise.  Stop it where it is.
+  if (mtr->HardStop() != StepMtrErr::Ok) return false;
+
+  // Valve positions range from the zero position (fully open) to
+  // -MaxMove (fully closed), give or take a few degrees.
+  static constexpr float Tolerance = 5.0f;
+  float pos;
+  if (mtr->GetPosition(&pos) != StepMtrErr::Ok) return false;
+  if (pos < std::min(0.0f, -MaxMove) - Tolerance || pos > std::max(0.0f, -MaxMove) + Tolerance)
+    return false;
+
+  // The driver kept the normal speed/accel settings, but the motor's record
+  // of them (see StepMotor::StreamPos) started over.
+  if (mtr->SetMaxSpeed(MoveVel) != StepMtrErr::Ok) return false;
+  if (mtr->SetAccel(MoveAccel) != StepMtrErr::Ok) return false;
+
+  home_state_ = PinchValveHomeState::Homed;
+  return true;
+}
+
 // This runs through the homing procedure.  The pinch valves need
 // to be homed before they can be used, and this needs to be done
 // any time the valve is first enabled
@@ -196,20 +226,10 @@ void PinchValve::SetOutput(float value) {
   float pos = (value - 1.0f) * MaxMove;
 
   // Once you put a move in motion you can't change the destination position
-  // until the move ends. That means that if the servo loop commands a
-  // relatively large move of the valve in one cycle, then any new commands
-  // will be ignored until that move finishes. This can cause the pinch valve
-  // to oscillate if you turn the gains up too high.
-  //
-  // To fix this, we hard-stop the valve before sending a new position. This
-  // doesn't do anything if the valve was already stopped, but if it was in the
-  // middle of a big move it tells it to abandon that old move and start a new
-  // move to the new commanded position.
-  //
-  // This seems to really smooth out the pinch valve motion and allow for
-  // higher gains.
-  if (fabsf(pos - last_command_) > FLT_EPSILON) mtr->HardStop();
-
-  last_command_ = pos;
-  mtr->GotoPos(pos);
+  // until the move ends, so starting a move to each new position would make
+  // the valve lag behind (or oscillate with high gains), unless the previous
+  // move is hard-stopped first.  Streaming the positions instead keeps the
+  // motor running toward the latest one, and only sends the motor driver
+  // velocity changes.
+  mtr->StreamPos(pos);
 }
@@ -15,6 +15,8 @@ limitations under the License.
 
 #pragma once
 
+#include <array>
+
 #include "stepper.h"
 #include "units.h"
 #include "vars.h"
@@ -71,6 +73,25 @@ class PinchValve {
   // before it can be used
   void Disable();
 
+  // Makes the valve ready without homing it, if its
+  // motor driver kept the position and settings from
+  // a homing done before the controller was reset (see
+  // StepMotor::OneTimeInit).  The valve is stopped where
+  // it is if it was moving.  It's left as is, and false
+  // returned, if the driver doesn't look like it kept its
+  // state.
+  //
+  // This should be called at startup from the background
+  // loop, instead of homing the valve.
+  bool RestoreHome();
+
+  // Table used to linearize the valve output, see calibration_.
+  static constexpr size_t CalibrationSize{11};
+  const std::array<float, CalibrationSize> &calibration() const { return calibration_.data; }
+  void set_calibration(const std::array<float, CalibrationSize> &table) {
+    calibration_.data = table;
+  }
+
   // Return true if the pinch valve is ready for action
   bool IsReady() { return home_state_ == PinchValveHomeState::Homed; }
 
@@ -80,8 +101,6 @@ class PinchValve {
   // \todo test invalid initialization?
   int motor_index_{-1};
 
-  float last_command_{-1.0f};
-
   PinchValveHomeState home_state_{PinchValveHomeState::Disabled};
 
   // This table is used to roughly linearize the pinch valve output.  It was built by adjusting the
@@ -89,5 +108,5 @@ class PinchValve {
   // valve settings for a list of equally spaced flow rates.  The first entry should be the setting
   // for 0 flow rate (normally 0) and the last entry should be the setting for 100% flow rate. The
   // minimum length of the table is 2 entries.
-  Debug::Variable::FloatArray<11> calibration_;
+  Debug::Variable::FloatArray<CalibrationSize> calibration_;
 };
@@ -66,15 +66,56 @@ void Sensors::calibrate() {
   fio2_sensor_.set_zero(hal);
 }
 
+static_assert(NVParams::WarmStart::NumSensorZeros == NumSensors);
+
+std::array<AnalogSensor *, NumSensors> Sensors::analog_sensors() {
+  return {&patient_pressure_sensor_, &air_influx_sensor_dp_, &oxygen_influx_sensor_dp_,
+          &outflow_sensor_dp_, &fio2_sensor_};
+}
+
+void Sensors::save_zeros(NVParams::WarmStart *params) {
+  auto sensors = analog_sensors();
+  for (size_t i = 0; i < NumSensors; ++i) params->sensor_zeros[i] = sensors[i]->zero().volts();
+}
+
+void Sensors::restore_zeros(const NVParams::WarmStart &params) {
+  auto sensors = analog_sensors();
+  for (size_t i = 0; i < NumSensors; ++i) sensors[i]->set_zero(volts(params.sensor_zeros[i]));
+}
+
+std::array<Sensors::VenturiTable, 3> Sensors::venturi_tables() {
+  return {{
+      {&air_influx_sensor_, offsetof(NVParams::Structure, air_influx_flow_table)},
+      {&oxygen_influx_sensor_, offsetof(NVParams::Structure, oxygen_influx_flow_table)},
+      {&outflow_sensor_, offsetof(NVParams::Structure, outflow_flow_table)},
+  }};
+}
+
+void Sensors::load_flow_tables(NVParams::Handler *nv_params) {
+  for (auto [sensor, nv_offset] : venturi_tables()) {
+    FlowTable table;
+    if (nv_params->Get(static_cast<uint16_t>(nv_offset), &table, sizeof(table))) {
+      sensor->set_flow_table(table);
+    }
+  }
+}
+
+void Sensors::update_flow_tables(NVParams::Handler *nv_params) {
+  for (auto [sensor, nv_offset] : venturi_tables()) {
+    FlowTable table;
+    if (!sensor->flow_table_edited(&table)) continue;
+    {
+      // The control loop may be reading the sensor.
+      BlockInterrupts block;
+      sensor->set_flow_table(table);
+    }
+    nv_params->Set(static_cast<uint16_t>(nv_offset), &table, sizeof(table));
+  }
+}
+
 /// \TODO: Add alarms if sensor value is out of expected range?
 
 SensorReadings Sensors::get_readings() const {
-  //@TODO: Potential Caution: Density of air slightly varies over temperature and
-  // altitude - need mechanism to adjust based on delivery? Constant involving
-  // density of air. Density assumed at 15 deg. Celsius and 1 atm of pressure.
-  // Sourced from https://en.wikipedia.org/wiki/Density_of_air
-  static constexpr float AirDensity{1.225f};  // kg/m^3
-
   // Assuming ambient pressure of 101.3 kPa
   // TODO: measure ambient pressure from an additional sensor
   //  and/or estimate from user input (from altitude?)
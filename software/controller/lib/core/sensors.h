@@ -15,6 +15,9 @@ limitations under the License.
 
 #pragma once
 
+#include <array>
+
+#include "nvparams.h"
 #include "oxygen.h"
 #include "pressure_sensors.h"
 #include "venturi.h"
@@ -61,13 +64,23 @@ class Sensors {
   // are called.
   void calibrate();
 
+  // Copies the sensor zeros found by calibrate() to params, to be saved for warm starts.
+  void save_zeros(NVParams::WarmStart *params);
+
+  // Restores sensor zeros saved by save_zeros, instead of calibrating.
+  void restore_zeros(const NVParams::WarmStart &params);
+
+  // Makes the venturi flow sensors use the calibrated flow tables stored in non-volatile
+  // parameters, if any.  Call this on startup, once the parameters are initialized.
+  void load_flow_tables(NVParams::Handler *nv_params);
+
+  // Applies the flow tables changed through debug variables (at the end of a calibration run),
+  // and stores them in non-volatile parameters.  Call this periodically from the background loop.
+  void update_flow_tables(NVParams::Handler *nv_params);
+
   // Read the sensors.
   SensorReadings get_readings() const;
 
- private:
-  /// \TODO: get this either from ADC constants header or something like that
-  static constexpr float ADCVoltageRange{3.3f};
-
   // \TODO: create a physical constants header for custom parts like venturi
   // Diameters and correction coefficient relating to 3/4in Venturi, see https://bit.ly/2ARuReg.
   // Correction factor of 0.97 is based on ISO recommendations for Reynolds of roughly 10^4 and
@@ -80,6 +93,26 @@ class Sensors {
   static_assert(VenturiPortDiameter > VenturiChokeDiameter);
   static_assert(VenturiChokeDiameter > meters(0));
 
+  //@TODO: Potential Caution: Density of air slightly varies over temperature and
+  // altitude - need mechanism to adjust based on delivery? Constant involving
+  // density of air. Density assumed at 15 deg. Celsius and 1 atm of pressure.
+  // Sourced from https://en.wikipedia.org/wiki/Density_of_air
+  constexpr static float AirDensity{1.225f};  // kg/m^3
+
+ private:
+  // Each venturi with the offset of its table in the non-volatile parameters.
+  struct VenturiTable {
+    VenturiFlowSensor *sensor;
+    size_t nv_offset;
+  };
+  std::array<VenturiTable, 3> venturi_tables();
+
+  // Sensors with a zero, in the order of the Sensor enum.
+  std::array<AnalogSensor *, NumSensors> analog_sensors();
+
+  /// \TODO: get this either from ADC constants header or something like that
+  static constexpr float ADCVoltageRange{3.3f};
+
   // Fundamental sensors
   MPXV5010DP patient_pressure_sensor_{"patient_pressure_", "for patient airway pressure",
                                       sensor_pin(Sensor::PatientPressure), ADCVoltageRange};
@@ -0,0 +1,60 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "waveform_recorder.h"
+
+void WaveformRecorder::record(Time now, const WaveformSample &sample) {
+  uint32_t cycle = cycle_++;
+  uint32_t head = head_;
+  if (head - tail_ >= Capacity) {
+    ++dropped_;
+    return;
+  }
+  entries_[head % Capacity] = {
+      .sample = sample,
+      .micros_since_startup = now.microsSinceStartup(),
+      .cycle = cycle,
+  };
+  head_ = head + 1;
+}
+
+uint32_t WaveformRecorder::take(SampleBatch *batch) {
+  WaveformSample samples[SampleBatchCapacity];
+  uint64_t first_sample_micros = 0;
+  uint32_t count = 0;
+  {
+    // record() is called from an interrupt, which must not see the samples
+    // we are copying as free.
+    BlockInterrupts block;
+    uint32_t tail = tail_;
+    uint32_t first_cycle = entries_[tail % Capacity].cycle;
+    first_sample_micros = entries_[tail % Capacity].micros_since_startup;
+    while (tail + count != head_ && count < SampleBatchCapacity) {
+      const Entry &entry = entries_[(tail + count) % Capacity];
+      // Stop at a gap left by dropped samples, since the batch only has room
+      // for the time of its first sample.
+      if (entry.cycle != first_cycle + count) break;
+      samples[count++] = entry.sample;
+    }
+    tail_ = tail + count;
+  }
+  return pack_samples(samples, count, first_sample_micros,
+                      static_cast<uint32_t>(ControlLoopPeriod.microseconds()), batch);
+}
+
+uint32_t WaveformRecorder::size() const {
+  BlockInterrupts block;
+  return head_ - tail_;
+}
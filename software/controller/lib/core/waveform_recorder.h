@@ -0,0 +1,76 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "hal.h"
+#include "network_protocol.pb.h"
+#include "sample_batch.h"
+
+// Records the waveforms sampled on every control loop cycle, so that comms
+// can send all of them to the GUI, in batches, rather than only the latest
+// values whenever it gets to send a ControllerStatus.
+//
+// Samples are kept in a ring buffer which HighPriorityTask writes to, and the
+// main loop reads from.  If the main loop doesn't keep up, new samples are
+// dropped until there is room for them again.
+//
+// The link to the GUI keeps up at loop rates up to 500Hz.  At 1kHz it can't:
+// a status with a full batch of typical samples (about 6 bytes each) takes
+// about 17ms to send at 115200 bauds, during which 17 samples are recorded.
+// The buffer then stays full, and roughly one sample in ten is dropped (see
+// dropped()), leaving gaps in the waveforms the GUI draws.  A bigger buffer
+// would only delay this.
+class WaveformRecorder {
+ public:
+  // Enough for a few frames worth of samples, to absorb the jitter of the
+  // main loop and the link.
+  static constexpr uint32_t Capacity{64};
+  static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+  // Records the sample taken on the current control loop cycle.
+  // Must be called from HighPriorityTask, once per cycle.
+  void record(Time now, const WaveformSample &sample);
+
+  // Packs the oldest recorded samples into batch, as many as fit and as long
+  // as they were taken on consecutive cycles, and forgets about them.
+  // Must be called from the main loop.
+  // Returns the number of samples packed.
+  uint32_t take(SampleBatch *batch);
+
+  // Number of samples currently recorded.
+  uint32_t size() const;
+  // Number of samples dropped because the buffer was full.
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  struct Entry {
+    WaveformSample sample;
+    uint64_t micros_since_startup;
+    // Index of the control loop cycle this sample was taken on, to know if
+    // samples are consecutive.
+    uint32_t cycle;
+  };
+
+  Entry entries_[Capacity];
+  // Free-running indexes: entries_[tail_ % Capacity] is the oldest sample,
+  // and head_ - tail_ is the number of samples recorded.
+  volatile uint32_t head_{0};
+  volatile uint32_t tail_{0};
+  uint32_t cycle_{0};
+  volatile uint32_t dropped_{0};
+};
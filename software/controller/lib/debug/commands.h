@@ -93,6 +93,26 @@ class PokeHandler : public MemoryHandler {
 //    trace period
 //  CountSamples - Used to get the number of samples currently in the trace
 //    buffer
+//  StartStreaming - Used to start recording in streaming mode, in which the
+//    interface sends trace data as it is recorded (see interface.h)
+//  GetResolution followed by var index (1 byte) - Used to get the resolution
+//    of a traced float variable
+//  SetResolution followed by var index (1 byte) and resolution (float, 4
+//    bytes) - Used to set the resolution of a traced float variable
+//  SetTrigger followed by variable ID (2 bytes), condition (1 byte, see
+//    Trigger::Condition) and level (4 bytes, in the variable's type) - Used
+//    to set up the trigger condition, which Start then waits for
+//  GetTrigger - Used to get the trigger variable ID, condition and level
+//  SetTriggerPosition followed by pre-trigger fraction (float, 4 bytes) and
+//    number of post-trigger samples (4 bytes) - Used to set the position of
+//    the trigger in the captured trace
+//  GetTriggerPosition - Used to get the pre-trigger fraction and number of
+//    post-trigger samples
+//  GetTriggerStatus - Used to get the trigger state (1 byte, see
+//    Trace::TriggerState) and the index of the triggering sample (4 bytes)
+//
+// Trace data is downloaded in the compact form described in trace_codec.h,
+// each response starting from a reference sample of zeros.
 
 class TraceHandler : public Handler {
  public:
@@ -108,13 +128,28 @@ class TraceHandler : public Handler {
     SetVarId = 0x05,  // set traced variable id
     GetPeriod = 0x06,
     SetPeriod = 0x07,
-    CountSamples = 0x08,  // get number of samples in the trace buffer
+    CountSamples = 0x08,        // get number of samples in the trace buffer
+    StartStreaming = 0x09,      // start tracing data and sending it as it comes
+    GetResolution = 0x0A,       // get traced float variable resolution
+    SetResolution = 0x0B,       // set traced float variable resolution
+    SetTrigger = 0x0C,          // set trigger condition
+    GetTrigger = 0x0D,          // get trigger condition
+    SetTriggerPosition = 0x0E,  // set pre-trigger fraction and post-trigger samples
+    GetTriggerPosition = 0x0F,  // get pre-trigger fraction and post-trigger samples
+    GetTriggerStatus = 0x10,    // get trigger state and triggering sample index
   };
 
  private:
   ErrorCode ReadTraceBuffer(Context *context);
   ErrorCode SetTraceVar(Context *context);
   ErrorCode GetTraceVar(Context *context);
+  ErrorCode SetResolution(Context *context);
+  ErrorCode GetResolution(Context *context);
+  ErrorCode SetTrigger(Context *context);
+  ErrorCode GetTrigger(Context *context);
+  ErrorCode SetTriggerPosition(Context *context);
+  ErrorCode GetTriggerPosition(Context *context);
+  ErrorCode GetTriggerStatus(Context *context);
   Trace *trace_{nullptr};
 };
 
@@ -140,16 +175,52 @@ class TraceHandler : public Handler {
 //
 //  GetCount - Used to know how many debug variables are currently active
 //
+//  GetMultiple - Read the values of several variables at once.
+//
+//             Input data is the 16-bit index (in the list) of the first
+//             variable to read, followed by the list of 16-bit variable IDs.
+//             An empty list stands for all variables, in ID order.
+//             The output is the 16-bit index of the first variable that
+//             didn't fit in the response, followed by the values of the
+//             variables that did, packed in list order (each value is
+//             serialized as in Get).  If that index is less than the length
+//             of the list, the client asks for the rest with another request,
+//             starting from that index.
+//
+//  SetMultiple - Set the values of several variables at once.
+//
+//             Input data is a sequence of 16-bit variable IDs, each followed
+//             by the variable's value (serialized as in Set).  Either all
+//             variables are set, or none if an error is returned.
+//
+//  GetInfoMultiple - Read info about as many variables as fit in a response.
+//
+//             Input data is the 16-bit ID of the first variable.
+//             The output is the 16-bit ID of the first variable that didn't
+//             fit in the response (the variable count once all are read),
+//             followed by the info of the variables that did, formatted as in
+//             GetInfo.  Since each info starts with the length of its
+//             strings, the client can split them.
+//
+//  GetFingerprint - Returns a 32-bit hash of the metadata of all variables.
+//
+//             Clients can cache the metadata they read, and skip reading it
+//             again as long as the fingerprint stays the same.
+//
 class VarHandler : public Handler {
  public:
   VarHandler() = default;
   ErrorCode Process(Context *context) override;
 
   enum class Subcommand : uint8_t {
-    GetInfo = 0x00,   // get variable info (name, type, help string)
-    Get = 0x01,       // get variable value
-    Set = 0x02,       // set variable value
-    GetCount = 0x03,  // get count of active vars
+    GetInfo = 0x00,          // get variable info (name, type, help string)
+    Get = 0x01,              // get variable value
+    Set = 0x02,              // set variable value
+    GetCount = 0x03,         // get count of active vars
+    GetMultiple = 0x04,      // get values of a list of variables (or all of them)
+    SetMultiple = 0x05,      // set values of a list of variables
+    GetInfoMultiple = 0x06,  // get info of consecutive variables
+    GetFingerprint = 0x07,   // get hash of the info of all variables
   };
 
  private:
@@ -165,6 +236,14 @@ class VarHandler : public Handler {
   ErrorCode SetVar(Context *context);
 
   ErrorCode GetVarCount(Context *context);
+
+  ErrorCode GetMultipleVars(Context *context);
+
+  ErrorCode SetMultipleVars(Context *context);
+
+  ErrorCode GetMultipleVarInfo(Context *context);
+
+  ErrorCode GetRegistryFingerprint(Context *context);
 };
 
 // Eeprom command.
@@ -27,6 +27,12 @@ enum class State { AwaitingCommand, Processing, AwaitingResponse, Responding };
 // See debug.cpp for a detailed description of how this works
 enum class SpecialChar : uint8_t { Escape = 0xf1, EndTransfer = 0xf2 };
 
+// Packets the interface sends on its own initiative (as opposed to responses
+// to commands) start with one of these codes in place of the error code.
+enum class StreamCode : uint8_t {
+  TraceData = 0x80,  // Trace samples, sent while tracing in streaming mode
+};
+
 enum class ErrorCode : uint8_t {
   None = 0x00,             // No error (=success)
   CrcError = 0x01,         // CRC error on command
@@ -43,13 +43,10 @@ Interface::Interface(Trace *trace, int count, ...) {
 bool Interface::Poll() {
   switch (state_) {
     // Waiting for a new command to be received.
-    // I continue to process bytes until there are no more available,
-    // or a full command has been received.  Either way, the
-    // ReadNextByte function will return false when its time
-    // to move on.
+    // I process all available bytes, until a full command has been received.
+    // Trace data is only streamed in between commands.
     case State::AwaitingCommand:
-      while (ReadNextByte()) {
-      }
+      if (!ReadRequest()) (void)MaybeStreamTrace();
       return false;
 
     // Process the current command
@@ -69,84 +66,83 @@ bool Interface::Poll() {
 
     // Send my response
     case State::Responding:
-      while (SendNextByte()) {
-      }
-      return true;
+      return SendResponseData();
   }
   return false;
 }
 
-// Read the next byte from the debug serial port.
-// Returns false if there were no more bytes available.
-// Also returns false if a full command has been received.
-bool Interface::ReadNextByte() {
-  // Get the next byte from the debug serial port if there is one.
-  char next_char;
-  if (hal.DebugRead(&next_char, 1) < 1) return false;
-
-  uint8_t byte = static_cast<uint8_t>(next_char);
-
-  // If the previous character received was an escape character
-  // then just save this byte (assuming there's space)
-  if (escape_next_byte_) {
-    escape_next_byte_ = false;
-
-    if (request_size_ < std::size(request_)) request_[request_size_++] = byte;
-    return true;
-  }
-
-  // If this is an escape character, don't save it just keep track
-  // of the fact that we saw it.
-  if (byte == static_cast<uint8_t>(SpecialChar::Escape)) {
-    escape_next_byte_ = true;
-    return true;
-  }
+// Reads the bytes available on the debug serial port, straight from its
+// buffer, until the end of the command.
+// Returns true if a full command has been received, in which case the bytes
+// following it are left in the buffer for the next command.
+bool Interface::ReadRequest() {
+  for (Span<const uint8_t> span = hal.DebugReadSpan(); span.size > 0;
+       span = hal.DebugReadSpan()) {
+    for (size_t i = 0; i < span.size; ++i) {
+      uint8_t byte = span.data[i];
+
+      // If the previous character received was an escape character
+      // then just save this byte.  Otherwise, escape and termination
+      // characters aren't saved.
+      if (!escape_next_byte_) {
+        if (byte == static_cast<uint8_t>(SpecialChar::Escape)) {
+          escape_next_byte_ = true;
+          continue;
+        }
+        if (byte == static_cast<uint8_t>(SpecialChar::EndTransfer)) {
+          hal.DebugConsume(i + 1);
+          state_ = State::Processing;
+          return true;
+        }
+      }
+      escape_next_byte_ = false;
 
-  // If this is an termination character, then change our state and return false
-  if (byte == static_cast<uint8_t>(SpecialChar::EndTransfer)) {
-    state_ = State::Processing;
-    return false;
+      // Save the data if there's space in the buffer
+      if (request_size_ < std::size(request_)) request_[request_size_++] = byte;
+    }
+    hal.DebugConsume(span.size);
   }
-
-  // For other characters, just save them if there's space in the buffer
-  if (request_size_ < std::size(request_)) request_[request_size_++] = byte;
-  return true;
+  return false;
 }
 
-// Send the next byte of my response to the last command.
-// Returns false if no more data will fit in the output buffer,
-// or if the entire response has been sent.
-bool Interface::SendNextByte() {
-  // To simplify things below, I require at least 3 bytes
-  // in the output buffer to continue
-  if (hal.DebugBytesAvailableForWrite() < 3) return false;
-
-  // See what the next character to send is.
-  char next_char = response_[response_bytes_sent_++];
-
-  // If its a special character, I need to escape it.
-  if ((next_char == static_cast<char>(SpecialChar::EndTransfer)) ||
-      (next_char == static_cast<char>(SpecialChar::Escape))) {
-    char escaped_char[2];
-    escaped_char[0] = static_cast<char>(SpecialChar::Escape);
-    escaped_char[1] = next_char;
-    (void)hal.DebugWrite(escaped_char, 2);
-  } else {
-    (void)hal.DebugWrite(&next_char, 1);
-  }
-
-  // If there's more response to send, return true
-  if (response_bytes_sent_ < response_size_) return true;
+// Writes as much of my response to the last command as fits in the debug
+// serial port buffer, straight into it.
+// Returns true if the entire response has been sent.
+bool Interface::SendResponseData() {
+  while (true) {
+    Span<uint8_t> span = hal.DebugWriteSpan();
+    size_t written = 0;
+    while (written < span.size && response_bytes_sent_ < response_size_) {
+      uint8_t byte = response_[response_bytes_sent_];
+      // If its a special character, I need to escape it.  The escape character
+      // may end up at the end of a span, and the character at the start of the
+      // next one.
+      if (!escape_sent_ && ((byte == static_cast<uint8_t>(SpecialChar::EndTransfer)) ||
+                            (byte == static_cast<uint8_t>(SpecialChar::Escape)))) {
+        span.data[written++] = static_cast<uint8_t>(SpecialChar::Escape);
+        escape_sent_ = true;
+        continue;
+      }
+      span.data[written++] = byte;
+      escape_sent_ = false;
+      ++response_bytes_sent_;
+    }
 
-  // If that was the last byte in my response, send the
-  // termination character and start waiting on the next
-  // command.
-  char end_transfer = static_cast<char>(SpecialChar::EndTransfer);
-  (void)hal.DebugWrite(&end_transfer, 1);
+    // If that was the last byte in my response, send the termination
+    // character and start waiting on the next command.
+    if (response_bytes_sent_ == response_size_ && written < span.size) {
+      span.data[written++] = static_cast<uint8_t>(SpecialChar::EndTransfer);
+      hal.DebugCommitWrite(written);
+      state_ = State::AwaitingCommand;
+      response_bytes_sent_ = 0;
+      return true;
+    }
 
-  state_ = State::AwaitingCommand;
-  response_bytes_sent_ = 0;
-  return false;
+    hal.DebugCommitWrite(written);
+    // Stop when the buffer is full, otherwise carry on with the free space
+    // that wrapped around the end of the buffer.
+    if (written == 0) return false;
+  }
 }
 
 // Process the received command
@@ -200,8 +196,36 @@ void Interface::ProcessCommand() {
   response_length_ = context.response_length;
 }
 
-void Interface::SendResponse(ErrorCode error, uint32_t response_length) {
-  response_[0] = static_cast<uint8_t>(error);
+bool Interface::MaybeStreamTrace() {
+  if (!trace_->streaming()) return false;
+
+  size_t sample_count = trace_->sample_count();
+  if (sample_count == 0) return false;
+
+  // Packet data is the sequence number and dropped count, then the samples.
+  static constexpr size_t HeaderSize{2 * sizeof(uint32_t)};
+  static constexpr size_t MaxDataSize{sizeof(response_) - 3 - HeaderSize};
+  // Samples are encoded to save space (see trace_codec.h), but we can only
+  // be sure that this many of them fit.
+  size_t max_samples =
+      MaxDataSize / (trace_->active_variable_count() * TraceCodec::MaxValueSize);
+  if (sample_count < max_samples && hal.Now() < last_stream_time_ + StreamPeriod) return false;
+
+  uint8_t *data = &response_[1];
+  u32_to_u8(stream_sequence_++, data);
+  // Read the dropped count before the samples: if the trace drops samples
+  // meanwhile, the gap is reported after the samples we send.
+  u32_to_u8(trace_->dropped_samples(), data + sizeof(uint32_t));
+  size_t data_size = trace_->read_encoded(data + HeaderSize, MaxDataSize);
+
+  last_stream_time_ = hal.Now();
+  SendPacket(static_cast<uint8_t>(StreamCode::TraceData),
+             static_cast<uint32_t>(HeaderSize + data_size));
+  return true;
+}
+
+void Interface::SendPacket(uint8_t code, uint32_t response_length) {
+  response_[0] = code;
 
   // Calculate the CRC on the data and error code returned
   // and append this to the end of the response
@@ -53,6 +53,25 @@ namespace Debug {
 // The escape byte causes the serial processor to treat the next byte as
 // data no matter what its value is.  It's used when the data being sent
 // has a special value.
+//
+// While the trace runs in streaming mode, the interface also sends trace
+// data on its own, whenever it isn't busy with a command:
+//   <code> <seq> <dropped> <samples> <crc> <term>
+//
+// <code> is StreamCode::TraceData, which tells these packets apart from
+// responses.
+//
+// <seq> is a 32-bit packet sequence number, incremented with every packet,
+// which lets the client notice lost packets.
+//
+// <dropped> is the 32-bit count of samples the trace dropped so far because
+// its buffer was full (see Trace::dropped_samples).
+//
+// <samples> are the oldest samples in the trace buffer, encoded as in the
+// trace download command (see trace_codec.h): each packet can be decoded on
+// its own.
+//
+// All 32 and 16-bit values are sent LSB first.
 class Interface {
  public:
   explicit Interface(Trace *trace, int count, ...);
@@ -81,6 +100,9 @@ class Interface {
   uint8_t response_[500] = {0};
   uint32_t response_size_{0};
   uint32_t response_bytes_sent_{0};
+  // Remember when we sent an escape char, for the char that follows (in case
+  // there's no room left for it)
+  bool escape_sent_{false};
 
   // Some commands take time to be fully processed, we record their start time
   // and status
@@ -95,12 +117,27 @@ class Interface {
   // enabled through the trace command)
   Trace *trace_;
 
-  bool ReadNextByte();
+  // When streaming, we wait for the trace buffer to hold a full packet worth
+  // of samples, or for this long after the last packet, whichever comes
+  // first.  This keeps the packet overhead low without letting data pile up.
+  static constexpr Duration StreamPeriod{milliseconds(50)};
+  Time last_stream_time_{microsSinceStartup(0)};
+  uint32_t stream_sequence_{0};
+
+  bool ReadRequest();
   void ProcessCommand();
-  bool SendNextByte();
+  bool SendResponseData();
+
+  // Sends the trace data that is due, if streaming.  Returns true if it did.
+  bool MaybeStreamTrace();
 
-  void SendResponse(ErrorCode error, uint32_t response_length);
+  void SendResponse(ErrorCode error, uint32_t response_length) {
+    SendPacket(static_cast<uint8_t>(error), response_length);
+  }
   void SendError(ErrorCode error) { SendResponse(error, 0); }
+  // Sends the code followed by response_length bytes of data, which the
+  // caller wrote at &response_[1].
+  void SendPacket(uint8_t code, uint32_t response_length);
 };
 
 }  // namespace Debug
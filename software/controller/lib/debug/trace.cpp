@@ -15,6 +15,11 @@ limitations under the License.
 
 #include "trace.h"
 
+#include <cmath>
+#include <cstring>
+
+#include "hal.h"
+
 namespace Debug {
 
 bool Trace::running() const { return running_; }
@@ -22,11 +27,33 @@ bool Trace::running() const { return running_; }
 // (Re-)start the trace
 void Trace::start() {
   if (!running_) {
-    trace_buffer_.Flush();
+    flush();
   }
+  // The high priority loop may be checking the previous trigger.
+  BlockInterrupts block;
+  running_ = true;
+  streaming_ = false;
+  armed_trigger_ = trigger_;
+  armed_trigger_.reset();
+  trigger_state_ = armed_trigger_.enabled() ? TriggerState::Armed : TriggerState::Off;
+  trigger_sample_index_ = 0;
+  post_trigger_count_ = 0;
+}
+
+// (Re-)start the trace in streaming mode, from an empty buffer so that the stream only holds
+// contiguous samples.
+void Trace::start_streaming() {
+  flush();
+  dropped_samples_ = 0;
+  streaming_ = true;
   running_ = true;
+  trigger_state_ = TriggerState::Off;
 }
 
+bool Trace::streaming() const { return running_ && streaming_; }
+
+uint32_t Trace::dropped_samples() const { return dropped_samples_; }
+
 void Trace::stop() { running_ = false; }
 
 uint32_t Trace::period() const { return period_; }
@@ -39,8 +66,15 @@ void Trace::maybe_sample() {
 
   if (cycles_count_ == 0) {
     if (!sample_all_variables()) {
-      // Trace buffer is full, stop tracing.
-      stop();
+      // Trace buffer is full: when streaming, the interface will make room soon enough, otherwise
+      // stop tracing.
+      if (streaming_) {
+        ++dropped_samples_;
+      } else {
+        stop();
+      }
+    } else {
+      update_trigger();
     }
   }
 
@@ -48,11 +82,48 @@ void Trace::maybe_sample() {
   if (cycles_count_ >= period_) cycles_count_ = 0;
 }
 
-void Trace::flush() { trace_buffer_.Flush(); }
+void Trace::update_trigger() {
+  switch (trigger_state_) {
+    case TriggerState::Off:
+      return;
+    case TriggerState::Armed:
+      if (armed_trigger_.check()) {
+        trigger_state_ = TriggerState::Triggered;
+        // The triggering sample is the last one in the buffer.
+        trigger_sample_index_ = sample_count_ > 0 ? static_cast<uint32_t>(sample_count_ - 1) : 0;
+      }
+      return;
+    case TriggerState::Triggered:
+      ++post_trigger_count_;
+      if (post_trigger_samples_ > 0 && post_trigger_count_ >= post_trigger_samples_) stop();
+      return;
+  }
+}
+
+bool Trace::set_trigger(uint16_t variable_registry_id, Trigger::Condition condition,
+                        uint32_t level) {
+  return trigger_.set(variable_registry_id, condition, level);
+}
+
+bool Trace::set_trigger_position(float pre_trigger_fraction, uint32_t post_trigger_samples) {
+  if (!(pre_trigger_fraction >= 0 && pre_trigger_fraction <= 1)) return false;
+  pre_trigger_fraction_ = pre_trigger_fraction;
+  post_trigger_samples_ = post_trigger_samples;
+  return true;
+}
+
+void Trace::flush() {
+  // The high priority loop must not sample in the middle of this.
+  BlockInterrupts block;
+  trace_buffer_.Flush();
+  sample_count_ = 0;
+  last_written_.fill(0);
+  last_read_.fill(0);
+}
 
 size_t Trace::sample_count() {
   if (!active_variable_count()) return 0;
-  return trace_buffer_.FullCount() / active_variable_count();
+  return sample_count_;
 }
 
 uint16_t Trace::active_variable_count() {
@@ -61,8 +132,11 @@ uint16_t Trace::active_variable_count() {
 }
 
 bool Trace::set_traced_variable(uint8_t index, uint16_t variable_registry_id) {
+  if (index >= MaxVars) return false;
   if (variable_registry_id == Variable::InvalidID) {
     traced_vars_[index] = nullptr;
+    resolutions_[index] = 0;
+    flush();
     return true;
   }
   auto *var_ptr = Variable::Registry::singleton().find(variable_registry_id);
@@ -71,12 +145,25 @@ bool Trace::set_traced_variable(uint8_t index, uint16_t variable_registry_id) {
     return false;
   }
   traced_vars_[index] = var_ptr;
+  resolutions_[index] = 0;
   // like in the SetTraceVarId<int index> template, we need to flush the buffer
   // when the set of traced variables change.
-  trace_buffer_.Flush();
+  flush();
+  return true;
+}
+
+bool Trace::set_resolution(uint8_t index, float resolution) {
+  if (index >= MaxVars || !(resolution >= 0) || std::isinf(resolution)) return false;
+  resolutions_[index] = resolution;
+  flush();
   return true;
 }
 
+float Trace::resolution(uint8_t index) const {
+  if (index >= MaxVars) return 0;
+  return resolutions_[index];
+}
+
 uint16_t Trace::traced_variable(uint8_t index) {
   if (index >= MaxVars) {
     return Variable::InvalidID;
@@ -85,33 +172,94 @@ uint16_t Trace::traced_variable(uint8_t index) {
 }
 
 [[nodiscard]] bool Trace::get_next_record(std::array<uint32_t, MaxVars> *record, size_t *count) {
-  // Grab one sample with interrupts disabled. There's a chance the trace is still running, so we
-  // could get interrupted by the high priority thread that adds to the buffer.
-  // We want to make sure we read a full sample without being interrupted.
   *count = 0;
-  BlockInterrupts block;
-  for (auto *var : traced_vars_) {
-    if (!var) continue;
-    std::optional<uint32_t> dat = trace_buffer_.Get();
-    if (!dat) return false;
-    (*record)[(*count)++] = *dat;
+  // While waiting for the trigger, the high priority loop drops the oldest samples from the buffer,
+  // so it is the one reading from it, and there is nothing for us to read.
+  if (running_ && trigger_state_ == TriggerState::Armed) return false;
+  return pop_record(record, count);
+}
+
+bool Trace::pop_record(std::array<uint32_t, MaxVars> *record, size_t *count) {
+  // The trace buffer has a single writer (the high priority loop, which may be running) and a
+  // single reader (us), so there's no need to disable interrupts here: samples are counted once
+  // they are fully written.
+  *count = 0;
+  if (sample_count_ == 0) return false;
+
+  size_t var_count = active_variable_count();
+  for (size_t i = 0; i < var_count; ++i) {
+    // Varints end with the first byte that doesn't have its top bit set.
+    uint8_t encoded[TraceCodec::MaxValueSize];
+    size_t length = 0;
+    do {
+      std::optional<uint8_t> byte = trace_buffer_.Get();
+      // Only whole samples are written to the buffer, so this is a bug.
+      if (!byte || length == TraceCodec::MaxValueSize) return false;
+      encoded[length++] = *byte;
+    } while (encoded[length - 1] & 0x80);
+
+    uint32_t delta{0};
+    (void)TraceCodec::read_varint(encoded, length, &delta);
+    last_read_[i] += static_cast<uint32_t>(TraceCodec::zigzag_decode(delta));
+    (*record)[(*count)++] = last_read_[i];
   }
+  --sample_count_;
   return true;
 }
 
-bool Trace::sample_all_variables() {
-  // If there are no enabled trace variables, or if there isn't enough space
-  // in the buffer for a full sample, then signal to stop the trace.
-  if (trace_buffer_.FreeCount() < active_variable_count()) {
-    return false;
+size_t Trace::read_encoded(uint8_t *out, size_t size) {
+  size_t var_count = active_variable_count();
+  std::array<uint32_t, MaxVars> reference = {0};
+  std::array<uint32_t, MaxVars> record;
+  size_t length = 0;
+  // Stop as soon as a sample might not fit.
+  while (size - length >= var_count * TraceCodec::MaxValueSize &&
+         get_next_record(&record, &var_count)) {
+    length += TraceCodec::encode_sample(record.data(), reference.data(), var_count, out + length);
+    reference = record;
   }
-  // Sample each enabled variable and store the result to the buffer.
-  for (auto *var : traced_vars_) {
+  return length;
+}
+
+bool Trace::sample_all_variables() {
+  size_t var_count = 0;
+  for (size_t i = 0; i < MaxVars; ++i) {
+    auto *var = traced_vars_[i];
     if (!var) continue;
-    // Can't fail as we've already checked for sufficient space above.
-    var->serialize_value(&temp_variable_value_);
-    (void)trace_buffer_.Put(temp_variable_value_);
+    var->serialize_value(&sample_values_[var_count]);
+    if (resolutions_[i] > 0 && var->type() == Variable::Type::Float) {
+      float value;
+      std::memcpy(&value, &sample_values_[var_count], sizeof(value));
+      sample_values_[var_count] =
+          static_cast<uint32_t>(TraceCodec::quantize(value, resolutions_[i]));
+    }
+    ++var_count;
+  }
+  if (var_count == 0) return true;
+
+  size_t length = TraceCodec::encode_sample(sample_values_.data(), last_written_.data(), var_count,
+                                            encoded_sample_);
+  if (trigger_state_ == TriggerState::Armed) {
+    // Waiting for the trigger: make room for this sample by dropping the oldest ones, so that the
+    // pre-trigger history doesn't take more than its share of the buffer.
+    auto pre_trigger_size = static_cast<size_t>(
+        pre_trigger_fraction_ * static_cast<float>(BufferSize * sizeof(uint32_t)));
+    std::array<uint32_t, MaxVars> dropped;
+    size_t dropped_count;
+    while (trace_buffer_.FullCount() + length > pre_trigger_size &&
+           pop_record(&dropped, &dropped_count)) {
+      // Nothing else to do, pop_record keeps track of the remaining samples.
+    }
+  }
+
+  // If there isn't enough space in the buffer for the full sample, then signal to stop the trace.
+  if (trace_buffer_.FreeCount() < length) {
+    return false;
   }
+  // Can't be partial as we've already checked for sufficient space above.
+  (void)trace_buffer_.Write(encoded_sample_, length);
+  last_written_ = sample_values_;
+  ++sample_count_;
   return true;
 }
 
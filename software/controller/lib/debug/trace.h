@@ -15,10 +15,14 @@ limitations under the License.
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <optional>
 
-#include "circular_buffer.h"
+#include "spsc_ring.h"
+#include "trace_codec.h"
+#include "trigger.h"
 #include "vars.h"
 
 namespace Debug {
@@ -32,21 +36,54 @@ namespace Debug {
  * This is extremely useful for tuning control systems because it allows data to be captured
  * precisely at high update rates, much higher than could be done using simple printouts over a
  * serial port.
+ *
+ * Samples are stored in the buffer in the compact form described in trace_codec.h, which takes as
+ * little as one byte per variable, and 5 at most.  Float variables only compress well when given
+ * a resolution (see set_resolution), in which case their values are traced as integer multiples
+ * of that resolution.
+ *
+ * Like an oscilloscope, the trace can also wait for a trigger condition (see Trigger) to capture
+ * rare events: once started, it records continuously, only keeping the latest samples which fit in
+ * the pre-trigger fraction of the buffer.  When the condition is met, it keeps recording until it
+ * has captured the requested number of post-trigger samples (or filled the buffer), then stops,
+ * freezing the samples around the event in the buffer.
  */
 class Trace {
  public:
-  static constexpr uint16_t MaxVars{4};
+  static constexpr uint16_t MaxVars{16};
 
   // This circular buffer is as big as we consider reasonable, to give a good tracing capability:
-  // 40% of the RAM available on our STM32
-  static constexpr size_t BufferSize{0x4000};
+  // 50% of the RAM available on our STM32 (debug variables' metadata stays in flash, which leaves
+  // room for it).  Size is in 32-bit words, although the buffer holds bytes.
+  static constexpr size_t BufferSize{0x5000};
+
+  enum class TriggerState : uint8_t {
+    Off = 0x00,        // no trigger, recording from start
+    Armed = 0x01,      // recording pre-trigger history, waiting for the trigger
+    Triggered = 0x02,  // recording post-trigger samples (or done, if stopped)
+  };
 
   /// \returns false if manually stopped or autostopped when buffer was filled
   bool running() const;
 
   /// \brief starts acquisition; or restarts if already started (flushes)
+  /// Arms the trigger if one is set up.
   void start();
 
+  /* \brief starts (or restarts) acquisition in streaming mode, from an empty buffer
+   *
+   * In streaming mode the buffer is expected to be drained continuously (the debug interface
+   * sends its content as it fills), so when the buffer is full, trace drops the new samples and
+   * counts them instead of stopping.  The trigger is ignored in this mode.
+   * */
+  void start_streaming();
+
+  /// \returns true if running in streaming mode
+  bool streaming() const;
+
+  /// \returns number of samples dropped because the buffer was full, since streaming started
+  uint32_t dropped_samples() const;
+
   /// \brief stops acquisition, does not flush
   void stop();
 
@@ -63,6 +100,44 @@ class Trace {
   /// \brief clears trace buffer
   void flush();
 
+  /* \brief selects the resolution of the float variable at position `index`
+   * \param resolution 0 to trace the exact value, otherwise values are rounded to a multiple of
+   *        resolution, and traced as that multiple (int32)
+   * \returns false if index or resolution is invalid
+   * Flushes the buffer, as it changes the interpretation of traced values.  Selecting another
+   * variable at that position resets its resolution to 0.
+   * */
+  bool set_resolution(uint8_t index, float resolution);
+
+  /// \returns resolution at index, or 0 if invalid
+  float resolution(uint8_t index) const;
+
+  /* \brief sets up the trigger, which takes effect on the next start(): a trace already running
+   * keeps waiting for the trigger it was started with
+   * \returns false (leaving the trigger unchanged) if Trigger::set does
+   * */
+  bool set_trigger(uint16_t variable_registry_id, Trigger::Condition condition, uint32_t level);
+
+  const Trigger &trigger() const { return trigger_; }
+
+  /* \brief sets the position of the trigger in the captured trace
+   * \param pre_trigger_fraction fraction of the buffer (between 0 and 1) holding the samples
+   *        recorded before the trigger
+   * \param post_trigger_samples number of samples to record after the trigger, 0 to record until
+   *        the buffer is full
+   * \returns false if pre_trigger_fraction is invalid
+   * */
+  bool set_trigger_position(float pre_trigger_fraction, uint32_t post_trigger_samples);
+
+  float pre_trigger_fraction() const { return pre_trigger_fraction_; }
+  uint32_t post_trigger_samples() const { return post_trigger_samples_; }
+
+  TriggerState trigger_state() const { return trigger_state_; }
+
+  /// \returns index in the buffer of the sample which met the trigger condition, i.e. number of
+  /// pre-trigger samples captured, once triggered (and before the buffer is read)
+  uint32_t trigger_sample_index() const { return trigger_sample_index_; }
+
   /* \returns number of acquired samples in time series,
    * i.e. not multiplied by traced variable count
    * */
@@ -72,10 +147,11 @@ class Trace {
   uint16_t active_variable_count();
 
   /* \brief selects position `index` to trace the variable spcified by `variable_registry_id`
-   * \param index assumed to be a number number < MaxVars
+   * \param index position, must be < MaxVars
    * \param variable_registry_id may be any variable ID, including Variable::InvalidID, which will
    *        disable tracing at that position
-   * \returns false if variable could not be found in registry, or the type was of wrong size
+   * \returns false if index is invalid, if variable could not be found in registry, or the type
+   *          was of wrong size
    *          true if successfully set or disabled
    *          */
   bool set_traced_variable(uint8_t index, uint16_t variable_registry_id);
@@ -84,19 +160,43 @@ class Trace {
   uint16_t traced_variable(uint8_t index);
 
   /* Grabs the next sample of all traced variables from the trace buffer. Returns false if the
-   * buffer has less data than the number of traced variables - this should never happen. Sets
-   * *count to the number of elements actually set in *record. This will equal
-   * active_variable_count() but is easier to use for testing.
+   * buffer is empty, or while the trace is waiting for its trigger. Sets *count to the number of
+   * elements actually set in *record. This will equal active_variable_count() but is easier to use
+   * for testing.
    * */
   [[nodiscard]] bool get_next_record(std::array<uint32_t, MaxVars> *record, size_t *count);
 
+  /* Moves as many samples as fit in `size` bytes from the trace buffer to `out`, in the form
+   * described in trace_codec.h, starting from a reference sample of zeros so that the result can
+   * be decoded on its own.
+   * \returns number of bytes written
+   * */
+  size_t read_encoded(uint8_t *out, size_t size);
+
  private:
   // This function is called at the end of the high priority loop function.
   // It captures any enabled data variables to the trace buffer.
   bool sample_all_variables();
 
-  // It will auto-clear when the buffer is full, or when stopped.
-  bool running_{false};
+  // Called when a sample was captured, handles the trigger.
+  void update_trigger();
+
+  // Reads the next sample from the buffer, see get_next_record.
+  bool pop_record(std::array<uint32_t, MaxVars> *record, size_t *count);
+
+  // It will auto-clear when the buffer is full (unless streaming), or when stopped.
+  volatile bool running_{false};
+  bool streaming_{false};
+  uint32_t dropped_samples_{0};
+
+  // The trigger as set up, and the one the high priority loop checks, copied from it by start().
+  Trigger trigger_;
+  Trigger armed_trigger_;
+  float pre_trigger_fraction_{0.5f};
+  uint32_t post_trigger_samples_{0};
+  volatile TriggerState trigger_state_{TriggerState::Off};
+  uint32_t trigger_sample_index_{0};
+  uint32_t post_trigger_count_{0};
 
   // The trace period gives the period of the trace data capture in units of loop cycles.
   uint32_t period_{1};
@@ -104,10 +204,22 @@ class Trace {
   uint32_t cycles_count_{0};
 
   std::array<Variable::Base *, MaxVars> traced_vars_ = {nullptr};
-
-  // Pre-allocated because it will be reused for every capture
-  uint32_t temp_variable_value_{0};
-  CircularBuffer<uint32_t, BufferSize> trace_buffer_;
+  std::array<float, MaxVars> resolutions_ = {0};
+
+  // Pre-allocated because they will be reused for every capture
+  std::array<uint32_t, MaxVars> sample_values_ = {0};
+  uint8_t encoded_sample_[MaxVars * TraceCodec::MaxValueSize] = {0};
+
+  // Samples are encoded relative to the previous one, so we keep track of the last sample written
+  // to and read from the buffer.  Both only hold active variables, in order.
+  std::array<uint32_t, MaxVars> last_written_ = {0};
+  std::array<uint32_t, MaxVars> last_read_ = {0};
+  // The buffer is written by the high priority loop and read by the main loop.  While the trigger
+  // is armed, the high priority loop also reads from it, dropping the oldest samples to make room
+  // for new ones, and the main loop doesn't (see get_next_record).  Only start(), in the main loop,
+  // arms the trigger, so the buffer never has two readers at once.
+  std::atomic<size_t> sample_count_{0};
+  SpscRing<uint8_t, BufferSize * sizeof(uint32_t)> trace_buffer_;
 };
 
 }  // namespace Debug
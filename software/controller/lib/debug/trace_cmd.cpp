@@ -14,6 +14,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <cstring>
+
 #include "commands.h"
 
 namespace Debug::Command {
@@ -45,6 +47,12 @@ ErrorCode TraceHandler::Process(Context *context) {
       *(context->processed) = true;
       return ErrorCode::None;
 
+    case Subcommand::StartStreaming:
+      trace_->start_streaming();
+      context->response_length = 0;
+      *(context->processed) = true;
+      return ErrorCode::None;
+
     case Subcommand::Stop:
       trace_->stop();
       context->response_length = 0;
@@ -82,55 +90,50 @@ ErrorCode TraceHandler::Process(Context *context) {
       *(context->processed) = true;
       return ErrorCode::None;
 
+    case Subcommand::GetResolution:
+      return GetResolution(context);
+
+    case Subcommand::SetResolution:
+      return SetResolution(context);
+
+    case Subcommand::SetTrigger:
+      return SetTrigger(context);
+
+    case Subcommand::GetTrigger:
+      return GetTrigger(context);
+
+    case Subcommand::SetTriggerPosition:
+      return SetTriggerPosition(context);
+
+    case Subcommand::GetTriggerPosition:
+      return GetTriggerPosition(context);
+
+    case Subcommand::GetTriggerStatus:
+      return GetTriggerStatus(context);
+
     default:
       return ErrorCode::InvalidData;
   }
 }
 
 ErrorCode TraceHandler::ReadTraceBuffer(Context *context) {
-  // See how many active trace variables there are
-  // This gives us our sample size;
-  size_t var_count = trace_->active_variable_count();
-
   // If there aren't any active variables, I'm done
-  if (!var_count) {
+  if (!trace_->active_variable_count()) {
     context->response_length = 0;
     *(context->processed) = true;
     return ErrorCode::None;
   }
 
-  // See how many samples I can return
-  // First, find out how many I could based on the max value
-  size_t max_samples =
-      context->max_response_length / static_cast<size_t>(var_count * sizeof(uint32_t));
-
   // If there's not enough room for even one sample, return an error.
   // That really shouldn't happen
-  if (max_samples == 0) {
+  if (context->max_response_length <
+      trace_->active_variable_count() * TraceCodec::MaxValueSize) {
     return ErrorCode::NoMemory;
   }
 
-  // Find the total number of samples in the buffer
-  size_t samples_count = trace_->sample_count();
-  if (samples_count > max_samples) {
-    samples_count = max_samples;
-  }
-
-  std::array<uint32_t, Trace::MaxVars> record;
-  for (size_t sample = 0; sample < samples_count; sample++) {
-    // This shouldn't fail since I've already confirmed
-    // the number of elements in the buffer.  If it does
-    // fail it's a bug.
-    if (!trace_->get_next_record(&record, &var_count)) {
-      break;
-    }
-    for (size_t variable = 0; variable < var_count; variable++) {
-      u32_to_u8(record[variable], context->response);
-      context->response += sizeof(uint32_t);
-    }
-  }
-
-  context->response_length = static_cast<uint32_t>(samples_count * var_count * sizeof(uint32_t));
+  // Samples are sent in the same compact form as they are stored, see trace_codec.h
+  context->response_length =
+      static_cast<uint32_t>(trace_->read_encoded(context->response, context->max_response_length));
   *(context->processed) = true;
   return ErrorCode::None;
 }
@@ -165,4 +168,97 @@ ErrorCode TraceHandler::GetTraceVar(Context *context) {
   return ErrorCode::None;
 }
 
+ErrorCode TraceHandler::SetResolution(Context *context) {
+  // 5 extra bytes are required to provide variable index and resolution (float)
+  if (context->request_length < 6) return ErrorCode::MissingData;
+  uint8_t index = context->request[1];
+  uint32_t raw_resolution = u8_to_u32(&context->request[2]);
+  float resolution;
+  std::memcpy(&resolution, &raw_resolution, sizeof(resolution));
+  if (!trace_->set_resolution(index, resolution)) {
+    return ErrorCode::InvalidData;
+  }
+  context->response_length = 0;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+ErrorCode TraceHandler::GetResolution(Context *context) {
+  // 1 extra byte is required to provide variable index
+  if (context->request_length < 2) return ErrorCode::MissingData;
+
+  // response (resolution) is a float (4 bytes)
+  if (context->max_response_length < 4) return ErrorCode::NoMemory;
+  float resolution = trace_->resolution(context->request[1]);
+  uint32_t raw_resolution;
+  std::memcpy(&raw_resolution, &resolution, sizeof(raw_resolution));
+  u32_to_u8(raw_resolution, context->response);
+  context->response_length = 4;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+ErrorCode TraceHandler::SetTrigger(Context *context) {
+  // 7 extra bytes are required to provide variable ID, condition and level
+  if (context->request_length < 8) return ErrorCode::MissingData;
+  uint16_t var_id = u8_to_u16(&context->request[1]);
+  auto condition = static_cast<Trigger::Condition>(context->request[3]);
+  uint32_t level = u8_to_u32(&context->request[4]);
+  if (!trace_->set_trigger(var_id, condition, level)) {
+    return ErrorCode::InvalidData;
+  }
+  context->response_length = 0;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+ErrorCode TraceHandler::GetTrigger(Context *context) {
+  // response is variable ID (2 bytes), condition (1 byte) and level (4 bytes)
+  if (context->max_response_length < 7) return ErrorCode::NoMemory;
+  const Trigger &trigger = trace_->trigger();
+  u16_to_u8(trigger.variable_id(), context->response);
+  context->response[2] = static_cast<uint8_t>(trigger.condition());
+  u32_to_u8(trigger.level(), &context->response[3]);
+  context->response_length = 7;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+ErrorCode TraceHandler::SetTriggerPosition(Context *context) {
+  // 8 extra bytes are required to provide pre-trigger fraction (float) and post-trigger samples
+  if (context->request_length < 9) return ErrorCode::MissingData;
+  uint32_t raw_fraction = u8_to_u32(&context->request[1]);
+  float fraction;
+  std::memcpy(&fraction, &raw_fraction, sizeof(fraction));
+  if (!trace_->set_trigger_position(fraction, u8_to_u32(&context->request[5]))) {
+    return ErrorCode::InvalidData;
+  }
+  context->response_length = 0;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+ErrorCode TraceHandler::GetTriggerPosition(Context *context) {
+  // response is pre-trigger fraction (float) and post-trigger samples (4 bytes)
+  if (context->max_response_length < 8) return ErrorCode::NoMemory;
+  float fraction = trace_->pre_trigger_fraction();
+  uint32_t raw_fraction;
+  std::memcpy(&raw_fraction, &fraction, sizeof(raw_fraction));
+  u32_to_u8(raw_fraction, context->response);
+  u32_to_u8(trace_->post_trigger_samples(), &context->response[4]);
+  context->response_length = 8;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+ErrorCode TraceHandler::GetTriggerStatus(Context *context) {
+  // response is trigger state (1 byte) and triggering sample index (4 bytes)
+  if (context->max_response_length < 5) return ErrorCode::NoMemory;
+  context->response[0] = static_cast<uint8_t>(trace_->trigger_state());
+  u32_to_u8(trace_->trigger_sample_index(), &context->response[1]);
+  context->response_length = 5;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
 }  // namespace Debug::Command
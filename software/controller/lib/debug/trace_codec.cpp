@@ -0,0 +1,78 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "trace_codec.h"
+
+#include <cmath>
+
+namespace Debug::TraceCodec {
+
+size_t write_varint(uint32_t value, uint8_t *out) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = static_cast<uint8_t>(value);
+  return length;
+}
+
+size_t read_varint(const uint8_t *in, size_t length, uint32_t *value) {
+  uint32_t result = 0;
+  for (size_t i = 0; i < length && i < MaxValueSize; ++i) {
+    result |= static_cast<uint32_t>(in[i] & 0x7F) << (7 * i);
+    if ((in[i] & 0x80) == 0) {
+      *value = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+size_t encode_sample(const uint32_t *values, const uint32_t *reference, size_t count,
+                     uint8_t *out) {
+  size_t length = 0;
+  for (size_t i = 0; i < count; ++i) {
+    // Differences wrap around, which is fine as decoding wraps them back.
+    auto delta = static_cast<int32_t>(values[i] - reference[i]);
+    length += write_varint(zigzag_encode(delta), out + length);
+  }
+  return length;
+}
+
+size_t decode_sample(const uint8_t *in, size_t length, const uint32_t *reference, size_t count,
+                     uint32_t *values) {
+  size_t read = 0;
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t encoded;
+    size_t value_size = read_varint(in + read, length - read, &encoded);
+    if (value_size == 0) return 0;
+    read += value_size;
+    values[i] = reference[i] + static_cast<uint32_t>(zigzag_decode(encoded));
+  }
+  return read;
+}
+
+int32_t quantize(float value, float resolution) {
+  float steps = std::round(value / resolution);
+  if (std::isnan(steps)) return 0;
+  // 2^31 is exactly representable as a float, unlike INT32_MAX.
+  static constexpr float Limit{2147483648.0f};
+  if (steps >= Limit) return INT32_MAX;
+  if (steps < -Limit) return INT32_MIN;
+  return static_cast<int32_t>(steps);
+}
+
+}  // namespace Debug::TraceCodec
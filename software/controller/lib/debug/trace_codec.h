@@ -0,0 +1,78 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Debug::TraceCodec {
+
+/*
+ * Compact encoding of trace samples.
+ *
+ * A trace sample is made of one 32-bit value per traced variable.  Consecutive samples of a
+ * variable tend to be close to one another, so rather than storing each value in full, we store
+ * the difference with the previous sample of the same variable.  That difference is zig-zag
+ * encoded (0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...) so that small negative differences are
+ * small numbers too, and written as a varint: 7 bits per byte, least significant bits first, with
+ * the top bit of each byte set if more bytes follow.  A value which doesn't change takes a single
+ * byte, and none takes more than MaxValueSize bytes.
+ *
+ * The values of float variables only compress well once quantized (see quantize()), which the
+ * trace does when it is given a resolution for them.  Otherwise their raw bits are used, which is
+ * lossless but typically takes 3 to 5 bytes per value.
+ *
+ * The python debug client decodes this format (see debug_types.py), keep both in sync.
+ */
+
+static constexpr size_t MaxValueSize{5};
+
+constexpr uint32_t zigzag_encode(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+constexpr int32_t zigzag_decode(uint32_t value) {
+  return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+/// \brief writes value to out as a varint
+/// \returns number of bytes written, at most MaxValueSize
+size_t write_varint(uint32_t value, uint8_t *out);
+
+/// \brief reads a varint from the length bytes at in
+/// \returns number of bytes read, or 0 if the varint is truncated or longer than MaxValueSize
+size_t read_varint(const uint8_t *in, size_t length, uint32_t *value);
+
+/*! \brief Encodes a sample of count values, as differences with the reference sample
+ *  \param out must hold count * MaxValueSize bytes
+ *  \returns number of bytes written
+ */
+size_t encode_sample(const uint32_t *values, const uint32_t *reference, size_t count,
+                     uint8_t *out);
+
+/*! \brief Decodes a sample of count values, encoded relative to the reference sample
+ *  \returns number of bytes read, or 0 if the encoded sample is incomplete or invalid
+ */
+size_t decode_sample(const uint8_t *in, size_t length, const uint32_t *reference, size_t count,
+                     uint32_t *values);
+
+/*! \brief Returns the value as an integer number of resolution steps
+ *  \param resolution must be greater than 0
+ *  Values out of the int32 range are clamped to it, NaN becomes 0.
+ */
+int32_t quantize(float value, float resolution);
+
+}  // namespace Debug::TraceCodec
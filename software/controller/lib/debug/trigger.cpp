@@ -0,0 +1,104 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "trigger.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace Debug {
+
+bool Trigger::set(uint16_t variable_registry_id, Condition condition, uint32_t level) {
+  if (condition == Condition::None) {
+    var_ = nullptr;
+    condition_ = Condition::None;
+    return true;
+  }
+  if (condition > Condition::Change) return false;
+
+  auto *var = Variable::Registry::singleton().find(variable_registry_id);
+  if (!var || (var->byte_size() != sizeof(uint32_t))) return false;
+  switch (var->type()) {
+    case Variable::Type::Int32:
+    case Variable::Type::UInt32:
+    case Variable::Type::Float:
+      break;
+    default:
+      return false;
+  }
+
+  var_ = var;
+  condition_ = condition;
+  level_ = level;
+  reset();
+  return true;
+}
+
+uint16_t Trigger::variable_id() const { return var_ ? var_->id() : Variable::InvalidID; }
+
+bool Trigger::check() {
+  if (!var_) return false;
+
+  uint32_t value;
+  var_->serialize_value(&value);
+  bool had_previous = has_previous_;
+  uint32_t previous = previous_;
+  previous_ = value;
+  has_previous_ = true;
+
+  // NaN never meets a threshold (but a change to or from NaN is a change).
+  if (condition_ != Condition::Change && is_nan(value)) return false;
+
+  switch (condition_) {
+    case Condition::None:
+      return false;
+    case Condition::Above:
+      return compare(value, level_) > 0;
+    case Condition::Below:
+      return compare(value, level_) < 0;
+    case Condition::Rising:
+      return had_previous && compare(previous, level_) < 0 && compare(value, level_) >= 0;
+    case Condition::Falling:
+      return had_previous && compare(previous, level_) > 0 && compare(value, level_) <= 0;
+    case Condition::Change:
+      return had_previous && value != previous;
+  }
+  return false;
+}
+
+bool Trigger::is_nan(uint32_t value) const {
+  if (var_->type() != Variable::Type::Float) return false;
+  float f;
+  std::memcpy(&f, &value, sizeof(f));
+  return std::isnan(f);
+}
+
+int Trigger::compare(uint32_t a, uint32_t b) const {
+  switch (var_->type()) {
+    case Variable::Type::Int32:
+      return (static_cast<int32_t>(a) > static_cast<int32_t>(b)) -
+             (static_cast<int32_t>(a) < static_cast<int32_t>(b));
+    case Variable::Type::Float: {
+      float fa, fb;
+      std::memcpy(&fa, &a, sizeof(fa));
+      std::memcpy(&fb, &b, sizeof(fb));
+      return (fa > fb) - (fa < fb);
+    }
+    default:
+      return (a > b) - (a < b);
+  }
+}
+
+}  // namespace Debug
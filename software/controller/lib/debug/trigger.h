@@ -0,0 +1,79 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "vars.h"
+
+namespace Debug {
+
+/*
+ * Condition on a debug variable, which starts the capture of a triggered trace (see Trace).
+ *
+ * Any registered 32-bit variable (int32, uint32 or float) can be watched, whether it is traced or
+ * not, and its value is compared to the trigger level according to the variable's type.  This
+ * lets us catch rare events such as pressure overshoots (pip rising above a level), a state
+ * machine leaving a state (state falling below a value), or the start of a new breath (breath_id
+ * changing).
+ */
+class Trigger {
+ public:
+  enum class Condition : uint8_t {
+    None = 0x00,     // trigger disabled
+    Above = 0x01,    // value is greater than level
+    Below = 0x02,    // value is less than level
+    Rising = 0x03,   // value goes from less than level to greater than or equal to it
+    Falling = 0x04,  // value goes from greater than level to less than or equal to it
+    Change = 0x05,   // value differs from the previous one, level is ignored
+  };
+
+  /*! \brief sets up the trigger
+   *  \param variable_registry_id variable to watch, may be Variable::InvalidID along with
+   *         Condition::None to disable the trigger
+   *  \param level raw value (as serialized by the variable) of the trigger level
+   *  \returns false if the variable can't be found or isn't a 32-bit number, or if the condition
+   *           is invalid, in which case the trigger is left unchanged
+   */
+  bool set(uint16_t variable_registry_id, Condition condition, uint32_t level);
+
+  bool enabled() const { return condition_ != Condition::None; }
+  Condition condition() const { return condition_; }
+  uint32_t level() const { return level_; }
+  /// \returns id of watched variable, Variable::InvalidID if disabled
+  uint16_t variable_id() const;
+
+  /// \brief forgets the previous value of the variable, to be called before watching it anew
+  void reset() { has_previous_ = false; }
+
+  /// \brief reads the variable, and checks the condition against it (and its previous value)
+  /// \returns true if the condition is met
+  bool check();
+
+ private:
+  // Returns <0, 0 or >0 if a is respectively less than, equal to or greater than b, in the
+  // variable's type.
+  int compare(uint32_t a, uint32_t b) const;
+  bool is_nan(uint32_t value) const;
+
+  Variable::Base *var_{nullptr};
+  Condition condition_{Condition::None};
+  uint32_t level_{0};
+  uint32_t previous_{0};
+  bool has_previous_{false};
+};
+
+}  // namespace Debug
@@ -21,6 +21,81 @@ limitations under the License.
 
 namespace Debug::Command {
 
+// Serializes the value of the variable to buffer, which must have room for its
+// byte_size(), with endian conversion.
+static void WriteValue(Variable::Base *var, uint8_t *buffer) {
+  size_t size = var->byte_size();
+  uint32_t intermediate_buffer[size / sizeof(uint32_t)];
+  var->serialize_value(intermediate_buffer);
+
+  // endian conversion
+  for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+    u32_to_u8(intermediate_buffer[i], buffer);
+    buffer += sizeof(uint32_t);
+  }
+}
+
+// Sets the value of the variable from buffer, which must hold its byte_size(),
+// with endian conversion.
+static void ReadValue(const uint8_t *buffer, Variable::Base *var) {
+  size_t size = var->byte_size();
+  // endian conversion
+  uint32_t intermediate_buffer[size / sizeof(uint32_t)];
+  for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+    intermediate_buffer[i] = u8_to_u32(buffer);
+    buffer += sizeof(uint32_t);
+  }
+
+  var->deserialize_value(intermediate_buffer);
+}
+
+// Writes info about the variable to buffer (see GetVarInfo for the format).
+// Returns the number of bytes written, or 0 if they don't fit in size.
+static size_t WriteInfo(const Variable::Base *var, uint8_t *buffer, size_t size) {
+  // The info I return consists of the following:
+  // <type>     - 1 byte variable type code
+  // <access>   - 1 byte gives the possible access to that variable (read only?)
+  // <size>     - 1 byte size of datatype in bytes
+  // <reserved> - 1 reserved byte for things we think of later
+  // <name len> - 1 byte gives length of variable name string
+  // <fmt len>  - 1 byte gives length of formation string
+  // <help len> - 1 byte gives length of help string
+  // <unit len> - 1 byte gives length of unit string
+  // <name> - variable length name string
+  // <fmt>  - variable length format string
+  // <help> - variable length help string
+  // <unit> - variable length unit string
+  // The strings are not null terminated.
+  Variable::Text name = var->name();
+  Variable::Text help = var->help();
+  size_t name_length = name.length();
+  size_t format_length = strlen(var->format());
+  size_t help_length = help.length();
+  size_t unit_length = strlen(var->units());
+
+  if (size < 8 + name_length + format_length + help_length + unit_length) return 0;
+
+  size_t count = 0;
+  buffer[count++] = static_cast<uint8_t>(var->type());
+  buffer[count++] = static_cast<uint8_t>(var->access());
+  buffer[count++] = static_cast<uint8_t>(var->byte_size());
+  buffer[count++] = 0;
+  buffer[count++] = static_cast<uint8_t>(name_length);
+  buffer[count++] = static_cast<uint8_t>(format_length);
+  buffer[count++] = static_cast<uint8_t>(help_length);
+  buffer[count++] = static_cast<uint8_t>(unit_length);
+  count += name.copy(reinterpret_cast<char *>(&buffer[count]), name_length);
+
+  memcpy(&buffer[count], var->format(), format_length);
+  count += format_length;
+
+  count += help.copy(reinterpret_cast<char *>(&buffer[count]), help_length);
+
+  memcpy(&buffer[count], var->units(), unit_length);
+  count += unit_length;
+  return count;
+}
+
 ErrorCode VarHandler::Process(Context *context) {
   // The first byte of data is always required, this
   // gives the sub-command.
@@ -42,6 +117,18 @@ ErrorCode VarHandler::Process(Context *context) {
     case Subcommand::GetCount:
       return GetVarCount(context);
 
+    case Subcommand::GetMultiple:
+      return GetMultipleVars(context);
+
+    case Subcommand::SetMultiple:
+      return SetMultipleVars(context);
+
+    case Subcommand::GetInfoMultiple:
+      return GetMultipleVarInfo(context);
+
+    case Subcommand::GetFingerprint:
+      return GetRegistryFingerprint(context);
+
     default:
       return ErrorCode::InvalidData;
   }
@@ -62,51 +149,11 @@ ErrorCode VarHandler::GetVarInfo(Context *context) {
   const auto *var = Variable::Registry::singleton().find(var_id);
   if (!var) return ErrorCode::UnknownVariable;
 
-  // The info I return consists of the following:
-  // <type>     - 1 byte variable type code
-  // <access>   - 1 byte gives the possible access to that variable (read only?)
-  // <size>     - 1 byte size of datatype in bytes
-  // <reserved> - 1 reserved byte for things we think of later
-  // <name len> - 1 byte gives length of variable name string
-  // <fmt len>  - 1 byte gives length of formation string
-  // <help len> - 1 byte gives length of help string
-  // <unit len> - 1 byte gives length of unit string
-  // <name> - variable length name string
-  // <fmt>  - variable length format string
-  // <help> - variable length help string
-  // <unit> - variable length unit string
-  // The strings are not null terminated.
-  size_t name_length = strlen(var->name());
-  size_t format_length = strlen(var->format());
-  size_t help_length = strlen(var->help());
-  size_t unit_length = strlen(var->units());
-
+  size_t size = WriteInfo(var, context->response, context->max_response_length);
   // Fail if the strings are too large to fit.
-  if (context->max_response_length < 8 + name_length + format_length + help_length + unit_length)
-    return ErrorCode::NoMemory;
-
-  uint32_t count = 0;
-  context->response[count++] = static_cast<uint8_t>(var->type());
-  context->response[count++] = static_cast<uint8_t>(var->access());
-  context->response[count++] = static_cast<uint8_t>(var->byte_size());
-  context->response[count++] = 0;
-  context->response[count++] = static_cast<uint8_t>(name_length);
-  context->response[count++] = static_cast<uint8_t>(format_length);
-  context->response[count++] = static_cast<uint8_t>(help_length);
-  context->response[count++] = static_cast<uint8_t>(unit_length);
-  memcpy(&context->response[count], var->name(), name_length);
-  count += static_cast<uint32_t>(name_length);
-
-  memcpy(&context->response[count], var->format(), format_length);
-  count += static_cast<uint32_t>(format_length);
-
-  memcpy(&context->response[count], var->help(), help_length);
-  count += static_cast<uint32_t>(help_length);
-
-  memcpy(&context->response[count], var->units(), unit_length);
-  count += static_cast<uint32_t>(unit_length);
+  if (!size) return ErrorCode::NoMemory;
 
-  context->response_length = count;
+  context->response_length = static_cast<uint32_t>(size);
   *(context->processed) = true;
   return ErrorCode::None;
 }
@@ -123,15 +170,8 @@ ErrorCode VarHandler::GetVar(Context *context) {
   auto size = var->byte_size();
   if (context->max_response_length < size) return ErrorCode::NoMemory;
 
-  uint32_t intermediate_buffer[size / sizeof(uint32_t)];
-  var->serialize_value(intermediate_buffer);
-
-  // endian conversion
-  for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
-    u32_to_u8(intermediate_buffer[i], context->response);
-    context->response += sizeof(uint32_t);
-  }
-  context->response_length = static_cast<uint32_t>(var->byte_size());
+  WriteValue(var, context->response);
+  context->response_length = static_cast<uint32_t>(size);
 
   *(context->processed) = true;
   return ErrorCode::None;
@@ -153,15 +193,7 @@ ErrorCode VarHandler::SetVar(Context *context) {
 
   if (!var->write_allowed()) return ErrorCode::InternalError;
 
-  // endian conversion
-  uint32_t intermediate_buffer[size / sizeof(uint32_t)];
-  const auto *request_ptr = context->request + 3;
-  for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
-    intermediate_buffer[i] = u8_to_u32(request_ptr);
-    request_ptr += sizeof(uint32_t);
-  }
-
-  var->deserialize_value(intermediate_buffer);
+  ReadValue(context->request + 3, var);
   context->response_length = 0;
   *(context->processed) = true;
   return ErrorCode::None;
@@ -176,4 +208,106 @@ ErrorCode VarHandler::GetVarCount(Context *context) {
   return ErrorCode::None;
 }
 
+ErrorCode VarHandler::GetMultipleVars(Context *context) {
+  // We expect a 16-bit index, followed by an even number of bytes
+  if (context->request_length < 3 || (context->request_length - 3) % 2)
+    return ErrorCode::MissingData;
+  if (context->max_response_length < 2) return ErrorCode::NoMemory;
+
+  auto &registry = Variable::Registry::singleton();
+  uint16_t index = u8_to_u16(&context->request[1]);
+  const uint8_t *ids = &context->request[3];
+  uint32_t list_length = (context->request_length - 3) / 2;
+  // An empty list stands for all variables
+  bool all = (list_length == 0);
+  if (all) list_length = registry.count();
+
+  uint32_t count = 2;
+  for (; index < list_length; ++index) {
+    uint16_t var_id = all ? index : u8_to_u16(&ids[2 * index]);
+    auto *var = registry.find(var_id);
+    if (!var) return ErrorCode::UnknownVariable;
+
+    auto size = var->byte_size();
+    if (count + size > context->max_response_length) {
+      // Not even the first variable fits: we would never get anywhere.
+      if (count == 2) return ErrorCode::NoMemory;
+      break;
+    }
+    WriteValue(var, &context->response[count]);
+    count += static_cast<uint32_t>(size);
+  }
+  u16_to_u8(index, context->response);
+
+  context->response_length = count;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+ErrorCode VarHandler::SetMultipleVars(Context *context) {
+  auto &registry = Variable::Registry::singleton();
+
+  // Check the whole request before setting anything, so that we don't set
+  // only some of the variables.
+  for (uint32_t offset = 1; offset < context->request_length;) {
+    if (context->request_length - offset < 2) return ErrorCode::MissingData;
+    auto *var = registry.find(u8_to_u16(&context->request[offset]));
+    if (!var) return ErrorCode::UnknownVariable;
+    offset += 2;
+
+    auto size = var->byte_size();
+    if (context->request_length - offset < size) return ErrorCode::MissingData;
+    if (!var->write_allowed()) return ErrorCode::InternalError;
+    offset += static_cast<uint32_t>(size);
+  }
+
+  for (uint32_t offset = 1; offset < context->request_length;) {
+    auto *var = registry.find(u8_to_u16(&context->request[offset]));
+    offset += 2;
+    ReadValue(&context->request[offset], var);
+    offset += static_cast<uint32_t>(var->byte_size());
+  }
+
+  context->response_length = 0;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+ErrorCode VarHandler::GetMultipleVarInfo(Context *context) {
+  // We expect the 16-bit ID of the first variable
+  if (context->request_length < 3) return ErrorCode::MissingData;
+  if (context->max_response_length < 2) return ErrorCode::NoMemory;
+
+  auto &registry = Variable::Registry::singleton();
+  uint16_t var_id = u8_to_u16(&context->request[1]);
+
+  size_t count = 2;
+  for (; var_id < registry.count(); ++var_id) {
+    auto *var = registry.find(var_id);
+    if (!var) return ErrorCode::UnknownVariable;
+
+    size_t size = WriteInfo(var, &context->response[count], context->max_response_length - count);
+    if (!size) {
+      // Not even the first variable fits: we would never get anywhere.
+      if (count == 2) return ErrorCode::NoMemory;
+      break;
+    }
+    count += size;
+  }
+  u16_to_u8(var_id, context->response);
+
+  context->response_length = static_cast<uint32_t>(count);
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+ErrorCode VarHandler::GetRegistryFingerprint(Context *context) {
+  if (context->max_response_length < 4) return ErrorCode::NoMemory;
+
+  u32_to_u8(Variable::Registry::singleton().fingerprint(), context->response);
+  context->response_length = 4;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
 }  // namespace Debug::Command
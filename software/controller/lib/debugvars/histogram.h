@@ -0,0 +1,138 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include "vars_base.h"
+
+namespace Debug::Variable {
+
+/*! \class Histogram histogram.h "histogram.h"
+ *  \brief Fixed-bucket histogram of a float quantity, readable as a debug variable
+ *
+ * This is meant to collect timing statistics from the high priority control loop, where we can't
+ * afford locks or blocking interrupts.  Samples must be added from a single context (the writer),
+ * while the debug interface reads the histogram from the background loop.  Each bucket is a
+ * 32-bit counter which the writer is the only one to modify, so readers always see consistent
+ * counts, though a snapshot may straddle a sample (counts may disagree with max by one sample).
+ *
+ * Bucket i counts samples in [i * width, (i + 1) * width), with negative samples counted in the
+ * first bucket and samples beyond the range counted in the last (overflow) bucket.
+ *
+ * The debug interface sees this as a FloatArray of N + 2 elements:
+ *   [bucket width, maximum sample, count of bucket 0, ..., count of bucket N - 1]
+ *
+ * Writing any value to the variable requests the histogram to be cleared by the writer on its
+ * next sample.  If the first element written is positive, it also becomes the new bucket width.
+ */
+template <size_t N>
+class Histogram : public Base {
+  static_assert(N >= 2, "Need at least one bucket plus the overflow bucket");
+
+ public:
+  Histogram(const char *name, float bucket_width, const char *units, const char *help = "",
+            const char *fmt = "%.0f")
+      : Base(Type::FloatArray, name, Access::ReadWrite, units, help, fmt),
+        bucket_width_(bucket_width) {}
+
+  /// \brief Adds a sample to the histogram, must only be called from the writer context
+  void add(float value) {
+    if (reset_requested_) {
+      clear();
+      reset_requested_ = false;
+    }
+    size_t bucket = 0;
+    if (value > 0) {
+      bucket = std::min(static_cast<size_t>(value / bucket_width_), N - 1);
+    }
+    counts_[bucket] = counts_[bucket] + 1;
+    if (value > max_) max_ = value;
+  }
+
+  /// \brief Requests the writer to clear all counts on its next sample
+  void reset() { reset_requested_ = true; }
+
+  uint32_t count(size_t bucket) const { return bucket < N ? counts_[bucket] : 0; }
+
+  /// \returns total number of samples
+  uint32_t total() const {
+    uint32_t total = 0;
+    for (size_t i = 0; i < N; ++i) total += counts_[i];
+    return total;
+  }
+
+  /// \returns largest sample since the last reset
+  float max() const { return max_; }
+
+  float bucket_width() const { return bucket_width_; }
+
+  /*! \param fraction of samples, in [0, 1] (for example 0.99 for the 99th percentile)
+   *  \returns value below which the given fraction of samples fall, rounded up to the upper edge
+   *  of a bucket (and never more than the maximum sample).
+   */
+  float percentile(float fraction) const {
+    float target = fraction * static_cast<float>(total());
+    if (target <= 0) return 0;
+    uint32_t cumulated = 0;
+    for (size_t i = 0; i < N - 1; ++i) {
+      cumulated += counts_[i];
+      if (static_cast<float>(cumulated) >= target) {
+        return std::min(static_cast<float>(i + 1) * bucket_width_, max());
+      }
+    }
+    return max();
+  }
+
+  void serialize_value(void *write_buff) override {
+    auto *out = static_cast<uint8_t *>(write_buff);
+    float header[2] = {bucket_width_, max_};
+    std::memcpy(out, header, sizeof(header));
+    out += sizeof(header);
+    for (size_t i = 0; i < N; ++i, out += sizeof(float)) {
+      float count = static_cast<float>(counts_[i]);
+      std::memcpy(out, &count, sizeof(float));
+    }
+  }
+
+  void deserialize_value(const void *read_buf) override {
+    float width;
+    std::memcpy(&width, read_buf, sizeof(width));
+    if (width > 0) pending_width_ = width;
+    reset();
+  }
+
+  size_t byte_size() const override { return sizeof(float) * (N + 2); }
+
+ private:
+  void clear() {
+    if (pending_width_ > 0) {
+      bucket_width_ = pending_width_;
+      pending_width_ = 0;
+    }
+    for (size_t i = 0; i < N; ++i) counts_[i] = 0;
+    max_ = 0;
+  }
+
+  float bucket_width_;
+  volatile uint32_t counts_[N] = {0};
+  volatile float max_{0};
+  volatile float pending_width_{0};
+  volatile bool reset_requested_{false};
+};
+
+}  // namespace Debug::Variable
@@ -15,38 +15,41 @@ limitations under the License.
 
 #include "vars_base.h"
 
+#include <algorithm>
 #include <cstring>
 
 namespace Debug::Variable {
 
+size_t Text::length() const { return strlen(first_) + strlen(second_); }
+
+size_t Text::copy(char *dest, size_t size) const {
+  size_t first_length = std::min(strlen(first_), size);
+  memcpy(dest, first_, first_length);
+  size_t second_length = std::min(strlen(second_), size - first_length);
+  memcpy(dest + first_length, second_, second_length);
+  return first_length + second_length;
+}
+
+bool Text::operator==(const char *other) const {
+  size_t first_length = strlen(first_);
+  return strncmp(first_, other, first_length) == 0 && strcmp(second_, other + first_length) == 0;
+}
+
 Base::Base(Type type, const char *name, Access access, const char *units, const char *help,
            const char *fmt)
-    : type_(type), access_(access) {
-  // \todo use stricpy instead?
-  strcpy(name_, name);
-  strcpy(help_, help);
-  strcpy(units_, units);
-  strcpy(fmt_, fmt);
+    : type_(type), access_(access), name_(name), units_(units), help_(help), fmt_(fmt) {
   Registry::singleton().register_variable(this);
 }
 
-const char *Base::name() const { return name_; }
+Text Base::name() const { return Text(name_prefix_, name_); }
 
-void Base::prepend_name(const char *prefix) {
-  // Assumes name_ has enough space allocated for the combined string.
-  size_t len = strlen(prefix);
-  memmove(name_ + len, name_, strlen(name_) + 1);
-  memcpy(name_, prefix, len);
-}
+void Base::prepend_name(const char *prefix) { name_prefix_ = prefix; }
 
-void Base::append_help(const char *text) {
-  // \todo use stricat instead?
-  strcat(help_, text);
-}
+void Base::append_help(const char *text) { help_suffix_ = text; }
 
 const char *Base::format() const { return fmt_; }
 
-const char *Base::help() const { return help_; }
+Text Base::help() const { return Text(help_, help_suffix_); }
 
 const char *Base::units() const { return units_; }
 
@@ -40,6 +40,33 @@ static constexpr uint16_t MaxVariableCount{100};
 
 static constexpr uint16_t InvalidID{MaxVariableCount};
 
+/*! \class Text vars_base.h "vars_base.h"
+ *  \brief Read-only string made of two parts
+ *
+ * Variable names and help texts are made of string literals, which live in flash, rather than
+ * copied into RAM.  Classes such as PID need names and help texts specific to each instance (for
+ * example "blower_valve_" + "kp"), so those are made of two literals, which are only put together
+ * when sent over the debug interface.
+ */
+class Text {
+ public:
+  constexpr Text(const char *first, const char *second = "") : first_(first), second_(second) {}
+
+  /// \returns number of characters, excluding the null terminator
+  size_t length() const;
+
+  /*! \brief copies the characters (without null terminator) to dest
+   *  \returns number of characters copied, which is at most size
+   */
+  size_t copy(char *dest, size_t size) const;
+
+  bool operator==(const char *other) const;
+
+ private:
+  const char *first_;
+  const char *second_;
+};
+
 /*! \class Base vars_base.h "vars_base.h"
  *  \brief Abstract base class for debug variables
  *
@@ -49,6 +76,10 @@ static constexpr uint16_t InvalidID{MaxVariableCount};
  * We give each such variable a name which the debugger command line will use to access it. We can
  * also link it with a C++ variable whose value it will read or write.
  *
+ * The strings describing the variable (name, units, help and format) aren't copied: they must
+ * outlive it, which is why they should be string literals.  This way they stay in flash, and
+ * each variable only takes a few pointers worth of RAM.
+ *
  * Each variable will register itself with the debug variable Registry, which will issue it a unique
  * ID. However, name uniqueness is not automatically guaranteed, and you are responsible for
  * ensuring it, lest the client side of the debugger fail to function properly.
@@ -75,12 +106,14 @@ class Base {
   /// \returns number of bytes occupied by value, so caller can ensure sufficient size of buffer
   virtual size_t byte_size() const = 0;
 
-  const char *name() const;
+  Text name() const;
+  /// \brief sets the prefix of the name, which must outlive the variable (as the name itself)
   void prepend_name(const char *prefix);
+  /// \brief sets the suffix of the help text, which must outlive the variable (as the help itself)
   void append_help(const char *text);
 
   const char *format() const;
-  const char *help() const;
+  Text help() const;
   const char *units() const;
   Type type() const;
   uint16_t id() const;
@@ -91,10 +124,12 @@ class Base {
   uint16_t id_{InvalidID};
   const Type type_;
   const Access access_;
-  char name_[50]{0};
-  char units_[20]{0};
-  char help_[300]{0};
-  char fmt_[10]{0};
+  const char *name_prefix_{""};
+  const char *const name_;
+  const char *const units_;
+  const char *const help_;
+  const char *help_suffix_{""};
+  const char *const fmt_;
 
   friend class Registry;
 };
@@ -127,9 +162,21 @@ class Registry {
    */
   uint16_t count() const;
 
+  /*! \brief hash of the IDs and metadata (type, access, size, name, units, help and format) of all
+   *         registered variables, which lets debug clients know whether the metadata they cached
+   *         still holds.
+   *
+   *  Variables are registered (and named) during static initialization, so this is computed the
+   *  first time it is asked for, and only again if more variables got registered since.
+   */
+  uint32_t fingerprint();
+
  private:
   Base *var_list_[MaxVariableCount]{};
   uint16_t var_count_{0};
+  uint32_t fingerprint_{0};
+  // number of variables the fingerprint was computed for
+  uint16_t fingerprint_count_{0};
 
   // singleton assurance, because these are private
   Registry() = default;              // cannot default initialize
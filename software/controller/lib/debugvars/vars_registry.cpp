@@ -14,6 +14,7 @@ limitations under the License.
 */
 
 #include <array>
+#include <cstring>
 
 #include "vars_base.h"
 
@@ -33,4 +34,43 @@ Base *Registry::find(uint16_t vid) {
 
 uint16_t Registry::count() const { return var_count_; }
 
+// 32-bit FNV-1a hash, see http://www.isthe.com/chongo/tech/comp/fnv/
+static constexpr uint32_t FnvOffsetBasis{2166136261};
+static uint32_t Fnv1a(uint32_t hash, const char *data, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+// Strings are hashed along with their terminator, so that moving characters from one to the next
+// changes the hash.
+static uint32_t Fnv1a(uint32_t hash, const char *str) { return Fnv1a(hash, str, strlen(str) + 1); }
+static uint32_t Fnv1a(uint32_t hash, Text text) {
+  char str[text.length() + 1];
+  str[text.copy(str, text.length())] = '\0';
+  return Fnv1a(hash, str, sizeof(str));
+}
+
+uint32_t Registry::fingerprint() {
+  if (fingerprint_count_ == var_count_ && fingerprint_ != 0) return fingerprint_;
+
+  uint32_t hash = FnvOffsetBasis;
+  for (uint16_t id = 0; id < var_count_; ++id) {
+    const Base *var = var_list_[id];
+    const char header[] = {static_cast<char>(id), static_cast<char>(id >> 8),
+                           static_cast<char>(var->type()), static_cast<char>(var->access()),
+                           static_cast<char>(var->byte_size())};
+    hash = Fnv1a(hash, header, sizeof(header));
+    hash = Fnv1a(hash, var->name());
+    hash = Fnv1a(hash, var->units());
+    hash = Fnv1a(hash, var->help());
+    hash = Fnv1a(hash, var->format());
+  }
+  fingerprint_ = hash;
+  fingerprint_count_ = var_count_;
+  return fingerprint_;
+}
+
 }  // namespace Debug::Variable
@@ -0,0 +1,106 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "dsp.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Dsp {
+
+uint32_t Sum(const uint16_t *samples, size_t n) {
+  uint32_t sum = 0;
+  size_t i = 0;
+  for (; i + 1 < n; i += 2) {
+    uint32_t pair = LoadPair(&samples[i]);
+    sum = AddHigh(AddLow(sum, pair), pair);
+  }
+  if (i < n) sum += samples[i];
+  return sum;
+}
+
+size_t Decimate(const uint16_t *samples, size_t n, size_t factor, uint32_t *out) {
+  size_t outputs = n / factor;
+  for (size_t i = 0; i < outputs; ++i) out[i] = Sum(&samples[i * factor], factor);
+  return outputs;
+}
+
+int64_t Dot(const int16_t *a, const int16_t *b, size_t n) {
+  int64_t acc = 0;
+  size_t i = 0;
+  for (; i + 1 < n; i += 2) acc = MultiplyAccumulatePairs(LoadPair(&a[i]), LoadPair(&b[i]), acc);
+  if (i < n) acc += int32_t{a[i]} * b[i];
+  return acc;
+}
+
+static int16_t ToQ14(float value) {
+  long q = std::lround(value * (1 << 14));
+  return static_cast<int16_t>(std::clamp<long>(q, INT16_MIN, INT16_MAX));
+}
+
+BiquadCoefficients LowPass(float cutoff_hz, float sample_rate_hz) {
+  if (!(cutoff_hz > 0 && cutoff_hz <= sample_rate_hz / 5)) return PassThrough;
+
+  // Robert Bristow-Johnson's Audio EQ Cookbook, with Q = 1/sqrt(2).
+  float w0 = 2 * static_cast<float>(M_PI) * cutoff_hz / sample_rate_hz;
+  float cos_w0 = std::cos(w0);
+  float alpha = std::sin(w0) / std::sqrt(2.0f);
+  float a0 = 1 + alpha;
+
+  BiquadCoefficients c;
+  c.a1 = ToQ14(2 * cos_w0 / a0);
+  c.a2 = ToQ14(-(1 - alpha) / a0);
+  // The DC gain is (b0 + b1 + b2) / (1 - a1 - a2): make the numerator match the rounded
+  // denominator, adjusting b1 which is the largest.
+  int32_t dc_sum = (1 << 14) - c.a1 - c.a2;
+  c.b0 = c.b2 = ToQ14((1 - cos_w0) / 2 / a0);
+  c.b1 = static_cast<int16_t>(dc_sum - c.b0 - c.b2);
+  return c;
+}
+
+void Biquad::set_coefficients(const BiquadCoefficients &coefficients) {
+  b0_b1_ = Pack(coefficients.b0, coefficients.b1);
+  b2_a1_ = Pack(coefficients.b2, coefficients.a1);
+  a2_ = Pack(coefficients.a2, 0);
+}
+
+void Biquad::Reset(int16_t x) {
+  x1_ = x2_ = y1_ = y2_ = x;
+  error_ = 0;
+}
+
+int16_t Biquad::Filter(int16_t x) {
+  // Three pairwise multiply-accumulates, the samples being packed like the coefficients.
+  int64_t acc = error_;
+  acc = MultiplyAccumulatePairs(Pack(x, x1_), b0_b1_, acc);
+  acc = MultiplyAccumulatePairs(Pack(x2_, y1_), b2_a1_, acc);
+  acc = MultiplyAccumulatePairs(Pack(y2_, 0), a2_, acc);
+
+  // The sum of 5 products of an int16_t and a q14 is well within 32 bits once back to q0.
+  int16_t y = Saturate16(static_cast<int32_t>(acc >> 14));
+  error_ = acc & ((1 << 14) - 1);
+
+  x2_ = x1_;
+  x1_ = x;
+  y2_ = y1_;
+  y1_ = y;
+  return y;
+}
+
+void Biquad::Filter(const int16_t *in, int16_t *out, size_t n) {
+  for (size_t i = 0; i < n; ++i) out[i] = Filter(in[i]);
+}
+
+}  // namespace Dsp
@@ -0,0 +1,128 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+// Fixed-point signal processing kernels for 16-bit sensor data.
+//
+// The kernels load samples two at a time, in one 32-bit access, and use the Cortex-M4 DSP
+// extension (see dsp_intrinsics.h) on the pair: Dot multiplies and accumulates both samples in one
+// instruction, while Sum takes one instruction per sample, adding each half without unpacking it.
+// They are bit-exact with their native emulation, so their results can be checked in native tests
+// against straightforward scalar code.
+//
+// Fixed-point formats: qN values are integers standing for value / 2^N, so q14 coefficients range
+// from -2 to 2 and q15 ones from -1 to 1.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "dsp_intrinsics.h"
+
+namespace Dsp {
+
+// Returns the sum of the n samples.  Can't overflow for n < 65537.
+uint32_t Sum(const uint16_t *samples, size_t n);
+
+// Decimates the n samples by factor, summing each group of factor consecutive samples (boxcar
+// filter) to an output.  Incomplete groups at the end are ignored.
+// Returns the number of outputs, n / factor.
+size_t Decimate(const uint16_t *samples, size_t n, size_t factor, uint32_t *out);
+
+// Returns the dot product of the n values of a and b.
+int64_t Dot(const int16_t *a, const int16_t *b, size_t n);
+
+// Finite impulse response filter with Taps q15 coefficients:
+//   y[n] = sum(coefficients[k] * x[n - k]), k from 0 to Taps - 1
+// Results are rounded down and saturated to the int16_t range.
+template <size_t Taps>
+class Fir {
+  static_assert(Taps > 0);
+
+ public:
+  explicit Fir(const int16_t (&coefficients)[Taps]) {
+    for (size_t i = 0; i < Taps; ++i) coefficients_[i] = coefficients[i];
+  }
+
+  int16_t Filter(int16_t x) {
+    // The history is stored twice in a row, newest first, so that the last Taps samples are
+    // always contiguous, and line up with the coefficients.
+    position_ = position_ ? position_ - 1 : Taps - 1;
+    history_[position_] = history_[position_ + Taps] = x;
+    // Each product is below 2^30, so the sum shifted back to q0 fits in 32 bits.
+    return Saturate16(static_cast<int32_t>(Dot(&history_[position_], coefficients_, Taps) >> 15));
+  }
+
+  void Filter(const int16_t *in, int16_t *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = Filter(in[i]);
+  }
+
+ private:
+  int16_t coefficients_[Taps];
+  int16_t history_[2 * Taps] = {};
+  size_t position_{0};
+};
+
+// Coefficients of a second order IIR filter, in q14:
+//   y[n] = b0 * x[n] + b1 * x[n-1] + b2 * x[n-2] + a1 * y[n-1] + a2 * y[n-2]
+// Beware that the feedback coefficients a1 and a2 are added, so their sign is the opposite of the
+// usual transfer function denominator's.
+struct BiquadCoefficients {
+  int16_t b0, b1, b2, a1, a2;
+};
+
+// Coefficients which leave the signal unchanged.
+inline constexpr BiquadCoefficients PassThrough{1 << 14, 0, 0, 0, 0};
+
+// Returns the coefficients of a Butterworth low-pass filter (bilinear transform), or PassThrough
+// if the cutoff is not above 0 and at most a fifth of the sample rate.  Higher cutoffs barely
+// filter anything, and their poles are close enough to -1 for the error feedback of Biquad to
+// sustain small oscillations.
+//
+// The coefficients are adjusted after rounding so that the gain at DC is exactly one.  Precision
+// degrades for cutoffs below about 1% of the sample rate.
+BiquadCoefficients LowPass(float cutoff_hz, float sample_rate_hz);
+
+// Second order IIR filter, in direct form I.
+//
+// The remainder of the output rounding is fed back to the next sample (first order error
+// feedback), which keeps the low-frequency noise of the fixed-point arithmetic low and lets
+// constant inputs settle to their exact value.  Results are saturated to the int16_t range.
+class Biquad {
+ public:
+  explicit Biquad(const BiquadCoefficients &coefficients = PassThrough) {
+    set_coefficients(coefficients);
+  }
+
+  void set_coefficients(const BiquadCoefficients &coefficients);
+
+  // Sets the filter state as if it had always seen the value x, which avoids the transient from
+  // zero on startup.
+  void Reset(int16_t x);
+
+  int16_t Filter(int16_t x);
+  void Filter(const int16_t *in, int16_t *out, size_t n);
+
+ private:
+  // Coefficients packed the way the samples are, see Filter.
+  uint32_t b0_b1_{0};
+  uint32_t b2_a1_{0};
+  uint32_t a2_{0};
+
+  int16_t x1_{0}, x2_{0}, y1_{0}, y2_{0};
+  int64_t error_{0};
+};
+
+}  // namespace Dsp
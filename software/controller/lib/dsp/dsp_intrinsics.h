@@ -0,0 +1,101 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+// Wrappers for the few Cortex-M4 DSP instructions used by the dsp kernels.
+//
+// These instructions work on pairs of 16-bit values packed in a 32-bit word (the first element of
+// the pair in the low half, as little-endian loads put them).  On the STM32 they compile to the
+// instruction itself.  Elsewhere (native tests), they are emulated in plain C++ following the
+// instruction's definition in the ARMv7-M Architecture Reference Manual, so that the kernels run
+// the same algorithm and give bit-identical results on both.
+//
+// Our toolchain (gcc 9) doesn't have the ACLE intrinsics for these yet, hence the inline assembly.
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(BARE_STM32) && defined(__ARM_FEATURE_DSP)
+#define DSP_USE_ARM_INSTRUCTIONS 1
+#else
+#define DSP_USE_ARM_INSTRUCTIONS 0
+#endif
+
+namespace Dsp {
+
+// Loads two consecutive 16-bit values as a single word.  Unaligned loads are fine on the
+// Cortex-M4 (and memcpy compiles to a single LDR there).
+template <typename T>
+inline uint32_t LoadPair(const T *pair) {
+  static_assert(sizeof(T) == 2);
+  uint32_t word;
+  std::memcpy(&word, pair, sizeof(word));
+  return word;
+}
+
+// Packs two 16-bit values in a word, low first (PKHBT).
+inline uint32_t Pack(int16_t low, int16_t high) {
+  return static_cast<uint16_t>(low) | static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16;
+}
+
+// UXTAH: acc + low half of x.
+inline uint32_t AddLow(uint32_t acc, uint32_t x) {
+#if DSP_USE_ARM_INSTRUCTIONS
+  uint32_t result;
+  asm("uxtah %0, %1, %2" : "=r"(result) : "r"(acc), "r"(x));
+  return result;
+#else
+  return acc + (x & 0xFFFF);
+#endif
+}
+
+// UXTAH with a 16-bit rotation: acc + high half of x.
+inline uint32_t AddHigh(uint32_t acc, uint32_t x) {
+#if DSP_USE_ARM_INSTRUCTIONS
+  uint32_t result;
+  asm("uxtah %0, %1, %2, ror #16" : "=r"(result) : "r"(acc), "r"(x));
+  return result;
+#else
+  return acc + (x >> 16);
+#endif
+}
+
+// SMLALD: acc + x.low * y.low + x.high * y.high, the halves being signed.
+inline int64_t MultiplyAccumulatePairs(uint32_t x, uint32_t y, int64_t acc) {
+#if DSP_USE_ARM_INSTRUCTIONS
+  asm("smlald %Q0, %R0, %1, %2" : "+r"(acc) : "r"(x), "r"(y));
+  return acc;
+#else
+  auto low = [](uint32_t word) { return static_cast<int16_t>(word & 0xFFFF); };
+  auto high = [](uint32_t word) { return static_cast<int16_t>(word >> 16); };
+  return acc + int32_t{low(x)} * low(y) + int32_t{high(x)} * high(y);
+#endif
+}
+
+// SSAT #16: x clamped to the int16_t range.
+inline int16_t Saturate16(int32_t x) {
+#if DSP_USE_ARM_INSTRUCTIONS
+  int32_t result;
+  asm("ssat %0, #16, %1" : "=r"(result) : "r"(x));
+  return static_cast<int16_t>(result);
+#else
+  if (x > INT16_MAX) return INT16_MAX;
+  if (x < INT16_MIN) return INT16_MIN;
+  return static_cast<int16_t>(x);
+#endif
+}
+
+}  // namespace Dsp
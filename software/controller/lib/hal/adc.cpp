@@ -42,18 +42,28 @@ limitations under the License.
 // The way we get around this here and also increase the length of
 // time that we can oversample is to use DMA to continuously store
 // all the A/D readings to a circular buffer.  Each reading that is
-// stored there will be the sum of N readings of that channel.  When
-// we read the data we will sum up all the readings for a particular
-// channel stored to the buffer and scale it appropriately.
+// stored there will be the sum of N readings of that channel.  Each
+// time the DMA fills half of the buffer, its interrupt adds that half
+// to running per-channel sums over the last few halves (see
+// adc_accumulator.h), so reading a channel only takes scaling its sum.
 // This allows us to efficiently average the A/D inputs for relatively
 // long periods.
 //
+// The A/D can either convert continuously, or be triggered by the
+// control loop timer (see AdcAcquisition below).  In the latter case,
+// each control loop period the timer triggers a few interleaved scans
+// of all channels, timed so that they end just before the control
+// loop reads them.  This way, the readings the loop gets are as fresh
+// as they can be, and always of the same age.
+//
 ////////////////////////////////////////////////////////////////////
 
 #if defined(BARE_STM32)
 
+#include "adc_accumulator.h"
 #include "hal.h"
 #include "hal_stm32.h"
+#include "vars.h"
 
 /*
 Please refer to [PCB] as the ultimate source of which pin is used for which function.
@@ -68,12 +78,41 @@ The following pins are used as analog inputs on the rev-1 PCB:
 Reference abbreviations ([RM], [PCB], etc) are defined in hal/README.md
 */
 
-// How long a period (in seconds) we want to average the A/D readings.
+// How the A/D conversions are started:
+//  - FreeRunning: the A/D converts continuously, and the control loop reads the average of the
+//    last SampleHistoryTimeSec of readings, which ended anywhere within the last block of the DMA
+//    buffer (i.e. up to a third of that time ago).
+//  - LoopAligned: the control loop timer triggers AlignedScans scans each loop period, timed to
+//    end just before the control loop starts.  The loop reads the average of those scans.  Until
+//    the loop timer starts, the A/D converts continuously and readings average the last
+//    AlignedScans scans.
+// Either way, the adc_sample_age debug variable tells how old the readings are when read.
+enum class AdcAcquisition { FreeRunning, LoopAligned };
+static constexpr AdcAcquisition Acquisition{AdcAcquisition::LoopAligned};
+
+// How long a period (in seconds) we want to average the A/D readings in free running mode.
 static constexpr float SampleHistoryTimeSec = 0.001f;
+// The average must not span more than one control loop period, so that each loop gets readings
+// that are entirely new.  At 1ms, this holds at every supported loop rate.
+static_assert(SampleHistoryTimeSec <= ControlLoopPeriod.seconds());
 
 // Total number of A/D inputs we're sampling
 static constexpr int AdcChannels = 5;
 
+// A/D input of each channel, in the order of AnalogPin
+static constexpr int AdcInputs[AdcChannels] = {
+    1,   // PC0 (ADC1_IN1)  interim board: analog pressure
+    6,   // PA1 (ADC1_IN6)  U3 patient pressure
+    9,   // PA4 (ADC1_IN9)  U4 inhale flow
+    15,  // PB0 (ADC1_IN15) U5 exhale flow
+    2,   // PC3 (ADC1_IN2)  interim board: oxygen sensor
+};
+
+// Number of scans of all channels triggered each loop period in loop aligned mode.  They are
+// interleaved (first channel, second channel..., first channel again...), so that all channels
+// are averaged over about the same time.  The A/D sequences up to 16 conversions ([RM] 16.4.17).
+static constexpr int AlignedScans = 16 / AdcChannels;
+
 // Resolution of the ADC channels (in bits).
 // We are using the default value (which is also the highest possible one - see [RM] 16.4.22).
 static constexpr int AdcResolution = 12;
@@ -82,7 +121,8 @@ static constexpr int AdcResolution = 12;
 // and sum them before moving on to the next input.  The constant is set
 // as a log base 2, so a value of 3 for example would mean sample 8 times
 // (2^3 == 8).  Legal values range from 0 to 8.
-static constexpr int OversampleLog2 = 4;
+// In loop aligned mode, we only get AlignedScans scans per loop, so we oversample more.
+static constexpr int OversampleLog2 = (Acquisition == AdcAcquisition::LoopAligned) ? 5 : 4;
 static constexpr int OversampleCount = 1 << OversampleLog2;
 
 // [RM] 16.4.30: Oversampler (pg 425)
@@ -134,24 +174,51 @@ static constexpr int AdcConversionTime = [] {
   __builtin_unreachable();
 }();
 
-// Calculate how long our history buffer needs to be based on the above.
-static constexpr int AdcSampleHistory = static_cast<int>(
+// Calculate how long our history needs to be based on the above.
+static constexpr int AdcSampleHistoryTarget = static_cast<int>(
     SampleHistoryTimeSec * CPU_FREQ / AdcConversionTime / OversampleCount / AdcChannels);
 
+// In free running mode, the history is made of this many blocks, each half of the DMA buffer.
+// Every block triggers an interrupt, so more blocks mean more frequent (but shorter) interrupts,
+// and a smaller DMA buffer.
+// In loop aligned mode, each block holds the scans of a loop period, and the history is a single
+// block.
+static constexpr int AdcHistoryBlocks = (Acquisition == AdcAcquisition::LoopAligned) ? 1 : 3;
+static constexpr int AdcBlockScans = (Acquisition == AdcAcquisition::LoopAligned)
+                                         ? AlignedScans
+                                         : std::max(1, AdcSampleHistoryTarget / AdcHistoryBlocks);
+
+using Accumulator = AdcAccumulator<AdcChannels, AdcBlockScans, AdcHistoryBlocks>;
+static Accumulator adc_sums;
+static constexpr int AdcSampleHistory = Accumulator::WindowScans;
+
+// Time it takes to convert a block, and so the length of the history in loop aligned mode.
+static constexpr float AdcBlockTimeSec =
+    static_cast<float>(AdcBlockScans * AdcChannels * OversampleCount * AdcConversionTime) /
+    CPU_FREQ;
+
+// In loop aligned mode, the conversions are triggered this long before the loop starts.  This
+// leaves time for the DMA interrupt to add them to the sums.
+static constexpr float AlignedTriggerLeadSec = AdcBlockTimeSec + 20e-6f;
+static_assert(Acquisition != AdcAcquisition::LoopAligned ||
+              AlignedTriggerLeadSec < ControlLoopPeriod.seconds());
+
+// Completion time of the last block (as hal.Now(), truncated to 32 bits), and age of the readings
+// (from the middle of the history) the last time they were read, in microseconds.
+static volatile uint32_t block_end_micros{0};
+static float sample_age{0};
+static Debug::Variable::Primitive32 dbg_sample_age(
+    "adc_sample_age", Debug::Variable::Access::ReadOnly, &sample_age, "\xB5s",
+    "Age of the A/D readings when last read, from the middle of their averaging window", "%.1f");
+
 // This scaler converts the sum of the A/D readings (a total of
 // AdcSampleHistory) into a voltage.  The A/D is scaled so a value of 0
 // corresponds to 0 volts, and MaxAdcReading corresponds to 3.3V
-static constexpr float AdcScaler = 3.3f / (MaxAdcReading * AdcSampleHistory);
-
-// This buffer will hold the readings from the A/D
-static volatile uint16_t adc_buff[AdcSampleHistory * AdcChannels];
+static constexpr float AdcScaler = 3.3f / (static_cast<float>(MaxAdcReading) * AdcSampleHistory);
 
-// NOTE - we need the sample history to be small for two reasons:
-// - We sum to a 32-bit floating point number and will lose precision if we add in too many samples
-// - We want the A/D reading to be fast, so summing up a really large array might be too slow.
-//
-// If you get hit with this assertion you may need to rethink the way this function works.
-static_assert(AdcSampleHistory < 100);
+// This buffer will hold the readings from the A/D, its two halves being the blocks the DMA is
+// filling, and the one we sum.
+static volatile uint16_t adc_buff[2 * Accumulator::BlockSize];
 
 void HalApi::InitADC() {
   // Enable the clock to the A/D converter
@@ -195,6 +262,10 @@ void HalApi::InitADC() {
 
   adc->adc[0].configuration1.dma_enable = 1;
   adc->adc[0].configuration1.dma_config = 1;
+  // In loop aligned mode, we also convert continuously until the loop timer starts (which is when
+  // the sensors have been calibrated), see AdcSyncToLoopTimer.  Until then, readings average the
+  // last AlignedScans scans only, a shorter window than the SampleHistoryTimeSec used in free
+  // running mode, so the sensor zeros are averaged over that shorter window too.
   adc->adc[0].configuration1.continuous_conversion = 1;
   // note: since we are using default resolution (12 bits), we don't actually need this
   // values are from [RM] p461 (values for register RES[1:0])
@@ -227,14 +298,17 @@ void HalApi::InitADC() {
   adc->adc[0].sample_times.ch15 = static_cast<uint32_t>(AdcSampleTime);
   adc->adc[0].sample_times.ch2 = static_cast<uint32_t>(AdcSampleTime);
 
-  // Set conversion sequence length (number of used channels - 1, per [RM] p468)
-  adc->adc[0].sequence.length = AdcChannels - 1;
-
-  adc->adc[0].sequence.sequence1 = 1;   // PC0 (ADC1_IN1)  interim board: analog pressure
-  adc->adc[0].sequence.sequence2 = 6;   // PA1 (ADC1_IN6)  U3 patient pressure
-  adc->adc[0].sequence.sequence3 = 9;   // PA4 (ADC1_IN9)  U4 inhale flow
-  adc->adc[0].sequence.sequence4 = 15;  // PB0 (ADC1_IN15) U5 exhale flow
-  adc->adc[0].sequence.sequence5 = 2;   // PC3 (ADC1_IN2)  interim board: oxygen sensor
+  // Set the conversion sequence: the channels in turn, once for each scan of a sequence.
+  // The sequence registers ([RM] 16.6.11) hold 6 bits per rank, 5 ranks per register, the first
+  // register starting with the sequence length (number of conversions - 1).
+  static constexpr int SequenceScans =
+      (Acquisition == AdcAcquisition::LoopAligned) ? AlignedScans : 1;
+  volatile uint32_t *sequence = reinterpret_cast<volatile uint32_t *>(&adc->adc[0].sequence);
+  for (int i = 0; i < 4; ++i) sequence[i] = 0;
+  sequence[0] = SequenceScans * AdcChannels - 1;
+  for (int rank = 1; rank <= SequenceScans * AdcChannels; ++rank) {
+    sequence[rank / 5] |= AdcInputs[(rank - 1) % AdcChannels] << (6 * (rank % 5));
+  }
 
   // I use DMA1 channel 1 to copy A/D readings into the buffer ([RM] 11.4.4)
   EnableClock(Dma1Base);
@@ -243,11 +317,11 @@ void HalApi::InitADC() {
 
   dma->channel[c1].peripheral_address = &adc->adc[0].data;
   dma->channel[c1].memory_address = adc_buff;
-  dma->channel[c1].count = AdcSampleHistory * AdcChannels;
+  dma->channel[c1].count = 2 * Accumulator::BlockSize;
 
   dma->channel[c1].config.enable = 0;
-  dma->channel[c1].config.tx_complete_interrupt = 0;
-  dma->channel[c1].config.half_tx_interrupt = 0;
+  dma->channel[c1].config.tx_complete_interrupt = 1;
+  dma->channel[c1].config.half_tx_interrupt = 1;
   dma->channel[c1].config.tx_error_interrupt = 0;
   dma->channel[c1].config.direction = static_cast<uint32_t>(DmaChannelDir::PeripheralToMemory);
   dma->channel[c1].config.circular = 1;
@@ -258,10 +332,47 @@ void HalApi::InitADC() {
   dma->channel[c1].config.priority = 0;
   dma->channel[c1].config.enable = 1;
 
+  // The interrupt sums each half of the buffer once the DMA has filled it
+  EnableInterrupt(InterruptVector::Dma1Channel1, IntPriority::Standard);
+
   // Start the A/D converter (by setting bit 2 of the control register - per [RM] p457)
   adc->adc[0].control |= 0x00000004;
 }
 
+void AdcSyncToLoopTimer(TimerReg *timer, uint32_t period_ticks, float tick_micros) {
+  if constexpr (Acquisition != AdcAcquisition::LoopAligned) return;
+
+  // Send a trigger pulse when the counter reaches the compare value of channel 1 (frozen output
+  // compare, which only sets the compare flag), which we set so that conversions end just before
+  // the counter wraps around and the loop starts ([RM] 28.6.2 and 28.6.7).
+  uint32_t lead_ticks = static_cast<uint32_t>(AlignedTriggerLeadSec * 1e6f / tick_micros) + 1;
+  timer->capture_compare[0] = period_ticks - lead_ticks;
+  timer->capture_compare_mode[0] = 0;
+  timer->control2 = 0b011 << 4;  // MMS: compare pulse on TRGO
+
+  // Stop the continuous conversions (by setting bit 4 of the control register, and waiting for
+  // the conversion in progress to end, per [RM] 16.4.17).
+  AdcReg *adc = AdcBase;
+  adc->adc[0].control |= 0x00000010;
+  while (adc->adc[0].control & 0x00000004) {
+  }
+
+  // Restart the DMA at the beginning of the buffer, so that each trigger fills a block.
+  DmaReg *dma = Dma1Base;
+  int c1 = static_cast<int>(DmaChannel::Chan1);
+  dma->channel[c1].config.enable = 0;
+  DmaClearInt(dma, DmaChannel::Chan1, DmaInterrupt::Global);
+  dma->channel[c1].count = 2 * Accumulator::BlockSize;
+  dma->channel[c1].config.enable = 1;
+
+  // From now on, convert the sequence on each rising edge of the loop timer's trigger output
+  // (TIM15_TRGO, [RM] 16.4.18).
+  adc->adc[0].configuration1.continuous_conversion = 0;
+  adc->adc[0].configuration1.external_trigger_selection = 14;
+  adc->adc[0].configuration1.external_trigger_enable = 1;
+  adc->adc[0].control |= 0x00000004;
+}
+
 // Read the specified analog input.
 Voltage HalApi::AnalogRead(AnalogPin pin) {
   int offset = [&] {
@@ -281,14 +392,29 @@ Voltage HalApi::AnalogRead(AnalogPin pin) {
     __builtin_unreachable();
   }();
 
-  // We just run through the buffer and add up all the readings for
-  // this channel.  The DMA is still writing to this buffer in the
-  // background, but that shouldn't cause any problems because memory
-  // accesses for 16-bit values are atomic.
-  float sum = 0;
-  for (int i = 0; i < AdcSampleHistory; i++) sum += adc_buff[i * AdcChannels + offset];
+  // The sum is updated by the DMA interrupt, in a single (atomic) write.
+  float sum = static_cast<float>(adc_sums.Sum(offset));
+
+  uint32_t since_block_end =
+      static_cast<uint32_t>(hal.Now().microsSinceStartup()) - block_end_micros;
+  sample_age = static_cast<float>(since_block_end) + AdcBlockTimeSec * AdcHistoryBlocks * 1e6f / 2;
 
   return volts(sum * AdcScaler);
 }
 
+// Called when the DMA filled either half of the buffer.
+void DMA1Channel1ISR() {
+  DmaReg *dma = Dma1Base;
+  // If we were late, both halves may be ready, the first one being the oldest.
+  if (DmaIntStatus(dma, DmaChannel::Chan1, DmaInterrupt::HalfTransfer)) {
+    DmaClearInt(dma, DmaChannel::Chan1, DmaInterrupt::HalfTransfer);
+    adc_sums.AddBlock(&adc_buff[0]);
+  }
+  if (DmaIntStatus(dma, DmaChannel::Chan1, DmaInterrupt::TransferComplete)) {
+    DmaClearInt(dma, DmaChannel::Chan1, DmaInterrupt::TransferComplete);
+    adc_sums.AddBlock(&adc_buff[Accumulator::BlockSize]);
+  }
+  block_end_micros = static_cast<uint32_t>(hal.Now().microsSinceStartup());
+}
+
 #endif
@@ -0,0 +1,74 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Running per-channel sums of A/D readings, over a sliding window.
+//
+// The DMA stores readings to a circular buffer made of two blocks of BlockScans scans, a scan
+// being one reading of each of the Channels channels in turn.  Once it fills a block (which the
+// half-transfer and transfer-complete interrupts tell us), that block is handed to AddBlock, which
+// sums its readings per channel.  The window is made of the last WindowBlocks such blocks: we keep
+// the sums of each of them, so that the window sums only take adding the new block's sums and
+// subtracting those of the block it replaces.
+//
+// Reading the sum of a channel is then a single load, whatever the window length, and the window
+// can be much longer than the DMA buffer.  Until the window is full, the missing blocks count as
+// zero.
+//
+// AddBlock is meant to be called from an interrupt handler, and Sum from other contexts: each sum
+// is a single 32-bit word, which is read and written atomically.
+template <size_t Channels, size_t BlockScans, size_t WindowBlocks>
+class AdcAccumulator {
+  static_assert(Channels > 0 && BlockScans > 0 && WindowBlocks > 0);
+
+ public:
+  // Number of readings of each channel in the window.
+  static constexpr size_t WindowScans{BlockScans * WindowBlocks};
+
+  // Number of readings in a block (half of the DMA buffer).
+  static constexpr size_t BlockSize{BlockScans * Channels};
+
+  // Window sums can't overflow, even with readings of 0xFFFF.
+  static_assert(WindowScans <= UINT32_MAX / UINT16_MAX, "A/D window is too long");
+
+  // Adds the block of BlockSize interleaved readings to the window, replacing the oldest one.
+  void AddBlock(const volatile uint16_t *block) {
+    uint32_t *block_sums = block_sums_[oldest_];
+    for (size_t channel = 0; channel < Channels; ++channel) {
+      uint32_t block_sum = 0;
+      for (size_t i = channel; i < BlockSize; i += Channels) block_sum += block[i];
+
+      // Unsigned arithmetic wraps around, so the sum is right even if the intermediate is not.
+      uint32_t sum = sums_[channel].load(std::memory_order_relaxed);
+      sums_[channel].store(sum + block_sum - block_sums[channel], std::memory_order_relaxed);
+      block_sums[channel] = block_sum;
+    }
+    oldest_ = (oldest_ + 1 == WindowBlocks) ? 0 : oldest_ + 1;
+  }
+
+  // Returns the sum of the readings of the channel over the window.
+  uint32_t Sum(size_t channel) const { return sums_[channel].load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint32_t> sums_[Channels] = {};
+  uint32_t block_sums_[WindowBlocks][Channels] = {};
+  // index in block_sums_ of the oldest block of the window
+  size_t oldest_{0};
+};
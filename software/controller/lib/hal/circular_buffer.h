@@ -26,6 +26,9 @@ limitations under the License.
 // and the interrupt handlers, so it needs to be thread safe.
 // I'm disabling interrupts during the critical sections to
 // ensure that's the case.
+//
+// Buffers that have a single writer and a single reader should rather use
+// SpscRing (see spsc_ring.h), which doesn't need to disable interrupts.
 template <class T, size_t N>
 class CircularBuffer {
   // Uses an array of size N+1 to hold all N elements of the buffer, as
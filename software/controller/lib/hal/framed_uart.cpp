@@ -0,0 +1,108 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "framed_uart.h"
+
+#include "hal.h"
+
+FramedUart rpi_uart(&uart_dma);
+
+void FramedUart::init(uint32_t baud) {
+  uart_->init(baud);
+  uart_->enable_character_match();
+  restart_rx();
+}
+
+bool FramedUart::send(const uint8_t *payload, uint32_t length) {
+  if (tx_pending_ || length > MaxPayloadSize) return false;
+
+  // The buffer that DMA is not reading from is ours until we mark it pending.
+  uint8_t index = tx_in_progress_ ? static_cast<uint8_t>(1 - tx_active_) : tx_active_;
+  tx_lengths_[index] = encode_frame(payload, length, tx_buffers_[index], FrameBufferSize);
+  if (tx_lengths_[index] == 0) return false;
+
+  BlockInterrupts block;
+  if (tx_in_progress_) {
+    // on_tx_complete will send it.
+    tx_pending_ = true;
+  } else {
+    start_tx(index);
+  }
+  return true;
+}
+
+void FramedUart::start_tx(uint8_t index) {
+  tx_active_ = index;
+  tx_in_progress_ = uart_->start_tx(tx_buffers_[index], tx_lengths_[index], this);
+}
+
+void FramedUart::on_tx_complete() {
+  tx_in_progress_ = false;
+  if (tx_pending_) {
+    start_tx(static_cast<uint8_t>(1 - tx_active_));
+    tx_pending_ = false;
+  }
+}
+
+// The frame is lost, move on to the next one.
+void FramedUart::on_tx_error() { on_tx_complete(); }
+
+uint32_t FramedUart::receive(uint8_t *payload, uint32_t size) {
+  uint32_t length = rx_ready_length_;
+  if (length == 0) return 0;
+
+  // The interrupt handlers leave the ready buffer alone until we reset
+  // rx_ready_length_.
+  uint32_t payload_length = decode_frame(rx_buffers_[1 - rx_active_], length, payload, size);
+  rx_ready_length_ = 0;
+  if (payload_length == 0) ++rx_errors_;
+  return payload_length;
+}
+
+void FramedUart::restart_rx() {
+  uart_->stop_rx();
+  (void)uart_->start_rx(rx_buffers_[rx_active_], FrameBufferSize, this);
+}
+
+void FramedUart::on_character_match() {
+  uint32_t received = FrameBufferSize - uart_->rx_bytes_left();
+  // A mark at the start of the buffer opens a frame, wait for the one closing it.
+  if (received <= 1) return;
+
+  if (rx_ready_length_ != 0) {
+    // The previous frame hasn't been read yet, drop this one.
+    ++rx_dropped_;
+    restart_rx();
+    return;
+  }
+
+  uart_->stop_rx();
+  rx_active_ = static_cast<uint8_t>(1 - rx_active_);
+  (void)uart_->start_rx(rx_buffers_[rx_active_], FrameBufferSize, this);
+  // Hand over the frame only once we're done with the buffer indexes.
+  rx_ready_length_ = received;
+}
+
+// We filled the whole buffer without seeing the end of a frame, so this is
+// either garbage or a frame too long for us.
+void FramedUart::on_rx_complete() {
+  ++rx_errors_;
+  restart_rx();
+}
+
+void FramedUart::on_rx_error(RxError) {
+  ++rx_errors_;
+  restart_rx();
+}
@@ -0,0 +1,109 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "framing.h"
+#include "serial_listeners.h"
+#include "uart_dma.h"
+
+/*! \class FramedUart framed_uart.h "framed_uart.h"
+ *  \brief Sends and receives whole frames (see framing.h) through a UartDma.
+ *
+ * Both directions are double-buffered, so that the CPU never has to touch individual bytes:
+ *
+ *  - send() encodes a frame into whichever transmit buffer DMA is not currently reading from,
+ *    and the frame is handed over to DMA as soon as the previous one is done (from the DMA
+ *    interrupt).
+ *  - DMA writes received bytes to one receive buffer, and the UART character match interrupt
+ *    tells us when a FramingMark arrives.  If that mark ends a frame, reception moves on to the
+ *    other buffer while receive() decodes the frame at its leisure.
+ *
+ * Only the latest frames matter to us (they carry the current state of the controller or of the
+ * GUI), so when we can't keep up we drop frames rather than queue them: at most one frame waits
+ * to be sent, and at most one received frame waits to be read.
+ *
+ * Listener callbacks are called from interrupt context, while send() and receive() are meant to
+ * be called from the main loop.
+ */
+class FramedUart : public RxListener, public TxListener {
+ public:
+  // Largest payload we can send or receive.  This needs to fit a ControllerStatus with a full
+  // batch of samples, even though the typical one is a fraction of that.
+  static constexpr uint32_t MaxPayloadSize{640};
+  static constexpr uint32_t FrameBufferSize{max_encoded_frame_size(MaxPayloadSize)};
+
+  explicit FramedUart(UartDma *uart) : uart_(uart) {}
+
+  /// \brief Initializes the UART and starts listening for frames
+  void init(uint32_t baud);
+
+  /// \returns true if send() can take a frame right away
+  bool ready_to_send() const { return !tx_pending_; }
+
+  /*! \brief Frames the payload and sends it
+   *  \returns false if the payload is too large, or if a frame is already waiting for the
+   *  previous one to be sent.
+   */
+  bool send(const uint8_t *payload, uint32_t length);
+
+  /*! \brief Decodes the last received frame, if any, into payload
+   *  \returns length of the payload, or 0 if no valid frame was received since the last call
+   */
+  uint32_t receive(uint8_t *payload, uint32_t size);
+
+  /// \returns number of received frames that were invalid (bad CRC, escaping, or too long)
+  uint32_t rx_errors() const { return rx_errors_; }
+  /// \returns number of received frames that were dropped because receive() wasn't called soon
+  /// enough
+  uint32_t rx_dropped() const { return rx_dropped_; }
+
+  // RxListener and TxListener interface
+  void on_rx_complete() override;
+  void on_character_match() override;
+  void on_rx_error(RxError) override;
+  void on_tx_complete() override;
+  void on_tx_error() override;
+
+ private:
+  // Restarts reception into the active receive buffer, discarding its contents.
+  void restart_rx();
+  // Hands the given transmit buffer to DMA.
+  void start_tx(uint8_t index);
+
+  UartDma *uart_;
+
+  uint8_t tx_buffers_[2][FrameBufferSize];
+  uint32_t tx_lengths_[2]{0, 0};
+  // Index of the buffer that DMA is sending.
+  volatile uint8_t tx_active_{0};
+  volatile bool tx_in_progress_{false};
+  // Whether the other buffer holds a frame that has yet to be sent.
+  volatile bool tx_pending_{false};
+
+  uint8_t rx_buffers_[2][FrameBufferSize];
+  // Index of the buffer that DMA is filling.
+  volatile uint8_t rx_active_{0};
+  // Length of the frame held by the other buffer, 0 if it doesn't hold one.
+  volatile uint32_t rx_ready_length_{0};
+
+  volatile uint32_t rx_errors_{0};
+  volatile uint32_t rx_dropped_{0};
+};
+
+// Link to the GUI
+extern FramedUart rpi_uart;
@@ -35,6 +35,7 @@ limitations under the License.
 
 #include <algorithm>
 
+#include "span.h"
 #include "units.h"
 
 #ifdef TEST_MODE
@@ -60,6 +61,19 @@ limitations under the License.
 
 #endif  // TEST_MODE
 
+// Frequency of the control loop, which is driven by the loop timer.  This is
+// selected at build time by adding e.g. -DCONTROL_LOOP_HZ=500 to the build
+// flags.  Anything that depends on the loop rate (filter coefficients, sensor
+// averaging windows...) must be derived from ControlLoopPeriod, so that the
+// controller behaves the same whatever the rate.
+#ifndef CONTROL_LOOP_HZ
+#define CONTROL_LOOP_HZ 100
+#endif
+static_assert(CONTROL_LOOP_HZ == 100 || CONTROL_LOOP_HZ == 250 || CONTROL_LOOP_HZ == 500 ||
+                  CONTROL_LOOP_HZ == 1000,
+              "Unsupported control loop rate, CONTROL_LOOP_HZ must be 100, 250, 500 or 1000");
+inline constexpr Duration ControlLoopPeriod{microseconds(1'000'000 / CONTROL_LOOP_HZ)};
+
 // ---------------------------------------------------------------
 // Strongly typed analogues of some Arduino types.
 // "Strongly typed" means that it will be a compile error, e.g.,
@@ -137,12 +151,18 @@ class TestSerialPort {
   [[nodiscard]] uint16_t Read(char *buf, uint16_t len);
   uint16_t BytesAvailableForWrite();
   uint16_t BytesAvailableForRead();
+  Span<const uint8_t> ReadSpan();
+  void Consume(size_t count);
+  Span<uint8_t> WriteSpan();
+  void CommitWrite(size_t count);
   void PutIncomingData(const char *data, uint16_t len);
   uint16_t GetOutgoingData(char *data, uint16_t len);
 
  private:
   std::deque<std::vector<char>> incoming_data_;
   std::vector<char> outgoing_data_;
+  // Handed out by WriteSpan, copied to outgoing_data_ on CommitWrite.
+  uint8_t write_span_[64] = {0};
 };
 #endif  // TEST_MODE
 
@@ -195,41 +215,34 @@ class HalApi {
   // Sets `pin` to high or low.
   void DigitalWrite(BinaryPin pin, VoltageLevel value);
 
-  // Receives bytes from the GUI controller along the serial bus.
-  //
-  // Arduino's SerialIO will block if len > SerialBytesAvailableForRead(), but
-  // this function will never block. Instead it returns the number of bytes
-  // read.  It's up to you to check how many bytes were actually read and
-  // handle "short reads" where we read fewer bytes than were requested.
-  //
-  // TODO(jlebar): Change the serial* functions to use uint32_t once we've
-  // dropped support for Arduino.
-  [[nodiscard]] uint16_t SerialRead(char *buf, uint16_t len);
-
-  // Number of bytes we can read without blocking.
-  uint16_t SerialBytesAvailableForRead();
-
-  // Sends bytes to the GUI controller along the serial bus.
+  // Serial port used for debugging.  (The serial port to the GUI controller
+  // sends and receives whole frames, see framed_uart.h.)
   //
-  // Arduino's SerialIO will block if len > SerialBytesAvailableForWrite(),
-  // but this function will never block.  Instead, it returns the number of
-  // bytes written.  number of bytes written.  It's up to you to check how
-  // many bytes were actually written and handle "short writes" where we wrote
-  // less than the whole buffer.
-  [[nodiscard]] uint16_t SerialWrite(const char *buf, uint16_t len);
-  [[nodiscard]] uint16_t SerialWrite(uint8_t data) {
-    return SerialWrite(reinterpret_cast<const char *>(&data), 1);
-  }
-
-  // Number of bytes we can write without blocking.
-  uint16_t SerialBytesAvailableForWrite();
-
-  // Serial port used for debugging
+  // Arduino's SerialIO will block if len > DebugBytesAvailableForRead() or
+  // DebugBytesAvailableForWrite(), but these functions will never block.
+  // Instead they return the number of bytes actually read or written, and it's
+  // up to you to handle "short reads" and "short writes".
   [[nodiscard]] uint16_t DebugWrite(const char *buf, uint16_t len);
   [[nodiscard]] uint16_t DebugRead(char *buf, uint16_t len);
   uint16_t DebugBytesAvailableForWrite();
   uint16_t DebugBytesAvailableForRead();
 
+  // Zero-copy access to the debug serial port buffers, which lets us parse
+  // incoming data and format outgoing data in bulk, without going through
+  // intermediate copies and a function call per byte:
+  //  - DebugReadSpan() returns (some of) the received data, of which the first
+  //    `count` bytes are popped by DebugConsume(count).
+  //  - DebugWriteSpan() returns (some of) the free space in the transmit
+  //    buffer, of which DebugCommitWrite(count) sends the first `count` bytes.
+  // Spans don't necessarily cover all received data or free space, as those
+  // may wrap around the end of the buffers: call them again after consuming
+  // or committing to get the rest.  Spans stay valid until the next consume or
+  // commit, and an empty span means there is nothing to read / no room left.
+  Span<const uint8_t> DebugReadSpan();
+  void DebugConsume(size_t count);
+  Span<uint8_t> DebugWriteSpan();
+  void DebugCommitWrite(size_t count);
+
   // Buzzer used for alarms.  These functions turn the buzzer on/off.
   void BuzzerOn(float volume = 1.0f);
   void BuzzerOff();
@@ -262,50 +275,68 @@ class HalApi {
   void EarlyInit();
 
 #else
-  // Reads up to `len` bytes of data "sent" via SerialWrite.  Returns the
+  // Reads up to `len` bytes of data "sent" via DebugWrite.  Returns the
   // total number of bytes read.
-  //
-  // TODO: Once we have explicit message framing, this should simply read one
-  // message.
-  uint16_t TESTSerialGetOutgoingData(char *data, uint16_t len);
+  uint16_t TESTDebugGetOutgoingData(char *data, uint16_t len);
 
-  // Simulates receiving serial data from the GUI controller.  Makes these
-  // bytes available to be read by serialReadByte().
+  // Simulates receiving serial data from the debug port.  Makes these bytes
+  // available to be read by DebugRead().
   //
   // Large buffers sent this way will be split into smaller buffers, to
   // simulate the fact that the Arduino has a small rx buffer.
   //
-  // Furthermore, SerialRead() will not read across a
-  // TESTSerialPutIncomingData() boundary.  This allows you to test short
+  // Furthermore, DebugRead() will not read across a
+  // TESTDebugPutIncomingData() boundary.  This allows you to test short
   // reads.  For example, if you did
   //
   //   char buf1[8];
   //   char buf2[4];
-  //   hal.TESTSerialPutIncomingData(buf1, 8);
-  //   hal.TESTSerialPutIncomingData(buf2, 4);
+  //   hal.TESTDebugPutIncomingData(buf1, 8);
+  //   hal.TESTDebugPutIncomingData(buf2, 4);
   //
   // then the you'd have the following execution
   //
   //   char buf[16];
-  //   hal.SerialBytesAvailableForRead() == 8
-  //   hal.SerialRead(buf, 16) == 8
-  //   hal.SerialBytesAvailableForRead() == 4
-  //   hal.SerialRead(buf, 16) == 4
-  //   hal.SerialBytesAvailableForRead() == 0
+  //   hal.DebugBytesAvailableForRead() == 8
+  //   hal.DebugRead(buf, 16) == 8
+  //   hal.DebugBytesAvailableForRead() == 4
+  //   hal.DebugRead(buf, 16) == 4
+  //   hal.DebugBytesAvailableForRead() == 0
   //
-  void TESTSerialPutIncomingData(const char *data, uint16_t len);
-
-  // Same as above, but for the debug serial port.
-  uint16_t TESTDebugGetOutgoingData(char *data, uint16_t len);
   void TESTDebugPutIncomingData(const char *data, uint16_t len);
 #endif
 
   // Performs the device soft-reset
   [[noreturn]] void ResetDevice();
 
+  // Returns true if the last reset was caused by the watchdog or by ResetDevice, rather than by
+  // powering on or the reset pin.  The rest of the board, notably the stepper motor drivers, kept
+  // its power and state through such a reset.
+  //
+  // In test mode, returns the last value set via TESTSetWarmReset.
+  bool WarmReset() const { return warm_reset_; }
+
+#ifdef TEST_MODE
+  void TESTSetWarmReset(bool warm) { warm_reset_ = warm; }
+#endif
+
+  // Initializes the stepper motor drivers.  This isn't part of Init, because
+  // whether the drivers may keep their state through a warm reset depends on
+  // the non-volatile params, which can only be read once Init is done.  Unless
+  // keep_state is set, the drivers are reset and configured from scratch.
+  void StepperMotorInit(bool keep_state);
+
   // Start the loop timer
   void StartLoopTimer(const Duration &period, void (*callback)(void *), void *arg);
 
+  // Time elapsed since the start of the current loop timer period, in
+  // microseconds.  This is meant for profiling the control loop, so it has
+  // sub-microsecond resolution on the STM32.
+  //
+  // Faked when testing: the loop timer starts when StartLoopTimer is called
+  // and advances with Delay().
+  float LoopTimerMicros();
+
   // Pets the watchdog, this makes the watchdog not reset the
   // system for configured amount of time
   void WatchdogHandler();
@@ -326,7 +357,13 @@ class HalApi {
   bool InterruptsEnabled() const;
 
   // Return true if we are currently executing in an interrupt handler
+  //
+  // In test mode, returns the last value set via TESTSetInInterruptHandler,
+  // which lets tests act as the control loop.
   bool InInterruptHandler();
+#ifdef TEST_MODE
+  void TESTSetInInterruptHandler(bool in_handler) { in_interrupt_handler_ = in_handler; }
+#endif
 
  private:
   // Initializes watchdog, sets appropriate pins to Output, etc.  Called by
@@ -342,7 +379,6 @@ class HalApi {
   void InitUARTs();
   void EnableClock(volatile void *ptr);
   void EnableInterrupt(InterruptVector vec, IntPriority pri);
-  void StepperMotorInit();
   void InitBuzzer();
 
 #endif
@@ -350,9 +386,15 @@ class HalApi {
   void SetDigitalPinMode(PwmPin pin, PinMode mode);
   void SetDigitalPinMode(BinaryPin pin, PinMode mode);
 
+  bool warm_reset_{false};
+
 #ifdef TEST_MODE
   Time time_ = microsSinceStartup(0);
   bool interrupts_enabled_ = true;
+  bool in_interrupt_handler_ = false;
+
+  Time loop_timer_start_ = microsSinceStartup(0);
+  Duration loop_timer_period_ = microseconds(0);
 
   // The default pin mode on Arduino is Input, which happens to be the first
   // enumerator in PinMode and so the default in these maps!
@@ -366,7 +408,6 @@ class HalApi {
   std::map<BinaryPin, VoltageLevel> binary_pin_values_;
   std::map<PwmPin, float> pwm_pin_values_;
 
-  TestSerialPort serial_port_;
   TestSerialPort debug_serial_port_;
 #endif
 };
@@ -425,6 +466,7 @@ inline bool HalApi::InInterruptHandler() {
 
 #else
 inline void HalApi::Init() {}
+inline void HalApi::StepperMotorInit(bool keep_state) {}
 inline void HalApi::WatchdogHandler() {}
 
 inline Time HalApi::Now() { return time_; }
@@ -450,23 +492,6 @@ inline void HalApi::AnalogWrite(PwmPin pin, float duty) {
   pwm_pin_values_[pin] = duty;
 }
 
-inline uint16_t HalApi::SerialRead(char *buf, uint16_t len) { return serial_port_.Read(buf, len); }
-inline uint16_t HalApi::SerialBytesAvailableForRead() {
-  return serial_port_.BytesAvailableForRead();
-}
-inline uint16_t HalApi::SerialWrite(const char *buf, uint16_t len) {
-  return serial_port_.Write(buf, len);
-}
-inline uint16_t HalApi::SerialBytesAvailableForWrite() {
-  return serial_port_.BytesAvailableForWrite();
-}
-inline uint16_t HalApi::TESTSerialGetOutgoingData(char *data, uint16_t len) {
-  return serial_port_.GetOutgoingData(data, len);
-}
-inline void HalApi::TESTSerialPutIncomingData(const char *data, uint16_t len) {
-  serial_port_.PutIncomingData(data, len);
-}
-
 inline uint16_t HalApi::DebugRead(char *buf, uint16_t len) {
   return debug_serial_port_.Read(buf, len);
 }
@@ -479,6 +504,10 @@ inline uint16_t HalApi::DebugWrite(const char *buf, uint16_t len) {
 inline uint16_t HalApi::DebugBytesAvailableForWrite() {
   return debug_serial_port_.BytesAvailableForWrite();
 }
+inline Span<const uint8_t> HalApi::DebugReadSpan() { return debug_serial_port_.ReadSpan(); }
+inline void HalApi::DebugConsume(size_t count) { debug_serial_port_.Consume(count); }
+inline Span<uint8_t> HalApi::DebugWriteSpan() { return debug_serial_port_.WriteSpan(); }
+inline void HalApi::DebugCommitWrite(size_t count) { debug_serial_port_.CommitWrite(count); }
 inline uint16_t HalApi::TESTDebugGetOutgoingData(char *data, uint16_t len) {
   return debug_serial_port_.GetOutgoingData(data, len);
 }
@@ -489,7 +518,7 @@ inline void HalApi::TESTDebugPutIncomingData(const char *data, uint16_t len) {
 inline void HalApi::DisableInterrupts() { interrupts_enabled_ = false; }
 inline void HalApi::EnableInterrupts() { interrupts_enabled_ = true; }
 inline bool HalApi::InterruptsEnabled() const { return interrupts_enabled_; }
-inline bool HalApi::InInterruptHandler() { return false; }
+inline bool HalApi::InInterruptHandler() { return in_interrupt_handler_; }
 
 inline uint16_t TestSerialPort::Read(char *buf, uint16_t len) {
   if (incoming_data_.empty()) {
@@ -517,6 +546,32 @@ inline uint16_t TestSerialPort::BytesAvailableForWrite() {
   // the Arduino tx buffer.
   return 64;
 }
+// Like Read, spans don't go across a PutIncomingData boundary.
+inline Span<const uint8_t> TestSerialPort::ReadSpan() {
+  if (incoming_data_.empty()) {
+    return {};
+  }
+  auto &read_buffer = incoming_data_.front();
+  return {reinterpret_cast<const uint8_t *>(read_buffer.data()), read_buffer.size()};
+}
+inline void TestSerialPort::Consume(size_t count) {
+  if (incoming_data_.empty()) {
+    return;
+  }
+  auto &read_buffer = incoming_data_.front();
+  count = std::min(count, read_buffer.size());
+  read_buffer.erase(read_buffer.begin(), read_buffer.begin() + count);
+  if (read_buffer.empty()) {
+    incoming_data_.pop_front();
+  }
+}
+inline Span<uint8_t> TestSerialPort::WriteSpan() {
+  return {write_span_, std::min<size_t>(std::size(write_span_), BytesAvailableForWrite())};
+}
+inline void TestSerialPort::CommitWrite(size_t count) {
+  outgoing_data_.insert(outgoing_data_.end(), write_span_,
+                        write_span_ + std::min(count, std::size(write_span_)));
+}
 inline uint16_t TestSerialPort::GetOutgoingData(char *data, uint16_t len) {
   uint16_t n = std::min(len, static_cast<uint16_t>(outgoing_data_.size()));
   memcpy(data, outgoing_data_.data(), n);
@@ -533,7 +588,15 @@ inline void TestSerialPort::PutIncomingData(const char *data, uint16_t len) {
   incoming_data_.push_back(std::vector<char>(data, data + len));
 }
 
-inline void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), void *arg) {}
+inline void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), void *arg) {
+  loop_timer_start_ = time_;
+  loop_timer_period_ = period;
+}
+inline float HalApi::LoopTimerMicros() {
+  int64_t elapsed = (time_ - loop_timer_start_).microseconds();
+  if (loop_timer_period_ > microseconds(0)) elapsed %= loop_timer_period_.microseconds();
+  return static_cast<float>(elapsed);
+}
 
 inline void BuzzerOn(float volume) {}
 inline void BuzzerOff() {}
@@ -32,8 +32,10 @@ Abbreviations [RM], [DS], etc are defined in hal/README.md.
 #include <optional>
 
 #include "checksum.h"
-#include "circular_buffer.h"
+#include "framed_uart.h"
 #include "hal.h"
+#include "histogram.h"
+#include "spsc_ring.h"
 #include "stepper.h"
 #include "uart_dma.h"
 #include "vars.h"
@@ -54,6 +56,7 @@ static volatile int64_t ms_count;
 static void Timer6ISR();
 static void Timer15ISR();
 void Uart3ISR();
+void DMA1Channel1ISR();
 void DMA1Channel2ISR();
 void DMA1Channel3ISR();
 void I2c1EventISR();
@@ -162,6 +165,19 @@ void HalApi::EarlyInit() {
  * One time init of HAL.
  */
 void HalApi::Init() {
+  // Find out what caused the last reset, then clear the reset flags for the next one.
+  // [RM] 6.4.29 Control/status register (RCC_CSR)
+  RccReg *rcc = RccBase;
+  static constexpr uint32_t BrownoutResetFlag{1u << 27};
+  static constexpr uint32_t SoftwareResetFlag{1u << 28};
+  static constexpr uint32_t IndependentWatchdogResetFlag{1u << 29};
+  static constexpr uint32_t WindowWatchdogResetFlag{1u << 30};
+  uint32_t reset_flags = rcc->status;
+  warm_reset_ = (reset_flags & BrownoutResetFlag) == 0 &&
+                (reset_flags & (SoftwareResetFlag | IndependentWatchdogResetFlag |
+                                WindowWatchdogResetFlag)) != 0;
+  rcc->status |= 1u << 23;
+
   // Init various components needed by the system.
   InitGpio();
   InitSysTimer();
@@ -172,7 +188,6 @@ void HalApi::Init() {
   InitPSOL();
   InitI2C();
   EnableInterrupts();
-  StepperMotorInit();
 }
 
 // Reset the processor
@@ -331,6 +346,8 @@ Time HalApi::Now() {
  *****************************************************************/
 static void (*controller_callback)(void *);
 static void *controller_arg;
+// Duration of one loop timer tick, in microseconds
+static float loop_timer_tick_micros;
 void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), void *arg) {
   controller_callback = callback;
   controller_arg = arg;
@@ -350,6 +367,7 @@ void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), vo
     prescale = static_cast<int>(reload / 65536.0) + 1;
     reload /= prescale;
   }
+  loop_timer_tick_micros = static_cast<float>(prescale) / CPU_FREQ_MHZ;
 
   // Enable the clock to the timer
   EnableClock(Timer15Base);
@@ -359,6 +377,8 @@ void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), vo
   tmr->auto_reload = reload - 1;
   tmr->prescaler = prescale - 1;
   tmr->event = 1;
+  // The timer may also trigger A/D conversions, timed relative to the loop.
+  AdcSyncToLoopTimer(tmr, reload, loop_timer_tick_micros);
   tmr->control_reg1.bitfield.counter_enable = 1;
   tmr->interrupts_enable = 1;
 
@@ -371,6 +391,13 @@ void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), vo
   EnableInterrupt(InterruptVector::Timer15, IntPriority::Low);
 }
 
+float HalApi::LoopTimerMicros() {
+  return static_cast<float>(Timer15Base->counter) * loop_timer_tick_micros;
+}
+
+// Number of buckets of the loop timing histograms
+static constexpr size_t LoopHistogramBuckets{32};
+
 static float latency, max_latency, loop_time;
 static Debug::Variable::Primitive32 dbg_loop_latency("loop_latency",
                                                      Debug::Variable::Access::ReadOnly, &latency,
@@ -382,21 +409,25 @@ static Debug::Variable::Primitive32 dbg_max_latency("max_latency",
 static Debug::Variable::Primitive32 dbg_loop_time("loop_time", Debug::Variable::Access::ReadOnly,
                                                   &loop_time, "\xB5s", "Duration of loop function",
                                                   "%.2f");
+static Debug::Variable::Histogram<LoopHistogramBuckets> dbg_latency_histogram(
+    "loop_hist_latency", 1.0f, "\xB5s", "Histogram of the latency of the loop function");
+static Debug::Variable::Histogram<LoopHistogramBuckets> dbg_loop_time_histogram(
+    "loop_hist_time", 100.0f, "\xB5s", "Histogram of the duration of the loop function");
 
 static void Timer15ISR() {
-  uint32_t start = Timer15Base->counter;
+  latency = hal.LoopTimerMicros();
   Timer15Base->status = 0;
 
   // Keep track of loop latency in uSec
   // Also max latency since it was last zeroed
-  latency = static_cast<float>(start) * (1.0f / CPU_FREQ_MHZ);
   if (latency > max_latency) max_latency = latency;
+  dbg_latency_histogram.add(latency);
 
   // Call the function
   controller_callback(controller_arg);
 
-  uint32_t end = Timer15Base->counter;
-  loop_time = static_cast<float>(end - start) * (1.0f / CPU_FREQ_MHZ);
+  loop_time = hal.LoopTimerMicros() - latency;
+  dbg_loop_time_histogram.add(loop_time);
 
   // Start sending any queued commands to the stepper motor
   StepMotor::StartQueuedCommands();
@@ -477,13 +508,16 @@ void HalApi::AnalogWrite(PwmPin pin, float duty) {
 }
 
 /******************************************************************
- * Serial port to GUI
+ * Interrupt driven serial port, used for the debug interface.
+ * (The serial port to the GUI uses DMA, see framed_uart.h)
  * [RM] Chapter 38 defines the USART registers.
  *****************************************************************/
 
 class UART {
-  CircularBuffer<uint8_t, 128> rx_data_;
-  CircularBuffer<uint8_t, 128> tx_data_;
+  // Each buffer is written on one side (ISR or main loop) and read on the other, so the ISR never
+  // needs to disable interrupts.
+  SpscRing<uint8_t, 128> rx_data_;
+  SpscRing<uint8_t, 128> tx_data_;
   UartReg *const uart_;
 
  public:
@@ -540,17 +574,9 @@ class UART {
   // are available it will only return the available bytes
   // Returns the number of bytes actually read.
   uint16_t Read(char *buf, uint16_t len) {
-    for (uint16_t i = 0; i < len; i++) {
-      std::optional<uint8_t> ch = rx_data_.Get();
-      if (ch == std::nullopt) {
-        return i;
-      }
-      *buf++ = *ch;
-    }
-
     // Note that we don't need to enable the rx interrupt
     // here.  That one is always enabled.
-    return len;
+    return static_cast<uint16_t>(rx_data_.Read(reinterpret_cast<uint8_t *>(buf), len));
   }
 
   // Write up to len bytes to the buffer.
@@ -559,16 +585,23 @@ class UART {
   // will occur.
   // The number of bytes actually written is returned.
   uint16_t Write(const char *buf, uint16_t len) {
-    uint16_t i;
-    for (i = 0; i < len; i++) {
-      if (!tx_data_.Put(*buf++)) break;
-    }
+    auto written =
+        static_cast<uint16_t>(tx_data_.Write(reinterpret_cast<const uint8_t *>(buf), len));
 
     // Enable the tx interrupt.  If there was already anything
     // in the buffer this will already be enabled, but enabling
     // it again doesn't hurt anything.
     uart_->control_reg1.bitfield.tx_interrupt = 1;
-    return i;
+    return written;
+  }
+
+  // Zero-copy versions of Read and Write, see HalApi::DebugReadSpan.
+  Span<const uint8_t> ReadSpan() const { return rx_data_.ReadSpan(); }
+  void Consume(size_t count) { rx_data_.Consume(count); }
+  Span<uint8_t> WriteSpan() { return tx_data_.WriteSpan(); }
+  void CommitWrite(size_t count) {
+    tx_data_.CommitWrite(count);
+    uart_->control_reg1.bitfield.tx_interrupt = 1;
   }
 
   // Return the number of bytes currently in the
@@ -580,11 +613,7 @@ class UART {
   uint16_t TxFree() { return static_cast<uint16_t>(tx_data_.FreeCount()); }
 };
 
-static UART rpi_uart(Uart3Base);
 static UART debug_uart(Uart2Base);
-#ifdef UART_VIA_DMA
-extern UartDma dma_uart;
-#endif
 // The UART that talks to the rPi uses the following pins:
 //    PB10 - TX
 //    PB11 - RX
@@ -608,9 +637,7 @@ void HalApi::InitUARTs() {
   //        Need to do that as soon as the boards are available.
   EnableClock(Uart2Base);
   EnableClock(Uart3Base);
-#ifdef UART_VIA_DMA
   EnableClock(Dma1Base);
-#endif
   GpioPinAltFunc(GpioABase, 2, 7);
   GpioPinAltFunc(GpioABase, 3, 7);
 
@@ -619,11 +646,9 @@ void HalApi::InitUARTs() {
   GpioPinAltFunc(GpioBBase, 13, 7);
   GpioPinAltFunc(GpioBBase, 14, 7);
 
-#ifdef UART_VIA_DMA
-  dma_uart.Init(115200);
-#else
-  rpi_uart.Init(115200);
-#endif
+  // The rPi link sends frames through DMA, see framed_uart.h
+  DmaCtrl(Dma1Base).init();
+  rpi_uart.init(115200);
   debug_uart.Init(115200);
 
   EnableInterrupt(InterruptVector::Dma1Channel2, IntPriority::Standard);
@@ -634,23 +659,19 @@ void HalApi::InitUARTs() {
 
 static void Uart2ISR() { debug_uart.ISR(); }
 
-#ifndef UART_VIA_DMA
-void Uart3ISR() { rpi_uart.ISR(); }
-#endif
-
-uint16_t HalApi::SerialRead(char *buf, uint16_t len) { return rpi_uart.Read(buf, len); }
+uint16_t HalApi::DebugWrite(const char *buf, uint16_t len) { return debug_uart.Write(buf, len); }
 
-uint16_t HalApi::SerialBytesAvailableForRead() { return rpi_uart.RxFull(); }
+uint16_t HalApi::DebugRead(char *buf, uint16_t len) { return debug_uart.Read(buf, len); }
 
-uint16_t HalApi::SerialWrite(const char *buf, uint16_t len) { return rpi_uart.Write(buf, len); }
+uint16_t HalApi::DebugBytesAvailableForWrite() { return debug_uart.TxFree(); }
 
-uint16_t HalApi::SerialBytesAvailableForWrite() { return rpi_uart.TxFree(); }
+Span<const uint8_t> HalApi::DebugReadSpan() { return debug_uart.ReadSpan(); }
 
-uint16_t HalApi::DebugWrite(const char *buf, uint16_t len) { return debug_uart.Write(buf, len); }
+void HalApi::DebugConsume(size_t count) { debug_uart.Consume(count); }
 
-uint16_t HalApi::DebugRead(char *buf, uint16_t len) { return debug_uart.Read(buf, len); }
+Span<uint8_t> HalApi::DebugWriteSpan() { return debug_uart.WriteSpan(); }
 
-uint16_t HalApi::DebugBytesAvailableForWrite() { return debug_uart.TxFree(); }
+void HalApi::DebugCommitWrite(size_t count) { debug_uart.CommitWrite(count); }
 
 /******************************************************************
  * Watchdog timer (see [RM] chapter 32).
@@ -833,14 +854,9 @@ __attribute__((used)) __attribute__((section(".isr_vector"))) void (*const Vecto
     BadISR,         //  24 - 0x060
     BadISR,         //  25 - 0x064
     BadISR,         //  26 - 0x068
-    BadISR,         //  27 - 0x06C
-#ifdef UART_VIA_DMA
+    DMA1Channel1ISR,  //  27 - 0x06C DMA1 CH1
     DMA1Channel2ISR,  //  28 - 0x070 DMA1 CH2
     DMA1Channel3ISR,  //  29 - 0x074 DMA1 CH3
-#else
-    BadISR,  //  28 - 0x070
-    BadISR,  //  29 - 0x074
-#endif
     BadISR,           //  30 - 0x078
     BadISR,           //  31 - 0x07C
     BadISR,           //  32 - 0x080
@@ -38,6 +38,7 @@ Reference abbreviations [RM], [DS], etc are defined in hal/README.md.
 // The values here are the offsets into the interrupt table.
 // These can be found in [RM] chapter 12 (NVIC)
 enum class InterruptVector {
+  Dma1Channel1 = 0x6C,
   Dma1Channel2 = 0x70,
   Dma1Channel3 = 0x074,
   Timer15 = 0xA0,
@@ -118,3 +119,8 @@ inline void GpioPullDn(GpioReg *gpio, int pin) {
   x |= 2 << (2 * pin);
   gpio->pullup_pulldown = x;
 }
+
+// Called by HalApi::StartLoopTimer while setting up the loop timer (whose period is period_ticks
+// ticks of tick_micros microseconds), so that it can trigger the A/D conversions if they are
+// aligned with the loop (see adc.cpp).
+void AdcSyncToLoopTimer(TimerReg *timer, uint32_t period_ticks, float tick_micros);
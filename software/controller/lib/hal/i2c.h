@@ -19,7 +19,8 @@ limitations under the License.
 
 #pragma once
 
-#include "circular_buffer.h"
+#include "hal.h"
+#include "spsc_ring.h"
 #if defined(BARE_STM32)
 #include "hal_stm32.h"
 #endif
@@ -154,7 +155,7 @@ class Channel {
   // buffer of indexes to know the queue state and let the tested template
   // worry about buffer management but we also use our own Request table
   // (to which the circular buffer elements lead)
-  CircularBuffer<uint8_t, QueueLength> buffer_;
+  SpscRing<uint8_t, QueueLength> buffer_;
   Request queue_[QueueLength];
   uint8_t ind_queue_{0};
 
@@ -230,10 +231,10 @@ class TestChannel : public Channel {
  private:
   // in test mode, fake sending and receiving data through circular
   // buffers.
-  CircularBuffer<uint8_t, WriteBufferSize> sent_buffer_;
+  SpscRing<uint8_t, WriteBufferSize> sent_buffer_;
   // note it is up to the tester to put data in the rx_buffer before
   // calling I2CEventHandler during a read request
-  CircularBuffer<uint8_t, WriteBufferSize> rx_buffer_;
+  SpscRing<uint8_t, WriteBufferSize> rx_buffer_;
   // fake a NACK condition on next handler call
   bool nack_{false};
 
@@ -0,0 +1,156 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "span.h"
+
+// This class is a lock-free circular buffer with fixed size, for a single producer and a single
+// consumer.
+//
+// Unlike CircularBuffer, it doesn't disable interrupts.  Instead, it relies on only one context
+// (the main loop, or a given interrupt handler) ever writing to it, and only one context ever
+// reading from it, which is the case for an ISR feeding data to the main loop or the other way
+// round.  The producer is the only one to update head_ and the consumer the only one to update
+// tail_.  Each side publishes its updates with release semantics and reads the other side's with
+// acquire semantics, which guarantees that elements are written before the consumer can see them,
+// and read before the producer can overwrite them.
+//
+// head_ and tail_ count from 0 to 2N - 1 before wrapping around, which tells a full buffer
+// (head_ - tail_ == N) from an empty one (head_ == tail_), so all N elements are usable.  Their
+// value modulo N is the index of the next element to write/read.  As they only ever move by less
+// than N at a time, that modulo and their wrap around take a comparison rather than a division,
+// whatever N.
+//
+// Besides element-wise Put and Get, the buffer gives direct access to its storage for bulk
+// transfers (memcpy, parsing, DMA...):
+//  - the producer fills (part of) WriteSpan(), then makes it visible with CommitWrite(count)
+//  - the consumer uses (part of) ReadSpan(), then frees it with Consume(count)
+// Spans stop at the end of the storage, so the free or full part of the buffer can take two of
+// them; Write and Read handle that for plain copies.
+template <class T, size_t N>
+class SpscRing {
+  static_assert(N > 0, "SpscRing can't be empty");
+
+  T buffer_[N] = {};
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+
+  static size_t Index(size_t counter) { return counter < N ? counter : counter - N; }
+  static size_t Advance(size_t counter, size_t count) {
+    counter += count;
+    return counter < 2 * N ? counter : counter - 2 * N;
+  }
+  static size_t Distance(size_t head, size_t tail) {
+    return head >= tail ? head - tail : head + 2 * N - tail;
+  }
+
+ public:
+  static constexpr size_t Capacity{N};
+
+  // Return number of elements available in the buffer to read.
+  size_t FullCount() const {
+    return Distance(head_.load(std::memory_order_acquire), tail_.load(std::memory_order_acquire));
+  }
+
+  // Return number of free spaces in the buffer where more elements can be written.
+  size_t FreeCount() const { return N - FullCount(); }
+
+  // Producer side
+
+  // Add an element to the buffer.
+  //
+  // Returns false if the buffer is full.
+  [[nodiscard]] bool Put(T dat) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (Distance(head, tail_.load(std::memory_order_acquire)) == N) return false;
+    buffer_[Index(head)] = std::move(dat);
+    head_.store(Advance(head, 1), std::memory_order_release);
+    return true;
+  }
+
+  // Returns the contiguous free space following the last written element.
+  Span<T> WriteSpan() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t free = N - Distance(head, tail_.load(std::memory_order_acquire));
+    return {&buffer_[Index(head)], std::min(free, N - Index(head))};
+  }
+
+  // Makes the first count elements of WriteSpan() available to the consumer.
+  void CommitWrite(size_t count) {
+    head_.store(Advance(head_.load(std::memory_order_relaxed), count), std::memory_order_release);
+  }
+
+  // Copies up to count elements to the buffer, as many as fit.
+  // Returns the number of elements written.
+  size_t Write(const T *data, size_t count) {
+    size_t written = 0;
+    // At most two spans: until the end of the storage, then from its start.
+    for (int i = 0; i < 2 && written < count; ++i) {
+      Span<T> span = WriteSpan();
+      size_t size = std::min(span.size, count - written);
+      std::copy(data + written, data + written + size, span.data);
+      CommitWrite(size);
+      written += size;
+    }
+    return written;
+  }
+
+  // Consumer side
+
+  // Get the oldest element from the buffer, popping it from the buffer.
+  std::optional<T> Get() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail) return std::nullopt;
+    T val = std::move(buffer_[Index(tail)]);
+    tail_.store(Advance(tail, 1), std::memory_order_release);
+    return val;
+  }
+
+  // Returns the contiguous elements starting from the oldest one.
+  Span<const T> ReadSpan() const {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t full = Distance(head_.load(std::memory_order_acquire), tail);
+    return {&buffer_[Index(tail)], std::min(full, N - Index(tail))};
+  }
+
+  // Pops the first count elements of ReadSpan() from the buffer.
+  void Consume(size_t count) {
+    tail_.store(Advance(tail_.load(std::memory_order_relaxed), count), std::memory_order_release);
+  }
+
+  // Moves up to count elements from the buffer to data.
+  // Returns the number of elements read.
+  size_t Read(T *data, size_t count) {
+    size_t read = 0;
+    for (int i = 0; i < 2 && read < count; ++i) {
+      Span<const T> span = ReadSpan();
+      size_t size = std::min(span.size, count - read);
+      std::copy(span.data, span.data + size, data + read);
+      Consume(size);
+      read += size;
+    }
+    return read;
+  }
+
+  // Drops all elements currently in the buffer.
+  void Flush() { tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release); }
+};
@@ -15,21 +15,31 @@ limitations under the License.
 
 #include "stepper.h"
 
-#include "hal.h"
-
-StepMotor StepMotor::motor_[StepMotor::MaxMotors];
-int StepMotor::total_motors_;
-
-#if defined(BARE_STM32)
-
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
+#include "hal.h"
+
+#if defined(BARE_STM32)
 #include "hal_stm32.h"
+#endif
 
 // Static data members
-uint8_t StepMotor::dma_buff_[StepMotor::MaxMotors];
+StepMotor StepMotor::motor_[StepMotor::MaxMotors];
+int StepMotor::total_motors_;
 StepCommState StepMotor::coms_state_ = StepCommState::Idle;
+uint8_t StepMotor::dma_buff_[StepMotor::MaxMotors];
+uint8_t StepMotor::frame_[2][StepMotor::QueueSize * StepMotor::MaxMotors];
+int StepMotor::fill_;
+int StepMotor::frame_len_;
+int StepMotor::frame_ndx_;
+uint32_t StepMotor::frames_started_;
+uint32_t StepMotor::frames_done_;
+uint32_t StepMotor::frame_overruns_;
+#ifdef TEST_MODE
+StepperSpiBus *StepMotor::test_bus_;
+#endif
 
 // This array holds the length of each parameter in units of
 // bytes, rounded up to the nearest byte.  This info is based
@@ -80,14 +90,20 @@ static constexpr float VelMinSpeedReg = TickTime * (1 << 24);
 static constexpr float VelFSSpeedReg = TickTime * (1 << 18);
 static constexpr float VelIntSpeedReg = TickTime * (1 << 26);
 
+// Same for accelerations in steps/sec/sec, used by both the
+// acceleration and deceleration registers.
+static constexpr float AccelReg = TickTime * TickTime * 1099511627776.f;
+
 // The number of microsteps / full step.
 // For now this is a constant, we're just using the
 // default value of the chip.
 static constexpr int MicrostepPerStep = 128;
 
+#if defined(BARE_STM32)
 // These functions raise and lower the chip select pin
 inline void CSHigh() { GpioSetPin(GpioBBase, 6); }
 inline void CSLow() { GpioClrPin(GpioBBase, 6); }
+#endif
 
 StepMtrErr StepMotor::SetParam(StepMtrParam param, uint32_t value) {
   uint8_t p = static_cast<uint8_t>(param);
@@ -143,6 +159,7 @@ StepMtrErr StepMotor::GetParam(StepMtrParam param, uint32_t *value) {
   return err;
 }
 
+#if defined(BARE_STM32)
 /******************************************************************
  * SPI port used to talk to stepper motor drivers.
  *
@@ -161,7 +178,7 @@ StepMtrErr StepMotor::GetParam(StepMtrParam param, uint32_t *value) {
  * on the rising edge of CS.  That's a little better for us since
  * we have 3 steppers.
  *****************************************************************/
-void HalApi::StepperMotorInit() {
+void HalApi::StepperMotorInit(bool keep_state) {
   EnableClock(Spi1Base);
   EnableClock(Dma2Base);
 
@@ -260,26 +277,28 @@ void HalApi::StepperMotorInit() {
 
   hal.EnableInterrupt(InterruptVector::Dma2Channel3, IntPriority::Standard);
 
-  StepMotor::OneTimeInit();
+  StepMotor::OneTimeInit(keep_state);
 }
 
 // Do some basic init of the stepper motor chips so we can
 // make them spin the motors
-void StepMotor::OneTimeInit() {
+void StepMotor::OneTimeInit(bool keep_state) {
   uint32_t val;
 
-  ProbeChips();
+  ProbeChips(keep_state);
 
   for (int i = 0; i < total_motors_; i++) {
     StepMotor *mtr = StepMotor::GetStepper(i);
 
-    mtr->Reset();
+    if (!keep_state) {
+      mtr->Reset();
 
-    // We need to delay briefly after reset before sending
-    // a new command.  For the power-step chip this delay
-    // time is specified as 500 microseconds in the data sheet.
-    // For the L6470 its only 45 max
-    hal.Delay(microseconds(500));
+      // We need to delay briefly after reset before sending
+      // a new command.  For the power-step chip this delay
+      // time is specified as 500 microseconds in the data sheet.
+      // For the L6470 its only 45 max
+      hal.Delay(microseconds(500));
+    }
 
     // Get the first gate config register of the powerSTEP01.
     // This is actually the config register on the L6470
@@ -291,6 +310,11 @@ void StepMotor::OneTimeInit() {
 
     mtr->power_step_ = true;
 
+    // The gate config registers can only be written while the
+    // outputs are disabled, which they may not be if the chip
+    // kept its state.  They should be set already then.
+    if (keep_state && val == 0x0FFD) continue;
+
     // Configure the two gate config registers to reasonable values
     //
     // GateConfig1 xxxxxxxxxxxxxxxx
@@ -307,6 +331,7 @@ void StepMotor::OneTimeInit() {
     mtr->SetParam(StepMtrParam::GateConfig2, 0xF7);
   }
 }
+#endif
 
 // Convert a velocity from Deg/sec units to the value to program
 // into one of the stepper controller registers
@@ -342,7 +367,9 @@ StepMtrErr StepMotor::SetMaxSpeed(float dps) {
   uint32_t speed = static_cast<uint32_t>(DpsToVelReg(dps, VelMaxSpeedReg));
   if (speed > 0x3ff) speed = 0x3ff;
 
-  return SetParam(StepMtrParam::MaxSpeed, speed);
+  StepMtrErr err = SetParam(StepMtrParam::MaxSpeed, speed);
+  if (err == StepMtrErr::Ok) max_speed_reg_ = speed;
+  return err;
 }
 
 // Get the motor's max speed setting in deg/sec
@@ -384,20 +411,26 @@ StepMtrErr StepMotor::GetMinSpeed(float *ret) {
 //
 // NOTE - The motor must be disabled to set this
 StepMtrErr StepMotor::SetAccel(float acc) {
-  static constexpr float Scaler = (TickTime * TickTime * 1099511627776.f);
   if (acc < 0) return StepMtrErr::BadValue;
 
   // Convert from deg/sec/sec to steps/sec/sec
   acc *= static_cast<float>(steps_per_rev_) / 360.0f;
 
   // Convert to the proper units for the driver chip
-  uint32_t val = static_cast<uint32_t>(acc * Scaler);
+  uint32_t val = static_cast<uint32_t>(acc * AccelReg);
   if (val > 0x0fff) val = 0xfff;
 
   StepMtrErr err = SetParam(StepMtrParam::Acceleration, val);
   if (err != StepMtrErr::Ok) return err;
 
-  return SetParam(StepMtrParam::Deceleration, val);
+  err = SetParam(StepMtrParam::Deceleration, val);
+  if (err == StepMtrErr::Ok) accel_reg_ = val;
+  return err;
+}
+
+// Convert an acceleration from a register value to deg/sec/sec
+float StepMotor::RegAccelToDps2(uint32_t val) const {
+  return static_cast<float>(val) * 360.0f / (AccelReg * static_cast<float>(steps_per_rev_));
 }
 
 // Set the amplitude of the voltage output used to drive the motor.
@@ -454,6 +487,19 @@ StepMtrErr StepMotor::SetAmpAll(float amp) {
   return SetAmpDecel(amp);
 }
 
+// Fill cmd with the 4 byte command to run at a constant speed,
+// given as a current speed register value.
+static void EncodeRun(uint8_t *cmd, bool neg, int32_t speed) {
+  if (neg)
+    cmd[0] = static_cast<uint8_t>(StepMtrCmd::RunNegative);
+  else
+    cmd[0] = static_cast<uint8_t>(StepMtrCmd::RunPositive);
+
+  cmd[1] = static_cast<uint8_t>(speed >> 16);
+  cmd[2] = static_cast<uint8_t>(speed >> 8);
+  cmd[3] = static_cast<uint8_t>(speed);
+}
+
 // Start running at a constant velocity.
 // The velocity is specified in deg/sec units
 StepMtrErr StepMotor::RunAtVelocity(float vel) {
@@ -470,15 +516,8 @@ StepMtrErr StepMotor::RunAtVelocity(float vel) {
   if (s > 0x000fffff) s = 0x000fffff;
 
   uint8_t cmd[4];
-  if (neg)
-    cmd[0] = static_cast<uint8_t>(StepMtrCmd::RunNegative);
-  else
-    cmd[0] = static_cast<uint8_t>(StepMtrCmd::RunPositive);
-
-  cmd[1] = static_cast<uint8_t>(s >> 16);
-  cmd[2] = static_cast<uint8_t>(s >> 8);
-  cmd[3] = static_cast<uint8_t>(s);
-  return SendCmd(cmd, 4);
+  EncodeRun(cmd, neg, s);
+  return SendMotionCmd(cmd, 4);
 }
 
 // Decelerate to zero velocity and hold position
@@ -486,7 +525,7 @@ StepMtrErr StepMotor::RunAtVelocity(float vel) {
 // causing any motion
 StepMtrErr StepMotor::SoftStop() {
   uint8_t cmd = static_cast<uint8_t>(StepMtrCmd::SoftStop);
-  return SendCmd(&cmd, 1);
+  return SendMotionCmd(&cmd, 1);
 }
 
 // Stop abruptly and hold position
@@ -494,31 +533,51 @@ StepMtrErr StepMotor::SoftStop() {
 // causing any motion
 StepMtrErr StepMotor::HardStop() {
   uint8_t cmd = static_cast<uint8_t>(StepMtrCmd::HardStop);
-  return SendCmd(&cmd, 1);
+  return SendMotionCmd(&cmd, 1);
 }
 
 // Decelerate to zero velocity and disable
 StepMtrErr StepMotor::SoftDisable() {
   uint8_t cmd = static_cast<uint8_t>(StepMtrCmd::SoftDisable);
-  return SendCmd(&cmd, 1);
+  return SendMotionCmd(&cmd, 1);
 }
 
 // Immediately disable the motor
 StepMtrErr StepMotor::HardDisable() {
   uint8_t cmd = static_cast<uint8_t>(StepMtrCmd::HardDisable);
-  return SendCmd(&cmd, 1);
+  return SendMotionCmd(&cmd, 1);
 }
 
 // Reset the motor position to zero
 StepMtrErr StepMotor::ClearPosition() {
   uint8_t cmd = static_cast<uint8_t>(StepMtrCmd::ResetPosition);
-  return SendCmd(&cmd, 1);
+  return SendMotionCmd(&cmd, 1);
+}
+
+StepMtrErr StepMotor::GetPosition(float *deg) {
+  uint32_t val;
+  StepMtrErr err = GetParam(StepMtrParam::AbsolutePosition, &val);
+  *deg = AbsPosToDeg(val);
+  return err;
+}
+
+float StepMotor::AbsPosToDeg(uint32_t val) const {
+  // The position is a 22 bit two's complement value
+  int32_t ustep = static_cast<int32_t>(val << 10) >> 10;
+
+  uint32_t ustep_per_rev = MicrostepPerStep * steps_per_rev_;
+  return static_cast<float>(ustep) * 360.0f / static_cast<float>(ustep_per_rev);
 }
 
 // Reset the stepper chip
 StepMtrErr StepMotor::Reset() {
   uint8_t cmd = static_cast<uint8_t>(StepMtrCmd::ResetDevice);
-  return SendCmd(&cmd, 1);
+  StepMtrErr err = SendMotionCmd(&cmd, 1);
+
+  // Back to the chip's reset values
+  max_speed_reg_ = 0x041;
+  accel_reg_ = 0x08A;
+  return err;
 }
 
 StepMtrErr StepMotor::GetStatus(StepperStatus *stat) {
@@ -575,7 +634,7 @@ StepMtrErr StepMotor::GotoPos(float deg) {
   cmd[1] = static_cast<uint8_t>(ustep >> 16);
   cmd[2] = static_cast<uint8_t>(ustep >> 8);
   cmd[3] = static_cast<uint8_t>(ustep);
-  return SendCmd(cmd, 4);
+  return SendMotionCmd(cmd, 4);
 }
 
 // Start a relative move of the passed number of deg.
@@ -595,7 +654,141 @@ StepMtrErr StepMotor::MoveRel(float deg) {
   cmd[1] = static_cast<uint8_t>(dist >> 16);
   cmd[2] = static_cast<uint8_t>(dist >> 8);
   cmd[3] = static_cast<uint8_t>(dist);
-  return SendCmd(cmd, 4);
+  return SendMotionCmd(cmd, 4);
+}
+
+// Send a command that moves the motor, or changes its position.
+// This takes over from StreamPos, which starts over on its next call.
+StepMtrErr StepMotor::SendMotionCmd(uint8_t *cmd, uint32_t len) {
+  {
+    BlockInterrupts block;
+    stream_.active = false;
+    stream_.read_ndx = -1;
+  }
+  return SendCmd(cmd, len);
+}
+
+// Returns the distance (deg) covered in dt seconds by a motor
+// going at *speed (deg/sec) once told to run at the target speed,
+// and updates *speed to the speed it ends up with.  Like on the
+// driver chip, the speed changes linearly at the passed
+// acceleration (deg/sec/sec) until it reaches the target.
+static float Ramp(float *speed, float target, float accel, float dt) {
+  float change = target - *speed;
+  float t = std::min(dt, fabsf(change) / accel);
+  float end = (t < dt) ? target : *speed + copysignf(accel * t, change);
+  float dist = (*speed + end) / 2.0f * t + target * (dt - t);
+  *speed = end;
+  return dist;
+}
+
+// Follow a position which changes every control loop cycle.
+//
+// The motor position read during the previous cycle tells where
+// the motor was when the previous commands were sent.  From there,
+// the speed and acceleration settings of the chip tell where it is
+// now, and how fast it's going.  The new speed is then the fastest
+// one that still lets the motor stop at the position after running
+// at that speed until the next cycle.
+StepMtrErr StepMotor::StreamPos(float deg) {
+  // Distance (deg) from the position under which the motor is
+  // stopped, or left alone.  Speed changes which would move the
+  // motor by less than this by the next cycle aren't sent either.
+  static constexpr float Deadband = 0.05f;
+
+  // Outside the control loop (e.g. before its timer starts), nothing
+  // sends the queued commands, so the position can't be read back
+  // every cycle.  Move there the blocking way instead, hard-stopping
+  // any previous move first since the chip won't change its
+  // destination until a move ends.
+  if (!hal.InInterruptHandler()) {
+    if (deg != stream_.target || stream_.active) {
+      StepMtrErr err = HardStop();
+      if (err != StepMtrErr::Ok) return err;
+    }
+    stream_.target = deg;
+    return GotoPos(deg);
+  }
+  stream_.target = deg;
+
+  float dt = ControlLoopPeriod.seconds();
+  float accel = RegAccelToDps2(accel_reg_);
+  float max_speed = RegVelToDps(max_speed_reg_, VelMaxSpeedReg);
+
+  // The response to the position read queued by the previous
+  // call is in the frame sent, once it's done.
+  uint8_t response[4];
+  bool measured = stream_.read_ndx >= 0 &&
+                  QueuedResponse(stream_.read_frame, stream_.read_ndx, response, sizeof(response));
+  float measured_pos = 0;
+  if (measured) measured_pos = AbsPosToDeg(response[1] << 16 | response[2] << 8 | response[3]);
+  stream_.read_ndx = -1;
+
+  bool was_moving = stream_.speed != 0 || stream_.command != 0;
+  if (stream_.active) {
+    if (measured) stream_.position = measured_pos;
+    stream_.position += Ramp(&stream_.speed, stream_.command, accel, dt);
+  } else if (measured) {
+    // Start from the position read, assuming that the motor is stopped
+    stream_.active = true;
+    stream_.position = measured_pos;
+    stream_.speed = 0;
+    stream_.command = 0;
+  }
+
+  float command = 0;
+  int32_t speed_reg = 0;
+  float error = deg - stream_.position;
+  if (stream_.active && fabsf(error) >= Deadband) {
+    // Distance covered by the motor if told to run at speed v until
+    // the next cycle, then to stop.  This grows with v, so the speed
+    // that covers the distance to the position can be found by
+    // bisection.
+    auto stopping_distance = [&](float v) {
+      float speed = stream_.speed;
+      return Ramp(&speed, v, accel, dt) + v * fabsf(v) / (2.0f * accel);
+    };
+    float low = -max_speed;
+    float high = max_speed;
+    for (int i = 0; i < 16; i++) {
+      float mid = (low + high) / 2.0f;
+      if (stopping_distance(mid) < error)
+        low = mid;
+      else
+        high = mid;
+    }
+
+    // Round the speed toward zero to a value the chip can run at,
+    // so that it doesn't overshoot.
+    float v = error > 0 ? low : high;
+    speed_reg = std::min(static_cast<int32_t>(DpsToVelReg(fabsf(v), VelCurrentSpeedReg)),
+                         int32_t{0x000fffff});
+    command = copysignf(RegVelToDps(speed_reg, VelCurrentSpeedReg), v);
+  }
+
+  // Only tell the chip about speed changes that matter
+  bool change = command == 0 ? stream_.command != 0
+                             : fabsf(command - stream_.command) * dt >= Deadband;
+  if (stream_.active && change) {
+    uint8_t cmd[4];
+    EncodeRun(cmd, command < 0, speed_reg);
+    StepMtrErr err = EnqueueCmd(cmd, 4);
+    if (err != StepMtrErr::Ok) return err;
+    stream_.command = command;
+  }
+
+  // Keep reading the position until the motor has stopped.
+  if (stream_.active && !was_moving && command == 0) return StepMtrErr::Ok;
+
+  uint8_t read[4] = {static_cast<uint8_t>(StepMtrParam::AbsolutePosition), 0, 0, 0};
+  read[0] |= 0x20;
+  int ndx = queue_count_;
+  StepMtrErr err = EnqueueCmd(read, 4);
+  if (err == StepMtrErr::Ok) {
+    stream_.read_ndx = ndx;
+    stream_.read_frame = frames_started_;
+  }
+  return err;
 }
 
 // Send a command to the motor and wait for the response.
@@ -618,6 +811,14 @@ StepMtrErr StepMotor::SendCmd(uint8_t *cmd, uint32_t len) {
   // add this command to our queue and return
   if (hal.InInterruptHandler()) return EnqueueCmd(cmd, len);
 
+#ifdef TEST_MODE
+  // Motors not connected to a simulated bus respond with zeros
+  if (!test_bus_ || index_ < 0) {
+    memset(cmd, 0, len);
+    return StepMtrErr::Ok;
+  }
+#endif
+
   // Copy the command to my buffer with interrupts disabled.
   // I want to make sure the whole command gets sent as one continuous
   // stream and it's possible that commands are currently being sent
@@ -637,6 +838,9 @@ StepMtrErr StepMotor::SendCmd(uint8_t *cmd, uint32_t len) {
   // Wait for the ISR to finish sending the command.
   // When it does, it will set the pointer to NULL
   while (cmd_ptr_) {
+#ifdef TEST_MODE
+    test_bus_->Wait();
+#endif
   }
 
   // The ISR replaces the command with the response, I need to copy the
@@ -650,21 +854,60 @@ StepMtrErr StepMotor::SendCmd(uint8_t *cmd, uint32_t len) {
 
 // Enqueue the command and return immediately.  This is called
 // from the controller loop to send commands to the drivers.
+//
+// The control loop fills one frame while the other is sent,
+// so this doesn't race with the ISR that sends them.
 StepMtrErr StepMotor::EnqueueCmd(uint8_t *cmd, uint32_t len) {
-  // Block interrupts during this call to prevent race conditions
-  // with the ISR that handles the communication.
+  if (index_ < 0) return StepMtrErr::InvalidState;
+  if (queue_count_ + len > QueueSize) return StepMtrErr::QueueFull;
+
+  // The Nth byte queued by each motor goes in the Nth transfer
+  uint8_t *frame = frame_[fill_];
+  for (uint32_t i = 0; i < len; i++) frame[(queue_count_ + i) * total_motors_ + index_] = cmd[i];
+  queue_count_ += len;
+
+  return StepMtrErr::Ok;
+}
+
+bool StepMotor::QueuedResponse(uint32_t frame, int ndx, uint8_t *response, int len) const {
+  BlockInterrupts block;
+
+  // The frame must be the last one started, and be done.
+  if (frame + 1 != frames_started_ || frames_done_ != frames_started_) return false;
+
+  const uint8_t *sent = frame_[1 - fill_];
+  for (int i = 0; i < len; i++) response[i] = sent[(ndx + i) * total_motors_ + index_];
+  return true;
+}
+
+// This is called from the HAL at the end of the high
+// priority loop timer ISR.  It starts sending the frame
+// filled during the loop, unless the previous one is still
+// being sent.
+void StepMotor::StartQueuedCommands() {
   BlockInterrupts block;
 
-  // It's illegal to call this if we're currently pulling data
-  // from the queues.
-  if (coms_state_ == StepCommState::SendQueued) return StepMtrErr::InvalidState;
+  int len = 0;
+  for (int i = 0; i < total_motors_; i++) len = std::max(len, motor_[i].queue_count_);
+  if (!len) return;
 
-  if (queue_count_ + len > sizeof(queue_)) return StepMtrErr::QueueFull;
+  // The commands queued stay in the frame, to be sent with
+  // those of the next cycle.
+  if (frames_done_ != frames_started_) {
+    frame_overruns_++;
+    return;
+  }
 
-  memcpy(&queue_[queue_count_], cmd, len);
-  queue_count_ += len;
+  // Swap the frames.  The one sent last is filled next, which
+  // starts with Nop for all motors.
+  fill_ = 1 - fill_;
+  memset(frame_[fill_], static_cast<uint8_t>(StepMtrCmd::Nop), frame_len_ * total_motors_);
+  for (int i = 0; i < total_motors_; i++) motor_[i].queue_count_ = 0;
+  frame_len_ = len;
+  frame_ndx_ = 0;
+  frames_started_++;
 
-  return StepMtrErr::Ok;
+  if (coms_state_ == StepCommState::Idle) UpdateComState();
 }
 
 // Update the communications state machine.
@@ -695,35 +938,20 @@ void StepMotor::UpdateComState() {
       // fall through
 
     //////////////////////////////////////////////
-    // We're sending data from the local queues.
-    // See if the queues still have more data to send.
-    // Note that I just ignore any response from
-    // the motor drivers when sending data from the queues
+    // We're sending the frame queued up by the
+    // control loop, one transfer at a time.  The
+    // responses from the motor drivers replace the
+    // bytes sent in the frame.
     //////////////////////////////////////////////
     case StepCommState::SendQueued:
-
-      // For each motor, grab the next byte from the queue
-      // and add it to my DMA buffer.  For any empty queue
-      // I just add a Nop command
-      for (int i = 0; i < total_motors_; i++) {
-        // This really should already be false
-        motor_[i].save_response_ = false;
-
-        if (motor_[i].queue_ndx_ < motor_[i].queue_count_) {
-          data_to_send = true;
-          dma_buff_[i] = motor_[i].queue_[motor_[i].queue_ndx_++];
-        }
-
-        else {
-          motor_[i].queue_ndx_ = 0;
-          motor_[i].queue_count_ = 0;
-          dma_buff_[i] = static_cast<uint8_t>(StepMtrCmd::Nop);
-        }
+      if (frame_ndx_ < frame_len_) {
+        StartTransfer(&frame_[1 - fill_][frame_ndx_++ * total_motors_], total_motors_);
+        return;
       }
+      frames_done_ = frames_started_;
 
-      // If any data was found in the queues, then I'm done.
-      // Otherwise, move on to the next state.
-      if (data_to_send) break;
+      // This really should already be false
+      for (int i = 0; i < total_motors_; i++) motor_[i].save_response_ = false;
 
       coms_state_ = StepCommState::SendSync;
       // fall through
@@ -757,18 +985,26 @@ void StepMotor::UpdateComState() {
       }
 
       // If I didn't find anything to send, then set our
-      // state to idle and return, I'm done.
+      // state to idle and return, I'm done.  A frame queued
+      // up in the meantime gets sent now though.
       if (!data_to_send) {
         coms_state_ = StepCommState::Idle;
+        if (frame_ndx_ < frame_len_) UpdateComState();
         return;
       }
   }
 
   //////////////////////////////////////////////
   // I've got a message to send out to the chain
-  // of motor driver chips.  Set up my DMA to
-  // send it out.
+  // of motor driver chips.
   //////////////////////////////////////////////
+  StartTransfer(dma_buff_, total_motors_);
+}
+
+#if defined(BARE_STM32)
+// Send len bytes out to the chain of motor driver chips,
+// using DMA.  The DMA interrupt fires once it's done.
+void StepMotor::StartTransfer(uint8_t *buff, int len) {
   int c3 = static_cast<int>(DmaChannel::Chan3);
   int c4 = static_cast<int>(DmaChannel::Chan4);
 
@@ -776,10 +1012,10 @@ void StepMotor::UpdateComState() {
   dma->channel[c3].config.enable = 0;
   dma->channel[c4].config.enable = 0;
 
-  dma->channel[c3].count = total_motors_;
-  dma->channel[c4].count = total_motors_;
-  dma->channel[c3].memory_address = dma_buff_;
-  dma->channel[c4].memory_address = dma_buff_;
+  dma->channel[c3].count = len;
+  dma->channel[c4].count = len;
+  dma->channel[c3].memory_address = buff;
+  dma->channel[c4].memory_address = buff;
 
   // NOTE - CS has to be high for at least 650ns between bytes.
   // I don't bother timing this because I've found that in
@@ -799,13 +1035,31 @@ void StepMotor::DmaISR() {
   UpdateComState();
 }
 
-// This is called from the HAL at the end of the high
-// priority loop timer ISR.  If the comm state machine
-// is idle it starts a new transmission
-void StepMotor::StartQueuedCommands() {
-  if (coms_state_ == StepCommState::Idle) UpdateComState();
+#else
+void StepMotor::StartTransfer(uint8_t *buff, int len) { test_bus_->StartTransfer(buff, len); }
+
+void StepMotor::DmaISR() { UpdateComState(); }
+
+void StepMotor::TESTConnect(StepperSpiBus *bus, int count) {
+  test_bus_ = bus;
+  total_motors_ = std::min(count, MaxMotors);
+  for (int i = 0; i < MaxMotors; i++) {
+    motor_[i] = StepMotor();
+    if (i < total_motors_) motor_[i].index_ = i;
+  }
+
+  coms_state_ = StepCommState::Idle;
+  memset(frame_, 0, sizeof(frame_));
+  fill_ = 0;
+  frame_len_ = 0;
+  frame_ndx_ = 0;
+  frames_started_ = 0;
+  frames_done_ = 0;
+  frame_overruns_ = 0;
 }
+#endif
 
+#if defined(BARE_STM32)
 // This is used to send a command to the stepper chips during
 // startup.
 void StepMotor::SendInitCmd(uint8_t *buff, int len) {
@@ -851,7 +1105,9 @@ void StepMotor::SendInitCmd(uint8_t *buff, int len) {
 // present in the system.  Once the hardware stabilizes enough
 // for everyone to have the same number of chips we can remove
 // this, but it's convenient for right now.
-void StepMotor::ProbeChips() {
+//
+// Chips are reset in the process, unless keep_state is set.
+void StepMotor::ProbeChips(bool keep_state) {
   // I use a buffer a bit larger than the max number of motors
   // to try to continue to work even if there are a few more
   // driver chips than I support on the bus.
@@ -865,12 +1121,15 @@ void StepMotor::ProbeChips() {
     SendInitCmd(probe_buff, sizeof(probe_buff));
   }
 
-  // Now send a reset to all the chips on the bus.
-  memset(probe_buff, static_cast<uint8_t>(StepMtrCmd::ResetDevice), sizeof(probe_buff));
+  // Now send a reset to all the chips on the bus.  To keep their state,
+  // send a read of the position instead, which has no side effects.
+  uint8_t probe_cmd = static_cast<uint8_t>(StepMtrCmd::ResetDevice);
+  if (keep_state) probe_cmd = static_cast<uint8_t>(StepMtrParam::AbsolutePosition) | 0x20;
+  memset(probe_buff, probe_cmd, sizeof(probe_buff));
   SendInitCmd(probe_buff, sizeof(probe_buff));
 
   // The first N bytes of the returned array should be 0 and the rest should
-  // be the reset command.
+  // be the probe command.
   total_motors_ = 0;
   for (unsigned char i : probe_buff) {
     if (i == 0x00)
@@ -882,22 +1141,14 @@ void StepMotor::ProbeChips() {
   // If all the bytes in the buffer were zero, then most likely there is
   // nothing connected at all.
   if (total_motors_ == sizeof(probe_buff)) total_motors_ = 0;
+  for (int i = 0; i < total_motors_; i++) motor_[i].index_ = i;
+
+  // The position read expects 3 more bytes, which make up the response.
+  if (keep_state) {
+    for (int i = 0; i < 3; i++) {
+      memset(probe_buff, static_cast<uint8_t>(StepMtrCmd::Nop), sizeof(probe_buff));
+      SendInitCmd(probe_buff, sizeof(probe_buff));
+    }
+  }
 }
-
-#else
-StepMtrErr StepMotor::HardDisable() { return StepMtrErr::Ok; }
-
-StepMtrErr StepMotor::SetAmpAll(float amp) { return StepMtrErr::Ok; }
-
-StepMtrErr StepMotor::SetMaxSpeed(float dps) { return StepMtrErr::Ok; }
-
-StepMtrErr StepMotor::SetAccel(float acc) { return StepMtrErr::Ok; }
-
-StepMtrErr StepMotor::MoveRel(float deg) { return StepMtrErr::Ok; }
-
-StepMtrErr StepMotor::ClearPosition() { return StepMtrErr::Ok; }
-
-StepMtrErr StepMotor::GotoPos(float deg) { return StepMtrErr::Ok; }
-
-StepMtrErr StepMotor::HardStop() { return StepMtrErr::Ok; }
 #endif
@@ -41,6 +41,8 @@ limitations under the License.
 // The HAL kicks off any queued up commands automatically at the end of the
 // high priority loop.  If an illegal command (i.e. one that returns a value)
 // is called from the high priority control loop it will result in an error.
+// The one exception is StreamPos, which reads the motor position back from
+// the commands sent in the previous cycle.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -157,6 +159,24 @@ struct StepperStatus {
   StepMoveStatus move_status{StepMoveStatus::Stopped};
 };
 
+#ifdef TEST_MODE
+// The SPI bus to the chain of stepper driver chips, simulated in
+// native tests (see StepMotor::TESTConnect).
+class StepperSpiBus {
+ public:
+  virtual ~StepperSpiBus() = default;
+
+  // Starts sending len bytes with the chip select low, one byte for
+  // each chip in the chain, the first one for motor 0.  The bytes the
+  // chips send back replace them.  Once done, the bus raises the chip
+  // select and calls StepMotor::DmaISR, like the DMA interrupt does.
+  virtual void StartTransfer(uint8_t *buff, int len) = 0;
+
+  // Runs the bus until the transfer in progress is done.
+  virtual void Wait() = 0;
+};
+#endif
+
 // Represents one of the stepper motors in the system
 class StepMotor {
   // This constant gives the maximum number of motors we
@@ -170,8 +190,12 @@ class StepMotor {
  public:
   StepMotor() = default;
 
-  // Called from HAL at startup
-  static void OneTimeInit();
+  // Called from HAL at startup (see HalApi::StepperMotorInit).
+  //
+  // If keep_state is set, which may be done after a warm reset of the
+  // controller (see HalApi::WarmReset), the driver chips aren't reset, so
+  // that motors keep their position and settings.
+  static void OneTimeInit(bool keep_state);
 
   // Return a pointer to the Nth stepper motor in the system.
   //
@@ -256,6 +280,25 @@ class StepMotor {
   // The velocity is specified in deg/sec units
   StepMtrErr RunAtVelocity(float vel);
 
+  // Follow a position (in deg) that changes over time.  This is
+  // meant to be called by the high priority control loop on every
+  // cycle, with the latest position.
+  //
+  // Rather than starting a new move to each position, this keeps
+  // the motor running, adjusting its velocity based on the motor
+  // position read back on the previous cycle.  Velocity commands
+  // are only sent when the velocity changes, and nothing is sent
+  // at all once the motor has stopped at a position that stays put.
+  //
+  // Streaming starts by reading the motor position, which is
+  // assumed to be stopped, so motion begins on the second call.
+  // Any other motion command, or clearing the position, ends it.
+  //
+  // Called outside the control loop, this blocks, and moves to the
+  // position with GotoPos instead (hard-stopping the motor first if
+  // the position changed), which also ends streaming.
+  StepMtrErr StreamPos(float deg);
+
   // Decelerate to zero velocity and hold position
   // This can also be used to enable the motor without
   // causing any motion
@@ -275,6 +318,11 @@ class StepMotor {
   // Reset the motor position to zero
   StepMtrErr ClearPosition();
 
+  // Read the current absolute motor position in deg.
+  // Like all reads, this can only be done in the
+  // background loop
+  StepMtrErr GetPosition(float *deg);
+
   // Reset the stepper chip
   StepMtrErr Reset();
 
@@ -296,12 +344,30 @@ class StepMotor {
   static uint8_t param_len_[32];
   static StepCommState coms_state_;
 
-  // This queue is used for sending commands from the high
-  // priority loop.  The command is copied to this queue and
-  // sent later.
-  uint8_t queue_[40];
+  // Commands from the high priority loop are queued up in frames,
+  // sent to all chips at once after each loop cycle.  A frame is a
+  // series of transfers of one byte per chip, made up of the first
+  // byte queued for each motor, then the second one, etc, and Nop
+  // for motors with fewer bytes queued.  Each motor can queue up to
+  // QueueSize bytes per frame.
+  //
+  // There are two frames: the control loop fills one while the
+  // other is sent.  The frame sent holds the responses until the
+  // next frame is sent, see QueuedResponse.
+  static constexpr int QueueSize{40};
+  static uint8_t frame_[2][QueueSize * MaxMotors];
+  static int fill_;               // Frame filled by the control loop
+  static int frame_len_;          // Number of transfers in the frame sent
+  static int frame_ndx_;          // Next transfer of the frame sent
+  static uint32_t frames_started_;
+  static uint32_t frames_done_;
+  static uint32_t frame_overruns_;
+
+  // Bytes queued up by this motor in the frame being filled
   int queue_count_{0};
-  int queue_ndx_{0};
+
+  // Position of the motor in the chain, -1 if not present
+  int index_{-1};
 
   // This pointer and count are used to hold the command being
   // sent to the motor and its response.
@@ -316,24 +382,57 @@ class StepMotor {
   // Defaults to the standard value for most steppers
   int steps_per_rev_{200};
 
+  // Max speed and acceleration registers as last set, starting
+  // from the chip's reset values.  StreamPos models the motion
+  // of the motor from these.
+  uint32_t max_speed_reg_{0x041};
+  uint32_t accel_reg_{0x08A};
+
+  // State of StreamPos
+  struct Stream {
+    bool active{false};
+    float target{0};         // Last position passed (deg)
+    float position{0};       // Modelled position when the last commands were sent (deg)
+    float speed{0};          // Modelled speed at that time (deg/sec)
+    float command{0};        // Last speed sent (deg/sec)
+    int read_ndx{-1};        // Offset of the position read in the frame, or -1
+    uint32_t read_frame{0};  // Number of the frame it was queued in
+  };
+  Stream stream_;
+
   float DpsToVelReg(float vel, float cnv) const;
   float RegVelToDps(int32_t val, float cnv) const;
+  float RegAccelToDps2(uint32_t val) const;
+  float AbsPosToDeg(uint32_t val) const;
   int32_t DegToUstep(float deg) const;
   StepMtrErr SetKval(StepMtrParam param, float amp);
 
   // Send a command and wait for the response
   StepMtrErr SendCmd(uint8_t *cmd, uint32_t len);
 
+  // Send a command which moves the motor, ending StreamPos
+  StepMtrErr SendMotionCmd(uint8_t *cmd, uint32_t len);
+
   // Queue up the command and return immediately
   StepMtrErr EnqueueCmd(uint8_t *cmd, uint32_t len);
 
+  // Copies the responses to len bytes queued at offset ndx in the
+  // passed frame, if that frame is the last one sent, and returns
+  // whether it was.
+  bool QueuedResponse(uint32_t frame, int ndx, uint8_t *response, int len) const;
+
   static void UpdateComState();
+  static void StartTransfer(uint8_t *buff, int len);
   static void SendInitCmd(uint8_t *buff, int len);
-  static void ProbeChips();
+  static void ProbeChips(bool keep_state);
 
   // True if this is a powerSTEP chip.
   bool power_step_{false};
 
+#ifdef TEST_MODE
+  static StepperSpiBus *test_bus_;
+#endif
+
  public:
   // Interrupt service routine.
   // This has to be public, but don't call it.
@@ -341,5 +440,19 @@ class StepMotor {
 
   // This function should only be called by the HAL
   // at the end of the high priority loop timer ISR
+  //
+  // It starts sending the frame queued during the cycle.  If the
+  // previous frame is still being sent, which counts as an overrun,
+  // the queued commands are kept for the next cycle instead.
   static void StartQueuedCommands();
+
+  // Number of control loop cycles which ended before the frame
+  // queued in the previous cycle was sent
+  static uint32_t GetFrameOverruns() { return frame_overruns_; }
+
+#ifdef TEST_MODE
+  // Connects count motors to a simulated bus, and sets the number of
+  // motors.  All motors and frames start over from their default state.
+  static void TESTConnect(StepperSpiBus *bus, int count);
+#endif
 };
@@ -14,10 +14,12 @@ limitations under the License.
 
 */
 
-#if defined(BARE_STM32) && defined(UART_VIA_DMA)
-
 #include "uart_dma.h"
 
+#include "framing.h"
+
+#if defined(BARE_STM32)
+
 #include "hal_stm32.h"
 #include "hal_stm32_regs.h"
 
@@ -31,7 +33,10 @@ limitations under the License.
 
 // This driver also provides Character Match callback on match_char reception.
 
-extern UartDma uart_dma;
+// UART3 transmission happens on DMA1 channel 2, reception on DMA1 channel 3
+// (channels are numbered from 0 here).  The UART watches for frame marks to
+// detect the end of received frames.
+UartDma uart_dma(Uart3Base, Dma1Base, /*tx_channel=*/1, /*rx_channel=*/2, FramingMark);
 
 // Performs UART3 initialization
 void UartDma::init(uint32_t baud) {
@@ -183,7 +188,7 @@ bool UartDma::start_rx(uint8_t *buf, uint32_t length, RxListener *rxl) {
   return true;
 }
 
-uint32_t UartDma::rx_bytes_left() { return dma_->channel[2].count; }
+uint32_t UartDma::rx_bytes_left() { return dma_->channel[rx_channel_].count; }
 
 void UartDma::stop_rx() {
   if (rx_in_progress()) {
@@ -290,4 +295,87 @@ void DMA1Channel3ISR() {
 // This is the interrupt handler for the UART.
 void Uart3ISR() { uart_dma.UART_interrupt_handler(); }
 
-#endif
+#else  // !BARE_STM32
+
+UartDma uart_dma(FramingMark);
+
+void UartDma::init(uint32_t baud) { baud_ = baud; }
+
+void UartDma::enable_character_match() { character_match_enabled_ = true; }
+
+bool UartDma::tx_in_progress() const { return tx_in_progress_; }
+
+bool UartDma::rx_in_progress() const { return rx_in_progress_; }
+
+bool UartDma::start_tx(uint8_t *buf, uint32_t length, TxListener *txl) {
+  if (tx_in_progress()) {
+    return false;
+  }
+  tx_listener_ = txl;
+  sent_data_.insert(sent_data_.end(), buf, buf + length);
+  tx_in_progress_ = true;
+  return true;
+}
+
+void UartDma::stop_tx() { tx_in_progress_ = false; }
+
+bool UartDma::start_rx(uint8_t *buf, uint32_t length, RxListener *rxl) {
+  if (rx_in_progress()) {
+    return false;
+  }
+  rx_listener_ = rxl;
+  rx_buffer_ = buf;
+  rx_length_ = length;
+  rx_count_ = 0;
+  rx_in_progress_ = true;
+  return true;
+}
+
+uint32_t UartDma::rx_bytes_left() { return rx_length_ - rx_count_; }
+
+void UartDma::stop_rx() { rx_in_progress_ = false; }
+
+void UartDma::DMA_tx_interrupt_handler() {
+  stop_tx();
+  if (tx_listener_) {
+    tx_listener_->on_tx_complete();
+  }
+}
+
+void UartDma::DMA_rx_interrupt_handler() {
+  stop_rx();
+  if (rx_listener_) {
+    rx_listener_->on_rx_complete();
+  }
+}
+
+std::vector<uint8_t> UartDma::TESTGetSentData() {
+  std::vector<uint8_t> data;
+  data.swap(sent_data_);
+  return data;
+}
+
+void UartDma::TESTCompleteTx() {
+  if (tx_in_progress()) {
+    DMA_tx_interrupt_handler();
+  }
+}
+
+void UartDma::TESTReceive(const uint8_t *data, uint32_t length) {
+  for (uint32_t i = 0; i < length; ++i) {
+    if (!rx_in_progress()) {
+      ++dropped_bytes_;
+      continue;
+    }
+    rx_buffer_[rx_count_++] = data[i];
+    if (character_match_enabled_ && data[i] == match_char_ && rx_listener_) {
+      rx_listener_->on_character_match();
+    }
+    // The listener may have restarted reception on character match.
+    if (rx_in_progress() && rx_count_ == rx_length_) {
+      DMA_rx_interrupt_handler();
+    }
+  }
+}
+
+#endif  // BARE_STM32
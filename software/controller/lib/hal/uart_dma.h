@@ -19,6 +19,10 @@ limitations under the License.
 #include "hal_stm32_regs.h"
 #include "serial_listeners.h"
 
+#ifdef TEST_MODE
+#include <vector>
+#endif
+
 class DmaCtrl {
  public:
   explicit DmaCtrl(DmaReg *const dma) : dma_(dma) {}
@@ -36,10 +40,11 @@ class DmaCtrl {
 class UartDma {
  public:
 #ifdef TEST_MODE
-  UartDma() = default;
+  explicit UartDma(uint8_t match_char)
+      : tx_channel_(0), rx_channel_(0), match_char_(match_char) {}
 #endif
   UartDma(UartReg *const uart, DmaReg *const dma, uint8_t tx_channel, uint8_t rx_channel,
-          char match_char)
+          uint8_t match_char)
       : uart_(uart),
         dma_(dma),
         tx_channel_(tx_channel),
@@ -65,6 +70,23 @@ class UartDma {
   void DMA_rx_interrupt_handler();
   void DMA_tx_interrupt_handler();
 
+#ifdef TEST_MODE
+  // In test mode, there is no UART, so instead:
+  //  - bytes handed to start_tx() are accumulated until the test gets them
+  //    with TESTGetSentData(), and the transfer only completes (calling
+  //    on_tx_complete) when the test calls TESTCompleteTx(),
+  //  - the test feeds received bytes with TESTReceive(), which writes them in
+  //    the reception buffer and calls the RxListener callbacks the same way the
+  //    DMA and UART interrupts would.
+  // Connecting the output of a UartDma to the input of another gives a
+  // loopback serial link.
+  std::vector<uint8_t> TESTGetSentData();
+  void TESTCompleteTx();
+  void TESTReceive(const uint8_t *data, uint32_t length);
+  // Number of bytes which were received while no reception was in progress.
+  uint32_t TESTDroppedBytes() const { return dropped_bytes_; }
+#endif
+
  private:
   UartReg *const uart_{nullptr};
   DmaReg *const dma_{nullptr};
@@ -76,4 +98,16 @@ class UartDma {
   uint8_t match_char_;
   bool tx_in_progress_{false};
   bool rx_in_progress_{false};
+
+#ifdef TEST_MODE
+  std::vector<uint8_t> sent_data_;
+  uint8_t *rx_buffer_{nullptr};
+  uint32_t rx_length_{0};
+  uint32_t rx_count_{0};
+  uint32_t dropped_bytes_{0};
+  bool character_match_enabled_{false};
+#endif
 };
+
+// UART used to communicate with the GUI
+extern UartDma uart_dma;
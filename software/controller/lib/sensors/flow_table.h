@@ -0,0 +1,36 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Calibrated conversion from differential pressure to flow of one venturi, as measured on a given
+// unit against a reference flow meter (see utils/debug/scripts/venturi_calibration.py).
+//
+// This is stored as is in the non-volatile parameters, hence the plain layout.  The table is made
+// of the leading points with finite and strictly increasing pressures: an all-zero table (the
+// default) has no valid points, and unused points can be left as NaN.  Flow between points is
+// interpolated linearly, and extrapolated from the first/last segment outside of them.
+struct FlowTable {
+  static constexpr size_t MaxPoints{16};
+
+  float dp_kPa[MaxPoints] = {};
+  float flow_ml_per_sec[MaxPoints] = {};
+
+  // Returns the number of valid points, which is 0 if there are less than 2 of them.
+  size_t points() const;
+};
@@ -15,17 +15,32 @@ limitations under the License.
 
 #include "sensor_base.h"
 
+#include <algorithm>
 #include <cmath>
 
+// Readings are filtered as fixed-point values: the differential voltage range (+/- 3.3V, the
+// A/D reference) scaled to the int16_t range, a resolution of 0.1mV.
+static constexpr float FilterCountsPerVolt{32767.0f / 3.3f};
+
+static int16_t ToFilterCounts(float volts) {
+  return static_cast<int16_t>(
+      std::clamp(std::round(volts * FilterCountsPerVolt), float{INT16_MIN}, float{INT16_MAX}));
+}
+
 AnalogSensor::AnalogSensor(const char *name, const char *help_supplement, AnalogPin pin)
     : pin_(pin),
       dbg_zero_("zero", Debug::Variable::Access::ReadOnly, 0.f, "V", "Voltage offset "),
-      dbg_voltage_("voltage", Debug::Variable::Access::ReadOnly, 0.f, "V", "Voltage reading ") {
+      dbg_voltage_("voltage", Debug::Variable::Access::ReadOnly, 0.f, "V", "Voltage reading "),
+      dbg_lpf_cutoff_("lpf_cutoff", Debug::Variable::Access::ReadWrite, 0.f, "Hz",
+                      "Low-pass filter cutoff (0 = off) ") {
   dbg_zero_.prepend_name(name);
   dbg_zero_.append_help(help_supplement);
 
   dbg_voltage_.prepend_name(name);
   dbg_voltage_.append_help(help_supplement);
+
+  dbg_lpf_cutoff_.prepend_name(name);
+  dbg_lpf_cutoff_.append_help(help_supplement);
 }
 
 void AnalogSensor::set_zero(HalApi &hal_api) {
@@ -33,8 +48,25 @@ void AnalogSensor::set_zero(HalApi &hal_api) {
   dbg_zero_.set(zero_.volts());
 }
 
+void AnalogSensor::set_zero(Voltage zero) {
+  zero_ = zero;
+  dbg_zero_.set(zero_.volts());
+}
+
 float AnalogSensor::read_diff_volts(HalApi &hal_api) const {
   auto ret = (hal_api.AnalogRead(pin_) - zero_).volts();
+
+  float cutoff = dbg_lpf_cutoff_.get();
+  if (cutoff != filter_cutoff_) {
+    // Start from the current reading rather than from 0.
+    filter_.set_coefficients(Dsp::LowPass(cutoff, 1.0f / ControlLoopPeriod.seconds()));
+    filter_.Reset(ToFilterCounts(ret));
+    filter_cutoff_ = cutoff;
+  }
+  if (cutoff > 0) {
+    ret = static_cast<float>(filter_.Filter(ToFilterCounts(ret))) / FilterCountsPerVolt;
+  }
+
   dbg_voltage_.set(ret);
   return ret;
 }
@@ -15,6 +15,7 @@ limitations under the License.
 
 #pragma once
 
+#include "dsp.h"
 #include "hal.h"
 #include "units.h"
 #include "vars.h"
@@ -25,14 +26,30 @@ class AnalogSensor {
 
   void set_zero(HalApi &hal_api);
 
+  // Zero saved from a previous calibration, see set_zero(HalApi&).
+  Voltage zero() const { return zero_; }
+  void set_zero(Voltage zero);
+
+  // Sets the cutoff of the low-pass filter, 0 to disable it.  This can also be changed through
+  // the lpf_cutoff debug variable.
+  void set_lpf_cutoff(float hz) { dbg_lpf_cutoff_.set(hz); }
+
+  // Returns the reading relative to the zero, through the low-pass filter if one is set.
+  // The filter assumes this is called once per control loop cycle.
   float read_diff_volts(HalApi &hal_api) const;
 
  private:
   AnalogPin pin_;
   Voltage zero_;
 
+  // Low-pass filter of the readings, disabled (0) by default.  Its cutoff can be changed through
+  // the lpf_cutoff debug variable, the coefficients are updated on the next reading.
+  mutable Dsp::Biquad filter_;
+  mutable float filter_cutoff_{0};
+
   mutable Debug::Variable::Float dbg_zero_;
   mutable Debug::Variable::Float dbg_voltage_;
+  mutable Debug::Variable::Float dbg_lpf_cutoff_;
 };
 
 class PressureSensor {
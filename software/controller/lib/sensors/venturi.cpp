@@ -16,6 +16,7 @@ limitations under the License.
 #include "venturi.h"
 
 #include <cmath>
+#include <cstring>
 
 float pow2(float f) { return f * f; }
 
@@ -30,9 +31,43 @@ VenturiFlowSensor::VenturiFlowSensor(const char* name, const char* help_suppleme
                                      Length venturi_choke_diameter, float venturi_correction)
     : FlowSensor(name, help_supplement),
       pressure_sensor_(pressure_sensor),
-      venturi_correction_(venturi_correction) {
+      venturi_correction_(venturi_correction),
+      dbg_flow_table_("flow_table", Debug::Variable::Access::ReadWrite, 0.f, "kPa, mL/s",
+                      "Venturi flow table: 16 pressures then 16 flows ") {
   port_area_ = diameter_to_area_m2(venturi_port_diameter);
   choke_area_ = diameter_to_area_m2(venturi_choke_diameter);
+
+  dbg_flow_table_.prepend_name(name);
+  dbg_flow_table_.append_help(help_supplement);
+}
+
+size_t FlowTable::points() const {
+  size_t n = 0;
+  while (n < MaxPoints && std::isfinite(dp_kPa[n]) && std::isfinite(flow_ml_per_sec[n]) &&
+         (n == 0 || dp_kPa[n] > dp_kPa[n - 1])) {
+    ++n;
+  }
+  return n < 2 ? 0 : n;
+}
+
+void VenturiFlowSensor::set_flow_table(const FlowTable& table) {
+  table_ = table;
+  table_points_ = table.points();
+  for (size_t i = 0; i + 1 < table_points_; ++i) {
+    table_slopes_[i] = (table.flow_ml_per_sec[i + 1] - table.flow_ml_per_sec[i]) /
+                       (table.dp_kPa[i + 1] - table.dp_kPa[i]);
+  }
+  for (size_t i = 0; i < FlowTable::MaxPoints; ++i) {
+    dbg_flow_table_.data[i] = table.dp_kPa[i];
+    dbg_flow_table_.data[FlowTable::MaxPoints + i] = table.flow_ml_per_sec[i];
+  }
+}
+
+bool VenturiFlowSensor::flow_table_edited(FlowTable* table) const {
+  std::memcpy(table->dp_kPa, &dbg_flow_table_.data[0], sizeof(table->dp_kPa));
+  std::memcpy(table->flow_ml_per_sec, &dbg_flow_table_.data[FlowTable::MaxPoints],
+              sizeof(table->flow_ml_per_sec));
+  return std::memcmp(table, &table_, sizeof(FlowTable)) != 0;
 }
 
 /*
@@ -54,6 +89,24 @@ VolumetricFlow VenturiFlowSensor::read(HalApi& hal_api, float air_density) const
 }
 
 VolumetricFlow VenturiFlowSensor::pressure_delta_to_flow(Pressure delta, float air_density) const {
+  if (table_points_) {
+    // Binary search for the segment of the table that holds delta (or the first/last one if it is
+    // out of the table), then interpolate.
+    float dp = delta.kPa();
+    size_t first = 0;
+    size_t last = table_points_ - 2;
+    while (first < last) {
+      size_t middle = (first + last + 1) / 2;
+      if (dp < table_.dp_kPa[middle]) {
+        last = middle - 1;
+      } else {
+        first = middle;
+      }
+    }
+    return ml_per_sec(table_.flow_ml_per_sec[first] +
+                      (dp - table_.dp_kPa[first]) * table_slopes_[first]);
+  }
+
   return cubic_m_per_sec(venturi_correction_ *
                          std::copysign(std::sqrt(std::abs(delta.kPa()) * 1000.0f), delta.kPa()) *
                          std::sqrt(2 / air_density) * port_area_ * choke_area_ /
@@ -15,6 +15,7 @@ limitations under the License.
 
 #pragma once
 
+#include "flow_table.h"
 #include "pressure_sensors.h"
 #include "sensor_base.h"
 
@@ -30,6 +31,16 @@ class VenturiFlowSensor : public FlowSensor {
   /// This is exposed as static so the math can be tested without HAL
   VolumetricFlow pressure_delta_to_flow(Pressure delta, float air_density) const;
 
+  /// Replaces the venturi formula with the calibrated table, or goes back to the formula if the
+  /// table has no valid points.  The table is calibrated for a given air density, so air_density
+  /// is ignored while it is in use.
+  void set_flow_table(const FlowTable& table);
+  const FlowTable& flow_table() const { return table_; }
+
+  /// Returns whether the table was changed through the flow_table debug variable, in which case
+  /// the new one is copied to *table.
+  bool flow_table_edited(FlowTable* table) const;
+
  private:
   PressureSensor* pressure_sensor_;
 
@@ -38,4 +49,12 @@ class VenturiFlowSensor : public FlowSensor {
 
   /// \TODO: define and explain this
   float venturi_correction_;
+
+  FlowTable table_;
+  /// Number of valid points in table_, 0 to use the formula.
+  size_t table_points_{0};
+  /// Slope of each segment of the table, in mL/s/kPa.
+  float table_slopes_[FlowTable::MaxPoints - 1] = {};
+
+  mutable Debug::Variable::FloatArray<2 * FlowTable::MaxPoints> dbg_flow_table_;
 };
@@ -4,9 +4,13 @@ Import("env")
 import sys
 
 # Sanitizers have to be enabled both in CCFLAGS and LINKFLAGS.
+# Environments may pick other sanitizers with the custom_sanitizers option,
+# e.g. the thread sanitizer, which can't be combined with the address one.
 sanitizers = [
-    "-fsanitize=undefined",
-    "-fsanitize=address",
+    "-fsanitize=" + sanitizer
+    for sanitizer in env.GetProjectOption(
+        "custom_sanitizers", "undefined address"
+    ).split()
 ]
 
 # TODO: Add -fsanitize=memory when supported.
@@ -13,18 +13,22 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <string.h>
+
 #include "actuators.h"
 #include "commands.h"
 #include "comms.h"
 #include "controller.h"
 #include "eeprom.h"
 #include "hal.h"
+#include "histogram.h"
 #include "interface.h"
 #include "network_protocol.pb.h"
 #include "nvparams.h"
 #include "sensors.h"
 #include "trace.h"
 #include "version.h"
+#include "waveform_recorder.h"
 
 using DUint32 = Debug::Variable::UInt32;
 using DFloat = Debug::Variable::Float;
@@ -65,6 +69,7 @@ static DFloat forced_fio2(
 
 static Controller controller;
 static ControllerStatus controller_status;
+static WaveformRecorder waveforms;
 static Sensors sensors;
 static NVParams::Handler nv_params;
 static I2Ceeprom eeprom = I2Ceeprom(0x50, 64, 32768, &i2c1);
@@ -86,6 +91,19 @@ static Debug::Interface debug(&trace, 12, Debug::Command::Code::Mode, &mode_comm
                               Debug::Command::Code::Trace, &trace_command,
                               Debug::Command::Code::EepromAccess, &eeprom_command);
 
+// Timing of each stage of HighPriorityTask.  Together with the loop latency and
+// duration histograms kept by the HAL, these tell us how much of the loop
+// period we actually use, and where.
+static constexpr size_t StageHistogramBuckets{32};
+static Debug::Variable::Histogram<StageHistogramBuckets> dbg_sensors_histogram(
+    "loop_hist_sensors", 20.0f, "\xB5s", "Histogram of the duration of sensors.get_readings");
+static Debug::Variable::Histogram<StageHistogramBuckets> dbg_controller_histogram(
+    "loop_hist_controller", 50.0f, "\xB5s", "Histogram of the duration of Controller::Run");
+static Debug::Variable::Histogram<StageHistogramBuckets> dbg_actuators_histogram(
+    "loop_hist_actuators", 10.0f, "\xB5s", "Histogram of the duration of ActuatorsExecute");
+static Debug::Variable::Histogram<StageHistogramBuckets> dbg_trace_histogram(
+    "loop_hist_trace", 5.0f, "\xB5s", "Histogram of the duration of SampleTraceVars");
+
 static SensorsProto AsSensorsProto(const SensorReadings &r, const ControllerState &c) {
   SensorsProto proto = SensorsProto_init_zero;
   proto.patient_pressure_cm_h2o = r.patient_pressure.cmH2O();
@@ -105,35 +123,93 @@ static SensorsProto AsSensorsProto(const SensorReadings &r, const ControllerStat
 // NOTE - its important that anything being called from this function executes
 // quickly.  No busy waiting here.
 static void HighPriorityTask(void *arg) {
+  // Record the time spent since the previous timestamp in the given histogram
+  float timestamp = hal.LoopTimerMicros();
+  auto profile = [&timestamp](auto *histogram) {
+    float now = hal.LoopTimerMicros();
+    histogram->add(now - timestamp);
+    timestamp = now;
+  };
+
   // Read the sensors
   SensorReadings sensor_readings = sensors.get_readings();
+  profile(&dbg_sensors_histogram);
 
   // Run our PID loop
   auto [actuators_state, controller_state] =
       controller.Run(hal.Now(), controller_status.active_params, sensor_readings);
+  profile(&dbg_controller_histogram);
 
   // TODO update pb library to replace fan_power in ControllerStatus with
   // actuators_state, and remove pressure_setpoint_cm_h2o from ControllerStatus
 
   // Update the outputs from the PID
   ActuatorsExecute(actuators_state);
+  profile(&dbg_actuators_histogram);
 
   // Update controller_status.  This is periodically sent back to the GUI.
   controller_status.sensor_readings = AsSensorsProto(sensor_readings, controller_state);
   controller_status.fan_power = actuators_state.blower_power;
   controller_status.pressure_setpoint_cm_h2o = controller_state.pressure_setpoint.cmH2O();
 
-  // Sample any trace variables that are enabled
+  // Record this cycle's waveforms, which are also sent to the GUI.
+  WaveformSample sample = {
+      .patient_pressure_cm_h2o = sensor_readings.patient_pressure.cmH2O(),
+      .flow_ml_per_min = controller_state.net_flow.ml_per_min(),
+      .volume_ml = controller_state.patient_volume.ml(),
+      .pressure_setpoint_cm_h2o = controller_state.pressure_setpoint.cmH2O(),
+      .breath_id = controller_state.breath_id,
+  };
+  waveforms.record(hal.Now(), sample);
+
+  // Sample any trace variables that are enabled.  The controller_status and
+  // waveforms updates above are cheap, so they're accounted for along with the
+  // trace.
   debug.SampleTraceVars();
+  profile(&dbg_trace_histogram);
 
   // Pet the watchdog
   hal.WatchdogHandler();
 }
 
-// This function is the lower priority background loop which runs continuously
-// after some basic system init.  Pretty much everything not time critical
-// should go here.
-[[noreturn]] static void BackgroundLoop() {
+// Calibrations saved for warm starts, see NVParams::WarmStart.
+static constexpr uint16_t WarmStartOffset{offsetof(NVParams::Structure, warm_start)};
+
+// Reads the calibrations saved for warm starts into params, and returns true if
+// we may use them: after a watchdog or software reset, if warm starts are
+// enabled and the calibrations pass a plausibility check.
+static bool WarmStartAllowed(NVParams::WarmStart *params) {
+  if (!hal.WarmReset()) return false;
+  if (!nv_params.Get(WarmStartOffset, params, sizeof(*params))) return false;
+  return params->enabled && params->plausible();
+}
+
+// After a watchdog or software reset, restores the calibrations made by the
+// last cold start instead of making them again, so that we can get back to
+// ventilating within a fraction of a second.  This is only done if warm starts
+// are allowed (see WarmStartAllowed), and if the state of the actuators passes
+// a plausibility check too.  Returns false if a cold start is needed.
+static bool WarmStart() {
+  NVParams::WarmStart params;
+  if (!WarmStartAllowed(&params)) return false;
+
+  // Valves which lost their home position get homed by the cold start.
+  if (!ActuatorsWarmStart(params)) return false;
+
+  sensors.restore_zeros(params);
+  return true;
+}
+
+static void ColdStart() {
+  // Invalidate the calibrations saved by the previous cold start, in case we
+  // get reset before making new ones.
+  NVParams::WarmStart params;
+  nv_params.Get(WarmStartOffset, &params, sizeof(params));
+  if (params.calibrated) {
+    uint8_t calibrated = 0;
+    nv_params.Set(WarmStartOffset + offsetof(NVParams::WarmStart, calibrated), &calibrated, 1);
+  }
+
   // Sleep for a few seconds.  In the current iteration of the PCB, the fan
   // briefly turns on when the device starts up.  If we don't wait for the fan
   // to spin down, the sensors will miscalibrate.  This is a hardware issue
@@ -159,6 +235,32 @@ static void HighPriorityTask(void *arg) {
   // This needs to be done before the sensors are used.
   sensors.calibrate();
 
+  // Save the calibrations for warm starts.
+  nv_params.Get(WarmStartOffset, &params, sizeof(params));
+  params.calibrated = 1;
+  sensors.save_zeros(&params);
+  ActuatorsSaveCalibration(&params);
+  nv_params.Set(WarmStartOffset, &params, sizeof(params));
+}
+
+// Saves the pinch valve calibrations for warm starts when they are changed
+// through debug variables.
+static void UpdateWarmStart() {
+  NVParams::WarmStart saved;
+  nv_params.Get(WarmStartOffset, &saved, sizeof(saved));
+  NVParams::WarmStart params = saved;
+  ActuatorsSaveCalibration(&params);
+  if (memcmp(&params, &saved, sizeof(params)) != 0) {
+    nv_params.Set(WarmStartOffset, &params, sizeof(params));
+  }
+}
+
+// This function is the lower priority background loop which runs continuously
+// after some basic system init.  Pretty much everything not time critical
+// should go here.
+[[noreturn]] static void BackgroundLoop() {
+  if (!WarmStart()) ColdStart();
+
   // Current controller status.
   // Updated when we receive data from the GUI, when sensors read data, etc.
   controller_status = ControllerStatus_init_zero;
@@ -180,7 +282,7 @@ static void HighPriorityTask(void *arg) {
       local_controller_status = controller_status;
     }
 
-    CommsHandler(local_controller_status, &gui_status);
+    CommsHandler(local_controller_status, &waveforms, &gui_status);
 
     // Override received gui_status from the RPi with values from DebugVars iff
     // the forced_mode DebugVar has a legal value.
@@ -206,6 +308,8 @@ static void HighPriorityTask(void *arg) {
 
     // Update nv_params
     nv_params.Update(hal.Now(), &gui_status.desired_params);
+    sensors.update_flow_tables(&nv_params);
+    UpdateWarmStart();
   }
 }
 
@@ -215,6 +319,12 @@ int main() {
 
   // Locate our non-volatile parameter block in flash
   nv_params.Init(&eeprom);
+  sensors.load_flow_tables(&nv_params);
+
+  // The stepper motor drivers keep the home position of the pinch valves through a watchdog or
+  // software reset, which a warm start can reuse.  Otherwise, they're reset as on power up.
+  NVParams::WarmStart warm_start;
+  hal.StepperMotorInit(/*keep_state=*/WarmStartAllowed(&warm_start));
 
   CommsInit();
 
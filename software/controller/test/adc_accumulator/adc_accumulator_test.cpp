@@ -0,0 +1,104 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "adc_accumulator.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+// Plays the role of the DMA and its interrupts: writes readings to a circular buffer made of two
+// blocks, and hands each block to the accumulator once it is full.  Also records all readings, to
+// check the accumulator against them.
+template <class Accumulator>
+class FakeDma {
+ public:
+  explicit FakeDma(Accumulator *accumulator) : accumulator_(accumulator) {}
+
+  void Write(uint16_t reading) {
+    buffer_[position_] = reading;
+    readings_.push_back(reading);
+    ++position_;
+    if (position_ == Accumulator::BlockSize) {
+      // half-transfer interrupt
+      accumulator_->AddBlock(&buffer_[0]);
+    } else if (position_ == 2 * Accumulator::BlockSize) {
+      // transfer-complete interrupt
+      accumulator_->AddBlock(&buffer_[Accumulator::BlockSize]);
+      position_ = 0;
+    }
+  }
+
+  // Sum of the readings of the channel in the last window, computed the slow way.
+  uint32_t ExpectedSum(size_t channels, size_t channel) const {
+    // Only complete blocks count.
+    size_t end = readings_.size() - readings_.size() % Accumulator::BlockSize;
+    size_t window = Accumulator::WindowScans * channels;
+    size_t start = end > window ? end - window : 0;
+    uint32_t sum = 0;
+    for (size_t i = start + channel; i < end; i += channels) sum += readings_[i];
+    return sum;
+  }
+
+ private:
+  Accumulator *accumulator_;
+  volatile uint16_t buffer_[2 * Accumulator::BlockSize] = {};
+  size_t position_{0};
+  std::vector<uint16_t> readings_;
+};
+}  // namespace
+
+TEST(AdcAccumulator, MatchesSum) {
+  constexpr size_t Channels = 5;
+  using Accumulator = AdcAccumulator<Channels, 3, 3>;
+  static_assert(Accumulator::WindowScans == 9);
+  static_assert(Accumulator::BlockSize == 15);
+
+  Accumulator accumulator;
+  FakeDma<Accumulator> dma(&accumulator);
+  for (size_t channel = 0; channel < Channels; ++channel) EXPECT_EQ(0, accumulator.Sum(channel));
+
+  // Each channel reads around its own level, so that mixing channels up shows.
+  for (int scan = 0; scan < 200; ++scan) {
+    for (size_t channel = 0; channel < Channels; ++channel) {
+      dma.Write(static_cast<uint16_t>(channel * 10000 + rand() % 1000));
+      // The window starts partly empty, and sums only change when a block is complete.
+      for (size_t c = 0; c < Channels; ++c) {
+        ASSERT_EQ(dma.ExpectedSum(Channels, c), accumulator.Sum(c))
+            << "scan " << scan << ", channel " << c;
+      }
+    }
+  }
+}
+
+// The window can hold far more readings than the DMA buffer, and readings can be as high as the
+// A/D gets.
+TEST(AdcAccumulator, LongWindow) {
+  constexpr size_t Channels = 2;
+  using Accumulator = AdcAccumulator<Channels, 4, 1000>;
+  static_assert(Accumulator::WindowScans == 4000);
+
+  Accumulator accumulator;
+  FakeDma<Accumulator> dma(&accumulator);
+  for (int scan = 0; scan < 10000; ++scan) {
+    dma.Write(0xFFFF);
+    dma.Write(static_cast<uint16_t>(scan));
+  }
+  EXPECT_EQ(4000u * 0xFFFF, accumulator.Sum(0));
+  EXPECT_EQ(dma.ExpectedSum(Channels, 1), accumulator.Sum(1));
+}
@@ -130,7 +130,12 @@ void testSequence(const std::vector<BlowerFsmTest> &seq) {
   BlowerFsmInputs last_inputs;
   for (const auto &blower_fsm_test : seq) {
     SCOPED_TRACE("time = " + blower_fsm_test.time.microsSinceStartup() / 1000);
-    // Move time forward to t in steps of Controller::GetLoopPeriod().
+    // Move time forward to t in steps of Controller::GetLoopPeriod().  t
+    // needn't be a whole number of loop periods away at every control loop
+    // rate, so first move it by whatever is left over: the last loop cycle
+    // then runs at t, as it would at the default rate.
+    const int64_t period_us = Controller::GetLoopPeriod().microseconds();
+    hal.Delay(microseconds((blower_fsm_test.time - hal.Now()).microseconds() % period_us));
     while (hal.Now() < blower_fsm_test.time) {
       hal.Delay(Controller::GetLoopPeriod());
       (void)fsm.DesiredState(hal.Now(), last_params, last_inputs);
@@ -242,7 +247,9 @@ struct FlowTraceResults {
 };
 
 // Runs a breath using a fresh FSM of type FsmTy, using the given array of
-// flows (length n, time period between entries trace_interval).
+// flows (length n, time period between entries trace_interval).  The FSM is
+// run once per control loop cycle, as the controller does, with each flow of
+// the trace held until the next one.
 //
 // At every time named in setpoint_checks, check that the setpoint pressure is
 // as specified.
@@ -258,44 +265,47 @@ FlowTraceResults RunFlowTrace(const VolumetricFlow *trace, size_t n, const VentP
   FlowTraceResults results;
   auto check_it = setpoint_checks.begin();
 
-  for (size_t i = 0; i < n; i++) {
-    auto ms = (hal.Now() - start).microseconds() / 1000;
-    SCOPED_TRACE("time = " + std::to_string(ms));
-
+  for (size_t i = 0; i < n && !results.finish_time; i++) {
     VolumetricFlow f = trace[i];
+    Time next_flow_time = start + static_cast<int64_t>(i + 1) * trace_interval;
+
+    for (bool first_cycle = true; hal.Now() < next_flow_time; first_cycle = false) {
+      auto ms = (hal.Now() - start).microseconds() / 1000;
+      SCOPED_TRACE("time = " + std::to_string(ms));
+
+      // Our traces don't contain volume measurements, but this is OK for now.
+      BlowerSystemState desired_state =
+          fsm.DesiredState(hal.Now(), {.patient_volume = ml(0), .net_flow = f});
+      FlowDirection dir = desired_state.flow_direction;
+      if (dir == FlowDirection::Expiratory && !results.expire_start_time) {
+        results.expire_start_time = hal.Now() - start;
+      }
 
-    // Our traces don't contain volume measurements, but this is OK for now.
-    BlowerSystemState desired_state =
-        fsm.DesiredState(hal.Now(), {.patient_volume = ml(0), .net_flow = f});
-    FlowDirection dir = desired_state.flow_direction;
-    if (dir == FlowDirection::Expiratory && !results.expire_start_time) {
-      results.expire_start_time = hal.Now() - start;
-    }
-
-    if (results.expire_start_time == std::nullopt) {
-      EXPECT_EQ(FlowDirection::Inspiratory, dir);
-    } else {
-      EXPECT_EQ(FlowDirection::Expiratory, dir);
-    }
+      if (results.expire_start_time == std::nullopt) {
+        EXPECT_EQ(FlowDirection::Inspiratory, dir);
+      } else {
+        EXPECT_EQ(FlowDirection::Expiratory, dir);
+      }
 
-    if (check_it != setpoint_checks.end()) {
-      const auto &[check_ms, check_cmh2o] = *check_it;
-      if (check_ms == ms) {
-        auto sp = desired_state.pressure_setpoint;
-        EXPECT_TRUE(sp.has_value());
-        if (sp.has_value()) {
-          EXPECT_EQ(sp->cmH2O(), check_cmh2o);
+      if (first_cycle && check_it != setpoint_checks.end()) {
+        const auto &[check_ms, check_cmh2o] = *check_it;
+        if (check_ms == ms) {
+          auto sp = desired_state.pressure_setpoint;
+          EXPECT_TRUE(sp.has_value());
+          if (sp.has_value()) {
+            EXPECT_EQ(sp->cmH2O(), check_cmh2o);
+          }
         }
+        ++check_it;
       }
-      ++check_it;
-    }
 
-    if (desired_state.is_end_of_breath) {
-      results.finish_time = hal.Now() - start;
-      break;
-    }
+      if (desired_state.is_end_of_breath) {
+        results.finish_time = hal.Now() - start;
+        break;
+      }
 
-    hal.Delay(trace_interval);
+      hal.Delay(ControlLoopPeriod);
+    }
   }
 
   EXPECT_TRUE(check_it == setpoint_checks.end()) << "didn't see every expected pressure checkpoint";
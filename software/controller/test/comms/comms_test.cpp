@@ -4,13 +4,15 @@
 #include <pb_decode.h>
 #include <pb_encode.h>
 
+#include "framed_uart.h"
+#include "framing.h"
 #include "gtest/gtest.h"
 #include "hal.h"
 #include "network_protocol.pb.h"
 
 TEST(CommTests, SendControllerStatus) {
-  // Initialize a large ControllerStatus so as to force multiple calls to
-  // CommsHandler to send it.
+  rpi_uart.init(115200);
+
   ControllerStatus s = ControllerStatus_init_zero;
   s.uptime_ms = 42;
   s.active_params.mode = VentMode_PRESSURE_CONTROL;
@@ -23,16 +25,44 @@ TEST(CommTests, SendControllerStatus) {
   s.sensor_readings.volume_ml = 800;
   s.sensor_readings.flow_ml_per_min = 1000;
 
-  // Run CommsHandler until it stops sending data.  10 iterations should be
-  // more than enough.
-  for (int i = 0; i < 10; i++) {
-    GuiStatus gui_status_ignored = GuiStatus_init_zero;
-    CommsHandler(s, &gui_status_ignored);
+  WaveformRecorder waveforms;
+  for (int i = 0; i < 3; i++) {
+    WaveformSample sample = {
+        .patient_pressure_cm_h2o = 5.0f + static_cast<float>(i),
+        .flow_ml_per_min = 0,
+        .volume_ml = 100.0f * static_cast<float>(i),
+        .pressure_setpoint_cm_h2o = 15,
+        .breath_id = 42,
+    };
+    waveforms.record(microsSinceStartup(10'000 * i), sample);
   }
-  char tx_buffer[ControllerStatus_size];
-  uint16_t len = hal.TESTSerialGetOutgoingData(tx_buffer, sizeof(tx_buffer));
-  ASSERT_GT(len, 0);
-  pb_istream_t stream = pb_istream_from_buffer(reinterpret_cast<unsigned char *>(tx_buffer), len);
+
+  // The whole status goes out as a single frame in a single DMA transfer.
+  GuiStatus gui_status_ignored = GuiStatus_init_zero;
+  CommsHandler(s, &waveforms, &gui_status_ignored);
+  std::vector<uint8_t> frame = uart_dma.TESTGetSentData();
+  ASSERT_GT(frame.size(), 0u);
+  EXPECT_EQ(frame.front(), FramingMark);
+  EXPECT_EQ(frame.back(), FramingMark);
+
+  // While that frame is being sent, the next status waits for it, and any
+  // further ones are dropped.
+  CommsHandler(s, &waveforms, &gui_status_ignored);
+  CommsHandler(s, &waveforms, &gui_status_ignored);
+  EXPECT_TRUE(uart_dma.TESTGetSentData().empty());
+  uart_dma.TESTCompleteTx();
+  // That one has no samples left to carry, so it's shorter.
+  std::vector<uint8_t> next_frame = uart_dma.TESTGetSentData();
+  EXPECT_GT(next_frame.size(), 0u);
+  EXPECT_LT(next_frame.size(), frame.size());
+  uart_dma.TESTCompleteTx();
+  EXPECT_TRUE(uart_dma.TESTGetSentData().empty());
+
+  uint8_t tx_buffer[ControllerStatus_size];
+  uint32_t len = decode_frame(frame.data(), static_cast<uint32_t>(frame.size()), tx_buffer,
+                              sizeof(tx_buffer));
+  ASSERT_GT(len, 0u);
+  pb_istream_t stream = pb_istream_from_buffer(tx_buffer, len);
 
   ControllerStatus sent = ControllerStatus_init_zero;
   ASSERT_TRUE(pb_decode(&stream, ControllerStatus_fields, &sent));
@@ -41,9 +71,20 @@ TEST(CommTests, SendControllerStatus) {
   EXPECT_EQ(s.active_params.peep_cm_h2o, sent.active_params.peep_cm_h2o);
   EXPECT_EQ(s.sensor_readings.patient_pressure_cm_h2o,
             sent.sensor_readings.patient_pressure_cm_h2o);
+
+  // Recorded samples went with the first status.
+  WaveformSample samples[SampleBatchCapacity];
+  ASSERT_EQ(3u, unpack_samples(sent.samples, samples, SampleBatchCapacity));
+  EXPECT_EQ(0u, sent.samples.first_sample_uptime_us);
+  EXPECT_FLOAT_EQ(7.0f, samples[2].patient_pressure_cm_h2o);
+  EXPECT_FLOAT_EQ(200.0f, samples[2].volume_ml);
+  EXPECT_EQ(42u, samples[2].breath_id);
+  EXPECT_EQ(0u, waveforms.size());
 }
 
 TEST(CommTests, CommandRx) {
+  rpi_uart.init(115200);
+
   GuiStatus s = GuiStatus_init_zero;
   s.uptime_ms = std::numeric_limits<uint32_t>::max() / 2;
   s.desired_params.mode = VentMode_PRESSURE_CONTROL;
@@ -54,25 +95,26 @@ TEST(CommTests, CommandRx) {
   s.desired_params.inspiratory_trigger_cm_h2o = 5;
   s.desired_params.expiratory_trigger_ml_per_min = 9;
 
-  char rx_buffer[GuiStatus_size];
-  pb_ostream_t stream =
-      pb_ostream_from_buffer(reinterpret_cast<unsigned char *>(rx_buffer), sizeof(rx_buffer));
+  uint8_t rx_buffer[GuiStatus_size];
+  pb_ostream_t stream = pb_ostream_from_buffer(rx_buffer, sizeof(rx_buffer));
   pb_encode(&stream, GuiStatus_fields, &s);
   EXPECT_GT(stream.bytes_written, 0u);
-  hal.TESTSerialPutIncomingData(rx_buffer, static_cast<uint16_t>(stream.bytes_written));
-  EXPECT_GT(hal.SerialBytesAvailableForRead(), 0);
+  uint8_t frame[max_encoded_frame_size(GuiStatus_size)];
+  uint32_t frame_length = encode_frame(rx_buffer, static_cast<uint32_t>(stream.bytes_written),
+                                       frame, sizeof(frame));
+  ASSERT_GT(frame_length, 0u);
 
   ControllerStatus controller_status_ignored = ControllerStatus_init_zero;
+  WaveformRecorder waveforms;
   GuiStatus received = GuiStatus_init_zero;
 
-  // Run CommsHandler until it updates GuiStatus.  10 iterations should be
-  // more than enough to read the whole thing.
-  for (int i = 0; i < 10; i++) {
-    CommsHandler(controller_status_ignored, &received);
-    // We use a timeout for framing packets, so we have to advance the time,
-    // otherwise we'll never think the packet is complete!
-    hal.Delay(milliseconds(1));
-  }
+  // Nothing happens until the whole frame is in.
+  uart_dma.TESTReceive(frame, frame_length - 1);
+  CommsHandler(controller_status_ignored, &waveforms, &received);
+  EXPECT_EQ(0u, received.uptime_ms);
+
+  uart_dma.TESTReceive(frame + frame_length - 1, 1);
+  CommsHandler(controller_status_ignored, &waveforms, &received);
   EXPECT_EQ(s.uptime_ms, received.uptime_ms);
   EXPECT_EQ(s.desired_params.mode, received.desired_params.mode);
 }
@@ -0,0 +1,103 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "histogram.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "hal.h"
+
+using namespace Debug::Variable;
+
+static std::vector<float> Serialized(Histogram<4> &histogram) {
+  std::vector<float> data(histogram.byte_size() / sizeof(float));
+  histogram.serialize_value(data.data());
+  return data;
+}
+
+TEST(Histogram, Buckets) {
+  Histogram<4> histogram("histogram", 10.0f, "us", "help");
+  EXPECT_EQ(Type::FloatArray, histogram.type());
+  EXPECT_EQ(Access::ReadWrite, histogram.access());
+  EXPECT_EQ(6 * sizeof(float), histogram.byte_size());
+
+  for (float sample : {-1.0f, 0.0f, 9.9f, 10.0f, 25.0f, 29.0f, 30.0f, 1000.0f}) {
+    histogram.add(sample);
+  }
+  EXPECT_EQ(3u, histogram.count(0));
+  EXPECT_EQ(1u, histogram.count(1));
+  EXPECT_EQ(2u, histogram.count(2));
+  // Last bucket also counts overflows
+  EXPECT_EQ(2u, histogram.count(3));
+  EXPECT_EQ(0u, histogram.count(4));
+  EXPECT_EQ(8u, histogram.total());
+  EXPECT_FLOAT_EQ(1000.0f, histogram.max());
+
+  EXPECT_EQ((std::vector<float>{10, 1000, 3, 1, 2, 2}), Serialized(histogram));
+}
+
+TEST(Histogram, Percentile) {
+  Histogram<4> histogram("histogram", 10.0f, "us");
+  EXPECT_FLOAT_EQ(0.0f, histogram.percentile(0.5f));
+
+  for (int i = 0; i < 98; ++i) histogram.add(5.0f);
+  histogram.add(15.0f);
+  histogram.add(12.0f);
+  EXPECT_FLOAT_EQ(10.0f, histogram.percentile(0.5f));
+  EXPECT_FLOAT_EQ(10.0f, histogram.percentile(0.98f));
+  // Capped at the largest sample rather than the bucket edge
+  EXPECT_FLOAT_EQ(15.0f, histogram.percentile(0.99f));
+
+  histogram.add(500.0f);
+  EXPECT_FLOAT_EQ(500.0f, histogram.percentile(1.0f));
+}
+
+TEST(Histogram, ResetFromDebugInterface) {
+  Histogram<4> histogram("histogram", 10.0f, "us");
+  histogram.add(15.0f);
+
+  // Writing a zero width clears the counts but keeps the width.  The writer
+  // applies the reset on its next sample.
+  std::vector<float> data(6, 0.0f);
+  histogram.deserialize_value(data.data());
+  EXPECT_EQ(1u, histogram.total());
+  histogram.add(15.0f);
+  EXPECT_EQ((std::vector<float>{10, 15, 0, 1, 0, 0}), Serialized(histogram));
+
+  // Writing a positive width also changes the buckets.
+  data[0] = 20.0f;
+  histogram.deserialize_value(data.data());
+  histogram.add(15.0f);
+  EXPECT_EQ((std::vector<float>{20, 15, 1, 0, 0, 0}), Serialized(histogram));
+
+  histogram.reset();
+  histogram.add(45.0f);
+  EXPECT_EQ((std::vector<float>{20, 45, 0, 0, 1, 0}), Serialized(histogram));
+}
+
+TEST(Histogram, LoopTimer) {
+  Histogram<4> histogram("histogram", 100.0f, "us");
+  hal.StartLoopTimer(microseconds(1000), nullptr, nullptr);
+
+  float start = hal.LoopTimerMicros();
+  hal.Delay(microseconds(150));
+  histogram.add(hal.LoopTimerMicros() - start);
+  EXPECT_EQ(1u, histogram.count(1));
+
+  // The loop timer counts from 0 at the start of each loop period.
+  hal.Delay(microseconds(1000));
+  EXPECT_FLOAT_EQ(start + 150.0f, hal.LoopTimerMicros());
+}
@@ -17,7 +17,10 @@ limitations under the License.
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstring>
 #include <vector>
 
 #include "binary_utils.h"
@@ -42,7 +45,7 @@ std::vector<uint8_t> Escape(const std::vector<uint8_t> &data) {
 
 std::vector<uint8_t> Unescape(const std::vector<uint8_t> &data) {
   std::vector<uint8_t> res;
-  bool escape_next_byte;
+  bool escape_next_byte{false};
   for (uint8_t ch : data) {
     if (escape_next_byte) {
       res.push_back(ch);
@@ -184,6 +187,124 @@ TEST(Interface, AwaitingResponseState) {
   EXPECT_EQ(resp.size(), 0);
 }
 
+// Polls the interface until it has sent a packet on its own initiative, and
+// returns it unescaped, without its code, crc and term, after checking those.
+std::vector<uint8_t> ReceiveStreamPacket(Interface *serial) {
+  for (int i = 0; i < 10 && !serial->Poll(); ++i) {
+  }
+  std::vector<uint8_t> escaped(1000);
+  uint16_t length = hal.TESTDebugGetOutgoingData(reinterpret_cast<char *>(escaped.data()),
+                                                 static_cast<uint16_t>(escaped.size()));
+  escaped.resize(length);
+  if (escaped.empty()) return {};
+
+  std::vector<uint8_t> packet = Unescape(escaped);
+  EXPECT_GE(packet.size(), size_t{4} /* code + crc + term */);
+  EXPECT_EQ(static_cast<uint8_t>(SpecialChar::EndTransfer), packet.back());
+  packet.pop_back();
+  EXPECT_EQ(static_cast<uint8_t>(StreamCode::TraceData), packet[0]);
+  EXPECT_EQ(Interface::ComputeCRC(packet.data(), packet.size() - 2),
+            u8_to_u16(packet.data() + packet.size() - 2));
+  return std::vector<uint8_t>(packet.begin() + 1, packet.end() - 2);
+}
+
+// Decodes trace data of a single variable, as encoded by Trace::read_encoded.
+std::vector<uint32_t> DecodeTraceData(const std::vector<uint8_t> &data, size_t offset) {
+  std::vector<uint32_t> values;
+  uint32_t value{0};
+  while (offset < data.size()) {
+    uint32_t reference = value;
+    size_t length = TraceCodec::decode_sample(&data[offset], data.size() - offset, &reference, 1,
+                                              &value);
+    EXPECT_GT(length, 0);
+    if (length == 0) break;
+    offset += length;
+    values.push_back(value);
+  }
+  return values;
+}
+
+TEST(Interface, StreamsTrace) {
+  uint32_t x = 0;
+  Debug::Variable::Primitive32 var_x("x", Debug::Variable::Access::ReadOnly, &x, "unit");
+  Trace trace;
+  ASSERT_TRUE(trace.set_traced_variable(0, var_x.id()));
+  Command::TraceHandler trace_command(&trace);
+  Interface serial(&trace, 2, Command::Code::Trace, &trace_command);
+
+  // Nothing is sent unless streaming.
+  trace.start();
+  serial.SampleTraceVars();
+  hal.Delay(milliseconds(100));
+  EXPECT_TRUE(ReceiveStreamPacket(&serial).empty());
+
+  std::vector<uint8_t> req = {
+      static_cast<uint8_t>(Command::Code::Trace),
+      static_cast<uint8_t>(Command::TraceHandler::Subcommand::StartStreaming),
+  };
+  EXPECT_TRUE(ProcessCmd(&serial, req).empty());
+  EXPECT_TRUE(trace.streaming());
+
+  // The first sample goes out right away.
+  serial.SampleTraceVars();
+  std::vector<uint8_t> packet = ReceiveStreamPacket(&serial);
+  ASSERT_GT(packet.size(), 8);
+  EXPECT_EQ(0, u8_to_u32(&packet[0]));  // sequence
+  EXPECT_EQ(0, u8_to_u32(&packet[4]));  // dropped
+  EXPECT_THAT(DecodeTraceData(packet, 8), testing::ElementsAre(0));
+
+  // The next ones wait for a while, to be sent together.
+  for (x = 1; x <= 10; ++x) serial.SampleTraceVars();
+  EXPECT_TRUE(ReceiveStreamPacket(&serial).empty());
+  hal.Delay(milliseconds(50));
+  packet = ReceiveStreamPacket(&serial);
+  ASSERT_GT(packet.size(), 8);
+  EXPECT_EQ(1, u8_to_u32(&packet[0]));
+  EXPECT_EQ(0, u8_to_u32(&packet[4]));
+  EXPECT_THAT(DecodeTraceData(packet, 8), testing::ElementsAre(1, 2, 3, 4, 5, 6, 7, 8, 9, 10));
+  EXPECT_EQ(0, trace.sample_count());
+  EXPECT_TRUE(ReceiveStreamPacket(&serial).empty());
+
+  // Overflow the trace buffer: full packets are sent without waiting, and
+  // they report the dropped samples.  Each sample takes a byte.
+  static constexpr uint32_t Capacity{Trace::BufferSize * 4};
+  for (uint32_t i = 0; i < Capacity + 5; ++i, ++x) serial.SampleTraceVars();
+  // Packets are sent as soon as they would be full in the worst case, and
+  // filled as much as the response buffer allows.
+  static constexpr size_t MaxDataSize{500 - 3 - 8};
+  static constexpr size_t WorstCaseSamples{MaxDataSize / TraceCodec::MaxValueSize};
+  uint32_t expected_value = 11;
+  for (uint32_t sequence = 2; trace.sample_count() > 0; ++sequence) {
+    SCOPED_TRACE("packet " + std::to_string(sequence));
+    packet = ReceiveStreamPacket(&serial);
+    if (packet.empty()) {
+      EXPECT_LT(trace.sample_count(), WorstCaseSamples);
+      hal.Delay(milliseconds(50));
+      packet = ReceiveStreamPacket(&serial);
+    } else if (trace.sample_count() > 0) {
+      EXPECT_GT(packet.size(), 8 + MaxDataSize - TraceCodec::MaxValueSize);
+    }
+    ASSERT_GT(packet.size(), 8);
+    EXPECT_EQ(sequence, u8_to_u32(&packet[0]));
+    EXPECT_EQ(5, u8_to_u32(&packet[4]));
+    for (uint32_t value : DecodeTraceData(packet, 8)) {
+      EXPECT_EQ(expected_value++, value);
+    }
+  }
+  EXPECT_EQ(expected_value, 11 + Capacity);
+
+  // Once stopped, the trace stays in the buffer.
+  req[1] = static_cast<uint8_t>(Command::TraceHandler::Subcommand::Stop);
+  EXPECT_TRUE(ProcessCmd(&serial, req).empty());
+  serial.SampleTraceVars();
+  trace.start();
+  serial.SampleTraceVars();
+  trace.stop();
+  hal.Delay(milliseconds(100));
+  EXPECT_TRUE(ReceiveStreamPacket(&serial).empty());
+  EXPECT_EQ(1, trace.sample_count());
+}
+
 TEST(Interface, Errors) {
   Trace trace;
   TestEeprom eeprom_test(0x50, 64, 4096);
@@ -230,4 +351,95 @@ TEST(Interface, Errors) {
   uint16_t resp_len = hal.TESTDebugGetOutgoingData(reinterpret_cast<char *>(resp.data()), 10);
   EXPECT_EQ(resp_len, 0);
 }
+
+// Sends the request data back.
+class EchoHandler : public Command::Handler {
+ public:
+  ErrorCode Process(Command::Context *context) override {
+    uint32_t length = std::min(context->request_length, context->max_response_length);
+    std::memcpy(context->response, context->request, length);
+    context->response_length = length;
+    *context->processed = true;
+    return ErrorCode::None;
+  }
+};
+
+// Frames a request or response: escapes the data and crc, and terminates it.
+std::vector<uint8_t> Frame(std::vector<uint8_t> data) {
+  uint8_t crc_bytes[2];
+  u16_to_u8(Interface::ComputeCRC(data.data(), data.size()), &crc_bytes[0]);
+  data.push_back(crc_bytes[0]);
+  data.push_back(crc_bytes[1]);
+  std::vector<uint8_t> frame = Escape(data);
+  frame.push_back(static_cast<uint8_t>(SpecialChar::EndTransfer));
+  return frame;
+}
+
+// Goes through back to back echo requests of all sizes (and with all byte values), which wrap
+// around the serial buffers at every possible point, and checks the responses.  Returns the number
+// of bytes received and sent, and adds the time spent polling the interface to *elapsed.
+size_t EchoBackToBack(int requests, std::chrono::steady_clock::duration *elapsed) {
+  Trace trace;
+  EchoHandler echo_command;
+  Interface serial(&trace, 2, Command::Code::Mode, &echo_command);
+
+  std::vector<uint8_t> incoming;
+  std::vector<uint8_t> expected;
+  for (int i = 0; i < requests; ++i) {
+    std::vector<uint8_t> data(1 + (i * 37) % 400);
+    for (size_t j = 0; j < data.size(); ++j) data[j] = static_cast<uint8_t>(i + j * 7);
+    std::vector<uint8_t> request = data;
+    request.insert(request.begin(), static_cast<uint8_t>(Command::Code::Mode));
+    std::vector<uint8_t> response = data;
+    response.insert(response.begin(), static_cast<uint8_t>(ErrorCode::None));
+    for (uint8_t ch : Frame(request)) incoming.push_back(ch);
+    for (uint8_t ch : Frame(response)) expected.push_back(ch);
+  }
+  for (size_t i = 0; i < incoming.size(); i += 1000) {
+    size_t length = std::min<size_t>(1000, incoming.size() - i);
+    hal.TESTDebugPutIncomingData(reinterpret_cast<const char *>(&incoming[i]),
+                                 static_cast<uint16_t>(length));
+  }
+
+  // Outgoing data is read after each response, as the test HAL can't hold
+  // all of it, but that isn't timed.
+  std::vector<uint8_t> outgoing;
+  char buffer[1000];
+  int responses = 0;
+  for (int polls = 0; responses < requests && polls < 10 * requests; ++polls) {
+    auto start = std::chrono::steady_clock::now();
+    bool responded = serial.Poll();
+    *elapsed += std::chrono::steady_clock::now() - start;
+    if (!responded) continue;
+    ++responses;
+    while (uint16_t length = hal.TESTDebugGetOutgoingData(buffer, sizeof(buffer))) {
+      outgoing.insert(outgoing.end(), buffer, buffer + length);
+    }
+  }
+  EXPECT_EQ(requests, responses);
+  EXPECT_EQ(expected, outgoing);
+  return incoming.size() + outgoing.size();
+}
+
+TEST(Interface, BackToBackRequests) {
+  std::chrono::steady_clock::duration elapsed{0};
+  EchoBackToBack(2000, &elapsed);
+}
+
+// Checks how fast the interface goes through back to back requests, counting the bytes received
+// and sent.  This is no substitute for measurements on the target, and depends on the machine
+// running it, so it's a benchmark to run on demand when changing the serial handling:
+//
+//   GTEST_ALSO_RUN_DISABLED_TESTS=1 pio test -e native -f debug
+//
+// The bound is a thousand times the rate of the serial line (115200 baud, about 0.01 bytes/us),
+// and an order of magnitude below what a desktop machine does, so that only a large slowdown
+// fails it.
+TEST(Interface, DISABLED_Throughput) {
+  static constexpr float MinBytesPerMicrosecond{10.0f};
+  std::chrono::steady_clock::duration elapsed{0};
+  size_t bytes = EchoBackToBack(2000, &elapsed);
+  float elapsed_us = std::chrono::duration<float, std::micro>(elapsed).count();
+  EXPECT_GT(static_cast<float>(bytes) / elapsed_us, MinBytesPerMicrosecond);
+}
 }  // namespace Debug
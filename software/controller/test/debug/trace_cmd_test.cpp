@@ -22,17 +22,22 @@ limitations under the License.
 namespace Debug::Command {
 
 static constexpr size_t kResponseSize{100};
-// helper function that checks the buffer output
+// helper function that decodes the samples of a download response, and checks
+// that they are the expected ones
 void CheckBufferOutput(std::array<uint8_t, kResponseSize> response, uint32_t response_length,
-                       size_t sample_size, uint32_t initial_value) {
-  for (int i = 0; i < response_length / sample_size; ++i) {
-    uint8_t expected_value[sample_size];
-    u32_to_u8(static_cast<uint32_t>(i + initial_value), &expected_value[0]);
-    u32_to_u8(static_cast<uint32_t>(10 * (i + initial_value)), &expected_value[4]);
-    // if you add variables, you'll need to assign expected_value[8] and so on
-    for (int j = 0; j < sample_size; ++j) {
-      EXPECT_EQ(response[i * sample_size + j], expected_value[j]);
-    }
+                       size_t num_vars, uint32_t initial_value, uint32_t *num_samples) {
+  std::array<uint32_t, Trace::MaxVars> reference = {0};
+  std::array<uint32_t, Trace::MaxVars> sample;
+  *num_samples = 0;
+  for (size_t offset = 0; offset < response_length; ++*num_samples) {
+    size_t length = TraceCodec::decode_sample(&response[offset], response_length - offset,
+                                              reference.data(), num_vars, sample.data());
+    ASSERT_GT(length, 0);
+    offset += length;
+    EXPECT_EQ(sample[0], *num_samples + initial_value);
+    EXPECT_EQ(sample[1], 10 * (*num_samples + initial_value));
+    // if you add variables, you'll need to check sample[2] and so on
+    reference = sample;
   }
 }
 
@@ -152,10 +157,10 @@ TEST(TraceHandler, Read) {
   EXPECT_EQ(read_context.response_length, 0);
 
   // fill the buffer to a bigger size than the max response length
-  // note we are sampling 2 variables that are 4 bytes each
+  // note we are sampling 2 variables that change little, so that they take a
+  // byte each
   uint32_t num_vars = trace.active_variable_count();
-  size_t sample_size = num_vars * sizeof(uint32_t);
-  for (i = 0; i < kResponseSize / sample_size + kExtraSamples; ++i) {
+  for (i = 0; i < kResponseSize / num_vars + kExtraSamples; ++i) {
     trace.maybe_sample();
   }
 
@@ -175,20 +180,22 @@ TEST(TraceHandler, Read) {
 
   // issue a new read command
   EXPECT_EQ(ErrorCode::None, trace_handler.Process(&read_context));
-  // we are only returning entire samples
-  EXPECT_EQ(read_context.response_length, kResponseSize - kResponseSize % sample_size);
-  size_t read_samples = read_context.response_length / sample_size;
+  // we are only returning entire samples, as long as the worst case fits
+  EXPECT_LE(read_context.response_length, kResponseSize);
+  EXPECT_GT(read_context.response_length, kResponseSize - num_vars * TraceCodec::MaxValueSize);
   // check response
-  CheckBufferOutput(response, read_context.response_length, sample_size, 0);
+  uint32_t read_samples;
+  CheckBufferOutput(response, read_context.response_length, num_vars, 0, &read_samples);
 
   // reset response pointer and response_length before issuing a new read
   read_context.response = response.data();
   read_context.response_length = 0;
   EXPECT_EQ(ErrorCode::None, trace_handler.Process(&read_context));
-  EXPECT_EQ(read_context.response_length, kExtraSamples * sample_size);
   // check response
-  CheckBufferOutput(response, read_context.response_length, sample_size,
-                    static_cast<uint32_t>(read_samples));
+  uint32_t more_samples;
+  CheckBufferOutput(response, read_context.response_length, num_vars, read_samples,
+                    &more_samples);
+  EXPECT_EQ(read_samples + more_samples, i);
 
   // expect trace to still be running but with no samples in buffer
   EXPECT_TRUE(trace.running());
@@ -301,6 +308,136 @@ TEST(TraceHandler, SettersAndGetters) {
   EXPECT_EQ(get_period_context.response_length, 4);
 
   EXPECT_EQ(trace.period(), u8_to_u32(get_period_context.response));
+
+  // Set resolution for var 1
+  float resolution{0.25f};
+  uint32_t raw_resolution;
+  std::memcpy(&raw_resolution, &resolution, sizeof(raw_resolution));
+  std::array<uint8_t, 6> set_resolution_command = {
+      static_cast<uint8_t>(TraceHandler::Subcommand::SetResolution), 1};
+  u32_to_u8(raw_resolution, &set_resolution_command[2]);
+  processed = false;
+  Context set_resolution_context = {.request = set_resolution_command.data(),
+                                    .request_length = std::size(set_resolution_command),
+                                    .response = response.data(),
+                                    .max_response_length = kResponseSize,
+                                    .response_length = 0,
+                                    .processed = &processed};
+  EXPECT_EQ(ErrorCode::None, trace_handler.Process(&set_resolution_context));
+  EXPECT_TRUE(processed);
+  EXPECT_EQ(set_resolution_context.response_length, 0);
+  EXPECT_EQ(trace.resolution(1), resolution);
+
+  // Get resolution for var 1
+  std::array<uint8_t, 2> get_resolution_command = {
+      static_cast<uint8_t>(TraceHandler::Subcommand::GetResolution), 1};
+  processed = false;
+  Context get_resolution_context = {.request = get_resolution_command.data(),
+                                    .request_length = std::size(get_resolution_command),
+                                    .response = response.data(),
+                                    .max_response_length = kResponseSize,
+                                    .response_length = 0,
+                                    .processed = &processed};
+  EXPECT_EQ(ErrorCode::None, trace_handler.Process(&get_resolution_context));
+  EXPECT_TRUE(processed);
+  EXPECT_EQ(get_resolution_context.response_length, 4);
+  EXPECT_EQ(raw_resolution, u8_to_u32(response.data()));
+
+  // Set trigger on var x
+  std::array<uint8_t, 8> set_trigger_command = {
+      static_cast<uint8_t>(TraceHandler::Subcommand::SetTrigger), 0, 0,
+      static_cast<uint8_t>(Trigger::Condition::Rising)};
+  u16_to_u8(var_x.id(), &set_trigger_command[1]);
+  u32_to_u8(1234, &set_trigger_command[4]);
+  processed = false;
+  Context set_trigger_context = {.request = set_trigger_command.data(),
+                                 .request_length = std::size(set_trigger_command),
+                                 .response = response.data(),
+                                 .max_response_length = kResponseSize,
+                                 .response_length = 0,
+                                 .processed = &processed};
+  EXPECT_EQ(ErrorCode::None, trace_handler.Process(&set_trigger_context));
+  EXPECT_TRUE(processed);
+  EXPECT_EQ(set_trigger_context.response_length, 0);
+  EXPECT_EQ(var_x.id(), trace.trigger().variable_id());
+  EXPECT_EQ(Trigger::Condition::Rising, trace.trigger().condition());
+  EXPECT_EQ(1234, trace.trigger().level());
+
+  // Get trigger
+  std::array<uint8_t, 1> get_trigger_command = {
+      static_cast<uint8_t>(TraceHandler::Subcommand::GetTrigger)};
+  processed = false;
+  Context get_trigger_context = {.request = get_trigger_command.data(),
+                                 .request_length = std::size(get_trigger_command),
+                                 .response = response.data(),
+                                 .max_response_length = kResponseSize,
+                                 .response_length = 0,
+                                 .processed = &processed};
+  EXPECT_EQ(ErrorCode::None, trace_handler.Process(&get_trigger_context));
+  EXPECT_TRUE(processed);
+  EXPECT_EQ(get_trigger_context.response_length, 7);
+  EXPECT_EQ(var_x.id(), u8_to_u16(response.data()));
+  EXPECT_EQ(static_cast<uint8_t>(Trigger::Condition::Rising), response[2]);
+  EXPECT_EQ(1234, u8_to_u32(&response[3]));
+
+  // Set trigger position
+  float fraction{0.1f};
+  uint32_t raw_fraction;
+  std::memcpy(&raw_fraction, &fraction, sizeof(raw_fraction));
+  std::array<uint8_t, 9> set_position_command = {
+      static_cast<uint8_t>(TraceHandler::Subcommand::SetTriggerPosition)};
+  u32_to_u8(raw_fraction, &set_position_command[1]);
+  u32_to_u8(100, &set_position_command[5]);
+  processed = false;
+  Context set_position_context = {.request = set_position_command.data(),
+                                  .request_length = std::size(set_position_command),
+                                  .response = response.data(),
+                                  .max_response_length = kResponseSize,
+                                  .response_length = 0,
+                                  .processed = &processed};
+  EXPECT_EQ(ErrorCode::None, trace_handler.Process(&set_position_context));
+  EXPECT_TRUE(processed);
+  EXPECT_EQ(set_position_context.response_length, 0);
+  EXPECT_EQ(fraction, trace.pre_trigger_fraction());
+  EXPECT_EQ(100, trace.post_trigger_samples());
+
+  // Get trigger position
+  std::array<uint8_t, 1> get_position_command = {
+      static_cast<uint8_t>(TraceHandler::Subcommand::GetTriggerPosition)};
+  processed = false;
+  Context get_position_context = {.request = get_position_command.data(),
+                                  .request_length = std::size(get_position_command),
+                                  .response = response.data(),
+                                  .max_response_length = kResponseSize,
+                                  .response_length = 0,
+                                  .processed = &processed};
+  EXPECT_EQ(ErrorCode::None, trace_handler.Process(&get_position_context));
+  EXPECT_TRUE(processed);
+  EXPECT_EQ(get_position_context.response_length, 8);
+  EXPECT_EQ(raw_fraction, u8_to_u32(response.data()));
+  EXPECT_EQ(100, u8_to_u32(&response[4]));
+
+  // Get trigger status, once triggered
+  trace.set_period(1);
+  trace.start();
+  var_x.set(1000);
+  trace.maybe_sample();
+  var_x.set(2000);
+  trace.maybe_sample();
+  std::array<uint8_t, 1> get_status_command = {
+      static_cast<uint8_t>(TraceHandler::Subcommand::GetTriggerStatus)};
+  processed = false;
+  Context get_status_context = {.request = get_status_command.data(),
+                                .request_length = std::size(get_status_command),
+                                .response = response.data(),
+                                .max_response_length = kResponseSize,
+                                .response_length = 0,
+                                .processed = &processed};
+  EXPECT_EQ(ErrorCode::None, trace_handler.Process(&get_status_context));
+  EXPECT_TRUE(processed);
+  EXPECT_EQ(get_status_context.response_length, 5);
+  EXPECT_EQ(static_cast<uint8_t>(Trace::TriggerState::Triggered), response[0]);
+  EXPECT_EQ(1, u8_to_u32(&response[1]));
 }
 
 TEST(TraceHandler, Errors) {
@@ -317,18 +454,42 @@ TEST(TraceHandler, Errors) {
   trace.start();
 
   std::vector<std::tuple<std::vector<uint8_t>, ErrorCode>> requests = {
-      {{}, ErrorCode::MissingData},   // Missing subcommand
-      {{9}, ErrorCode::InvalidData},  // Invalid subcommand
+      {{}, ErrorCode::MissingData},    // Missing subcommand
+      {{17}, ErrorCode::InvalidData},  // Invalid subcommand
       {{static_cast<uint8_t>(TraceHandler::Subcommand::Download)}, ErrorCode::NoMemory},
       {{static_cast<uint8_t>(TraceHandler::Subcommand::SetVarId), 1, 1}, ErrorCode::MissingData},
-      //      {{static_cast<uint8_t>(TraceHandler::Subcommand::SetVarId), Trace::MaxVars, 1, 0},
-      //       ErrorCode::InvalidData}, // no longer the expected behavior?
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::SetVarId), Trace::MaxVars, 1, 0},
+       ErrorCode::InvalidData},
       {{static_cast<uint8_t>(TraceHandler::Subcommand::GetVarId)}, ErrorCode::MissingData},
       {{static_cast<uint8_t>(TraceHandler::Subcommand::GetVarId), 1}, ErrorCode::NoMemory},
       {{static_cast<uint8_t>(TraceHandler::Subcommand::SetPeriod), 1, 1, 1},
        ErrorCode::MissingData},
       {{static_cast<uint8_t>(TraceHandler::Subcommand::GetPeriod)}, ErrorCode::NoMemory},
       {{static_cast<uint8_t>(TraceHandler::Subcommand::CountSamples)}, ErrorCode::NoMemory},
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::GetResolution)}, ErrorCode::MissingData},
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::GetResolution), 1}, ErrorCode::NoMemory},
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::SetResolution), 1, 0, 0, 0},
+       ErrorCode::MissingData},
+      // Negative resolution
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::SetResolution), 1, 0, 0, 0x80, 0xBF},
+       ErrorCode::InvalidData},
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::SetResolution), Trace::MaxVars, 0, 0, 0,
+        0},
+       ErrorCode::InvalidData},
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::SetTrigger), 0, 0, 1, 0, 0, 0},
+       ErrorCode::MissingData},
+      // Unknown variable
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::SetTrigger), 0xFE, 0xFF, 1, 0, 0, 0, 0},
+       ErrorCode::InvalidData},
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::GetTrigger)}, ErrorCode::NoMemory},
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::SetTriggerPosition), 0, 0, 0, 0, 0, 0, 0},
+       ErrorCode::MissingData},
+      // Pre-trigger fraction greater than 1
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::SetTriggerPosition), 0, 0, 0, 0x40, 0, 0, 0,
+        0},
+       ErrorCode::InvalidData},
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::GetTriggerPosition)}, ErrorCode::NoMemory},
+      {{static_cast<uint8_t>(TraceHandler::Subcommand::GetTriggerStatus)}, ErrorCode::NoMemory},
   };
   std::array<uint8_t, kResponseSize> response;
   bool processed{false};
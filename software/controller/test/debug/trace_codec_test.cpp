@@ -0,0 +1,139 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "trace_codec.h"
+
+#include <stdint.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace Debug::TraceCodec;
+
+TEST(TraceCodec, ZigZag) {
+  EXPECT_EQ(0u, zigzag_encode(0));
+  EXPECT_EQ(1u, zigzag_encode(-1));
+  EXPECT_EQ(2u, zigzag_encode(1));
+  EXPECT_EQ(3u, zigzag_encode(-2));
+  EXPECT_EQ(0xFFFFFFFEu, zigzag_encode(INT32_MAX));
+  EXPECT_EQ(0xFFFFFFFFu, zigzag_encode(INT32_MIN));
+
+  for (int32_t value : {0, 1, -1, 63, -64, 64, 1000000, -1000000, INT32_MAX, INT32_MIN}) {
+    SCOPED_TRACE("value " + std::to_string(value));
+    EXPECT_EQ(value, zigzag_decode(zigzag_encode(value)));
+  }
+}
+
+TEST(TraceCodec, Varint) {
+  struct {
+    uint32_t value;
+    size_t size;
+  } cases[] = {
+      {0, 1},           {0x7F, 1},       {0x80, 2},       {0x3FFF, 2},       {0x4000, 3},
+      {0x1FFFFF, 3},    {0x200000, 4},   {0xFFFFFFF, 4},  {0x10000000, 5},   {0xFFFFFFFF, 5},
+  };
+  for (const auto &c : cases) {
+    SCOPED_TRACE("value " + std::to_string(c.value));
+    uint8_t buffer[MaxValueSize];
+    ASSERT_EQ(c.size, write_varint(c.value, buffer));
+    uint32_t value{0};
+    EXPECT_EQ(c.size, read_varint(buffer, c.size, &value));
+    EXPECT_EQ(c.value, value);
+    // Truncated
+    EXPECT_EQ(0u, read_varint(buffer, c.size - 1, &value));
+  }
+
+  // Longer than MaxValueSize
+  uint8_t too_long[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x00};
+  uint32_t value;
+  EXPECT_EQ(0u, read_varint(too_long, sizeof(too_long), &value));
+}
+
+TEST(TraceCodec, SampleRoundTrip) {
+  static constexpr size_t Count{16};
+  srand(0);
+  std::vector<std::vector<uint32_t>> samples = {
+      std::vector<uint32_t>(Count, 0),
+      std::vector<uint32_t>(Count, 0xFFFFFFFF),
+      std::vector<uint32_t>(Count, 0x80000000),
+      std::vector<uint32_t>(Count, 0),
+  };
+  for (int i = 0; i < 1000; ++i) {
+    std::vector<uint32_t> sample(Count);
+    for (size_t j = 0; j < Count; ++j) {
+      // Mostly small steps from the previous sample, sometimes random values.
+      uint32_t step = static_cast<uint32_t>((rand() % 201) - 100);
+      sample[j] = (rand() % 10) ? samples.back()[j] + step : static_cast<uint32_t>(rand());
+    }
+    samples.push_back(sample);
+  }
+
+  // Encode everything in a single stream.
+  std::vector<uint8_t> stream(samples.size() * Count * MaxValueSize);
+  std::vector<uint32_t> reference(Count, 0);
+  size_t length = 0;
+  for (const auto &sample : samples) {
+    size_t size = encode_sample(sample.data(), reference.data(), Count, &stream[length]);
+    EXPECT_GE(size, Count);
+    EXPECT_LE(size, Count * MaxValueSize);
+    length += size;
+    reference = sample;
+  }
+  // Small steps take 1 or 2 bytes, which makes up for the random values.
+  EXPECT_LT(length, samples.size() * Count * 2);
+
+  std::fill(reference.begin(), reference.end(), 0);
+  size_t offset = 0;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    SCOPED_TRACE("sample " + std::to_string(i));
+    std::vector<uint32_t> sample(Count);
+    size_t size =
+        decode_sample(&stream[offset], length - offset, reference.data(), Count, sample.data());
+    ASSERT_GT(size, 0u);
+    EXPECT_EQ(samples[i], sample);
+    offset += size;
+    reference = sample;
+  }
+  EXPECT_EQ(length, offset);
+}
+
+TEST(TraceCodec, IncompleteSample) {
+  uint32_t values[] = {1000, 2000, 3000};
+  uint32_t reference[] = {0, 0, 0};
+  uint8_t encoded[3 * MaxValueSize];
+  size_t length = encode_sample(values, reference, 3, encoded);
+
+  uint32_t decoded[3];
+  for (size_t truncated = 0; truncated < length; ++truncated) {
+    SCOPED_TRACE("length " + std::to_string(truncated));
+    EXPECT_EQ(0u, decode_sample(encoded, truncated, reference, 3, decoded));
+  }
+  EXPECT_EQ(length, decode_sample(encoded, length, reference, 3, decoded));
+}
+
+TEST(TraceCodec, Quantize) {
+  EXPECT_EQ(0, quantize(0, 0.1f));
+  EXPECT_EQ(123, quantize(12.3f, 0.1f));
+  EXPECT_EQ(-123, quantize(-12.3f, 0.1f));
+  EXPECT_EQ(3, quantize(0.74f, 0.25f));
+  EXPECT_EQ(INT32_MAX, quantize(1e30f, 0.01f));
+  EXPECT_EQ(INT32_MIN, quantize(-1e30f, 0.01f));
+  EXPECT_EQ(INT32_MAX, quantize(std::numeric_limits<float>::infinity(), 1));
+  EXPECT_EQ(0, quantize(std::numeric_limits<float>::quiet_NaN(), 1));
+}
@@ -17,8 +17,13 @@ limitations under the License.
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <vector>
 
 #include "gmock/gmock-matchers.h"
 #include "gtest/gtest.h"
@@ -58,7 +63,7 @@ TEST(Trace, MaybeSampleTwoVars) {
     EXPECT_EQ(expected_num_samples, trace.sample_count());
   }
 
-  std::array<uint32_t, 4> record = {0};
+  std::array<uint32_t, Trace::MaxVars> record = {0};
   size_t count;
 
   // Extract a few records
@@ -66,7 +71,8 @@ TEST(Trace, MaybeSampleTwoVars) {
     EXPECT_EQ(expected_num_samples, trace.sample_count());
     EXPECT_TRUE(trace.get_next_record(&record, &count));
     EXPECT_EQ(2, count);
-    EXPECT_THAT(record, testing::ElementsAre(j, 10 * j, 0, 0));
+    EXPECT_EQ(j, record[0]);
+    EXPECT_EQ(10 * j, record[1]);
   }
 
   // Simulate the high-priority thread running a few times while the trace is
@@ -82,7 +88,8 @@ TEST(Trace, MaybeSampleTwoVars) {
     EXPECT_EQ(expected_num_samples, trace.sample_count());
     EXPECT_TRUE(trace.get_next_record(&record, &count));
     EXPECT_EQ(2, count);
-    EXPECT_THAT(record, testing::ElementsAre(j, 10 * j, 0, 0));
+    EXPECT_EQ(j, record[0]);
+    EXPECT_EQ(10 * j, record[1]);
   }
 
   EXPECT_EQ(0, trace.sample_count());
@@ -110,8 +117,9 @@ TEST(Trace, BufferFull) {
   trace.set_traced_variable(0, var_x.id());
   trace.start();
 
-  // Buffer capacity from trace.h header file. Update if necessary.
-  int expected_capacity = 0x4000;
+  // Buffer capacity from trace.h header file (4 bytes per word), as samples of a variable which
+  // doesn't change take a single byte. Update if necessary.
+  int expected_capacity = 0x5000 * 4;
   for (int i = 0; i < expected_capacity; ++i) {
     EXPECT_TRUE(trace.running());
     trace.maybe_sample();
@@ -137,6 +145,250 @@ TEST(Trace, BufferFull) {
   EXPECT_EQ(3, trace.sample_count());
 }
 
+TEST(Trace, StreamingDropsSamplesWhenFull) {
+  uint32_t x = 42;
+  Variable::Primitive32 var_x("x", Variable::Access::ReadOnly, &x, "units");
+  Trace trace;
+  trace.set_traced_variable(0, var_x.id());
+  trace.start_streaming();
+  EXPECT_TRUE(trace.streaming());
+
+  int capacity = 0x5000 * 4;
+  for (int i = 0; i < capacity + 5; ++i) {
+    trace.maybe_sample();
+  }
+  // Samples that don't fit are dropped, but streaming goes on.
+  EXPECT_TRUE(trace.streaming());
+  EXPECT_EQ(capacity, trace.sample_count());
+  EXPECT_EQ(5, trace.dropped_samples());
+
+  std::array<uint32_t, Trace::MaxVars> record;
+  size_t count;
+  EXPECT_TRUE(trace.get_next_record(&record, &count));
+  trace.maybe_sample();
+  EXPECT_EQ(capacity, trace.sample_count());
+  EXPECT_EQ(5, trace.dropped_samples());
+
+  // Restarting resets the dropped count, and a regular start ends streaming.
+  trace.start_streaming();
+  EXPECT_EQ(0, trace.sample_count());
+  EXPECT_EQ(0, trace.dropped_samples());
+  trace.start();
+  EXPECT_TRUE(trace.running());
+  EXPECT_FALSE(trace.streaming());
+  trace.start_streaming();
+  trace.stop();
+  EXPECT_FALSE(trace.streaming());
+}
+
+TEST(Trace, MaxVars) {
+  std::vector<std::unique_ptr<Variable::UInt32>> vars;
+  Trace trace;
+  for (uint8_t i = 0; i < Trace::MaxVars; ++i) {
+    vars.push_back(std::make_unique<Variable::UInt32>("x", Variable::Access::ReadOnly, 0, "unit"));
+    EXPECT_TRUE(trace.set_traced_variable(i, vars.back()->id()));
+  }
+  EXPECT_EQ(Trace::MaxVars, trace.active_variable_count());
+  EXPECT_FALSE(trace.set_traced_variable(Trace::MaxVars, vars[0]->id()));
+
+  trace.start();
+  for (uint32_t sample = 0; sample < 100; ++sample) {
+    for (uint8_t i = 0; i < Trace::MaxVars; ++i) vars[i]->set(sample * sample + i);
+    trace.maybe_sample();
+  }
+
+  std::array<uint32_t, Trace::MaxVars> record;
+  size_t count;
+  for (uint32_t sample = 0; sample < 100; ++sample) {
+    ASSERT_TRUE(trace.get_next_record(&record, &count));
+    ASSERT_EQ(Trace::MaxVars, count);
+    for (uint8_t i = 0; i < Trace::MaxVars; ++i) EXPECT_EQ(sample * sample + i, record[i]);
+  }
+  EXPECT_FALSE(trace.get_next_record(&record, &count));
+}
+
+TEST(Trace, FloatResolution) {
+  float pressure = 0;
+  Variable::Primitive32 var_pressure("pressure", Variable::Access::ReadOnly, &pressure, "cmH2O");
+  float flow = 0;
+  Variable::Primitive32 var_flow("flow", Variable::Access::ReadOnly, &flow, "ml/s");
+  Trace trace;
+  trace.set_traced_variable(0, var_pressure.id());
+  trace.set_traced_variable(1, var_flow.id());
+  EXPECT_FALSE(trace.set_resolution(0, -1));
+  EXPECT_FALSE(trace.set_resolution(0, std::numeric_limits<float>::infinity()));
+  EXPECT_FALSE(trace.set_resolution(Trace::MaxVars, 1));
+  EXPECT_TRUE(trace.set_resolution(0, 0.01f));
+  EXPECT_EQ(0.01f, trace.resolution(0));
+  EXPECT_EQ(0, trace.resolution(1));
+
+  trace.start();
+  std::vector<float> values = {0, 12.345f, -3.21f, 1e12f, -0.004f};
+  for (float value : values) {
+    pressure = value;
+    flow = value;
+    trace.maybe_sample();
+  }
+
+  std::array<uint32_t, Trace::MaxVars> record;
+  size_t count;
+  for (float value : values) {
+    SCOPED_TRACE("value " + std::to_string(value));
+    ASSERT_TRUE(trace.get_next_record(&record, &count));
+    ASSERT_EQ(2, count);
+    // Pressure is traced as a multiple of its resolution, flow is exact.
+    EXPECT_EQ(static_cast<uint32_t>(TraceCodec::quantize(value, 0.01f)), record[0]);
+    float traced_flow;
+    std::memcpy(&traced_flow, &record[1], sizeof(traced_flow));
+    EXPECT_EQ(value, traced_flow);
+  }
+
+  // Selecting another variable resets the resolution.
+  trace.set_traced_variable(0, var_flow.id());
+  EXPECT_EQ(0, trace.resolution(0));
+}
+
+// The whole point of encoding samples is to fit more of them in the buffer.
+TEST(Trace, Capacity) {
+  static constexpr float Pi{3.14159265f};
+  uint32_t cycle = 0;
+  float pressure = 0, flow = 0, volume = 0;
+  int32_t state = 0;
+  Variable::UInt32 var_cycle("cycle", Variable::Access::ReadOnly, 0, "");
+  Variable::Primitive32 var_pressure("pressure", Variable::Access::ReadOnly, &pressure, "cmH2O");
+  Variable::Primitive32 var_flow("flow", Variable::Access::ReadOnly, &flow, "ml/s");
+  Variable::Primitive32 var_volume("volume", Variable::Access::ReadOnly, &volume, "ml");
+  Variable::Primitive32 var_state("state", Variable::Access::ReadOnly, &state, "");
+  Trace trace;
+  trace.set_traced_variable(0, var_cycle.id());
+  trace.set_traced_variable(1, var_pressure.id());
+  trace.set_traced_variable(2, var_flow.id());
+  trace.set_traced_variable(3, var_volume.id());
+  trace.set_traced_variable(4, var_state.id());
+  trace.set_resolution(1, 0.01f);
+  trace.set_resolution(2, 0.1f);
+  trace.set_resolution(3, 0.1f);
+
+  // Breaths of 3s, traced at 100Hz.
+  trace.start();
+  for (cycle = 0; trace.running(); ++cycle) {
+    float phase = 2 * Pi * static_cast<float>(cycle % 300) / 300.0f;
+    pressure = 15 + 10 * std::sin(phase);
+    flow = 500 * std::cos(phase);
+    volume = 250 + 250 * std::sin(phase);
+    state = phase < Pi ? 1 : 0;
+    var_cycle.set(cycle);
+    trace.maybe_sample();
+  }
+
+  // Stored as words, these 5 variables would only fit BufferSize / 5 samples.
+  EXPECT_GT(trace.sample_count(), 3 * Trace::BufferSize / 5);
+}
+
+TEST(Trace, Trigger) {
+  uint32_t x = 0;
+  Variable::Primitive32 var_x("x", Variable::Access::ReadOnly, &x, "units");
+  Trace trace;
+  trace.set_traced_variable(0, var_x.id());
+  EXPECT_TRUE(trace.set_trigger(var_x.id(), Trigger::Condition::Rising, 100000));
+  EXPECT_TRUE(trace.set_trigger_position(0.25f, 1000));
+  trace.start();
+  EXPECT_EQ(Trace::TriggerState::Armed, trace.trigger_state());
+
+  // Samples of x take a single byte, so a quarter of the buffer holds this many of them.
+  static constexpr size_t PreTriggerCapacity{Trace::BufferSize};
+  for (; x < 100000; ++x) {
+    trace.maybe_sample();
+    ASSERT_TRUE(trace.running());
+    ASSERT_EQ(std::min<size_t>(x + 1, PreTriggerCapacity), trace.sample_count());
+  }
+  EXPECT_EQ(Trace::TriggerState::Armed, trace.trigger_state());
+
+  trace.maybe_sample();
+  EXPECT_EQ(Trace::TriggerState::Triggered, trace.trigger_state());
+  EXPECT_EQ(PreTriggerCapacity - 1, trace.trigger_sample_index());
+
+  // Trace stops after the post-trigger samples.
+  for (++x; x <= 101000; ++x) {
+    EXPECT_TRUE(trace.running());
+    trace.maybe_sample();
+  }
+  EXPECT_FALSE(trace.running());
+  trace.maybe_sample();
+  EXPECT_EQ(PreTriggerCapacity + 1000, trace.sample_count());
+
+  std::array<uint32_t, Trace::MaxVars> record;
+  size_t count;
+  for (uint32_t i = 0; i < PreTriggerCapacity + 1000; ++i) {
+    ASSERT_TRUE(trace.get_next_record(&record, &count));
+    ASSERT_EQ(100000 - (PreTriggerCapacity - 1) + i, record[0]);
+  }
+  EXPECT_FALSE(trace.get_next_record(&record, &count));
+}
+
+TEST(Trace, TriggerTakesEffectOnStart) {
+  uint32_t x = 0;
+  Variable::Primitive32 var_x("x", Variable::Access::ReadOnly, &x, "units");
+  Trace trace;
+  trace.set_traced_variable(0, var_x.id());
+  EXPECT_TRUE(trace.set_trigger(var_x.id(), Trigger::Condition::Above, 10));
+  trace.start();
+
+  // The running trace keeps the trigger it was started with.
+  EXPECT_TRUE(trace.set_trigger(var_x.id(), Trigger::Condition::Above, 100));
+  EXPECT_EQ(100, trace.trigger().level());
+  x = 50;
+  trace.maybe_sample();
+  EXPECT_EQ(Trace::TriggerState::Triggered, trace.trigger_state());
+
+  trace.start();
+  EXPECT_EQ(Trace::TriggerState::Armed, trace.trigger_state());
+  trace.maybe_sample();
+  EXPECT_EQ(Trace::TriggerState::Armed, trace.trigger_state());
+  x = 150;
+  trace.maybe_sample();
+  EXPECT_EQ(Trace::TriggerState::Triggered, trace.trigger_state());
+}
+
+TEST(Trace, TriggerPosition) {
+  uint32_t x = 0;
+  Variable::Primitive32 var_x("x", Variable::Access::ReadOnly, &x, "units");
+  Trace trace;
+  trace.set_traced_variable(0, var_x.id());
+  EXPECT_EQ(0.5f, trace.pre_trigger_fraction());
+  EXPECT_EQ(0, trace.post_trigger_samples());
+  EXPECT_FALSE(trace.set_trigger_position(-0.1f, 1));
+  EXPECT_FALSE(trace.set_trigger_position(1.1f, 1));
+  EXPECT_FALSE(trace.set_trigger_position(std::numeric_limits<float>::quiet_NaN(), 1));
+  EXPECT_EQ(0.5f, trace.pre_trigger_fraction());
+  EXPECT_EQ(0, trace.post_trigger_samples());
+
+  // No trigger: trace records from start.
+  trace.start();
+  EXPECT_EQ(Trace::TriggerState::Off, trace.trigger_state());
+
+  // No pre-trigger history (besides the triggering sample), and record until the buffer is full.
+  EXPECT_TRUE(trace.set_trigger_position(0, 0));
+  EXPECT_TRUE(trace.set_trigger(var_x.id(), Trigger::Condition::Above, 9));
+  trace.start();
+  for (; x < 10; ++x) {
+    trace.maybe_sample();
+    EXPECT_EQ(1, trace.sample_count());
+  }
+  trace.maybe_sample();
+  EXPECT_EQ(Trace::TriggerState::Triggered, trace.trigger_state());
+  EXPECT_EQ(0, trace.trigger_sample_index());
+  while (trace.running()) {
+    ++x;
+    trace.maybe_sample();
+  }
+  EXPECT_EQ(Trace::BufferSize * sizeof(uint32_t), trace.sample_count());
+
+  // The trigger is ignored when streaming.
+  trace.start_streaming();
+  EXPECT_EQ(Trace::TriggerState::Off, trace.trigger_state());
+}
+
 TEST(Trace, FlushOnSetVar) {
   uint32_t x = 42, y = 37;
   Variable::Primitive32 var_x("x", Variable::Access::ReadOnly, &x, "units");
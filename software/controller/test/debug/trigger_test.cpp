@@ -0,0 +1,123 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "trigger.h"
+
+#include <stdint.h>
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace Debug;
+using Condition = Trigger::Condition;
+
+namespace {
+uint32_t raw(float value) {
+  uint32_t result;
+  std::memcpy(&result, &value, sizeof(result));
+  return result;
+}
+
+// Feeds values to the trigger through *var, returns the check results.
+template <typename T>
+std::vector<bool> Check(Trigger *trigger, T *var, const std::vector<T> &values) {
+  std::vector<bool> results;
+  for (T value : values) {
+    *var = value;
+    results.push_back(trigger->check());
+  }
+  return results;
+}
+}  // namespace
+
+TEST(Trigger, Set) {
+  int32_t state = 0;
+  Variable::Primitive32 var_state("trigger_state", Variable::Access::ReadOnly, &state, "");
+  Variable::FloatArray<3> fa3("trigger_fa3", Variable::Access::ReadWrite, "units");
+
+  Trigger trigger;
+  EXPECT_FALSE(trigger.enabled());
+  EXPECT_FALSE(trigger.check());
+  EXPECT_EQ(Variable::InvalidID, trigger.variable_id());
+
+  EXPECT_TRUE(trigger.set(var_state.id(), Condition::Above, 3));
+  EXPECT_TRUE(trigger.enabled());
+  EXPECT_EQ(var_state.id(), trigger.variable_id());
+  EXPECT_EQ(Condition::Above, trigger.condition());
+  EXPECT_EQ(3u, trigger.level());
+
+  // Failures leave the trigger unchanged.
+  EXPECT_FALSE(trigger.set(666, Condition::Below, 1));
+  EXPECT_FALSE(trigger.set(fa3.id(), Condition::Below, 1));
+  EXPECT_FALSE(trigger.set(var_state.id(), static_cast<Condition>(6), 1));
+  EXPECT_EQ(var_state.id(), trigger.variable_id());
+  EXPECT_EQ(Condition::Above, trigger.condition());
+  EXPECT_EQ(3u, trigger.level());
+
+  EXPECT_TRUE(trigger.set(Variable::InvalidID, Condition::None, 0));
+  EXPECT_FALSE(trigger.enabled());
+  EXPECT_EQ(Variable::InvalidID, trigger.variable_id());
+  state = 100;
+  EXPECT_FALSE(trigger.check());
+}
+
+TEST(Trigger, Conditions) {
+  int32_t state = 0;
+  Variable::Primitive32 var_state("trigger_int", Variable::Access::ReadOnly, &state, "");
+  uint32_t breath_id = 0;
+  Variable::Primitive32 var_breath("trigger_uint", Variable::Access::ReadOnly, &breath_id, "");
+  float pressure = 0;
+  Variable::Primitive32 var_pressure("trigger_float", Variable::Access::ReadOnly, &pressure, "");
+  Trigger trigger;
+
+  // Levels are compared in the variable's type.
+  ASSERT_TRUE(trigger.set(var_state.id(), Condition::Above, static_cast<uint32_t>(-2)));
+  EXPECT_EQ(std::vector<bool>({false, false, true, false}),
+            Check<int32_t>(&trigger, &state, {-5, -2, -1, -3}));
+  ASSERT_TRUE(trigger.set(var_breath.id(), Condition::Below, 0x80000000));
+  EXPECT_EQ(std::vector<bool>({false, true, false}),
+            Check<uint32_t>(&trigger, &breath_id, {0xFFFFFFFF, 1, 0x80000000}));
+  ASSERT_TRUE(trigger.set(var_pressure.id(), Condition::Above, raw(-1.5f)));
+  EXPECT_EQ(std::vector<bool>({false, true, false}),
+            Check<float>(&trigger, &pressure, {-2.0f, 0.5f, -1.5f}));
+
+  // Edges need to see the value on both sides of the level, the first check after (re)setting the
+  // trigger only records the value.
+  ASSERT_TRUE(trigger.set(var_pressure.id(), Condition::Rising, raw(30.0f)));
+  EXPECT_EQ(std::vector<bool>({false, false, true, false, false, false, true}),
+            Check<float>(&trigger, &pressure, {35, 20, 30, 40, 25, 29.9f, 31}));
+  ASSERT_TRUE(trigger.set(var_state.id(), Condition::Falling, 2));
+  EXPECT_EQ(std::vector<bool>({false, true, false, true, false}),
+            Check<int32_t>(&trigger, &state, {3, -1, 5, 2, 1}));
+  EXPECT_EQ(std::vector<bool>({false, true}), Check<int32_t>(&trigger, &state, {3, 1}));
+  trigger.reset();
+  EXPECT_EQ(std::vector<bool>({false}), Check<int32_t>(&trigger, &state, {1}));
+
+  // Change ignores the level.
+  ASSERT_TRUE(trigger.set(var_breath.id(), Condition::Change, 7));
+  EXPECT_EQ(std::vector<bool>({false, false, true, false, true}),
+            Check<uint32_t>(&trigger, &breath_id, {7, 7, 8, 8, 7}));
+
+  // NaN never meets a threshold.
+  static constexpr float NaN{std::numeric_limits<float>::quiet_NaN()};
+  ASSERT_TRUE(trigger.set(var_pressure.id(), Condition::Rising, raw(30.0f)));
+  EXPECT_EQ(std::vector<bool>({false, false, false}),
+            Check<float>(&trigger, &pressure, {20, NaN, 40}));
+  ASSERT_TRUE(trigger.set(var_pressure.id(), Condition::Below, raw(30.0f)));
+  EXPECT_EQ(std::vector<bool>({false}), Check<float>(&trigger, &pressure, {NaN}));
+}
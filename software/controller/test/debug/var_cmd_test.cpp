@@ -16,6 +16,9 @@ limitations under the License.
 #include <stdint.h>
 
 #include <array>
+#include <cstring>
+#include <string>
+#include <vector>
 
 #include "commands.h"
 #include "gtest/gtest.h"
@@ -162,6 +165,168 @@ TEST(VarHandler, GetVarCount) {
   EXPECT_EQ(response, expected_result);
 }
 
+void float_to_u8(float value, uint8_t *buffer) {
+  uint32_t raw;
+  std::memcpy(&raw, &value, sizeof(raw));
+  u32_to_u8(raw, buffer);
+}
+
+// Calls the handler with the given request, returns the response.
+std::vector<uint8_t> Process(const std::vector<uint8_t> &request, size_t max_response_length) {
+  std::vector<uint8_t> response(max_response_length);
+  bool processed{false};
+  Context context = {.request = request.data(),
+                     .request_length = static_cast<uint32_t>(request.size()),
+                     .response = response.data(),
+                     .max_response_length = static_cast<uint32_t>(response.size()),
+                     .response_length = 0,
+                     .processed = &processed};
+  EXPECT_EQ(ErrorCode::None, VarHandler().Process(&context));
+  EXPECT_TRUE(processed);
+  response.resize(context.response_length);
+  return response;
+}
+
+TEST(VarHandler, GetMultipleVars) {
+  uint32_t a = 0xDEADBEEF;
+  Debug::Variable::Primitive32 var_a("a", Debug::Variable::Access::ReadOnly, &a, "units");
+  Debug::Variable::FloatArray<3> var_b("b", Debug::Variable::Access::ReadOnly, {1, 2, 3}, "units");
+  int32_t c = -2;
+  Debug::Variable::Primitive32 var_c("c", Debug::Variable::Access::ReadOnly, &c, "units");
+
+  // Values are packed in list order, after the index where the list ends.
+  std::vector<uint8_t> request = {static_cast<uint8_t>(VarHandler::Subcommand::GetMultiple), 0, 0};
+  for (uint16_t id : {var_c.id(), var_b.id(), var_a.id(), var_c.id()}) {
+    request.push_back(static_cast<uint8_t>(id));
+    request.push_back(static_cast<uint8_t>(id >> 8));
+  }
+  std::vector<uint8_t> expected(2 + 4 + 12 + 4 + 4);
+  u16_to_u8(4, &expected[0]);
+  u32_to_u8(static_cast<uint32_t>(c), &expected[2]);
+  float_to_u8(1, &expected[6]);
+  float_to_u8(2, &expected[10]);
+  float_to_u8(3, &expected[14]);
+  u32_to_u8(a, &expected[18]);
+  u32_to_u8(static_cast<uint32_t>(c), &expected[22]);
+  EXPECT_EQ(expected, Process(request, 100));
+
+  // When the response is too small, the client continues from the returned index.
+  std::vector<uint8_t> response = Process(request, 2 + 4 + 12 + 3);
+  EXPECT_EQ(2, u8_to_u16(response.data()));
+  EXPECT_EQ(std::vector<uint8_t>(expected.begin() + 2, expected.begin() + 18),
+            std::vector<uint8_t>(response.begin() + 2, response.end()));
+  request[1] = 2;
+  response = Process(request, 2 + 4 + 12 + 3);
+  EXPECT_EQ(4, u8_to_u16(response.data()));
+  EXPECT_EQ(std::vector<uint8_t>(expected.begin() + 18, expected.end()),
+            std::vector<uint8_t>(response.begin() + 2, response.end()));
+
+  // An empty list gets all variables from the start index on, in ID order.  Earlier variables
+  // may be gone along with their test, so we start from the ones of this test, which are the last
+  // ones registered.
+  ASSERT_EQ(var_c.id() + 1, Debug::Variable::Registry::singleton().count());
+  request = {static_cast<uint8_t>(VarHandler::Subcommand::GetMultiple),
+             static_cast<uint8_t>(var_a.id()), static_cast<uint8_t>(var_a.id() >> 8)};
+  response = Process(request, 2 + 4 + 12 + 3);
+  EXPECT_EQ(var_c.id(), u8_to_u16(response.data()));
+  EXPECT_EQ(std::vector<uint8_t>(expected.begin() + 18, expected.begin() + 22),
+            std::vector<uint8_t>(response.begin() + 2, response.begin() + 6));
+  EXPECT_EQ(std::vector<uint8_t>(expected.begin() + 6, expected.begin() + 18),
+            std::vector<uint8_t>(response.begin() + 6, response.end()));
+  request[1] = static_cast<uint8_t>(var_c.id());
+  request[2] = static_cast<uint8_t>(var_c.id() >> 8);
+  response = Process(request, 2 + 4 + 12 + 3);
+  EXPECT_EQ(var_c.id() + 1, u8_to_u16(response.data()));
+  EXPECT_EQ(std::vector<uint8_t>(expected.begin() + 2, expected.begin() + 6),
+            std::vector<uint8_t>(response.begin() + 2, response.end()));
+}
+
+// Info of the variable as hand-built from the format given in var_cmd.cpp
+std::vector<uint8_t> Info(const Debug::Variable::Base &var, const std::string &name,
+                          const std::string &format, const std::string &help,
+                          const std::string &unit) {
+  std::vector<uint8_t> info = {static_cast<uint8_t>(var.type()),
+                               static_cast<uint8_t>(var.access()),
+                               static_cast<uint8_t>(var.byte_size()),
+                               0,
+                               static_cast<uint8_t>(name.size()),
+                               static_cast<uint8_t>(format.size()),
+                               static_cast<uint8_t>(help.size()),
+                               static_cast<uint8_t>(unit.size())};
+  for (const std::string *str : {&name, &format, &help, &unit})
+    info.insert(info.end(), str->begin(), str->end());
+  return info;
+}
+
+TEST(VarHandler, GetMultipleVarInfo) {
+  uint32_t value = 0;
+  Debug::Variable::Primitive32 var_a("a", Debug::Variable::Access::ReadOnly, &value, "s", "aa");
+  Debug::Variable::FloatArray<2> var_b("bb", Debug::Variable::Access::ReadWrite, 0.0f, "", "b",
+                                       "%.1f");
+  ASSERT_EQ(var_b.id() + 1, Debug::Variable::Registry::singleton().count());
+
+  std::vector<uint8_t> info_a = Info(var_a, "a", "%u", "aa", "s");
+  std::vector<uint8_t> info_b = Info(var_b, "bb", "%.1f", "b", "");
+
+  // Info of consecutive variables is packed after the ID of the next one.
+  std::vector<uint8_t> request = {static_cast<uint8_t>(VarHandler::Subcommand::GetInfoMultiple),
+                                  static_cast<uint8_t>(var_a.id()),
+                                  static_cast<uint8_t>(var_a.id() >> 8)};
+  std::vector<uint8_t> expected(2);
+  u16_to_u8(var_b.id() + 1, expected.data());
+  expected.insert(expected.end(), info_a.begin(), info_a.end());
+  expected.insert(expected.end(), info_b.begin(), info_b.end());
+  EXPECT_EQ(expected, Process(request, 100));
+
+  // When the response is too small, the client continues from the returned ID.
+  expected.resize(2 + info_a.size());
+  u16_to_u8(var_b.id(), expected.data());
+  EXPECT_EQ(expected, Process(request, 2 + info_a.size() + info_b.size() - 1));
+
+  // Past the last variable, there is nothing left to read.
+  u16_to_u8(var_b.id() + 1, &request[1]);
+  expected.resize(2);
+  u16_to_u8(var_b.id() + 1, expected.data());
+  EXPECT_EQ(expected, Process(request, 100));
+}
+
+TEST(VarHandler, SetMultipleVars) {
+  uint32_t a = 0;
+  Debug::Variable::Primitive32 var_a("a", Debug::Variable::Access::ReadWrite, &a, "units");
+  Debug::Variable::FloatArray<2> var_b("b", Debug::Variable::Access::ReadWrite, 0.0f, "units");
+  uint32_t c = 0;
+  Debug::Variable::Primitive32 var_c("c", Debug::Variable::Access::ReadOnly, &c, "units");
+
+  std::vector<uint8_t> request(1 + 2 + 4 + 2 + 8);
+  request[0] = static_cast<uint8_t>(VarHandler::Subcommand::SetMultiple);
+  u16_to_u8(var_b.id(), &request[1]);
+  float_to_u8(4, &request[3]);
+  float_to_u8(5, &request[7]);
+  u16_to_u8(var_a.id(), &request[11]);
+  u32_to_u8(0xCAFEBABE, &request[13]);
+  EXPECT_TRUE(Process(request, 0).empty());
+  EXPECT_EQ(0xCAFEBABE, a);
+  EXPECT_EQ(4, var_b.data[0]);
+  EXPECT_EQ(5, var_b.data[1]);
+
+  // Nothing is set if any of the variables can't be.
+  request.resize(request.size() + 6);
+  u32_to_u8(1, &request[13]);
+  u16_to_u8(var_c.id(), &request[17]);
+  u32_to_u8(1, &request[19]);
+  std::array<uint8_t, 1> response;
+  bool processed{false};
+  Context context = {.request = request.data(),
+                     .request_length = static_cast<uint32_t>(request.size()),
+                     .response = response.data(),
+                     .max_response_length = response.size(),
+                     .response_length = 0,
+                     .processed = &processed};
+  EXPECT_EQ(ErrorCode::InternalError, VarHandler().Process(&context));
+  EXPECT_EQ(0xCAFEBABE, a);
+  EXPECT_EQ(0, c);
+}
+
 TEST(VarHandler, Errors) {
   uint32_t value = 0xDEADBEEF;
   Debug::Variable::UInt32 var("name", Debug::Variable::Access::ReadWrite, value, "units", "help");
@@ -174,7 +339,7 @@ TEST(VarHandler, Errors) {
 
   std::vector<std::tuple<std::vector<uint8_t>, ErrorCode>> requests = {
       {{}, ErrorCode::MissingData},   // Missing subcommand
-      {{4}, ErrorCode::InvalidData},  // Invalid subcommand
+      {{8}, ErrorCode::InvalidData},  // Invalid subcommand
       {{0, 0xFF, 0xFF}, ErrorCode::UnknownVariable},
       {{1, 0xFF, 0xFF}, ErrorCode::UnknownVariable},
       {{2, 0xFF, 0xFF}, ErrorCode::UnknownVariable},
@@ -186,6 +351,19 @@ TEST(VarHandler, Errors) {
       {{3}, ErrorCode::NoMemory},
       {{2, id[0], id[1], 0xCA, 0xFE, 0x00}, ErrorCode::MissingData},
       {{2, id_readonly[0], id_readonly[1], 0xCA, 0xFE, 0x00, 0x00}, ErrorCode::InternalError},
+      {{4, 0}, ErrorCode::MissingData},
+      {{4, 0, 0, id[0]}, ErrorCode::MissingData},
+      {{4, 0, 0, 0xFF, 0xFF}, ErrorCode::UnknownVariable},
+      {{4, 0, 0, id[0], id[1]}, ErrorCode::NoMemory},
+      {{5, id[0]}, ErrorCode::MissingData},
+      {{5, 0xFF, 0xFF, 0xCA, 0xFE, 0x00, 0x00}, ErrorCode::UnknownVariable},
+      {{5, id[0], id[1], 0xCA, 0xFE, 0x00}, ErrorCode::MissingData},
+      {{5, id[0], id[1], 0xCA, 0xFE, 0x00, 0x00, id_readonly[0], id_readonly[1], 0xCA, 0xFE, 0x00,
+        0x00},
+       ErrorCode::InternalError},
+      {{6, 0}, ErrorCode::MissingData},
+      {{6, id[0], id[1]}, ErrorCode::NoMemory},
+      {{7}, ErrorCode::NoMemory},
   };
 
   for (auto &[request, error] : requests) {
@@ -15,20 +15,45 @@ limitations under the License.
 
 #include "vars.h"
 
+#include <cstring>
+
 #include "gtest/gtest.h"
 
 using namespace Debug::Variable;
 
+TEST(DebugVar, Text) {
+  Text text("prefix_", "name");
+  EXPECT_EQ(11, text.length());
+  EXPECT_EQ(text, "prefix_name");
+  EXPECT_FALSE(text == "prefix_");
+  EXPECT_FALSE(text == "prefix_name_");
+  EXPECT_FALSE(text == "pre");
+
+  char buffer[12] = {0};
+  EXPECT_EQ(11, text.copy(buffer, sizeof(buffer)));
+  EXPECT_STREQ("prefix_name", buffer);
+  // Copies are truncated to the given size
+  std::memset(buffer, 0, sizeof(buffer));
+  EXPECT_EQ(9, text.copy(buffer, 9));
+  EXPECT_STREQ("prefix_na", buffer);
+  std::memset(buffer, 0, sizeof(buffer));
+  EXPECT_EQ(3, text.copy(buffer, 3));
+  EXPECT_STREQ("pre", buffer);
+
+  EXPECT_EQ(Text("single"), "single");
+  EXPECT_EQ(Text("single").length(), 6);
+}
+
 TEST(DebugVar, DebugVarInt32) {
   int32_t value{5};
   int32_t other_val{0};
   Primitive32 var("var", Access::ReadOnly, &value, "unit", "help", "fmt");
-  EXPECT_STREQ("var", var.name());
+  EXPECT_EQ(var.name(), "var");
   var.prepend_name("pre_");
-  EXPECT_STREQ("pre_var", var.name());
-  EXPECT_STREQ("help", var.help());
+  EXPECT_EQ(var.name(), "pre_var");
+  EXPECT_EQ(var.help(), "help");
   var.append_help(" so much help");
-  EXPECT_STREQ("help so much help", var.help());
+  EXPECT_EQ(var.help(), "help so much help");
   EXPECT_EQ(Type::Int32, var.type());
   EXPECT_STREQ("fmt", var.format());
   EXPECT_STREQ("unit", var.units());
@@ -47,7 +72,7 @@ TEST(DebugVar, DebugVarInt32) {
 
   // All default arguments
   Primitive32 var_default("var", Access::ReadWrite, &value, "unit");
-  EXPECT_STREQ("", var_default.help());
+  EXPECT_EQ(var_default.help(), "");
   EXPECT_STREQ("%d", var_default.format());
 }
 
@@ -59,7 +84,7 @@ TEST(DebugVar, DebugVarUint32Defaults) {
   other_val = 0;
   var.serialize_value(&other_val);
   EXPECT_EQ(uint32_t{5}, other_val);
-  EXPECT_STREQ("", var.help());
+  EXPECT_EQ(var.help(), "");
   EXPECT_STREQ("%u", var.format());
   EXPECT_EQ(Type::UInt32, var.type());
 }
@@ -69,7 +94,7 @@ TEST(DebugVar, DebugVarFloatDefaults) {
   // All default arguments
   Primitive32 var("var", Access::ReadWrite, &value, "unit");
 
-  EXPECT_STREQ("", var.help());
+  EXPECT_EQ(var.help(), "");
   EXPECT_STREQ("%.3f", var.format());
   EXPECT_EQ(Type::Float, var.type());
 
@@ -130,8 +155,8 @@ TEST(DebugVar, String) {
   DEBUG_STRING(str_auto, "str_auto", Access::ReadOnly, "auto", "auto help");
   EXPECT_EQ(8, str_auto.byte_size());
   EXPECT_STREQ("auto", str_auto.get());
-  EXPECT_STREQ("str_auto", str_auto.name());
-  EXPECT_STREQ("auto help", str_auto.help());
+  EXPECT_EQ(str_auto.name(), "str_auto");
+  EXPECT_EQ(str_auto.help(), "auto help");
 }
 
 TEST(DebugVar, Registration) {
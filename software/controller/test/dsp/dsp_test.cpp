@@ -0,0 +1,263 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// The kernels are checked against plain scalar implementations of the same arithmetic, which they
+// must match bit for bit.  As the native build emulates the DSP instructions (see
+// dsp_intrinsics.h), this checks the kernels' algorithms, and the emulation is what the STM32
+// instructions do.
+
+#include "dsp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace Dsp;
+
+namespace {
+std::vector<uint16_t> RandomSamples(size_t n) {
+  std::vector<uint16_t> samples(n);
+  for (auto &sample : samples) sample = static_cast<uint16_t>(rand());
+  return samples;
+}
+
+std::vector<int16_t> RandomSignal(size_t n) {
+  std::vector<int16_t> signal(n);
+  for (auto &x : signal) x = static_cast<int16_t>(rand());
+  return signal;
+}
+
+uint32_t ReferenceSum(const uint16_t *samples, size_t n) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < n; ++i) sum += samples[i];
+  return sum;
+}
+
+int16_t Clamp16(int64_t x) {
+  return static_cast<int16_t>(std::clamp<int64_t>(x, INT16_MIN, INT16_MAX));
+}
+
+std::vector<int16_t> ReferenceFir(const std::vector<int16_t> &coefficients,
+                                  const std::vector<int16_t> &x) {
+  std::vector<int16_t> y(x.size());
+  for (size_t n = 0; n < x.size(); ++n) {
+    int64_t acc = 0;
+    for (size_t k = 0; k < coefficients.size() && k <= n; ++k) acc += coefficients[k] * x[n - k];
+    y[n] = Clamp16(acc >> 15);
+  }
+  return y;
+}
+
+// Direct form I with error feedback, one sample at a time.
+class ReferenceBiquad {
+ public:
+  explicit ReferenceBiquad(BiquadCoefficients c) : c_(c) {}
+
+  int16_t Filter(int16_t x) {
+    int64_t acc = error_ + c_.b0 * x + c_.b1 * x1_ + c_.b2 * x2_ + c_.a1 * y1_ + c_.a2 * y2_;
+    int16_t y = Clamp16(acc >> 14);
+    error_ = acc & 0x3FFF;
+    x2_ = x1_;
+    x1_ = x;
+    y2_ = y1_;
+    y1_ = y;
+    return y;
+  }
+
+ private:
+  BiquadCoefficients c_;
+  int64_t error_{0};
+  int32_t x1_{0}, x2_{0}, y1_{0}, y2_{0};
+};
+
+// Amplitude of a sine of the given frequency once through the filter, relative to the input's.
+float Gain(const BiquadCoefficients &coefficients, float frequency, float sample_rate) {
+  Biquad biquad(coefficients);
+  constexpr float Amplitude{10000};
+  float peak = 0;
+  for (int i = 0; i < 20000; ++i) {
+    float x = Amplitude * std::sin(2 * static_cast<float>(M_PI) * frequency *
+                                   static_cast<float>(i) / sample_rate);
+    int16_t y = biquad.Filter(static_cast<int16_t>(std::lround(x)));
+    // Skip the transient
+    if (i > 10000) peak = std::max(peak, std::abs(static_cast<float>(y)));
+  }
+  return peak / Amplitude;
+}
+
+template <typename Function>
+float NanosecondsPerSample(size_t samples, Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<float, std::nano>(elapsed).count() / static_cast<float>(samples);
+}
+}  // namespace
+
+TEST(Dsp, Sum) {
+  std::vector<uint16_t> samples = RandomSamples(1001);
+  // All lengths and alignments, including odd ones which leave one sample for the scalar tail.
+  for (size_t start = 0; start < 3; ++start) {
+    for (size_t n = 0; n < 40; ++n) {
+      EXPECT_EQ(ReferenceSum(&samples[start], n), Sum(&samples[start], n)) << start << " " << n;
+    }
+  }
+  EXPECT_EQ(ReferenceSum(samples.data(), samples.size()), Sum(samples.data(), samples.size()));
+
+  // No overflow at full scale.
+  std::vector<uint16_t> full_scale(65536, 0xFFFF);
+  EXPECT_EQ(65536u * 0xFFFF, Sum(full_scale.data(), full_scale.size()));
+}
+
+TEST(Dsp, Decimate) {
+  std::vector<uint16_t> samples = RandomSamples(100);
+  std::vector<uint32_t> out(100);
+  for (size_t factor : {1, 2, 3, 7, 16, 100}) {
+    ASSERT_EQ(100 / factor, Decimate(samples.data(), samples.size(), factor, out.data()));
+    for (size_t i = 0; i < 100 / factor; ++i) {
+      EXPECT_EQ(ReferenceSum(&samples[i * factor], factor), out[i]) << factor << " " << i;
+    }
+  }
+  EXPECT_EQ(0u, Decimate(samples.data(), 5, 6, out.data()));
+}
+
+TEST(Dsp, Fir) {
+  std::vector<int16_t> x = RandomSignal(500);
+
+  // Even and odd number of taps, with extreme coefficients that make the output saturate.
+  int16_t moving_average[4] = {8192, 8192, 8192, 8192};
+  int16_t extremes[5] = {INT16_MIN, INT16_MAX, -1, INT16_MAX, INT16_MIN};
+  Fir<4> average_filter(moving_average);
+  Fir<5> extremes_filter(extremes);
+  std::vector<int16_t> average(x.size()), saturated(x.size());
+  for (size_t i = 0; i < x.size(); ++i) average[i] = average_filter.Filter(x[i]);
+  extremes_filter.Filter(x.data(), saturated.data(), x.size());
+
+  EXPECT_EQ(ReferenceFir({8192, 8192, 8192, 8192}, x), average);
+  EXPECT_EQ(ReferenceFir({INT16_MIN, INT16_MAX, -1, INT16_MAX, INT16_MIN}, x), saturated);
+}
+
+TEST(Dsp, BiquadMatchesReference) {
+  std::vector<int16_t> x = RandomSignal(2000);
+  for (auto coefficients : {LowPass(5, 100), LowPass(20, 100), LowPass(1, 1000), PassThrough,
+                            BiquadCoefficients{INT16_MAX, INT16_MIN, INT16_MAX, 0, 0}}) {
+    Biquad biquad(coefficients);
+    ReferenceBiquad reference(coefficients);
+    std::vector<int16_t> expected(x.size()), y(x.size());
+    for (size_t i = 0; i < x.size(); ++i) expected[i] = reference.Filter(x[i]);
+    biquad.Filter(x.data(), y.data(), x.size());
+    EXPECT_EQ(expected, y);
+  }
+}
+
+TEST(Dsp, LowPass) {
+  // Invalid cutoffs disable filtering.
+  for (float cutoff : {0.0f, -1.0f, 20.5f, 50.0f, NAN}) {
+    BiquadCoefficients c = LowPass(cutoff, 100);
+    EXPECT_EQ(1 << 14, c.b0);
+    EXPECT_EQ(0, c.b1 | c.b2 | c.a1 | c.a2);
+  }
+
+  // Constant inputs come out unchanged once settled, whatever the rounding of coefficients.
+  for (float cutoff : {0.5f, 2.0f, 10.0f, 17.0f, 20.0f}) {
+    BiquadCoefficients c = LowPass(cutoff, 100);
+    EXPECT_EQ(1 << 14, c.b0 + c.b1 + c.b2 + c.a1 + c.a2) << cutoff;
+    for (int16_t level : {int16_t{-32768}, int16_t{-1234}, int16_t{1}, int16_t{32767}}) {
+      Biquad biquad(c);
+      int16_t y = 0;
+      for (int i = 0; i < 5000; ++i) y = biquad.Filter(level);
+      EXPECT_EQ(level, y) << cutoff;
+    }
+  }
+
+  // Reset starts from a steady state.
+  Biquad biquad(LowPass(5, 100));
+  biquad.Reset(1000);
+  EXPECT_EQ(1000, biquad.Filter(1000));
+
+  // Butterworth response: -3dB at the cutoff, -12dB per octave above.
+  BiquadCoefficients c = LowPass(10, 1000);
+  EXPECT_NEAR(1.0f, Gain(c, 1, 1000), 0.01f);
+  EXPECT_NEAR(M_SQRT1_2, Gain(c, 10, 1000), 0.01f);
+  EXPECT_NEAR(0.0246f, Gain(c, 64, 1000), 0.005f);
+}
+
+// Checks how long the kernels take per sample, against the scalar reference code (which uses float
+// for the filters, as sensor code would otherwise).  This is no substitute for measurements on the
+// target, where the kernels use the DSP instructions, and depends on the machine running it, so
+// it's a benchmark to run on demand when changing the kernels:
+//
+//   GTEST_ALSO_RUN_DISABLED_TESTS=1 pio test -e native -f dsp
+//
+// Natively, the filters use the portable fixed point code, which is slower than float on a desktop
+// machine, so they're only checked to stay within a small factor of it.  The sum should be faster
+// than the scalar loop everywhere.
+TEST(Dsp, DISABLED_Benchmark) {
+  constexpr size_t Samples{1 << 20};
+  constexpr float MaxFilterSlowdown{4};
+  std::vector<uint16_t> samples = RandomSamples(Samples);
+  std::vector<int16_t> x = RandomSignal(Samples);
+  std::vector<int16_t> y(Samples);
+
+  volatile uint32_t sum = 0;
+  float reference_sum_ns =
+      NanosecondsPerSample(Samples, [&] { sum = ReferenceSum(samples.data(), Samples); });
+  float sum_ns = NanosecondsPerSample(Samples, [&] { sum = Sum(samples.data(), Samples); });
+  EXPECT_LT(sum_ns, reference_sum_ns);
+
+  BiquadCoefficients c = LowPass(10, 1000);
+  std::vector<float> float_y(Samples);
+  float reference_biquad_ns = NanosecondsPerSample(Samples, [&] {
+    float b0 = static_cast<float>(c.b0) / (1 << 14), b1 = static_cast<float>(c.b1) / (1 << 14);
+    float b2 = static_cast<float>(c.b2) / (1 << 14), a1 = static_cast<float>(c.a1) / (1 << 14);
+    float a2 = static_cast<float>(c.a2) / (1 << 14);
+    float x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    for (size_t i = 0; i < Samples; ++i) {
+      float x0 = x[i];
+      float y0 = b0 * x0 + b1 * x1 + b2 * x2 + a1 * y1 + a2 * y2;
+      x2 = x1;
+      x1 = x0;
+      y2 = y1;
+      y1 = y0;
+      float_y[i] = y0;
+    }
+  });
+  Biquad biquad(c);
+  float biquad_ns =
+      NanosecondsPerSample(Samples, [&] { biquad.Filter(x.data(), y.data(), Samples); });
+  EXPECT_LT(biquad_ns, MaxFilterSlowdown * reference_biquad_ns);
+
+  int16_t coefficients[8] = {4096, 4096, 4096, 4096, 4096, 4096, 4096, 4096};
+  float reference_fir_ns = NanosecondsPerSample(Samples, [&] {
+    float history[8] = {};
+    for (size_t i = 0; i < Samples; ++i) {
+      std::copy_backward(history, history + 7, history + 8);
+      history[0] = x[i];
+      float y0 = 0;
+      for (size_t k = 0; k < 8; ++k) {
+        y0 += static_cast<float>(coefficients[k]) / (1 << 15) * history[k];
+      }
+      float_y[i] = y0;
+    }
+  });
+  Fir<8> fir(coefficients);
+  float fir_ns = NanosecondsPerSample(Samples, [&] { fir.Filter(x.data(), y.data(), Samples); });
+  EXPECT_LT(fir_ns, MaxFilterSlowdown * reference_fir_ns);
+}
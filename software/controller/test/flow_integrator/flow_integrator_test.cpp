@@ -17,12 +17,17 @@ limitations under the License.
 
 #include "gtest/gtest.h"
 
-static const Volume COMPARISON_TOLERANCE_VOLUME = ml(1);
+// Flows are sampled once per control loop cycle.  The expected volumes below
+// are given as multiples of the volume of a 1 l/s flow over a sample period,
+// which is 10 ml at the default 100Hz loop rate.
+static constexpr Duration sample_period = ControlLoopPeriod;
+static constexpr Volume period_volume = liters_per_sec(1) * sample_period;
+
+static const Volume COMPARISON_TOLERANCE_VOLUME = period_volume / 10.0f;
 
 #define EXPECT_VOLUME_NEAR(a, b) EXPECT_NEAR((a).ml(), (b).ml(), COMPARISON_TOLERANCE_VOLUME.ml())
 
 static constexpr Time base = microsSinceStartup(10'000'000);
-static constexpr Duration sample_period = milliseconds(10);
 Time ticks(int num_ticks) { return base + num_ticks * sample_period; }
 
 // TODO: There ought to be more tests in here, e.g. of NoteExpectedVolume.
@@ -37,38 +42,41 @@ TEST(FlowIntegrator, FlowIntegrator) {
   // first call to AddFlow ==> initialization and TV is 0, even if flow is not
   EXPECT_EQ(tidal_volume.GetVolume().ml(), 0.0f);
   tidal_volume.AddFlow(ticks(t++), liters_per_sec(1.0f));
-  // integrate 1 l/s flow over 10 ms ==> 5 ml (rectangle rule with initial flow
-  // set to 0)
-  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), ml(5));
+  // integrate 1 l/s flow over a period ==> 0.5 period volumes (5 ml at 100Hz,
+  // rectangle rule with initial flow set to 0)
+  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), 0.5f * period_volume);
 
   tidal_volume.AddFlow(ticks(t++), cubic_m_per_sec(2e-3f));
-  // add 2 l/s flow over 10 ms ==> 20 ml ()
-  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), ml(20));
+  // add 2 l/s flow over a period ==> 2 period volumes (20 ml at 100Hz)
+  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), 2.0f * period_volume);
 
   tidal_volume.AddFlow(ticks(t++), ml_per_min(0.0f));
-  // add 0 l/s flow over 10 ms ==> 30 ml (rectangle rule)
-  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), ml(30.0f));
+  // add 0 l/s flow over a period ==> 3 period volumes (rectangle rule)
+  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), 3.0f * period_volume);
 
-  // integrate 0 for some time ==> still 30 ms
+  // integrate 0 for some time ==> still 3 period volumes
   while (t < 100) {
     tidal_volume.AddFlow(ticks(t++), ml_per_min(0.0f));
   }
 
-  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), ml(30.0f));
+  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), 3.0f * period_volume);
 
   // Reverse flow.  This does not increment t in order to allow oversampling
   // (following test).
   tidal_volume.AddFlow(ticks(t), liters_per_sec(-1.0f));
-  // remove 1 l/s flow over 10 ms ==> 25 ml (rectangle rule)
-  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), ml(25.0f));
+  // remove 1 l/s flow over a period ==> 2.5 period volumes (rectangle rule)
+  EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), 2.5f * period_volume);
 
-  // oversampling and expect volume to not change except on multiples of 5 ms
+  // oversampling at a tenth of the period, and expect volume to not change
+  // except every half period
   for (int i = 0; i < 50; i++) {
-    tidal_volume.AddFlow(ticks(t) + milliseconds(i), liters_per_sec(-1));
+    tidal_volume.AddFlow(ticks(t) + microseconds(i * sample_period.microseconds() / 10),
+                         liters_per_sec(-1));
 
-    // remove 1l/s flow over 5 ms only when i is a multiple of 5
+    // remove 1l/s flow over half a period only when i is a multiple of 5
     int j = i / 5 * 5;
-    EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(), ml(25.0f - static_cast<float>(j)));
+    EXPECT_VOLUME_NEAR(tidal_volume.GetVolume(),
+                       (2.5f - static_cast<float>(j) / 10.0f) * period_volume);
   }
 }
 
@@ -77,23 +85,23 @@ TEST(FlowIntegrator, NoteExpectedVolume) {
   int t = 0;
   f.AddFlow(ticks(t++), ml_per_sec(1000));
   f.AddFlow(ticks(t++), ml_per_sec(1000));
-  EXPECT_VOLUME_NEAR(f.GetVolume(), ml(1000 * 0.01));
+  EXPECT_VOLUME_NEAR(f.GetVolume(), 1.0f * period_volume);
   f.AddFlow(ticks(t++), ml_per_sec(1000));
-  EXPECT_VOLUME_NEAR(f.GetVolume(), ml(1000 * 0.02));
+  EXPECT_VOLUME_NEAR(f.GetVolume(), 2.0f * period_volume);
   f.NoteExpectedVolume(ml(0));
   EXPECT_FLOAT_EQ(f.FlowCorrection().ml_per_sec(), -2000);
 
   // Triangle rule; this is integrated as (1000ml/s + -1000ml/s) / 2.
   f.AddFlow(ticks(t++), ml_per_sec(1000));
-  EXPECT_VOLUME_NEAR(f.GetVolume(), ml(1000 * 0.02f));
+  EXPECT_VOLUME_NEAR(f.GetVolume(), 2.0f * period_volume);
 
   // This is intgrated as -1000ml/s.
   f.AddFlow(ticks(t++), ml_per_sec(1000));
-  EXPECT_VOLUME_NEAR(f.GetVolume(), ml(1000 * 0.01f));
+  EXPECT_VOLUME_NEAR(f.GetVolume(), 1.0f * period_volume);
 
   // Triangle rule; this is integrated as (-1000ml/s + -2000ml/s) / 2.
   f.AddFlow(ticks(t++), ml_per_sec(0));
-  EXPECT_VOLUME_NEAR(f.GetVolume(), ml(1000 * -0.005f));
+  EXPECT_VOLUME_NEAR(f.GetVolume(), -0.5f * period_volume);
 }
 
 TEST(FlowIntegrator, DrivesVolumeToZero) {
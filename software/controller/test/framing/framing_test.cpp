@@ -0,0 +1,256 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "framing.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "checksum.h"
+#include "framed_uart.h"
+#include "gtest/gtest.h"
+#include "uart_dma.h"
+
+static std::vector<uint8_t> Encode(const std::vector<uint8_t> &payload) {
+  std::vector<uint8_t> frame(max_encoded_frame_size(static_cast<uint32_t>(payload.size())));
+  uint32_t length = encode_frame(payload.data(), static_cast<uint32_t>(payload.size()),
+                                 frame.data(), static_cast<uint32_t>(frame.size()));
+  frame.resize(length);
+  return frame;
+}
+
+static std::vector<uint8_t> Decode(const std::vector<uint8_t> &frame) {
+  std::vector<uint8_t> payload(frame.size());
+  uint32_t length = decode_frame(frame.data(), static_cast<uint32_t>(frame.size()),
+                                 payload.data(), static_cast<uint32_t>(payload.size()));
+  payload.resize(length);
+  return payload;
+}
+
+TEST(Framing, RoundTrip) {
+  std::vector<std::vector<uint8_t>> payloads = {
+      {0x42},
+      {1, 2, 3, 4, 5, 6, 7, 8},
+      {FramingMark},
+      {FramingEscape},
+      {FramingMark, FramingEscape, FramingMark, 0, FramingEscape},
+  };
+  srand(0);
+  for (int i = 0; i < 100; ++i) {
+    std::vector<uint8_t> payload(1 + rand() % 200);
+    for (auto &byte : payload) byte = static_cast<uint8_t>(rand());
+    payloads.push_back(payload);
+  }
+
+  for (const auto &payload : payloads) {
+    SCOPED_TRACE("payload size " + std::to_string(payload.size()));
+    std::vector<uint8_t> frame = Encode(payload);
+    ASSERT_GT(frame.size(), payload.size() + FrameCrcSize);
+    EXPECT_LE(frame.size(), max_encoded_frame_size(static_cast<uint32_t>(payload.size())));
+
+    // Frame marks only delimit the frame.
+    EXPECT_EQ(frame.front(), FramingMark);
+    EXPECT_EQ(frame.back(), FramingMark);
+    EXPECT_EQ(std::count(frame.begin(), frame.end(), FramingMark), 2);
+
+    EXPECT_EQ(Decode(frame), payload);
+    // Marks are optional when decoding.
+    EXPECT_EQ(Decode(std::vector<uint8_t>(frame.begin() + 1, frame.end() - 1)), payload);
+  }
+}
+
+TEST(Framing, CrcMatchesChecksumLib) {
+  std::vector<uint8_t> payload = {'a', 'b', 'c', 'd', 'e'};
+  std::vector<uint8_t> frame = Encode(payload);
+  // None of these bytes needs escaping, so the frame holds the payload then its CRC.
+  ASSERT_EQ(frame.size(), 2 + payload.size() + FrameCrcSize);
+  EXPECT_TRUE(crc_ok(frame.data() + 1, static_cast<uint32_t>(frame.size() - 2)));
+}
+
+TEST(Framing, DecodeInPlace) {
+  std::vector<uint8_t> payload = {FramingMark, 1, FramingEscape, 2, 3};
+  std::vector<uint8_t> frame = Encode(payload);
+  uint32_t length = decode_frame(frame.data(), static_cast<uint32_t>(frame.size()), frame.data(),
+                                 static_cast<uint32_t>(frame.size()));
+  ASSERT_EQ(length, payload.size());
+  EXPECT_EQ(std::vector<uint8_t>(frame.begin(), frame.begin() + length), payload);
+}
+
+TEST(Framing, BufferTooSmall) {
+  std::vector<uint8_t> payload = {1, 2, 3, FramingMark};
+  std::vector<uint8_t> frame = Encode(payload);
+
+  std::vector<uint8_t> small(frame.size() - 1);
+  EXPECT_EQ(0u, encode_frame(payload.data(), static_cast<uint32_t>(payload.size()), small.data(),
+                             static_cast<uint32_t>(small.size())));
+
+  // The payload buffer only needs to fit the payload.
+  std::vector<uint8_t> decoded(payload.size());
+  EXPECT_EQ(payload.size(), decode_frame(frame.data(), static_cast<uint32_t>(frame.size()),
+                                         decoded.data(), static_cast<uint32_t>(decoded.size())));
+  EXPECT_EQ(0u, decode_frame(frame.data(), static_cast<uint32_t>(frame.size()), decoded.data(),
+                             static_cast<uint32_t>(decoded.size() - 1)));
+}
+
+TEST(Framing, InvalidFrames) {
+  std::vector<uint8_t> frame = Encode({1, 2, 3, 4, 5});
+
+  // Any single bit flip is caught, either by the CRC or because it breaks escaping.
+  for (size_t i = 1; i < frame.size() - 1; ++i) {
+    for (int bit = 0; bit < 8; ++bit) {
+      SCOPED_TRACE("byte " + std::to_string(i) + " bit " + std::to_string(bit));
+      std::vector<uint8_t> corrupt = frame;
+      corrupt[i] = static_cast<uint8_t>(corrupt[i] ^ (1 << bit));
+      EXPECT_TRUE(Decode(corrupt).empty());
+    }
+  }
+
+  // Truncated frames
+  for (size_t length = 0; length < frame.size() - 1; ++length) {
+    SCOPED_TRACE("length " + std::to_string(length));
+    EXPECT_TRUE(Decode(std::vector<uint8_t>(frame.begin(), frame.begin() + length)).empty());
+  }
+
+  // Escape not followed by an escaped byte, or ending the frame.
+  EXPECT_TRUE(Decode({FramingMark, 1, FramingEscape, 2, 3, 4, 5, 6, FramingMark}).empty());
+  EXPECT_TRUE(Decode({FramingMark, 1, 2, 3, 4, 5, FramingEscape, FramingMark}).empty());
+  // Two frames glued together
+  std::vector<uint8_t> twice = frame;
+  twice.insert(twice.end(), frame.begin(), frame.end());
+  EXPECT_TRUE(Decode(twice).empty());
+  // Empty payload
+  EXPECT_TRUE(Encode({}).empty());
+}
+
+// Two FramedUarts, connected through fake UartDmas.
+class FramedUartLink : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    a_.init(115200);
+    b_.init(115200);
+  }
+
+  // Moves whatever a_ sent to b_, completing the transfer.
+  void Transmit() {
+    std::vector<uint8_t> data = a_dma_.TESTGetSentData();
+    b_dma_.TESTReceive(data.data(), static_cast<uint32_t>(data.size()));
+    a_dma_.TESTCompleteTx();
+  }
+
+  std::vector<uint8_t> Receive() {
+    std::vector<uint8_t> payload(FramedUart::MaxPayloadSize);
+    payload.resize(b_.receive(payload.data(), static_cast<uint32_t>(payload.size())));
+    return payload;
+  }
+
+  UartDma a_dma_{FramingMark};
+  UartDma b_dma_{FramingMark};
+  FramedUart a_{&a_dma_};
+  FramedUart b_{&b_dma_};
+};
+
+TEST_F(FramedUartLink, SendReceive) {
+  for (uint8_t i = 0; i < 10; ++i) {
+    SCOPED_TRACE("frame " + std::to_string(i));
+    std::vector<uint8_t> payload = {i, FramingMark, FramingEscape, i};
+    ASSERT_TRUE(a_.ready_to_send());
+    ASSERT_TRUE(a_.send(payload.data(), static_cast<uint32_t>(payload.size())));
+    EXPECT_TRUE(Receive().empty());
+    Transmit();
+    EXPECT_EQ(Receive(), payload);
+    EXPECT_TRUE(Receive().empty());
+  }
+  EXPECT_EQ(0u, b_.rx_errors());
+  EXPECT_EQ(0u, b_.rx_dropped());
+}
+
+TEST_F(FramedUartLink, OneFrameWaitsForTransmission) {
+  std::vector<uint8_t> first = {1};
+  std::vector<uint8_t> second = {2};
+  std::vector<uint8_t> third = {3};
+  EXPECT_TRUE(a_.send(first.data(), 1));
+  // The second frame is queued behind the first, the third is refused.
+  EXPECT_TRUE(a_.ready_to_send());
+  EXPECT_TRUE(a_.send(second.data(), 1));
+  EXPECT_FALSE(a_.ready_to_send());
+  EXPECT_FALSE(a_.send(third.data(), 1));
+
+  Transmit();
+  EXPECT_EQ(Receive(), first);
+  EXPECT_TRUE(a_.ready_to_send());
+  Transmit();
+  EXPECT_EQ(Receive(), second);
+  Transmit();
+  EXPECT_TRUE(Receive().empty());
+}
+
+TEST_F(FramedUartLink, DropsFramesNotReadInTime) {
+  std::vector<uint8_t> first = {1};
+  std::vector<uint8_t> second = {2};
+  std::vector<uint8_t> third = {3};
+  a_.send(first.data(), 1);
+  Transmit();
+  a_.send(second.data(), 1);
+  Transmit();
+  // The first frame is kept until read, the second one is dropped.
+  EXPECT_EQ(Receive(), first);
+  EXPECT_EQ(1u, b_.rx_dropped());
+  a_.send(third.data(), 1);
+  Transmit();
+  EXPECT_EQ(Receive(), third);
+}
+
+TEST_F(FramedUartLink, ResynchronizesAfterGarbage) {
+  std::vector<uint8_t> payload = {4, 5, 6};
+  // Line noise, then a frame.
+  std::vector<uint8_t> garbage = {0x12, 0x34, 0x56};
+  b_dma_.TESTReceive(garbage.data(), static_cast<uint32_t>(garbage.size()));
+  a_.send(payload.data(), static_cast<uint32_t>(payload.size()));
+  Transmit();
+
+  // The garbage ends at the mark opening the frame, so it looks like a frame of its own, and the
+  // actual frame is dropped because that one wasn't read yet.  Once read, the garbage is reported
+  // as an invalid frame.
+  EXPECT_EQ(1u, b_.rx_dropped());
+  EXPECT_TRUE(Receive().empty());
+  EXPECT_EQ(1u, b_.rx_errors());
+  a_.send(payload.data(), static_cast<uint32_t>(payload.size()));
+  Transmit();
+  EXPECT_EQ(Receive(), payload);
+}
+
+TEST_F(FramedUartLink, FrameTooLong) {
+  std::vector<uint8_t> too_long(FramedUart::MaxPayloadSize + 1, 0);
+  EXPECT_FALSE(a_.send(too_long.data(), static_cast<uint32_t>(too_long.size())));
+
+  // A frame which doesn't fit the receive buffer is discarded, and the next one
+  // gets through.
+  std::vector<uint8_t> frame(FramedUart::FrameBufferSize + 10, 0x55);
+  frame.front() = FramingMark;
+  frame.back() = FramingMark;
+  b_dma_.TESTReceive(frame.data(), static_cast<uint32_t>(frame.size()));
+  EXPECT_TRUE(Receive().empty());
+  EXPECT_GT(b_.rx_errors(), 0u);
+  uint32_t errors = b_.rx_errors();
+
+  std::vector<uint8_t> payload(FramedUart::MaxPayloadSize, FramingMark);
+  ASSERT_TRUE(a_.send(payload.data(), static_cast<uint32_t>(payload.size())));
+  Transmit();
+  EXPECT_EQ(Receive(), payload);
+  EXPECT_EQ(errors, b_.rx_errors());
+}
@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "nvparams.h"
 
+#include <cmath>
+#include <cstring>
+
 #include "checksum.h"
 #include "gtest/gtest.h"
 
@@ -26,7 +29,7 @@ static constexpr uint32_t kMemSize{8192};
 static void CompareParams(int16_t address, const Structure &ref, NVParams::Handler &nv_params_,
                           TestEeprom &eeprom_) {
   // Reminder to update this function when Structure changes size.
-  static_assert(sizeof(Structure) == 52);
+  static_assert(sizeof(Structure) == 548);
   Structure read;
   if (address < 0) {
     nv_params_.Get(0, &read, sizeof(Structure));
@@ -57,6 +60,13 @@ static void CompareParams(int16_t address, const Structure &ref, NVParams::Handl
             ref.last_settings.inspiratory_trigger_cm_h2o);
   EXPECT_EQ(read.last_settings.expiratory_trigger_ml_per_min,
             ref.last_settings.expiratory_trigger_ml_per_min);
+
+  EXPECT_EQ(0, std::memcmp(&read.air_influx_flow_table, &ref.air_influx_flow_table,
+                           sizeof(FlowTable)));
+  EXPECT_EQ(0, std::memcmp(&read.oxygen_influx_flow_table, &ref.oxygen_influx_flow_table,
+                           sizeof(FlowTable)));
+  EXPECT_EQ(0, std::memcmp(&read.outflow_flow_table, &ref.outflow_flow_table, sizeof(FlowTable)));
+  EXPECT_EQ(0, std::memcmp(&read.warm_start, &ref.warm_start, sizeof(WarmStart)));
 }
 
 uint32_t ParamsCRC(Structure *params) {
@@ -172,9 +182,74 @@ TEST_F(NVparamsTest, Update) {
   SCOPED_TRACE("nv_param_ check after MACRO");
   CompareParams(-1, ref_params, nv_params_, eeprom_);
 
+  // Flow tables are larger than other parameters
+  ref_params.count++;
+  for (size_t i = 0; i < FlowTable::MaxPoints; ++i) {
+    ref_params.outflow_flow_table.dp_kPa[i] = static_cast<float>(i) * 0.25f;
+    ref_params.outflow_flow_table.flow_ml_per_sec[i] = static_cast<float>(i) * 100.0f;
+  }
+  ref_params.crc = ParamsCRC(&ref_params);
+
+  nv_params_.NV_PARAMS_UPDATE(outflow_flow_table, &ref_params.outflow_flow_table);
+
+  SCOPED_TRACE("nv_param_ check after flow table update");
+  CompareParams(-1, ref_params, nv_params_, eeprom_);
+
+  // Warm start calibrations
+  ref_params.count++;
+  ref_params.warm_start.calibrated = 1;
+  ref_params.warm_start.sensor_zeros[2] = 1.5f;
+  ref_params.warm_start.exhale_pinch_calibration[10] = 1.0f;
+  ref_params.crc = ParamsCRC(&ref_params);
+
+  nv_params_.NV_PARAMS_UPDATE(warm_start, &ref_params.warm_start);
+
+  SCOPED_TRACE("nv_param_ check after warm start update");
+  CompareParams(-1, ref_params, nv_params_, eeprom_);
+
   ASSERT_FALSE(nv_params_.Set(4, &ref_params.count + 1, 1));
 }
 
+TEST(NVparams, WarmStartPlausible) {
+  WarmStart params;
+  params.calibrated = 1;
+  for (float &zero : params.sensor_zeros) zero = 1.0f;
+  for (size_t i = 0; i < WarmStart::PinchCalibrationSize; ++i) {
+    params.blower_pinch_calibration[i] = static_cast<float>(i) / 10.0f;
+    params.exhale_pinch_calibration[i] = static_cast<float>(i * i) / 100.0f;
+  }
+  EXPECT_TRUE(params.plausible());
+
+  // Calibrations must have been made.
+  WarmStart invalid = params;
+  invalid.calibrated = 0;
+  EXPECT_FALSE(invalid.plausible());
+  EXPECT_FALSE(WarmStart().plausible());
+
+  // Sensor zeros within the A/D range.
+  for (float zero : {-0.1f, 3.4f, NAN}) {
+    invalid = params;
+    invalid.sensor_zeros[4] = zero;
+    EXPECT_FALSE(invalid.plausible()) << zero;
+  }
+
+  // Pinch valve tables within [0, 1] and not decreasing, but not necessarily from 0 to 1.
+  invalid = params;
+  invalid.blower_pinch_calibration[5] = invalid.blower_pinch_calibration[3];
+  EXPECT_FALSE(invalid.plausible());
+  invalid = params;
+  invalid.exhale_pinch_calibration[10] = 1.1f;
+  EXPECT_FALSE(invalid.plausible());
+  invalid = params;
+  invalid.exhale_pinch_calibration[0] = NAN;
+  EXPECT_FALSE(invalid.plausible());
+  WarmStart valid = params;
+  valid.blower_pinch_calibration[0] = 0.05f;
+  valid.blower_pinch_calibration[10] = 0.9f;
+  valid.blower_pinch_calibration[9] = 0.9f;
+  EXPECT_TRUE(valid.plausible());
+}
+
 TEST_F(NVparamsTest, GetAndReadMacro) {
   Structure ref_params;
   ref_params.count++;
@@ -209,7 +284,7 @@ TEST_F(NVparamsTest, InitValidFlip) {
   Structure flip_params = {
       .crc = 0,
       .count = 12,
-      .version = 0,
+      .version = Version,
       .reinit = 0,
       .reserved = 0,
       .vent_serial_number = 1234,
@@ -234,7 +309,7 @@ TEST_F(NVparamsTest, InitValidFlip) {
   Structure flop_params = {
       .crc = 0,
       .count = 10,
-      .version = 0,
+      .version = Version,
       .reinit = 0,
       .reserved = 0,
       .vent_serial_number = 2345,
@@ -296,7 +371,7 @@ TEST_F(NVparamsTest, InitValidFlop) {
   Structure flip_params = {
       .crc = 0,
       .count = 10,
-      .version = 0,
+      .version = Version,
       .reinit = 0,
       .reserved = 0,
       .vent_serial_number = 2345,
@@ -321,7 +396,7 @@ TEST_F(NVparamsTest, InitValidFlop) {
   Structure flop_params = {
       .crc = 0,
       .count = 12,
-      .version = 0,
+      .version = Version,
       .reinit = 0,
       .reserved = 0,
       .vent_serial_number = 1234,
@@ -383,7 +458,7 @@ TEST_F(NVparamsTest, InitBothValid) {
   Structure flip_params = {
       .crc = 0,
       .count = 11,
-      .version = 0,
+      .version = Version,
       .reinit = 0,
       .reserved = 0,
       .vent_serial_number = 1234,
@@ -408,7 +483,7 @@ TEST_F(NVparamsTest, InitBothValid) {
   Structure flop_params = {
       .crc = 0,
       .count = 12,
-      .version = 0,
+      .version = Version,
       .reinit = 0,
       .reserved = 0,
       .vent_serial_number = 2345,
@@ -455,3 +530,61 @@ TEST_F(NVparamsTest, InitBothValid) {
   SCOPED_TRACE("Flop check after Init");
   CompareParams(static_cast<uint16_t>(Address::Flop), flop_params, nv_params_, eeprom_);
 }
+
+TEST_F(NVparamsTest, MigrateVersion0) {
+  // Params saved by a unit running firmware from before the flow tables and
+  // warm start calibrations: valid flip and blank flop.
+  StructureV0 old_params = {
+      .crc = 0,
+      .count = 12,
+      .version = 0,
+      .reinit = 0,
+      .reserved = 0,
+      .vent_serial_number = 1234,
+      .power_cycles = 6,
+      .cumulated_service = 456780,
+      .last_settings =
+          {
+              .mode = VentMode::VentMode_PRESSURE_ASSIST,
+              .peep_cm_h2o = 20,
+              .breaths_per_min = 15,
+              .pip_cm_h2o = 5,
+              .inspiratory_expiratory_ratio = 0.5f,
+              .inspiratory_trigger_cm_h2o = 6,
+              .expiratory_trigger_ml_per_min = 200,
+              .fio2 = 0.21f,
+          },
+  };
+  old_params.crc = soft_crc32(reinterpret_cast<uint8_t *>(&old_params) + 4,
+                              sizeof(StructureV0) - 4);
+  TestEeprom eeprom(0x50, 64, kMemSize);
+  eeprom.WriteBytes(static_cast<uint16_t>(Address::Flip), sizeof(StructureV0), &old_params,
+                    nullptr);
+
+  NVParams::Handler nv_params;
+  nv_params.Init(&eeprom);
+
+  // Identity and counters are kept, and the new parameters initialized.  Init
+  // rewrites both sides in the new version, then counts the power cycle.
+  Structure valid_params;
+  valid_params.count = 14;
+  valid_params.vent_serial_number = old_params.vent_serial_number;
+  valid_params.power_cycles = old_params.power_cycles + 1;
+  valid_params.cumulated_service = old_params.cumulated_service;
+  valid_params.last_settings = old_params.last_settings;
+  valid_params.crc = ParamsCRC(&valid_params);
+
+  SCOPED_TRACE("nv_param_ check after migration");
+  CompareParams(-1, valid_params, nv_params, eeprom);
+  SCOPED_TRACE("Flop check after migration");
+  CompareParams(static_cast<uint16_t>(Address::Flop), valid_params, nv_params, eeprom);
+
+  // The migrated params are loaded as they are on the next boot.
+  NVParams::Handler reloaded;
+  reloaded.Init(&eeprom);
+  valid_params.count++;
+  valid_params.power_cycles++;
+  valid_params.crc = ParamsCRC(&valid_params);
+  SCOPED_TRACE("nv_param_ check after reboot");
+  CompareParams(-1, valid_params, reloaded, eeprom);
+}
@@ -57,14 +57,14 @@ TEST(PidTest, Initialization) {
   auto kd = reinterpret_cast<Debug::Variable::Float*>(registry.find(2));
 
   EXPECT_EQ(kp->get(), 1.f);
-  EXPECT_STREQ(kp->name(), "pid_kp");
-  EXPECT_STREQ(kp->help(), "Proportional gain for help");
+  EXPECT_EQ(kp->name(), "pid_kp");
+  EXPECT_EQ(kp->help(), "Proportional gain for help");
   EXPECT_EQ(ki->get(), 2.f);
-  EXPECT_STREQ(ki->name(), "pid_ki");
-  EXPECT_STREQ(ki->help(), "Integral gain for help");
+  EXPECT_EQ(ki->name(), "pid_ki");
+  EXPECT_EQ(ki->help(), "Integral gain for help");
   EXPECT_EQ(kd->get(), 3.f);
-  EXPECT_STREQ(kd->name(), "pid_kd");
-  EXPECT_STREQ(kd->help(), "Derivative gain for help");
+  EXPECT_EQ(kd->name(), "pid_kd");
+  EXPECT_EQ(kd->help(), "Derivative gain for help");
 }
 
 TEST(PidTest, AccessSetViaDebug) {
@@ -25,9 +25,11 @@ limitations under the License.
 
 #include <assert.h>
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <iostream>
+#include <iterator>
 #include <string>
 
 #include "flow_integrator.h"
@@ -285,3 +287,145 @@ TEST(SensorTests, Calibration) {
                    typical_venturi.pressure_delta_to_flow(kPa(0.01f), air_density));
   EXPECT_NEAR(readings.fio2, 0.25f + 0.21f, ComparisonToleranceFIO2);
 }
+
+TEST(SensorTests, LowPassFilter) {
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::PatientPressure), volts(0.5f));
+  AnalogSensor sensor("lpf_test_", "for test", sensor_pin(Sensor::PatientPressure));
+  sensor.set_zero(hal);
+
+  // No filtering by default.
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::PatientPressure), volts(1.5f));
+  EXPECT_FLOAT_EQ(1.0f, sensor.read_diff_volts(hal));
+
+  // The filter starts from the current reading, then smooths out steps.
+  sensor.set_lpf_cutoff(CONTROL_LOOP_HZ / 10.0f);
+  EXPECT_NEAR(1.0f, sensor.read_diff_volts(hal), 0.001f);
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::PatientPressure), volts(0.5f));
+  float first = sensor.read_diff_volts(hal);
+  EXPECT_GT(first, 0.5f);
+  EXPECT_LT(first, 1.0f);
+  for (int i = 0; i < 100; ++i) sensor.read_diff_volts(hal);
+  EXPECT_NEAR(0.0f, sensor.read_diff_volts(hal), 0.001f);
+
+  // Disabling the filter takes effect immediately.
+  sensor.set_lpf_cutoff(0);
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::PatientPressure), volts(2.0f));
+  EXPECT_FLOAT_EQ(1.5f, sensor.read_diff_volts(hal));
+}
+
+TEST(SensorTests, FlowTable) {
+  VenturiFlowSensor venturi{"", "", nullptr, venturi_port_diameter, venturi_choke_diameter,
+                            venturi_correction};
+  auto flow = [&](float dp_kPa) {
+    return venturi.pressure_delta_to_flow(kPa(dp_kPa), air_density).ml_per_sec();
+  };
+  float formula_flow = flow(1.0f);
+
+  // Interpolation between points, extrapolation out of them, unused points are NaN.
+  FlowTable table;
+  std::fill(std::begin(table.dp_kPa), std::end(table.dp_kPa), NAN);
+  std::fill(std::begin(table.flow_ml_per_sec), std::end(table.flow_ml_per_sec), NAN);
+  const float dp[] = {-1, 0, 1, 4};
+  const float flows[] = {-900, 0, 1000, 2200};
+  std::copy(std::begin(dp), std::end(dp), table.dp_kPa);
+  std::copy(std::begin(flows), std::end(flows), table.flow_ml_per_sec);
+  EXPECT_EQ(4, table.points());
+
+  venturi.set_flow_table(table);
+  for (size_t i = 0; i < 4; ++i) EXPECT_FLOAT_EQ(flows[i], flow(dp[i]));
+  EXPECT_FLOAT_EQ(-450, flow(-0.5f));
+  EXPECT_FLOAT_EQ(500, flow(0.5f));
+  EXPECT_FLOAT_EQ(1600, flow(2.5f));
+  EXPECT_FLOAT_EQ(-1800, flow(-2));
+  EXPECT_FLOAT_EQ(2600, flow(5));
+
+  // All points used.
+  for (size_t i = 0; i < FlowTable::MaxPoints; ++i) {
+    table.dp_kPa[i] = static_cast<float>(i);
+    table.flow_ml_per_sec[i] = static_cast<float>(i * i);
+  }
+  EXPECT_EQ(FlowTable::MaxPoints, table.points());
+  venturi.set_flow_table(table);
+  EXPECT_FLOAT_EQ(14.5f * 14.5f + 0.25f, flow(14.5f));
+  EXPECT_FLOAT_EQ(15 * 15 + 29 * 2, flow(17));
+
+  // Tables need increasing pressures, otherwise the formula is used.
+  table.dp_kPa[1] = table.dp_kPa[0];
+  EXPECT_EQ(0, table.points());
+  venturi.set_flow_table(table);
+  EXPECT_FLOAT_EQ(formula_flow, flow(1.0f));
+  venturi.set_flow_table(FlowTable());
+  EXPECT_FLOAT_EQ(formula_flow, flow(1.0f));
+}
+
+TEST(SensorTests, LoadFlowTables) {
+  TestEeprom eeprom(0x50, 64, 8192);
+  NVParams::Handler nv_params;
+  nv_params.Init(&eeprom);
+
+  FlowTable table;
+  table.dp_kPa[0] = 0;
+  table.dp_kPa[1] = 1;
+  table.flow_ml_per_sec[0] = 0;
+  table.flow_ml_per_sec[1] = 123;
+  ASSERT_TRUE(nv_params.Set(offsetof(NVParams::Structure, outflow_flow_table), &table,
+                            sizeof(table)));
+
+  Voltage voltage_at_0kPa = MPXV5004_PressureToVoltage(kPa(0));
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::PatientPressure), MPXV5010_PressureToVoltage(kPa(0)));
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::OxygenInflowPressureDiff), voltage_at_0kPa);
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::AirInflowPressureDiff), voltage_at_0kPa);
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::OutflowPressureDiff), voltage_at_0kPa);
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::FIO2), FIO2ToVoltage(0.21f, atm(1.0f)));
+  Sensors sensors;
+  sensors.calibrate();
+  sensors.load_flow_tables(&nv_params);
+
+  // Only the outflow venturi has a table.
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::OutflowPressureDiff),
+                       MPXV5004_PressureToVoltage(kPa(2)));
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::AirInflowPressureDiff),
+                       MPXV5004_PressureToVoltage(kPa(2)));
+  SensorReadings readings = sensors.get_readings();
+  EXPECT_FLOW_NEAR(readings.outflow, ml_per_sec(246));
+  EXPECT_FLOW_NEAR(readings.air_inflow,
+                   typical_venturi.pressure_delta_to_flow(kPa(2), air_density));
+
+  // Nothing to store when the tables were not changed through debug variables.
+  uint8_t count;
+  nv_params.Get(offsetof(NVParams::Structure, count), &count, 1);
+  sensors.update_flow_tables(&nv_params);
+  uint8_t count_after;
+  nv_params.Get(offsetof(NVParams::Structure, count), &count_after, 1);
+  EXPECT_EQ(count, count_after);
+}
+
+TEST(SensorTests, WarmStartZeros) {
+  const Sensor sensor_order[] = {Sensor::PatientPressure, Sensor::AirInflowPressureDiff,
+                                 Sensor::OxygenInflowPressureDiff, Sensor::OutflowPressureDiff,
+                                 Sensor::FIO2};
+  for (size_t i = 0; i < NumSensors; ++i) {
+    hal.TESTSetAnalogPin(sensor_pin(sensor_order[i]), volts(0.5f + 0.25f * static_cast<float>(i)));
+  }
+  Sensors sensors;
+  sensors.calibrate();
+  NVParams::WarmStart params;
+  sensors.save_zeros(&params);
+  for (size_t i = 0; i < NumSensors; ++i) {
+    EXPECT_FLOAT_EQ(0.5f + 0.25f * static_cast<float>(i), params.sensor_zeros[i]);
+  }
+
+  // Restored zeros give the same readings as calibrating again.
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::PatientPressure), volts(2.0f));
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::OutflowPressureDiff), volts(0.1f));
+  Sensors restored;
+  restored.restore_zeros(params);
+  SensorReadings expected = sensors.get_readings();
+  SensorReadings readings = restored.get_readings();
+  EXPECT_PRESSURE_NEAR(expected.patient_pressure, readings.patient_pressure);
+  EXPECT_FLOW_NEAR(expected.air_inflow, readings.air_inflow);
+  EXPECT_FLOW_NEAR(expected.oxygen_inflow, readings.oxygen_inflow);
+  EXPECT_FLOW_NEAR(expected.outflow, readings.outflow);
+  EXPECT_NEAR(expected.fio2, readings.fio2, ComparisonToleranceFIO2);
+  EXPECT_LT(readings.outflow.ml_per_sec(), 0);
+}
@@ -0,0 +1,297 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Closed-loop tests of the controller against a simulated lung and pneumatic
+// system (see plant_model.h).
+//
+// The loop is driven entirely by simulated time, so a breath takes a fraction
+// of a millisecond of wall time, and we can afford to sweep through many
+// patient compliance/resistance combinations on every CI run.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <optional>
+#include <vector>
+
+#include "controller.h"
+#include "gtest/gtest.h"
+#include "plant_model.h"
+#include "sensors.h"
+
+// Converts venturi pressure deltas to flows the way the controller's sensors do.
+static const VenturiFlowSensor Venturi{"", "", nullptr, Sensors::VenturiPortDiameter,
+                                       Sensors::VenturiChokeDiameter, Sensors::VenturiCorrection};
+
+// Pressures and volumes observed over a single breath.
+struct BreathStats {
+  // Mean patient pressure over the second half of inspiration, where a
+  // pressure controlled breath should have reached its plateau.
+  Pressure pip{cmH2O(0)};
+  // Patient pressure at the very end of expiration.
+  Pressure peep{cmH2O(0)};
+  // Largest swing of the (true) lung volume over the breath.
+  Volume tidal_volume{ml(0)};
+  // Largest swing of the lung volume as estimated by the controller.
+  Volume estimated_tidal_volume{ml(0)};
+};
+
+// Runs a Controller against a PlantModel, at the controller's loop period.
+class ClosedLoopSimulation {
+ public:
+  explicit ClosedLoopSimulation(const PatientParams &patient) : plant_(patient) {}
+
+  // Simulate the given number of breaths with fixed params, and return the
+  // statistics of each of them.
+  std::vector<BreathStats> run(const VentParams &params, int breaths) {
+    std::vector<BreathStats> stats;
+    // Samples of the breath in progress
+    std::vector<Pressure> insp_pressures;
+    float volume_min = 0, volume_max = 0, estimated_min = 0, estimated_max = 0;
+    std::optional<uint32_t> breath_id;
+    Pressure last_pressure = cmH2O(0);
+
+    auto reset_breath = [&](float volume, float estimated) {
+      insp_pressures.clear();
+      volume_min = volume_max = volume;
+      estimated_min = estimated_max = estimated;
+    };
+
+    while (static_cast<int>(stats.size()) < breaths) {
+      auto cycle_start = std::chrono::steady_clock::now();
+      const PlantOutputs &out = plant_.outputs();
+      SensorReadings readings = {
+          .patient_pressure = out.patient_pressure,
+          .fio2 = out.fio2,
+          .air_inflow = sensed_flow(out.air_inflow),
+          .oxygen_inflow = sensed_flow(out.oxygen_inflow),
+          .outflow = sensed_flow(out.outflow),
+      };
+      auto [actuators, status] = controller_.Run(plant_.now(), params, readings);
+      if (cycle_micros_ != nullptr) {
+        cycle_micros_->push_back(std::chrono::duration<float, std::micro>(
+                                     std::chrono::steady_clock::now() - cycle_start)
+                                     .count());
+      }
+
+      if (breath_id != status.breath_id) {
+        // The controller notes the end of breath one cycle after the last
+        // sample of the previous breath, so last_pressure is end-expiratory.
+        if (breath_id.has_value()) {
+          stats.push_back(close_breath(insp_pressures, last_pressure, volume_max - volume_min,
+                                       estimated_max - estimated_min));
+        }
+        breath_id = status.breath_id;
+        reset_breath(out.lung_volume.ml(), status.patient_volume.ml());
+      }
+      if (status.pressure_setpoint > cmH2O(static_cast<float>(params.peep_cm_h2o))) {
+        insp_pressures.push_back(out.patient_pressure);
+        float error = (out.patient_pressure - status.pressure_setpoint).cmH2O();
+        tracking_error_ += error * error * Controller::GetLoopPeriod().seconds();
+        tracking_time_ += Controller::GetLoopPeriod().seconds();
+      }
+      volume_min = std::min(volume_min, out.lung_volume.ml());
+      volume_max = std::max(volume_max, out.lung_volume.ml());
+      estimated_min = std::min(estimated_min, status.patient_volume.ml());
+      estimated_max = std::max(estimated_max, status.patient_volume.ml());
+      last_pressure = out.patient_pressure;
+
+      plant_.advance(Controller::GetLoopPeriod(),
+                     {.blower_power = actuators.blower_power,
+                      .blower_valve = actuators.blower_valve.value_or(0),
+                      .exhale_valve = actuators.exhale_valve.value_or(1),
+                      .fio2_valve = actuators.fio2_valve});
+    }
+    return stats;
+  }
+
+  Duration simulated_time() const { return plant_.now() - microsSinceStartup(0); }
+
+  // Makes run() append to micros the host time each control cycle takes, in microseconds: the
+  // sensor flow conversions and Controller::Run, which is the part of HighPriorityTask that runs
+  // natively.
+  void time_cycles(std::vector<float> *micros) { cycle_micros_ = micros; }
+
+  // Root mean square of the difference between patient pressure and its
+  // setpoint during inspiration, in cmH2O.
+  float rms_tracking_error() const { return std::sqrt(tracking_error_ / tracking_time_); }
+
+ private:
+  // Flow as seen by the controller: the plant's flow converted to a venturi
+  // pressure delta, then back to a flow using the controller's sensor math.
+  VolumetricFlow sensed_flow(VolumetricFlow flow) const {
+    return Venturi.pressure_delta_to_flow(plant_.venturi_pressure_delta(flow), Sensors::AirDensity);
+  }
+
+  static BreathStats close_breath(const std::vector<Pressure> &insp,
+                                  Pressure end_pressure, float tidal, float estimated_tidal) {
+    BreathStats stats;
+    // Skip the first half of inspiration, which includes the rise time.
+    size_t start = insp.size() / 2;
+    float sum = 0;
+    for (size_t i = start; i < insp.size(); ++i) sum += insp[i].cmH2O();
+    if (insp.size() > start) stats.pip = cmH2O(sum / static_cast<float>(insp.size() - start));
+    stats.peep = end_pressure;
+    stats.tidal_volume = ml(tidal);
+    stats.estimated_tidal_volume = ml(estimated_tidal);
+    return stats;
+  }
+
+  PlantModel plant_;
+  Controller controller_;
+  std::vector<float> *cycle_micros_{nullptr};
+
+  float tracking_error_{0};
+  float tracking_time_{0};
+};
+
+static VentParams PressureControlParams(uint32_t peep, uint32_t pip) {
+  VentParams params = VentParams_init_zero;
+  params.mode = VentMode::VentMode_PRESSURE_CONTROL;
+  params.peep_cm_h2o = peep;
+  params.pip_cm_h2o = pip;
+  params.breaths_per_min = 15;
+  params.inspiratory_expiratory_ratio = 1;
+  params.fio2 = 0.21f;
+  return params;
+}
+
+TEST(ClosedLoopSimulation, PressureControlAcrossPatients) {
+  constexpr int Breaths{8};
+  // Breaths ignored while the loop settles.
+  constexpr int SettlingBreaths{3};
+  constexpr float PipTolerance{2.0f};     // cmH2O
+  constexpr float PeepTolerance{2.0f};    // cmH2O
+  constexpr float VolumeTolerance{0.1f};  // relative
+
+  const std::vector<float> compliances = {10, 20, 35, 50, 75, 100};  // ml/cmH2O
+  const std::vector<float> resistances = {5, 10, 20, 50};            // cmH2O/(l/s)
+  const VentParams params = PressureControlParams(/*peep=*/5, /*pip=*/20);
+
+  for (float compliance : compliances) {
+    for (float resistance : resistances) {
+      SCOPED_TRACE("compliance = " + std::to_string(compliance) +
+                   " ml/cmH2O, resistance = " + std::to_string(resistance) + " cmH2O/(l/s)");
+      ClosedLoopSimulation sim(
+          {.compliance_ml_per_cmH2O = compliance, .resistance_cmH2O_per_lps = resistance});
+      std::vector<BreathStats> breaths = sim.run(params, Breaths);
+
+      for (int i = SettlingBreaths; i < Breaths; ++i) {
+        SCOPED_TRACE("breath " + std::to_string(i));
+        EXPECT_NEAR(breaths[i].pip.cmH2O(), static_cast<float>(params.pip_cm_h2o), PipTolerance);
+        EXPECT_NEAR(breaths[i].peep.cmH2O(), static_cast<float>(params.peep_cm_h2o),
+                    PeepTolerance);
+        // The controller's volume estimate should track the real lung.
+        EXPECT_NEAR(breaths[i].estimated_tidal_volume.ml(), breaths[i].tidal_volume.ml(),
+                    VolumeTolerance * breaths[i].tidal_volume.ml());
+      }
+    }
+  }
+}
+
+TEST(ClosedLoopSimulation, PressureControlPureOxygen) {
+  constexpr int Breaths{6};
+  constexpr int SettlingBreaths{3};
+  constexpr float PipTolerance{2.0f};   // cmH2O
+  constexpr float PeepTolerance{2.0f};  // cmH2O
+
+  VentParams params = PressureControlParams(/*peep=*/5, /*pip=*/20);
+  params.fio2 = 1.0f;
+
+  for (float compliance : {20.0f, 50.0f}) {
+    SCOPED_TRACE("compliance = " + std::to_string(compliance) + " ml/cmH2O");
+    ClosedLoopSimulation sim(
+        {.compliance_ml_per_cmH2O = compliance, .resistance_cmH2O_per_lps = 10.0f});
+    std::vector<BreathStats> breaths = sim.run(params, Breaths);
+    for (int i = SettlingBreaths; i < Breaths; ++i) {
+      SCOPED_TRACE("breath " + std::to_string(i));
+      EXPECT_NEAR(breaths[i].pip.cmH2O(), static_cast<float>(params.pip_cm_h2o), PipTolerance);
+      EXPECT_NEAR(breaths[i].peep.cmH2O(), static_cast<float>(params.peep_cm_h2o), PeepTolerance);
+    }
+  }
+}
+
+TEST(ClosedLoopSimulation, PressureAssistFollowsPatientEffort) {
+  constexpr float BackupRate{6.0f};    // breaths/min
+  constexpr float PatientRate{20.0f};  // breaths/min
+  constexpr int Breaths{12};
+
+  VentParams params = PressureControlParams(/*peep=*/5, /*pip=*/15);
+  params.mode = VentMode::VentMode_PRESSURE_ASSIST;
+  params.breaths_per_min = static_cast<uint32_t>(BackupRate);
+  // Keep inspiration shorter than the patient's breathing period.
+  params.inspiratory_expiratory_ratio = 0.25f;
+
+  ClosedLoopSimulation sim({.compliance_ml_per_cmH2O = 50.0f,
+                            .resistance_cmH2O_per_lps = 10.0f,
+                            .effort_amplitude = cmH2O(5.0f),
+                            .effort_breaths_per_min = PatientRate});
+  sim.run(params, Breaths);
+
+  float rate = static_cast<float>(Breaths) / sim.simulated_time().minutes();
+  // The ventilator should be triggered by the patient rather than by its backup
+  // rate.
+  EXPECT_GT(rate, 1.5f * BackupRate);
+}
+
+// The controller should behave the same at any of the supported loop rates.  This runs at the rate
+// the test was built with, so it's built once per rate (see the native-*hz environments in
+// platformio.ini), each time with the rate dependent constants of the controller.
+TEST(ClosedLoopSimulation, LoopRate) {
+  constexpr int Breaths{6};
+  constexpr int SettlingBreaths{3};
+  constexpr float PipTolerance{2.0f};   // cmH2O
+  constexpr float PeepTolerance{2.0f};  // cmH2O
+  constexpr float MaxTrackingError{2.5f};  // cmH2O rms
+
+  const VentParams params = PressureControlParams(/*peep=*/5, /*pip=*/20);
+
+  SCOPED_TRACE("rate = " + std::to_string(CONTROL_LOOP_HZ) + " Hz");
+  // Stiff lungs, where the pressure rise is the fastest.
+  ClosedLoopSimulation sim({.compliance_ml_per_cmH2O = 10.0f, .resistance_cmH2O_per_lps = 5.0f});
+  std::vector<BreathStats> breaths = sim.run(params, Breaths);
+  for (int i = SettlingBreaths; i < Breaths; ++i) {
+    SCOPED_TRACE("breath " + std::to_string(i));
+    EXPECT_NEAR(breaths[i].pip.cmH2O(), static_cast<float>(params.pip_cm_h2o), PipTolerance);
+    EXPECT_NEAR(breaths[i].peep.cmH2O(), static_cast<float>(params.peep_cm_h2o), PeepTolerance);
+  }
+  EXPECT_LT(sim.rms_tracking_error(), MaxTrackingError);
+}
+
+// Checks that a control cycle fits in the loop period, at the rate the test was built with.  This
+// depends on the machine running it, so it's a benchmark to run on demand, e.g. for the fastest
+// rate:
+//
+//   GTEST_ALSO_RUN_DISABLED_TESTS=1 pio test -e native-1000hz -f simulator
+//
+// The host is much faster than the STM32, and HighPriorityTask also reads the ADC, drives the
+// actuators and samples traces, so the controller only gets a fraction of the period here.  On
+// target, the loop_hist_* debug vars measure the whole task.
+TEST(ClosedLoopSimulation, DISABLED_LoopBudget) {
+  constexpr float BudgetFraction{0.1f};
+  constexpr int Breaths{6};
+
+  SCOPED_TRACE("rate = " + std::to_string(CONTROL_LOOP_HZ) + " Hz");
+  std::vector<float> cycle_micros;
+  ClosedLoopSimulation sim({.compliance_ml_per_cmH2O = 10.0f, .resistance_cmH2O_per_lps = 5.0f});
+  sim.time_cycles(&cycle_micros);
+  sim.run(PressureControlParams(/*peep=*/5, /*pip=*/20), Breaths);
+
+  // The slowest cycles are mostly the host being busy with something else, so this checks the 99th
+  // percentile rather than the maximum.
+  std::sort(cycle_micros.begin(), cycle_micros.end());
+  float p99 = cycle_micros[cycle_micros.size() * 99 / 100];
+  EXPECT_LT(p99, BudgetFraction * static_cast<float>(Controller::GetLoopPeriod().microseconds()));
+}
@@ -0,0 +1,197 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "spsc_ring.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+// Test the buffer counts and rollover
+TEST(SpscRing, Counts) {
+  constexpr size_t BufferSize = 128;
+  SpscRing<uint8_t, BufferSize> buff;
+
+  ASSERT_EQ(buff.FreeCount(), BufferSize);
+  ASSERT_EQ(buff.FullCount(), 0);
+
+  // Add/remove bytes enough times for the buffer to wrap around several times.
+  for (int i = 0; i < 100; i++) {
+    for (size_t j = 0; j < 20; j++) {
+      ASSERT_TRUE(buff.Put(static_cast<uint8_t>(j)));
+      ASSERT_EQ(buff.FreeCount(), BufferSize - j - 1);
+      ASSERT_EQ(buff.FullCount(), j + 1);
+    }
+    for (size_t j = 0; j < 20; j++) {
+      std::optional<uint8_t> ch = buff.Get();
+      ASSERT_EQ(*ch, static_cast<uint8_t>(j));
+      ASSERT_EQ(buff.FullCount(), 19 - j);
+    }
+  }
+}
+
+TEST(SpscRing, Full) {
+  constexpr size_t BufferSize = 8;
+  SpscRing<uint8_t, BufferSize> buff;
+
+  // All elements are usable
+  for (size_t i = 0; i < BufferSize; i++) ASSERT_TRUE(buff.Put(static_cast<uint8_t>(i)));
+  ASSERT_FALSE(buff.Put(0));
+  ASSERT_EQ(buff.FullCount(), BufferSize);
+  ASSERT_EQ(buff.FreeCount(), 0);
+  ASSERT_EQ(buff.WriteSpan().size, 0);
+
+  for (size_t i = 0; i < BufferSize; i++) ASSERT_EQ(buff.Get(), static_cast<uint8_t>(i));
+  ASSERT_EQ(buff.Get(), std::nullopt);
+  ASSERT_EQ(buff.ReadSpan().size, 0);
+
+  // Flush drops everything
+  ASSERT_TRUE(buff.Put(1));
+  ASSERT_TRUE(buff.Put(2));
+  buff.Flush();
+  ASSERT_EQ(buff.FullCount(), 0);
+  ASSERT_EQ(buff.FreeCount(), BufferSize);
+  ASSERT_EQ(buff.Get(), std::nullopt);
+}
+
+TEST(SpscRing, Spans) {
+  constexpr size_t BufferSize = 8;
+  SpscRing<uint8_t, BufferSize> buff;
+
+  // Move head and tail to the middle of the storage
+  uint8_t data[BufferSize] = {0};
+  ASSERT_EQ(buff.Write(data, 5), 5);
+  ASSERT_EQ(buff.Read(data, 5), 5);
+
+  // The free space wraps around: the first span stops at the end of the storage
+  Span<uint8_t> write_span = buff.WriteSpan();
+  ASSERT_EQ(write_span.size, 3);
+  for (size_t i = 0; i < write_span.size; i++) write_span.data[i] = static_cast<uint8_t>(10 + i);
+  buff.CommitWrite(2);
+  ASSERT_EQ(buff.FullCount(), 2);
+  write_span = buff.WriteSpan();
+  ASSERT_EQ(write_span.size, 1);
+  write_span.data[0] = 12;
+  buff.CommitWrite(1);
+  write_span = buff.WriteSpan();
+  ASSERT_EQ(write_span.size, 5);
+  for (size_t i = 0; i < write_span.size; i++) write_span.data[i] = static_cast<uint8_t>(13 + i);
+  buff.CommitWrite(5);
+  ASSERT_EQ(buff.FreeCount(), 0);
+
+  Span<const uint8_t> read_span = buff.ReadSpan();
+  ASSERT_EQ(read_span.size, 3);
+  ASSERT_EQ(read_span.data[0], 10);
+  buff.Consume(3);
+  read_span = buff.ReadSpan();
+  ASSERT_EQ(read_span.size, 5);
+  for (size_t i = 0; i < read_span.size; i++) ASSERT_EQ(read_span.data[i], 13 + i);
+  buff.Consume(5);
+  ASSERT_EQ(buff.FullCount(), 0);
+}
+
+// Sizes don't need to be powers of 2.
+TEST(SpscRing, AnySize) {
+  constexpr size_t BufferSize = 5;
+  SpscRing<uint8_t, BufferSize> buff;
+
+  // Go around the buffer enough times for the counters to wrap around.
+  for (uint8_t i = 0; i < 100; i++) {
+    for (uint8_t j = 0; j < 3; j++) ASSERT_TRUE(buff.Put(static_cast<uint8_t>(i + j)));
+    ASSERT_EQ(buff.FullCount(), 3);
+    Span<const uint8_t> read_span = buff.ReadSpan();
+    ASSERT_EQ(read_span.data[0], i);
+    ASSERT_EQ(read_span.size, std::min<size_t>(3, BufferSize - (3 * i) % BufferSize));
+    for (uint8_t j = 0; j < 3; j++) ASSERT_EQ(buff.Get(), static_cast<uint8_t>(i + j));
+    ASSERT_EQ(buff.FullCount(), 0);
+  }
+
+  for (size_t i = 0; i < BufferSize; i++) ASSERT_TRUE(buff.Put(static_cast<uint8_t>(i)));
+  ASSERT_FALSE(buff.Put(0));
+  ASSERT_EQ(buff.FreeCount(), 0);
+  ASSERT_EQ(buff.WriteSpan().size, 0);
+}
+
+// Make sure bulk copies work across the end of the storage, and are partial when they don't fit.
+TEST(SpscRing, BulkDataIO) {
+  constexpr size_t BufferSize = 256;
+  SpscRing<uint8_t, BufferSize> buff;
+
+  std::vector<uint8_t> test_set(10 * BufferSize);
+  for (auto &x : test_set) x = static_cast<uint8_t>(rand());
+
+  size_t written = 0, read = 0;
+  std::vector<uint8_t> result(test_set.size());
+  while (read < test_set.size()) {
+    size_t free = buff.FreeCount();
+    size_t count = std::min<size_t>(100, test_set.size() - written);
+    ASSERT_EQ(buff.Write(&test_set[written], count), std::min(count, free));
+    written += std::min(count, free);
+
+    size_t full = buff.FullCount();
+    ASSERT_EQ(buff.Read(&result[read], 70), std::min<size_t>(70, full));
+    read += std::min<size_t>(70, full);
+  }
+  ASSERT_EQ(result, test_set);
+}
+
+// Hammers the buffer from a producer and a consumer thread, which is best run with the thread
+// sanitizer (see the native-tsan environment in platformio.ini).
+TEST(SpscRing, TwoThreads) {
+  constexpr uint32_t Count = 200000;
+  SpscRing<uint32_t, 64> buff;
+
+  std::thread producer([&] {
+    uint32_t next = 0;
+    while (next < Count) {
+      // Alternate between element-wise and bulk writes.
+      uint32_t written = 0;
+      if (next % 3) {
+        written = buff.Put(next) ? 1 : 0;
+      } else {
+        uint32_t data[5];
+        for (uint32_t i = 0; i < 5; ++i) data[i] = next + i;
+        written = static_cast<uint32_t>(buff.Write(data, std::min<uint32_t>(5, Count - next)));
+      }
+      // Let the consumer run when the buffer is full.
+      if (!written) std::this_thread::yield();
+      next += written;
+    }
+  });
+
+  uint32_t expected = 0;
+  bool in_order = true;
+  while (expected < Count) {
+    if (buff.FullCount() == 0) {
+      std::this_thread::yield();
+    } else if (expected % 2) {
+      std::optional<uint32_t> value = buff.Get();
+      if (value) in_order &= (*value == expected++);
+    } else {
+      Span<const uint32_t> span = buff.ReadSpan();
+      for (size_t i = 0; i < span.size; ++i) in_order &= (span.data[i] == expected++);
+      buff.Consume(span.size);
+    }
+  }
+  producer.join();
+
+  EXPECT_TRUE(in_order);
+  EXPECT_EQ(buff.FullCount(), 0);
+}
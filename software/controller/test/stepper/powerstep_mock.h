@@ -0,0 +1,274 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "spi_bus_sim.h"
+
+// Simulation of an L6470 / powerSTEP01 stepper driver chip and of its motor, as seen from the SPI
+// bus, used to check what StepMotor sends.
+//
+// Bytes are decoded the way the chip does, and the commands received are logged.  The motor
+// moves as the chip would drive it, following the acceleration, deceleration and max speed
+// registers, one Advance at a time.  Only the commands StepMotor uses are supported, others are
+// logged and flagged in the status as wrong commands.  Registers other than those used for the
+// motion start at 0.
+class PowerStepMock : public StepperSpiDevice {
+ public:
+  struct Command {
+    uint8_t opcode;
+    uint32_t argument;  // Argument bytes, MSB first
+
+    bool operator==(const Command &other) const {
+      return opcode == other.opcode && argument == other.argument;
+    }
+  };
+
+  // Commands received (not counting Nop), and number of bytes received.
+  std::vector<Command> commands;
+  int bytes_received{0};
+
+  PowerStepMock() { ResetDevice(); }
+
+  uint8_t Transfer(uint8_t byte) override {
+    bytes_received++;
+
+    // Start of a command
+    if (argument_len_ == 0) {
+      opcode_ = byte;
+      argument_ = 0;
+      received_ = 0;
+      argument_len_ = ArgumentLength(byte);
+      if ((byte & 0xE0) == 0x20) response_ = ReadRegister(byte & 0x1F);
+      if (byte == GetStatus) response_ = Status();
+      if (argument_len_ == 0) Execute();
+      return 0;
+    }
+
+    // Argument bytes, during which the chip sends out the response to reads
+    argument_ = argument_ << 8 | byte;
+    received_++;
+    uint8_t out = static_cast<uint8_t>(response_ >> (8 * (argument_len_ - received_)));
+    if (received_ == argument_len_) {
+      argument_len_ = 0;
+      Execute();
+    }
+    return out;
+  }
+
+  // Moves the motor for the passed time.
+  void Advance(float seconds) {
+    static constexpr double Tick = 1e-5;
+    for (double t = Tick / 2; t < seconds; t += Tick) Move(Tick);
+  }
+
+  // Position of the motor in deg, for a 200 steps/rev motor, and a way to move it behind the
+  // chip's back (as happens when steps are lost).
+  double degrees() const { return position_ * 360.0 / (200 * MicrostepPerStep); }
+  void Displace(double deg) { position_ += deg * 200 * MicrostepPerStep / 360.0; }
+
+  bool stopped() const { return speed_ == 0 && mode_ != Mode::Positioning; }
+
+ private:
+  enum class Mode { Stopped, Running, Positioning };
+
+  static constexpr uint8_t GetStatus = 0xD0;
+  static constexpr int MicrostepPerStep = 128;
+
+  // Register numbers, and factors to convert steps/sec and steps/sec/sec to register values.
+  static constexpr int AbsPos = 0x01;
+  static constexpr int Acc = 0x05;
+  static constexpr int Dec = 0x06;
+  static constexpr int MaxSpeed = 0x07;
+  static constexpr double TickTime = 250e-9;
+  static constexpr double RunSpeedUnit = TickTime * (1 << 28);
+  static constexpr double MaxSpeedUnit = TickTime * (1 << 18);
+  static constexpr double AccelUnit = TickTime * TickTime * 1099511627776.0;
+
+  static int ParamLength(int param) {
+    static constexpr uint8_t Length[32] = {0, 3, 2, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 2, 1, 1,
+                                           1, 1, 1, 1, 1, 2, 1, 1, 2, 1, 2, 2, 0, 0, 0, 0};
+    return Length[param];
+  }
+
+  static int ArgumentLength(uint8_t opcode) {
+    if ((opcode & 0xE0) == 0x00 || (opcode & 0xE0) == 0x20) return ParamLength(opcode & 0x1F);
+    switch (opcode) {
+      case 0x50:  // Run
+      case 0x51:
+      case 0x40:  // Move
+      case 0x41:
+      case 0x60:  // GoTo
+        return 3;
+      case GetStatus:
+        return 2;
+      default:
+        return 0;
+    }
+  }
+
+  static int32_t SignExtend22(uint32_t value) { return static_cast<int32_t>(value << 10) >> 10; }
+
+  uint32_t ReadRegister(int param) const {
+    if (param == AbsPos) return static_cast<uint32_t>(std::lround(position_)) & 0x3FFFFF;
+    return registers_[param];
+  }
+
+  uint16_t Status() const {
+    // The under voltage, thermal, over current and step loss flags are active low.
+    uint16_t status = 0x7E00;
+    if (hiz_) status |= 0x0001;
+    if (speed_ >= 0) status |= 0x0010;
+    if (speed_ != 0) status |= move_status_;
+    if (wrong_command_) status |= 0x0100;
+    return status;
+  }
+
+  void ResetDevice() {
+    std::fill(std::begin(registers_), std::end(registers_), 0);
+    registers_[Acc] = 0x08A;
+    registers_[Dec] = 0x08A;
+    registers_[MaxSpeed] = 0x041;
+    position_ = 0;
+    speed_ = 0;
+    mode_ = Mode::Stopped;
+    hiz_ = true;
+    hiz_when_stopped_ = false;
+  }
+
+  void Execute() {
+    if (opcode_ == 0) return;
+    commands.push_back({opcode_, argument_});
+
+    bool negative = (opcode_ & 1) == 0;
+    double steps = static_cast<double>(argument_) / RunSpeedUnit;
+    switch (opcode_) {
+      case 0x50:  // Run
+      case 0x51:
+        Drive(Mode::Running);
+        target_speed_ = std::min(steps, registers_[MaxSpeed] / MaxSpeedUnit);
+        if (negative) target_speed_ = -target_speed_;
+        break;
+      case 0x40:  // Move
+      case 0x41:
+        Drive(Mode::Positioning);
+        target_position_ = position_ + (negative ? -1.0 : 1.0) * argument_;
+        break;
+      case 0x60:  // GoTo
+        Drive(Mode::Positioning);
+        target_position_ = SignExtend22(argument_);
+        break;
+      case 0xD8:  // ResetPos
+        position_ = 0;
+        break;
+      case 0xC0:  // ResetDevice
+        ResetDevice();
+        break;
+      case 0xB0:  // SoftStop
+      case 0xA0:  // SoftHiZ
+        Drive(Mode::Running);
+        target_speed_ = 0;
+        hiz_when_stopped_ = opcode_ == 0xA0;
+        break;
+      case 0xB8:  // HardStop
+      case 0xA8:  // HardHiZ
+        Drive(Mode::Stopped);
+        speed_ = 0;
+        hiz_ = opcode_ == 0xA8;
+        break;
+      case GetStatus:
+        wrong_command_ = false;
+        break;
+      default:
+        if ((opcode_ & 0xE0) == 0x00) {
+          int param = opcode_ & 0x1F;
+          if (param == AbsPos)
+            position_ = SignExtend22(argument_);
+          else
+            registers_[param] = argument_;
+        } else if ((opcode_ & 0xE0) != 0x20) {
+          wrong_command_ = true;
+        }
+        break;
+    }
+  }
+
+  void Drive(Mode mode) {
+    mode_ = mode;
+    hiz_ = false;
+    hiz_when_stopped_ = false;
+  }
+
+  // Moves the motor for a short time, changing its speed as the chip would.
+  void Move(double dt) {
+    if (hiz_) return;
+
+    double max_speed = registers_[MaxSpeed] / MaxSpeedUnit;
+    double target = 0;
+    if (mode_ == Mode::Running) {
+      target = target_speed_;
+    } else if (mode_ == Mode::Positioning) {
+      // As fast as possible while still being able to stop at the target
+      double remaining = (target_position_ - position_) / MicrostepPerStep;
+      double stop_speed = std::sqrt(2 * registers_[Dec] / AccelUnit * std::fabs(remaining));
+      target = std::copysign(std::min(max_speed, stop_speed), remaining);
+      if (std::fabs(target_position_ - position_) <= std::fabs(speed_) * dt * MicrostepPerStep ||
+          std::fabs(target_position_ - position_) < 0.5) {
+        position_ = target_position_;
+        speed_ = 0;
+        mode_ = Mode::Stopped;
+        return;
+      }
+    }
+
+    // The speed ramps up at the acceleration, and down at the deceleration.
+    bool speeding_up = std::fabs(target) > std::fabs(speed_) && target * speed_ >= 0;
+    double rate = (speeding_up ? registers_[Acc] : registers_[Dec]) / AccelUnit * dt;
+    double change = std::clamp(target - speed_, -rate, rate);
+    speed_ += change;
+    if (change == 0)
+      move_status_ = 0x60;
+    else
+      move_status_ = speeding_up ? 0x20 : 0x40;
+
+    position_ += speed_ * dt * MicrostepPerStep;
+    if (speed_ == 0 && hiz_when_stopped_) hiz_ = true;
+  }
+
+  uint32_t registers_[32];
+
+  // Command being received
+  uint8_t opcode_{0};
+  uint32_t argument_{0};
+  int argument_len_{0};
+  int received_{0};
+  uint32_t response_{0};
+
+  // Motion, in microsteps and steps/sec
+  Mode mode_{Mode::Stopped};
+  double position_{0};
+  double speed_{0};
+  double target_speed_{0};
+  double target_position_{0};
+  uint16_t move_status_{0};
+  bool hiz_{true};
+  bool hiz_when_stopped_{false};
+  bool wrong_command_{false};
+};
@@ -0,0 +1,97 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "stepper.h"
+
+// A stepper driver chip on the SPI bus.
+class StepperSpiDevice {
+ public:
+  virtual ~StepperSpiDevice() = default;
+
+  // Receives a byte sent to the chip, and returns the byte the chip sends back at the same time.
+  virtual uint8_t Transfer(uint8_t byte) = 0;
+};
+
+// Simulation of the SPI bus to the daisy chain of stepper driver chips, with its timing.
+//
+// Each transfer takes 8 bit times per byte, at the 5MHz clock StepMotor sets up, and the chip
+// select then stays high for CsHighTime before the next transfer can start.  That covers the time
+// the chips need between transfers and the time it takes to handle the DMA interrupt.  Transfers
+// are logged with their timing and the bytes sent, and the time only moves forward when the bus
+// is run (or waited on by StepMotor).
+class StepperBusSim : public StepperSpiBus {
+ public:
+  static constexpr double BitTime = 0.2e-6;
+  static constexpr double CsHighTime = 2e-6;
+
+  struct Transfer {
+    double start;
+    double end;
+    std::vector<uint8_t> bytes;  // Sent, the first one to chips[0]
+  };
+  std::vector<Transfer> transfers;
+
+  explicit StepperBusSim(std::vector<StepperSpiDevice *> chips) : chips_(std::move(chips)) {}
+
+  void StartTransfer(uint8_t *buff, int len) override {
+    buff_ = buff;
+    len_ = len;
+    double start = std::max(now_, ready_);
+    transfers.push_back({start, start + len * 8 * BitTime, {buff, buff + len}});
+  }
+
+  void Wait() override {
+    if (buff_) Complete();
+  }
+
+  // Runs the bus until the passed time.
+  void RunUntil(double time) {
+    while (buff_ && transfers.back().end <= time) Complete();
+    now_ = std::max(now_, time);
+  }
+
+  // Runs the bus until it's idle.
+  void Finish() {
+    while (buff_) Complete();
+  }
+
+  bool busy() const { return buff_ != nullptr; }
+  double now() const { return now_; }
+
+ private:
+  void Complete() {
+    uint8_t *buff = buff_;
+    buff_ = nullptr;
+    now_ = transfers.back().end;
+    ready_ = now_ + CsHighTime;
+    for (int i = 0; i < len_; i++) {
+      buff[i] = i < static_cast<int>(chips_.size()) ? chips_[i]->Transfer(buff[i]) : 0;
+    }
+    StepMotor::DmaISR();
+  }
+
+  std::vector<StepperSpiDevice *> chips_;
+  uint8_t *buff_{nullptr};
+  int len_{0};
+  double now_{0};
+  double ready_{0};
+};
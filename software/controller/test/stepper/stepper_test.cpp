@@ -15,7 +15,18 @@ limitations under the License.
 
 #include "stepper.h"
 
+#include <cmath>
+#include <functional>
+#include <utility>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "hal.h"
+#include "pinch_valve.h"
+#include "powerstep_mock.h"
+#include "spi_bus_sim.h"
+
+using Command = PowerStepMock::Command;
 
 // Not really tests, just silencing code coverage warning for native build
 TEST(Stepper, TestStubs) {
@@ -28,4 +39,412 @@ TEST(Stepper, TestStubs) {
   EXPECT_EQ(StepMtrErr::Ok, step_motor.ClearPosition());
   EXPECT_EQ(StepMtrErr::Ok, step_motor.GotoPos(0.0));
   EXPECT_EQ(StepMtrErr::Ok, step_motor.HardStop());
+  float position;
+  EXPECT_EQ(StepMtrErr::Ok, step_motor.GetPosition(&position));
+  StepperStatus status;
+  EXPECT_EQ(StepMtrErr::Ok, step_motor.GetStatus(&status));
+}
+
+TEST(Stepper, Commands) {
+  PowerStepMock chip;
+  StepperBusSim bus({&chip});
+  StepMotor::TESTConnect(&bus, 1);
+  ASSERT_EQ(nullptr, StepMotor::GetStepper(1));
+  StepMotor *motor = StepMotor::GetStepper(0);
+  ASSERT_NE(nullptr, motor);
+
+  EXPECT_EQ(StepMtrErr::Ok, motor->SetMaxSpeed(2000));
+  EXPECT_EQ(StepMtrErr::Ok, motor->SetAccel(40000));
+  EXPECT_EQ(StepMtrErr::Ok, motor->SetAmpHold(0.5f));
+  EXPECT_EQ(StepMtrErr::Ok, motor->MoveRel(90));
+  EXPECT_EQ(StepMtrErr::Ok, motor->GotoPos(-45));
+  EXPECT_EQ(StepMtrErr::Ok, motor->RunAtVelocity(-360));
+  EXPECT_EQ(StepMtrErr::Ok, motor->SoftStop());
+  EXPECT_EQ(StepMtrErr::Ok, motor->HardStop());
+  EXPECT_EQ(StepMtrErr::Ok, motor->ClearPosition());
+  EXPECT_EQ(StepMtrErr::Ok, motor->HardDisable());
+  EXPECT_EQ(StepMtrErr::Ok, motor->Reset());
+
+  // 200 steps/rev, 128 microsteps/step
+  std::vector<Command> expected = {
+      {0x07, 72},        // Max speed, 1111 steps/sec
+      {0x05, 0x5F7},     // Acceleration, 22222 steps/sec/sec
+      {0x06, 0x5F7},     // Deceleration
+      {0x09, 127},       // Holding amplitude
+      {0x41, 6400},      // Move positive 6400 microsteps
+      {0x60, 0xFFF380},  // GoTo -3200 microsteps
+      {0x50, 13421},     // Run negative 200 steps/sec
+      {0xB0, 0},         // SoftStop
+      {0xB8, 0},         // HardStop
+      {0xD8, 0},         // ResetPos
+      {0xA8, 0},         // HardHiZ
+      {0xC0, 0},         // ResetDevice
+  };
+  EXPECT_EQ(expected, chip.commands);
+  EXPECT_EQ(3 + 3 + 3 + 2 + 4 + 4 + 4 + 5, chip.bytes_received);
+}
+
+TEST(Stepper, Reads) {
+  PowerStepMock chip;
+  StepperBusSim bus({&chip});
+  StepMotor::TESTConnect(&bus, 1);
+  StepMotor *motor = StepMotor::GetStepper(0);
+
+  float max_speed;
+  EXPECT_EQ(StepMtrErr::Ok, motor->SetMaxSpeed(2000));
+  EXPECT_EQ(StepMtrErr::Ok, motor->GetMaxSpeed(&max_speed));
+  EXPECT_NEAR(2000, max_speed, 30);
+
+  // Reset disables the outputs, any move enables them.
+  StepperStatus status;
+  EXPECT_EQ(StepMtrErr::Ok, motor->GetStatus(&status));
+  EXPECT_FALSE(status.enabled);
+  EXPECT_EQ(StepMtrErr::Ok, motor->GotoPos(-45));
+  chip.Advance(0.01f);
+  EXPECT_EQ(StepMtrErr::Ok, motor->GetStatus(&status));
+  EXPECT_TRUE(status.enabled);
+  EXPECT_FALSE(status.under_voltage || status.thermal_warning || status.thermal_shutdown ||
+               status.over_current || status.step_loss || status.command_error);
+  EXPECT_EQ(StepMoveStatus::Accelerating, status.move_status);
+
+  chip.Advance(1);
+  float position;
+  EXPECT_EQ(StepMtrErr::Ok, motor->GetPosition(&position));
+  EXPECT_FLOAT_EQ(-45, position);
+  EXPECT_EQ(StepMtrErr::Ok, motor->GetStatus(&status));
+  EXPECT_EQ(StepMoveStatus::Stopped, status.move_status);
+}
+
+namespace {
+// Runs commands as the control loop does: queued up, then sent together at the end of the cycle.
+void ControlLoop(const std::function<void()> &commands) {
+  hal.TESTSetInInterruptHandler(true);
+  commands();
+  StepMotor::StartQueuedCommands();
+  hal.TESTSetInInterruptHandler(false);
+}
+
+// Bytes sent by the transfers of the passed bus, for one motor.
+std::vector<uint8_t> SentTo(const StepperBusSim &bus, int motor) {
+  std::vector<uint8_t> bytes;
+  for (const StepperBusSim::Transfer &transfer : bus.transfers) {
+    bytes.push_back(transfer.bytes[motor]);
+  }
+  return bytes;
+}
+
+// A chip which runs the control loop in the middle of its first transfer.
+class InterruptedChip : public StepperSpiDevice {
+ public:
+  InterruptedChip(StepperSpiDevice *chip, std::function<void()> loop)
+      : chip_(chip), loop_(std::move(loop)) {}
+
+  uint8_t Transfer(uint8_t byte) override {
+    if (loop_) {
+      ControlLoop(loop_);
+      loop_ = nullptr;
+    }
+    return chip_->Transfer(byte);
+  }
+
+ private:
+  StepperSpiDevice *chip_;
+  std::function<void()> loop_;
+};
+}  // namespace
+
+TEST(Stepper, QueuedFrame) {
+  PowerStepMock chips[3];
+  StepperBusSim bus({&chips[0], &chips[1], &chips[2]});
+  StepMotor::TESTConnect(&bus, 3);
+
+  ControlLoop([] {
+    EXPECT_EQ(StepMtrErr::Ok, StepMotor::GetStepper(2)->HardStop());
+    EXPECT_EQ(StepMtrErr::Ok, StepMotor::GetStepper(0)->RunAtVelocity(-360));
+    EXPECT_EQ(StepMtrErr::Ok, StepMotor::GetStepper(2)->SoftStop());
+  });
+  bus.Finish();
+
+  // One transfer per byte queued by the motor with the most, with Nop for motors with fewer.
+  EXPECT_EQ((std::vector<uint8_t>{0x50, 0x00, 0x34, 0x6D}), SentTo(bus, 0));
+  EXPECT_EQ((std::vector<uint8_t>{0, 0, 0, 0}), SentTo(bus, 1));
+  EXPECT_EQ((std::vector<uint8_t>{0xB8, 0xB0, 0, 0}), SentTo(bus, 2));
+  EXPECT_EQ((std::vector<Command>{{0x50, 13421}}), chips[0].commands);
+  EXPECT_TRUE(chips[1].commands.empty());
+  EXPECT_EQ((std::vector<Command>{{0xB8, 0}, {0xB0, 0}}), chips[2].commands);
+
+  // Transfers follow each other, with the chip select high in between.
+  for (size_t i = 1; i < bus.transfers.size(); i++) {
+    EXPECT_GE(bus.transfers[i].start, bus.transfers[i - 1].end + StepperBusSim::CsHighTime);
+  }
+
+  // Nothing queued, nothing sent.
+  ControlLoop([] {});
+  EXPECT_FALSE(bus.busy());
+  EXPECT_EQ(4u, bus.transfers.size());
+}
+
+TEST(Stepper, QueueFull) {
+  PowerStepMock chip;
+  StepperBusSim bus({&chip});
+  StepMotor::TESTConnect(&bus, 1);
+
+  ControlLoop([] {
+    StepMotor *motor = StepMotor::GetStepper(0);
+    for (int i = 0; i < 10; i++) EXPECT_EQ(StepMtrErr::Ok, motor->RunAtVelocity(360));
+    EXPECT_EQ(StepMtrErr::QueueFull, motor->HardStop());
+  });
+  bus.Finish();
+  EXPECT_EQ(10u, chip.commands.size());
+}
+
+TEST(Stepper, FrameOverrun) {
+  PowerStepMock chip;
+  StepperBusSim bus({&chip});
+  StepMotor::TESTConnect(&bus, 1);
+  StepMotor *motor = StepMotor::GetStepper(0);
+
+  ControlLoop([&] { EXPECT_EQ(StepMtrErr::Ok, motor->RunAtVelocity(360)); });
+  EXPECT_TRUE(bus.busy());
+
+  // The next frame is filled while the first one is sent, and waits for the next cycle if the
+  // first one isn't done by the end of this one.
+  ControlLoop([&] { EXPECT_EQ(StepMtrErr::Ok, motor->SoftStop()); });
+  EXPECT_EQ(1u, StepMotor::GetFrameOverruns());
+  bus.Finish();
+  EXPECT_EQ((std::vector<Command>{{0x51, 13421}}), chip.commands);
+
+  ControlLoop([&] { EXPECT_EQ(StepMtrErr::Ok, motor->HardStop()); });
+  bus.Finish();
+  EXPECT_EQ((std::vector<Command>{{0x51, 13421}, {0xB0, 0}, {0xB8, 0}}), chip.commands);
+  EXPECT_EQ((std::vector<uint8_t>{0x51, 0x00, 0x34, 0x6D, 0xB0, 0xB8}), SentTo(bus, 0));
+  EXPECT_EQ(1u, StepMotor::GetFrameOverruns());
+}
+
+TEST(Stepper, SyncCommandsWaitForFrame) {
+  PowerStepMock chips[2];
+  StepperBusSim bus({&chips[0], &chips[1]});
+  StepMotor::TESTConnect(&bus, 2);
+
+  ControlLoop([] { EXPECT_EQ(StepMtrErr::Ok, StepMotor::GetStepper(0)->RunAtVelocity(360)); });
+
+  // The status is read once the frame is done, the frame isn't interleaved with it.
+  StepperStatus status;
+  EXPECT_EQ(StepMtrErr::Ok, StepMotor::GetStepper(1)->GetStatus(&status));
+  EXPECT_FALSE(status.enabled);
+  EXPECT_EQ((std::vector<uint8_t>{0x51, 0x00, 0x34, 0x6D, 0, 0, 0}), SentTo(bus, 0));
+  EXPECT_EQ((std::vector<uint8_t>{0, 0, 0, 0, 0xD0, 0, 0}), SentTo(bus, 1));
+}
+
+TEST(Stepper, FrameWaitsForSyncCommand) {
+  PowerStepMock chip0;
+  PowerStepMock chip1;
+  InterruptedChip interrupted(&chip1, [] {
+    EXPECT_EQ(StepMtrErr::Ok, StepMotor::GetStepper(0)->RunAtVelocity(360));
+    EXPECT_EQ(StepMtrErr::Ok, StepMotor::GetStepper(1)->SoftStop());
+  });
+  StepperBusSim bus({&chip0, &interrupted});
+  StepMotor::TESTConnect(&bus, 2);
+
+  // The control loop runs in the middle of the status read, and its frame follows it.
+  StepperStatus status;
+  EXPECT_EQ(StepMtrErr::Ok, StepMotor::GetStepper(1)->GetStatus(&status));
+  bus.Finish();
+  EXPECT_EQ((std::vector<uint8_t>{0, 0, 0, 0x51, 0x00, 0x34, 0x6D}), SentTo(bus, 0));
+  EXPECT_EQ((std::vector<uint8_t>{0xD0, 0, 0, 0xB0, 0, 0, 0}), SentTo(bus, 1));
+  EXPECT_EQ((std::vector<Command>{{0xD0, 0}, {0xB0, 0}}), chip1.commands);
+}
+
+TEST(Stepper, FullFrameTiming) {
+  // As many motors as StepMotor supports
+  PowerStepMock chips[4];
+  StepperBusSim bus({&chips[0], &chips[1], &chips[2], &chips[3]});
+  StepMotor::TESTConnect(&bus, 4);
+
+  // Worst case: every motor queues as much as it can, every cycle.
+  for (int cycle = 0; cycle < 3; cycle++) {
+    ControlLoop([] {
+      for (int m = 0; m < 4; m++) {
+        for (int i = 0; i < 10; i++) {
+          EXPECT_EQ(StepMtrErr::Ok, StepMotor::GetStepper(m)->RunAtVelocity(360));
+        }
+      }
+    });
+    double start = bus.now();
+    bus.RunUntil(start + ControlLoopPeriod.seconds());
+    EXPECT_FALSE(bus.busy());
+
+    // The frame is sent in under 0.4ms, well within the cycle at every supported loop rate (up
+    // to 1kHz).
+    EXPECT_LT(bus.transfers.back().end - start, 0.4e-3);
+  }
+  EXPECT_EQ(0u, StepMotor::GetFrameOverruns());
+  EXPECT_EQ(3u * 40, bus.transfers.size());
+  for (const PowerStepMock &chip : chips) EXPECT_EQ(30u, chip.commands.size());
+}
+
+namespace {
+// A pinch valve motor, driven by the control loop.
+class StreamingTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    StepMotor::TESTConnect(&bus_, 1);
+    motor_ = StepMotor::GetStepper(0);
+    ASSERT_EQ(StepMtrErr::Ok, motor_->SetMaxSpeed(2000));
+    ASSERT_EQ(StepMtrErr::Ok, motor_->SetAccel(40000));
+    ASSERT_EQ(StepMtrErr::Ok, motor_->HardStop());
+    chip_.commands.clear();
+    chip_.bytes_received = 0;
+  }
+
+  // Runs a control loop cycle, and returns the distance from the motor to the position.
+  double Cycle(float position) {
+    ControlLoop([&] { EXPECT_EQ(StepMtrErr::Ok, motor_->StreamPos(position)); });
+    bus_.Finish();
+    chip_.Advance(ControlLoopPeriod.seconds());
+    return std::fabs(chip_.degrees() - position);
+  }
+
+  // Number of bytes the previous approach sent for the same positions: a hard stop when the
+  // position changed, followed by a GoTo, on every cycle.
+  int PreviousBytes(const std::vector<float> &positions) {
+    int bytes = 0;
+    float last = NAN;
+    for (float position : positions) {
+      bytes += (position != last ? 1 : 0) + 4;
+      last = position;
+    }
+    return bytes;
+  }
+
+  PowerStepMock chip_;
+  StepperBusSim bus_{{&chip_}};
+  StepMotor *motor_;
+
+  // Number of cycles in half a second, long enough for the motor to settle.
+  const int settle_cycles_ = static_cast<int>(0.5f / ControlLoopPeriod.seconds());
+};
+}  // namespace
+
+TEST_F(StreamingTest, FollowsPosition) {
+  // Positions as they come from a PID loop: a ramp down to -40 deg over 200ms, a hold, then a few
+  // jumps of various sizes, each held for 400ms.
+  constexpr float RampSpeed = 200;  // deg/sec
+  constexpr float Accel = 40000;    // deg/sec/sec, as set up
+  const int ramp_cycles = static_cast<int>(0.2f / ControlLoopPeriod.seconds());
+  const int hold_cycles = static_cast<int>(0.4f / ControlLoopPeriod.seconds());
+  const float ramp_step = RampSpeed * ControlLoopPeriod.seconds();
+  std::vector<float> positions;
+  for (int i = 1; i <= ramp_cycles; i++) positions.push_back(-ramp_step * static_cast<float>(i));
+  for (float position : {-40.0f, -39.0f, -10.0f, -10.2f, -25.0f}) {
+    for (int i = 0; i < hold_cycles; i++) positions.push_back(position);
+  }
+
+  double max_ramp_lag = 0;
+  double max_overshoot = 0;
+  for (size_t i = 0; i < positions.size(); i++) {
+    double distance = Cycle(positions[i]);
+    int held = static_cast<int>(i) - ramp_cycles;
+    if (held < 0) {
+      max_ramp_lag = std::max(max_ramp_lag, distance);
+    } else {
+      // Once past the position, the motor shouldn't go any further.
+      float previous = positions[i - 1];
+      bool past = (chip_.degrees() - positions[i]) * (positions[i] - previous) > 0;
+      if (past) max_overshoot = std::max(max_overshoot, distance);
+    }
+    // Settled at the end of each hold
+    if (held >= 0 && held % hold_cycles == hold_cycles - 1) {
+      EXPECT_LT(distance, 0.06) << i;
+      EXPECT_TRUE(chip_.stopped()) << i;
+    }
+  }
+  // The first cycle only reads the position, and the motor then lags by the distance it takes to
+  // get up to speed.
+  EXPECT_LT(max_ramp_lag, 2 * ramp_step + RampSpeed * RampSpeed / (2 * Accel));
+  EXPECT_LT(max_overshoot, 0.1);
+
+  // Only velocity changes and position reads were sent.
+  for (const Command &command : chip_.commands) {
+    EXPECT_TRUE(command.opcode == 0x50 || command.opcode == 0x51 || command.opcode == 0x21)
+        << static_cast<int>(command.opcode);
+  }
+  EXPECT_LT(chip_.bytes_received, PreviousBytes(positions) / 2);
+}
+
+TEST_F(StreamingTest, QuietWhenStopped) {
+  for (int i = 0; i < settle_cycles_; i++) Cycle(-20);
+  EXPECT_LT(std::fabs(chip_.degrees() + 20), 0.06);
+
+  chip_.commands.clear();
+  chip_.bytes_received = 0;
+  for (int i = 0; i < settle_cycles_; i++) Cycle(-20);
+  EXPECT_EQ(0, chip_.bytes_received);
+}
+
+TEST_F(StreamingTest, CatchesUpWithLostSteps) {
+  for (int i = 0; i < 5; i++) Cycle(-40);
+  chip_.Displace(3);
+  for (int i = 0; i < settle_cycles_; i++) Cycle(-40);
+  EXPECT_LT(std::fabs(chip_.degrees() + 40), 0.06);
+}
+
+TEST_F(StreamingTest, OtherCommandsTakeOver) {
+  for (int i = 0; i < settle_cycles_; i++) Cycle(-20);
+
+  // A new zero position, after which streaming starts over from there.
+  EXPECT_EQ(StepMtrErr::Ok, motor_->ClearPosition());
+  for (int i = 0; i < settle_cycles_; i++) Cycle(-10);
+  EXPECT_LT(std::fabs(chip_.degrees() + 10), 0.06);
+
+  // Moves aren't disturbed by the stream restarting.
+  EXPECT_EQ(StepMtrErr::Ok, motor_->GotoPos(-30));
+  chip_.Advance(1);
+  EXPECT_NEAR(-30, chip_.degrees(), 0.01);
+  for (int i = 0; i < settle_cycles_; i++) Cycle(-5);
+  EXPECT_LT(std::fabs(chip_.degrees() + 5), 0.06);
+}
+
+// Before the control loop starts, nothing sends the queued commands, so the motor moves the
+// blocking way.
+TEST_F(StreamingTest, MovesOutsideControlLoop) {
+  EXPECT_EQ(StepMtrErr::Ok, motor_->StreamPos(-30));
+  chip_.Advance(1);
+  EXPECT_NEAR(-30, chip_.degrees(), 0.01);
+  EXPECT_EQ((std::vector<Command>{{0xB8, 0}, {0x60, 0xFFF7AB}}), chip_.commands);
+
+  // Streaming takes over once the loop runs, and a move outside of it stops the stream first.
+  for (int i = 0; i < 5; i++) Cycle(-10);
+  ASSERT_FALSE(chip_.stopped());
+  chip_.commands.clear();
+  EXPECT_EQ(StepMtrErr::Ok, motor_->StreamPos(-5));
+  EXPECT_EQ((std::vector<Command>{{0xB8, 0}, {0x60, 0xFFFE9D}}), chip_.commands);
+  chip_.Advance(1);
+  EXPECT_NEAR(-5, chip_.degrees(), 0.01);
+}
+
+// A controller reset while a pinch valve is streaming leaves its motor running.  Restoring the
+// valve's home afterwards stops it.
+TEST_F(StreamingTest, RestoreHomeStopsStream) {
+  PinchValve valve(0, "stream_", "");
+  ASSERT_EQ(StepMtrErr::Ok, motor_->GotoPos(20));
+  chip_.Advance(1);
+  ASSERT_TRUE(valve.RestoreHome());
+
+  // Close the valve, and reset the controller on the way.
+  for (int i = 0; i < 5; i++) {
+    ControlLoop([&] { valve.SetOutput(0); });
+    bus_.Finish();
+    chip_.Advance(ControlLoopPeriod.seconds());
+  }
+  ASSERT_FALSE(chip_.stopped());
+
+  StepMotor::TESTConnect(&bus_, 1);
+  PinchValve restored(0, "restored_", "");
+  EXPECT_TRUE(restored.RestoreHome());
+  EXPECT_TRUE(restored.IsReady());
+  double position = chip_.degrees();
+  chip_.Advance(1);
+  EXPECT_TRUE(chip_.stopped());
+  EXPECT_DOUBLE_EQ(position, chip_.degrees());
 }
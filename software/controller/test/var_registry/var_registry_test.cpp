@@ -0,0 +1,209 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Debug variables are the debugger's API, so we make sure we don't change
+// them by mistake, for example while changing how their metadata is stored or
+// how their names are composed.
+//
+// This test has its own binary, as the registry never forgets variables, and
+// can only hold so many of them.  For the same reason, the objects owning the
+// variables live until the end of the program, so that the registry never
+// holds dangling variables.
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "commands.h"
+#include "controller.h"
+#include "gtest/gtest.h"
+#include "pinch_valve.h"
+#include "sensors.h"
+#include "vars.h"
+
+using namespace Debug::Variable;
+
+namespace {
+struct ExpectedVar {
+  const char *name;
+  Type type;
+  Access access;
+  size_t byte_size;
+  const char *units;
+  const char *help;
+  const char *format;
+};
+
+std::string ToString(Text text) {
+  std::string str(text.length(), '\0');
+  text.copy(str.data(), str.size());
+  return str;
+}
+
+struct Objects {
+  uint16_t first_id{Registry::singleton().count()};
+  Controller controller;
+  Sensors sensors;
+  PinchValve pinch_valve{0, "blower", " for blower valve"};
+};
+
+// Creates the objects on first call.
+Objects &GetObjects() {
+  static Objects *objects = new Objects;
+  return *objects;
+}
+}  // namespace
+
+// Variables of the controller, sensors and pinch valves, as seen by the debug
+// interface.
+TEST(VarRegistry, Contents) {
+  const std::vector<ExpectedVar> expected_vars = {
+    {"blower_valve_kp", Type::Float, Access::ReadWrite, 4, "",
+     "Proportional gain for blower valve PID", "%.3f"},
+    {"blower_valve_ki", Type::Float, Access::ReadWrite, 4, "",
+     "Integral gain for blower valve PID", "%.3f"},
+    {"blower_valve_kd", Type::Float, Access::ReadWrite, 4, "",
+     "Derivative gain for blower valve PID", "%.3f"},
+    {"psol_kp", Type::Float, Access::ReadWrite, 4, "", "Proportional gain for O2 psol PID", "%.3f"},
+    {"psol_ki", Type::Float, Access::ReadWrite, 4, "", "Integral gain for O2 psol PID", "%.3f"},
+    {"psol_kd", Type::Float, Access::ReadWrite, 4, "", "Derivative gain for O2 psol PID", "%.3f"},
+    {"fio2_kp", Type::Float, Access::ReadWrite, 4, "", "Proportional gain for FIO2 PID", "%.3f"},
+    {"fio2_ki", Type::Float, Access::ReadWrite, 4, "", "Integral gain for FIO2 PID", "%.3f"},
+    {"fio2_kd", Type::Float, Access::ReadWrite, 4, "", "Derivative gain for FIO2 PID", "%.3f"},
+    {"forced_blower_power", Type::Float, Access::ReadWrite, 4, "ratio",
+     "Force the blower fan to a particular power [0,1].  Specify a value outside this "
+     "range to let the controller control it.", "%.3f"},
+    {"forced_exhale_valve_pos", Type::Float, Access::ReadWrite, 4, "ratio",
+     "Force the exhale valve to a particular position [0,1].  Specify a value outside this "
+     "range to let the controller control it.", "%.3f"},
+    {"forced_blower_valve_pos", Type::Float, Access::ReadWrite, 4, "ratio",
+     "Force the blower valve to a particular position [0,1].  Specify a value outside this "
+     "range to let the controller control it.", "%.3f"},
+    {"forced_psol_pos", Type::Float, Access::ReadWrite, 4, "ratio",
+     "Force the O2 psol to a particular position [0,1].  (Note that psol.cpp scales this "
+     "further; see psol_pwm_closed and psol_pwm_open.)  Specify a value outside this range "
+     "to let the controller control the psol.", "%.3f"},
+    {"loop_period", Type::UInt32, Access::ReadOnly, 4, "\xB5""s", "Loop period", "%u"},
+    {"pc_setpoint", Type::Float, Access::ReadOnly, 4, "cmH2O",
+     "Pressure control set-point", "%.3f"},
+    {"fio2_setpoint", Type::Float, Access::ReadOnly, 4, "ratio",
+     "FiO2 setpoint [0.0, 1.0] as commanded by GUI", "%.3f"},
+    {"net_flow", Type::Float, Access::ReadOnly, 4, "mL/s", "Net flow rate", "%.3f"},
+    {"net_flow_uncorrected", Type::Float, Access::ReadOnly, 4, "mL/s",
+     "Net flow rate w/o correction", "%.3f"},
+    {"flow_correction", Type::Float, Access::ReadOnly, 4, "mL/s", "Correction to flow", "%.3f"},
+    {"volume", Type::Float, Access::ReadOnly, 4, "mL", "Patient volume", "%.3f"},
+    {"uncorrected_volume", Type::Float, Access::ReadOnly, 4, "mL",
+     "Patient volume w/o correction", "%.3f"},
+    {"breath_id", Type::UInt32, Access::ReadOnly, 4, "", "ID of the current breath", "%u"},
+    {"patient_pressure_dp", Type::Float, Access::ReadOnly, 4, "cmH2O",
+     "Differential pressure for patient airway pressure", "%.3f"},
+    {"patient_pressure_zero", Type::Float, Access::ReadOnly, 4, "V",
+     "Voltage offset for patient airway pressure", "%.3f"},
+    {"patient_pressure_voltage", Type::Float, Access::ReadOnly, 4, "V",
+     "Voltage reading for patient airway pressure", "%.3f"},
+    {"patient_pressure_lpf_cutoff", Type::Float, Access::ReadWrite, 4, "Hz",
+     "Low-pass filter cutoff (0 = off) for patient airway pressure", "%.3f"},
+    {"fio2fio2", Type::Float, Access::ReadOnly, 4, "ratio",
+     "Fraction of oxygen Fraction of oxygen in supplied air", "%.3f"},
+    {"fio2zero", Type::Float, Access::ReadOnly, 4, "V",
+     "Voltage offset Fraction of oxygen in supplied air", "%.3f"},
+    {"fio2voltage", Type::Float, Access::ReadOnly, 4, "V",
+     "Voltage reading Fraction of oxygen in supplied air", "%.3f"},
+    {"fio2lpf_cutoff", Type::Float, Access::ReadWrite, 4, "Hz",
+     "Low-pass filter cutoff (0 = off) Fraction of oxygen in supplied air", "%.3f"},
+    {"air_influx_dp", Type::Float, Access::ReadOnly, 4, "cmH2O",
+     "Differential pressure for ambient air influx", "%.3f"},
+    {"air_influx_zero", Type::Float, Access::ReadOnly, 4, "V",
+     "Voltage offset for ambient air influx", "%.3f"},
+    {"air_influx_voltage", Type::Float, Access::ReadOnly, 4, "V",
+     "Voltage reading for ambient air influx", "%.3f"},
+    {"air_influx_lpf_cutoff", Type::Float, Access::ReadWrite, 4, "Hz",
+     "Low-pass filter cutoff (0 = off) for ambient air influx", "%.3f"},
+    {"oxygen_influx_dp", Type::Float, Access::ReadOnly, 4, "cmH2O",
+     "Differential pressure for concentrated oxygen influx", "%.3f"},
+    {"oxygen_influx_zero", Type::Float, Access::ReadOnly, 4, "V",
+     "Voltage offset for concentrated oxygen influx", "%.3f"},
+    {"oxygen_influx_voltage", Type::Float, Access::ReadOnly, 4, "V",
+     "Voltage reading for concentrated oxygen influx", "%.3f"},
+    {"oxygen_influx_lpf_cutoff", Type::Float, Access::ReadWrite, 4, "Hz",
+     "Low-pass filter cutoff (0 = off) for concentrated oxygen influx", "%.3f"},
+    {"outflow_dp", Type::Float, Access::ReadOnly, 4, "cmH2O",
+     "Differential pressure for outflow", "%.3f"},
+    {"outflow_zero", Type::Float, Access::ReadOnly, 4, "V", "Voltage offset for outflow", "%.3f"},
+    {"outflow_voltage", Type::Float, Access::ReadOnly, 4, "V",
+     "Voltage reading for outflow", "%.3f"},
+    {"outflow_lpf_cutoff", Type::Float, Access::ReadWrite, 4, "Hz",
+     "Low-pass filter cutoff (0 = off) for outflow", "%.3f"},
+    {"air_influx_flow", Type::Float, Access::ReadOnly, 4, "mL/s",
+     "Volumetric flow for ambient air influx", "%.3f"},
+    {"air_influx_flow_table", Type::FloatArray, Access::ReadWrite, 128, "kPa, mL/s",
+     "Venturi flow table: 16 pressures then 16 flows for ambient air influx", "%.3f"},
+    {"oxygen_influx_flow", Type::Float, Access::ReadOnly, 4, "mL/s",
+     "Volumetric flow for concentrated oxygen influx", "%.3f"},
+    {"oxygen_influx_flow_table", Type::FloatArray, Access::ReadWrite, 128, "kPa, mL/s",
+     "Venturi flow table: 16 pressures then 16 flows for concentrated oxygen influx", "%.3f"},
+    {"outflow_flow", Type::Float, Access::ReadOnly, 4, "mL/s",
+     "Volumetric flow for outflow", "%.3f"},
+    {"outflow_flow_table", Type::FloatArray, Access::ReadWrite, 128, "kPa, mL/s",
+     "Venturi flow table: 16 pressures then 16 flows for outflow", "%.3f"},
+    {"blower_pinch_cal", Type::FloatArray, Access::ReadWrite, 44, "",
+     "Pinch valve flow table for blower valve", "%.3f"},
+  };
+
+  Registry &registry = Registry::singleton();
+  uint16_t first_id = GetObjects().first_id;
+  ASSERT_EQ(first_id + expected_vars.size(), registry.count());
+
+  for (size_t i = 0; i < expected_vars.size(); ++i) {
+    const ExpectedVar &expected = expected_vars[i];
+    SCOPED_TRACE(expected.name);
+    const Base *var = registry.find(static_cast<uint16_t>(first_id + i));
+    ASSERT_NE(nullptr, var);
+    EXPECT_EQ(expected.name, ToString(var->name()));
+    EXPECT_EQ(expected.type, var->type());
+    EXPECT_EQ(expected.access, var->access());
+    EXPECT_EQ(expected.byte_size, var->byte_size());
+    EXPECT_STREQ(expected.units, var->units());
+    EXPECT_EQ(expected.help, ToString(var->help()));
+    EXPECT_STREQ(expected.format, var->format());
+  }
+}
+
+TEST(VarRegistry, Fingerprint) {
+  GetObjects();
+  Registry &registry = Registry::singleton();
+  uint32_t fingerprint = registry.fingerprint();
+  EXPECT_EQ(fingerprint, registry.fingerprint());
+
+  // Debug clients get it through the var command.
+  std::array<uint8_t, 1> request = {
+      static_cast<uint8_t>(Debug::Command::VarHandler::Subcommand::GetFingerprint)};
+  std::array<uint8_t, 4> response;
+  bool processed{false};
+  Debug::Command::Context context = {.request = request.data(),
+                                     .request_length = request.size(),
+                                     .response = response.data(),
+                                     .max_response_length = response.size(),
+                                     .response_length = 0,
+                                     .processed = &processed};
+  EXPECT_EQ(Debug::ErrorCode::None, Debug::Command::VarHandler().Process(&context));
+  EXPECT_EQ(4, context.response_length);
+  EXPECT_EQ(fingerprint, u8_to_u32(response.data()));
+
+  // Any new variable changes it.
+  UInt32 var("fingerprint_test", Access::ReadOnly, 0, "");
+  EXPECT_NE(fingerprint, registry.fingerprint());
+}
@@ -0,0 +1,213 @@
+/* Copyright 2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "waveform_recorder.h"
+
+#include <pb_decode.h>
+#include <pb_encode.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "hal.h"
+#include "network_protocol.pb.h"
+#include "sample_batch.h"
+
+// Waveforms that look a bit like a breath, with some noise.
+static WaveformSample MakeSample(int i) {
+  float t = static_cast<float>(i) * 0.01f;
+  return {
+      .patient_pressure_cm_h2o = 5 + 10 * std::sin(t) + 0.003f * static_cast<float>(i % 7),
+      .flow_ml_per_min = 30'000 * std::cos(t) + 3.7f * static_cast<float>(i % 5),
+      .volume_ml = 400 + 300 * std::sin(t),
+      .pressure_setpoint_cm_h2o = i % 300 < 100 ? 15.0f : 5.0f,
+      .breath_id = 1'000'000 + static_cast<uint64_t>(i / 300) * 3'000'000,
+  };
+}
+
+static void ExpectQuantized(const WaveformSample &expected, const WaveformSample &actual) {
+  // Quantization rounds to the nearest step.
+  EXPECT_NEAR(expected.patient_pressure_cm_h2o, actual.patient_pressure_cm_h2o,
+              SampleBatchPressureStepCmH2O / 2 + 1e-4f);
+  EXPECT_NEAR(expected.flow_ml_per_min, actual.flow_ml_per_min,
+              SampleBatchFlowStepMlPerMin / 2 + 1e-2f);
+  EXPECT_NEAR(expected.volume_ml, actual.volume_ml, SampleBatchVolumeStepMl / 2 + 1e-4f);
+  EXPECT_NEAR(expected.pressure_setpoint_cm_h2o, actual.pressure_setpoint_cm_h2o,
+              SampleBatchPressureStepCmH2O / 2 + 1e-4f);
+  EXPECT_EQ(expected.breath_id, actual.breath_id);
+}
+
+TEST(SampleBatch, RoundTrip) {
+  for (int start : {0, 250, 299, 1000}) {
+    SCOPED_TRACE("start " + std::to_string(start));
+    std::vector<WaveformSample> samples;
+    for (int i = start; i < start + static_cast<int>(SampleBatchCapacity) + 3; ++i) {
+      samples.push_back(MakeSample(i));
+    }
+
+    SampleBatch batch = SampleBatch_init_zero;
+    ASSERT_EQ(SampleBatchCapacity, pack_samples(samples.data(),
+                                                static_cast<uint32_t>(samples.size()),
+                                                123'456, 10'000, &batch));
+    EXPECT_EQ(123'456u, batch.first_sample_uptime_us);
+    EXPECT_EQ(10'000u, batch.sample_period_us);
+
+    // Go through nanopb, as the GUI would.
+    uint8_t buffer[SampleBatch_size];
+    pb_ostream_t ostream = pb_ostream_from_buffer(buffer, sizeof(buffer));
+    ASSERT_TRUE(pb_encode(&ostream, SampleBatch_fields, &batch));
+    pb_istream_t istream = pb_istream_from_buffer(buffer, ostream.bytes_written);
+    SampleBatch decoded = SampleBatch_init_zero;
+    ASSERT_TRUE(pb_decode(&istream, SampleBatch_fields, &decoded));
+
+    WaveformSample unpacked[SampleBatchCapacity];
+    ASSERT_EQ(SampleBatchCapacity, unpack_samples(decoded, unpacked, SampleBatchCapacity));
+    for (uint32_t i = 0; i < SampleBatchCapacity; ++i) {
+      SCOPED_TRACE("sample " + std::to_string(i));
+      ExpectQuantized(samples[i], unpacked[i]);
+    }
+  }
+}
+
+TEST(SampleBatch, DeltasAreCompact) {
+  std::vector<WaveformSample> samples;
+  for (int i = 0; i < static_cast<int>(SampleBatchCapacity); ++i) {
+    samples.push_back(MakeSample(i));
+  }
+  SampleBatch batch = SampleBatch_init_zero;
+  pack_samples(samples.data(), SampleBatchCapacity, 0, 10'000, &batch);
+
+  uint8_t buffer[SampleBatch_size];
+  pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
+  ASSERT_TRUE(pb_encode(&stream, SampleBatch_fields, &batch));
+  // A full batch of typical samples takes a fraction of its worst case size,
+  // and each sample a fraction of the single one SensorsProto carries.
+  EXPECT_LT(stream.bytes_written, SampleBatch_size / 4);
+  EXPECT_LT(stream.bytes_written / SampleBatchCapacity, SensorsProto_size / 4);
+}
+
+TEST(SampleBatch, ExtremeValues) {
+  float nan = std::numeric_limits<float>::quiet_NaN();
+  float inf = std::numeric_limits<float>::infinity();
+  std::vector<WaveformSample> samples = {
+      {.patient_pressure_cm_h2o = 1e20f,
+       .flow_ml_per_min = -1e20f,
+       .volume_ml = nan,
+       .pressure_setpoint_cm_h2o = inf,
+       .breath_id = 0},
+      {.patient_pressure_cm_h2o = -1e20f,
+       .flow_ml_per_min = 1e20f,
+       .volume_ml = -inf,
+       .pressure_setpoint_cm_h2o = 0,
+       .breath_id = 1},
+      MakeSample(0),
+  };
+  SampleBatch batch = SampleBatch_init_zero;
+  ASSERT_EQ(3u, pack_samples(samples.data(), 3, 0, 10'000, &batch));
+  WaveformSample unpacked[3];
+  ASSERT_EQ(3u, unpack_samples(batch, unpacked, 3));
+
+  // Out of range values saturate, NaN becomes 0, and values that follow are
+  // unaffected.
+  EXPECT_GT(unpacked[0].patient_pressure_cm_h2o, 1e6f);
+  EXPECT_LT(unpacked[0].flow_ml_per_min, -1e6f);
+  EXPECT_EQ(0, unpacked[0].volume_ml);
+  EXPECT_LT(unpacked[1].patient_pressure_cm_h2o, -1e6f);
+  EXPECT_LT(unpacked[1].volume_ml, -1e6f);
+  ExpectQuantized(samples[2], unpacked[2]);
+}
+
+TEST(SampleBatch, Malformed) {
+  std::vector<WaveformSample> samples = {MakeSample(0), MakeSample(1)};
+  SampleBatch batch = SampleBatch_init_zero;
+  pack_samples(samples.data(), 2, 0, 10'000, &batch);
+  WaveformSample unpacked[2];
+
+  // Only unpack as many samples as asked for.
+  EXPECT_EQ(1u, unpack_samples(batch, unpacked, 1));
+  // Fields must have the same number of samples.
+  batch.volume_count = 1;
+  EXPECT_EQ(0u, unpack_samples(batch, unpacked, 2));
+}
+
+TEST(WaveformRecorder, TakesSamplesInBatches) {
+  WaveformRecorder recorder;
+  const uint64_t period = ControlLoopPeriod.microseconds();
+  int recorded = 0;
+  int taken = 0;
+
+  // Record a few samples between takes, like comms does, then more than fit
+  // in a batch.
+  for (int round : {3, 1, 0, 5, static_cast<int>(SampleBatchCapacity) + 5}) {
+    SCOPED_TRACE("round " + std::to_string(round));
+    for (int i = 0; i < round; ++i, ++recorded) {
+      recorder.record(microsSinceStartup(period * recorded), MakeSample(recorded));
+    }
+    while (taken < recorded) {
+      SampleBatch batch = SampleBatch_init_zero;
+      uint32_t count = recorder.take(&batch);
+      ASSERT_GT(count, 0u);
+      EXPECT_EQ(period * taken, batch.first_sample_uptime_us);
+      EXPECT_EQ(period, batch.sample_period_us);
+
+      WaveformSample unpacked[SampleBatchCapacity];
+      ASSERT_EQ(count, unpack_samples(batch, unpacked, SampleBatchCapacity));
+      for (uint32_t i = 0; i < count; ++i, ++taken) {
+        ExpectQuantized(MakeSample(taken), unpacked[i]);
+      }
+    }
+    EXPECT_EQ(0u, recorder.size());
+
+    // Nothing left, the batch is empty.
+    SampleBatch batch = SampleBatch_init_zero;
+    EXPECT_EQ(0u, recorder.take(&batch));
+    EXPECT_EQ(0u, batch.patient_pressure_count);
+  }
+  EXPECT_EQ(0u, recorder.dropped());
+}
+
+TEST(WaveformRecorder, DropsSamplesWhenFull) {
+  WaveformRecorder recorder;
+  const uint64_t period = ControlLoopPeriod.microseconds();
+  const int overflow = 10;
+  int recorded = 0;
+  for (; recorded < static_cast<int>(WaveformRecorder::Capacity) + overflow; ++recorded) {
+    recorder.record(microsSinceStartup(period * recorded), MakeSample(recorded));
+  }
+  EXPECT_EQ(WaveformRecorder::Capacity, recorder.size());
+  EXPECT_EQ(static_cast<uint32_t>(overflow), recorder.dropped());
+
+  // Make room for one more sample, which comes after a gap.
+  SampleBatch batch = SampleBatch_init_zero;
+  ASSERT_EQ(SampleBatchCapacity, recorder.take(&batch));
+  recorder.record(microsSinceStartup(period * recorded), MakeSample(recorded));
+
+  // Batches never span the gap, so that the sample after it gets the right
+  // time.
+  uint64_t expected_time = period * SampleBatchCapacity;
+  while (recorder.size() > 1) {
+    uint32_t count = recorder.take(&batch);
+    EXPECT_EQ(expected_time, batch.first_sample_uptime_us);
+    expected_time += period * count;
+  }
+  EXPECT_EQ(period * WaveformRecorder::Capacity, expected_time);
+  ASSERT_EQ(1u, recorder.take(&batch));
+  EXPECT_EQ(period * recorded, batch.first_sample_uptime_us);
+  WaveformSample unpacked;
+  ASSERT_EQ(1u, unpack_samples(batch, &unpacked, 1));
+  ExpectQuantized(MakeSample(recorded), unpacked);
+}
@@ -18,6 +18,7 @@ Item {
 
     property alias showBottomLine: bottomLine.visible
     property alias dataset: timeSeriesGraph.dataset
+    property alias timeOrigin: timeSeriesGraph.timeOrigin
 
 
     Text {
@@ -11,4 +11,5 @@ ScopeView {
     yMin: -60
     yMax: 60
     dataset: GuiStateContainer.flowSeries
+    timeOrigin: GuiStateContainer.seriesTimeOrigin
 }
@@ -8,6 +8,7 @@ ScopeView {
     name: "Pressure"
     unit: "cmH<sub>2</sub>O"
     dataset: GuiStateContainer.pressureSeries
+    timeOrigin: GuiStateContainer.seriesTimeOrigin
     // RW-SYS-003
     yMin: 0
     yMax: 60
@@ -17,4 +17,5 @@ ScopeView {
 
     showBottomLine: false
     dataset: GuiStateContainer.tidalSeries
+    timeOrigin: GuiStateContainer.seriesTimeOrigin
 }
@@ -16,6 +16,7 @@
 #include <QFontInfo>
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
+#include <QScreen>
 #include <QtCore/QDir>
 #include <QtQml/QQmlContext>
 #include <QtQml/QQmlEngine>
@@ -27,8 +28,9 @@
 QObject *gui_state_instance(QQmlEngine *engine, QJSEngine *scriptEngine) {
   static GuiStateContainer state_container(
       /*history_window=*/DurationMs(30000),
-      // 100ms looks a little janky, 50ms is fine.
-      /*granularity=*/DurationMs(50));
+      // Keep every waveform sample the controller sends at its default loop
+      // rate of 100Hz; 100ms looks a little janky.
+      /*granularity=*/DurationMs(10));
   Q_UNUSED(engine);
   Q_UNUSED(scriptEngine);
   // Since we are returning just a pointer, QQmlEngine does not know the object
@@ -102,6 +104,12 @@ int main(int argc, char *argv[]) {
 
   GuiStateContainer *state_container =
       static_cast<GuiStateContainer *>(gui_state_instance(nullptr, nullptr));
+  // Update the graphs as often as the display refreshes.
+  QScreen *screen = app.primaryScreen();
+  if (screen != nullptr && screen->refreshRate() > 0) {
+    state_container->SetGraphRefreshInterval(
+        DurationMs(static_cast<int>(1000 / screen->refreshRate())));
+  }
   // Check out utils/mock-cycle-controller.py - it is
   // a script that bangs ControllerState at the set rate into serial
   // port.
@@ -150,7 +158,15 @@ int main(int argc, char *argv[]) {
         });
   }
 
-  // Run comm thread at the same time interval as Cycle Controller.
+  // ControllerStatus-es are processed off the UI thread as soon as they
+  // arrive.
+  device->Start([state_container](
+                    SteadyInstant now,
+                    const std::vector<ControllerStatus> &controller_statuses) {
+    state_container->ReceiveControllerStatuses(now, controller_statuses);
+  });
+
+  // Send GuiStatus at the same time interval as Cycle Controller.
   std::mutex gui_status_mutex;
   GuiStatus gui_status = state_container->GetGuiStatus();
   QObject::connect(state_container, &GuiStateContainer::params_changed, [&]() {
@@ -158,13 +174,6 @@ int main(int argc, char *argv[]) {
     gui_status = state_container->GetGuiStatus();
   });
   PeriodicClosure communicate(DurationMs(30), [&] {
-    auto now = SteadyClock::now();
-    ControllerStatus controller_status;
-    if (device->ReceiveControllerStatus(&controller_status)) {
-      QMetaObject::invokeMethod(state_container, [=]() {
-        state_container->controller_status_changed(now, controller_status);
-      });
-    }
     GuiStatus status;
     {
       std::unique_lock<std::mutex> l(gui_status_mutex);
@@ -174,6 +183,7 @@ int main(int argc, char *argv[]) {
   });
   communicate.Start();
 
+  qRegisterMetaType<GraphSeries>();
   qmlRegisterType<TimeSeriesGraph>("Respira", 1, 0, "TimeSeriesGraph");
   qmlRegisterUncreatableType<AlarmPriority>("Respira", 1, 0, "AlarmPriority",
                                             "is an enum");
@@ -12,6 +12,9 @@ SOURCES += \
     $$top_srcdir/../common/third_party/nanopb/pb_decode.c \
     $$top_srcdir/../common/third_party/nanopb/pb_encode.c \
     $$top_srcdir/../common/libs/units/units.cpp \
+    $$top_srcdir/../common/libs/checksum/checksum.cpp \
+    $$top_srcdir/../common/libs/framing/framing.cpp \
+    $$top_srcdir/../common/libs/sample_batch/sample_batch.cpp \
     $$files("$$top_srcdir//../common/**/*.c")
 
 HEADERS += \
@@ -20,11 +23,17 @@ HEADERS += \
     $$top_srcdir/../common/third_party/nanopb/pb_common.h \
     $$top_srcdir/../common/third_party/nanopb/pb_decode.h \
     $$top_srcdir/../common/third_party/nanopb/pb_encode.h \
-    $$top_srcdir/../common/libs/units/units.h
+    $$top_srcdir/../common/libs/units/units.h \
+    $$top_srcdir/../common/libs/checksum/checksum.h \
+    $$top_srcdir/../common/libs/framing/framing.h \
+    $$top_srcdir/../common/libs/sample_batch/sample_batch.h
 
 HEADERS += $$files("$$top_srcdir/../common/**/*.h")
 
 INCLUDEPATH += \
     $$top_srcdir/../common/generated_libs/network_protocol \
     $$top_srcdir/../common/third_party/nanopb \
-    $$top_srcdir/../common/libs/units
+    $$top_srcdir/../common/libs/units \
+    $$top_srcdir/../common/libs/checksum \
+    $$top_srcdir/../common/libs/framing \
+    $$top_srcdir/../common/libs/sample_batch
@@ -1,22 +1,36 @@
 #ifndef CONNECTED_DEVICE_H
 #define CONNECTED_DEVICE_H
 
+#include "chrono.h"
 #include "network_protocol.pb.h"
+#include "periodic_closure.h"
 #include <functional>
+#include <memory>
+#include <vector>
 
 // Represents a connection to the device running the controller.
 class ConnectedDevice {
 public:
+  // Receives the ControllerStatus-es which arrived together, oldest first,
+  // along with the time the last of them arrived. Each one carries a batch of
+  // waveform samples, so none of them should be skipped.
+  //
+  // Called from a thread of the device, as soon as they arrive.
+  using StatusesCallback =
+      std::function<void(SteadyInstant received,
+                         const std::vector<ControllerStatus> &statuses)>;
+
   virtual ~ConnectedDevice() = default;
 
-  // Sends the GuiStatus to the controller. May block.
+  // Starts receiving ControllerStatus-es from the controller, passing them to
+  // on_statuses.
+  virtual void Start(StatusesCallback on_statuses) = 0;
+  // Sends the GuiStatus to the controller. Doesn't block.
   virtual bool SendGuiStatus(const GuiStatus &gui_status) = 0;
-  // Reads a ControllerStatus from the controller. May block.
-  // TODO: Make sure both functions can't block indefinitely.
-  virtual bool ReceiveControllerStatus(ControllerStatus *controller_status) = 0;
 };
 
-// A fake version of ConnectedDevice backed by a lambda for testing.
+// A fake version of ConnectedDevice backed by a lambda for testing, which
+// receives a ControllerStatus every 30ms.
 class FakeConnectedDevice : public ConnectedDevice {
 public:
   FakeConnectedDevice(std::function<void(const GuiStatus &)> send_fn,
@@ -24,18 +38,24 @@ public:
       : send_fn_(send_fn), receive_fn_(receive_fn) {}
   ~FakeConnectedDevice() = default;
 
+  void Start(StatusesCallback on_statuses) override {
+    receiver_ = std::make_unique<PeriodicClosure>(
+        DurationMs(30), [this, on_statuses] {
+          ControllerStatus controller_status = ControllerStatus_init_zero;
+          receive_fn_(&controller_status);
+          on_statuses(SteadyClock::now(), {controller_status});
+        });
+    receiver_->Start();
+  }
   bool SendGuiStatus(const GuiStatus &gui_status) override {
     send_fn_(gui_status);
     return true;
   }
-  bool ReceiveControllerStatus(ControllerStatus *controller_status) override {
-    receive_fn_(controller_status);
-    return true;
-  }
 
 private:
   std::function<void(const GuiStatus &)> send_fn_;
   std::function<void(ControllerStatus *)> receive_fn_;
+  std::unique_ptr<PeriodicClosure> receiver_;
 };
 
 #endif // CONNECTED_DEVICE_H
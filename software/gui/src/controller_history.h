@@ -4,13 +4,19 @@
 #include "chrono.h"
 #include "network_protocol.pb.h"
 
-#include <deque>
-#include <tuple>
+#include <algorithm>
+#include <stdint.h>
 #include <vector>
 
 // Maintains a history of recent ControllerStatus-es sufficient
 // for rendering the UI.
 //
+// Only the readings that get graphed are kept for each point, in one
+// array per reading, which together make a ring buffer allocated for the
+// whole window up front.  Points are numbered in the order they're added,
+// so that readers can pick up the points added since they last looked (see
+// Begin() and End()) rather than go through the whole history again.
+//
 // Non-thread-safe, needs external synchronization.
 class ControllerHistory {
 public:
@@ -21,7 +27,13 @@ public:
   // "granularity" signals how many points to keep: if a new point is less than
   // this much later than the latest point, it doesn't get added.
   ControllerHistory(DurationMs window, DurationMs granularity)
-      : window_(window), granularity_(granularity) {}
+      : window_(window), granularity_(granularity),
+        capacity_(static_cast<int>(window /
+                                   std::max(granularity, DurationMs(1))) +
+                  1),
+        time_(capacity_), patient_pressure_cm_h2o_(capacity_),
+        flow_ml_per_min_(capacity_), volume_ml_(capacity_),
+        breath_id_(capacity_) {}
 
   // Appends a ControllerStatus obtained at a given time point in GUI time.
   // We cannot use the controller's uptime, because if controller restarts,
@@ -29,36 +41,62 @@ public:
   // For a similar reason we also must use specifically a steady clock
   // (clock that never goes backwards) - as opposed to, say, the system clock.
   bool Append(SteadyInstant gui_now, const ControllerStatus &status) {
-    if (!history_.empty() &&
-        gui_now - std::get<SteadyInstant>(history_.back()) < granularity_) {
+    if (size_ > 0 && gui_now - Time(end_ - 1) < granularity_) {
       return false;
     }
-    history_.push_back({gui_now, status});
-    // Kick out points that are too old.
-    while (!history_.empty() &&
-           gui_now - std::get<SteadyInstant>(history_.front()) > window_) {
-      history_.pop_front();
+    // Kick out points that are too old, and make room for the new one. There
+    // is always room unless the granularity is under a millisecond.
+    while (size_ > 0 &&
+           (gui_now - Time(Begin()) > window_ || size_ == capacity_)) {
+      size_--;
     }
+
+    uint64_t i = end_ % capacity_;
+    time_[i] = gui_now;
+    patient_pressure_cm_h2o_[i] =
+        status.sensor_readings.patient_pressure_cm_h2o;
+    flow_ml_per_min_[i] = status.sensor_readings.flow_ml_per_min;
+    volume_ml_[i] = status.sensor_readings.volume_ml;
+    breath_id_[i] = status.sensor_readings.breath_id;
+    end_++;
+    size_++;
+    last_status_ = status;
     return true;
   }
 
-  int Size() const { return history_.size(); }
+  int Size() const { return size_; }
 
-  std::vector<std::tuple<SteadyInstant, ControllerStatus>> GetHistory() const {
-    return {history_.begin(), history_.end()};
-  }
+  // Numbers of the oldest point in the history, and of the next point to be
+  // added.  Points numbered from Begin() to End() - 1 can be read below.
+  uint64_t Begin() const { return end_ - size_; }
+  uint64_t End() const { return end_; }
 
-  ControllerStatus GetLastStatus() const {
-    if (history_.empty()) {
-      return ControllerStatus_init_zero;
-    }
-    return std::get<1>(history_.back());
+  SteadyInstant Time(uint64_t n) const { return time_[n % capacity_]; }
+  float PatientPressureCmH2O(uint64_t n) const {
+    return patient_pressure_cm_h2o_[n % capacity_];
   }
+  float FlowMlPerMin(uint64_t n) const {
+    return flow_ml_per_min_[n % capacity_];
+  }
+  float VolumeMl(uint64_t n) const { return volume_ml_[n % capacity_]; }
+  uint64_t BreathId(uint64_t n) const { return breath_id_[n % capacity_]; }
+
+  const ControllerStatus &GetLastStatus() const { return last_status_; }
 
 private:
   DurationMs window_;
   DurationMs granularity_;
-  std::deque<std::tuple<SteadyInstant, ControllerStatus>> history_;
+  int capacity_;
+
+  std::vector<SteadyInstant> time_;
+  std::vector<float> patient_pressure_cm_h2o_;
+  std::vector<float> flow_ml_per_min_;
+  std::vector<float> volume_ml_;
+  std::vector<uint64_t> breath_id_;
+  uint64_t end_ = 0;
+  int size_ = 0;
+
+  ControllerStatus last_status_ = ControllerStatus_init_zero;
 };
 
 #endif // CONTROLLER_HISTORY_H
@@ -0,0 +1,61 @@
+#ifndef FRAME_PARSER_H
+#define FRAME_PARSER_H
+
+#include "framing.h"
+
+#include <QByteArray>
+#include <string.h>
+
+// Splits the bytes received from the controller into frames (see framing.h)
+// as they arrive, in whatever chunks they arrive.
+//
+// A frame is complete as soon as its closing FramingMark is received. Bytes
+// received before the first FramingMark, which may be the end of a frame we
+// missed the beginning of, are dropped, as are empty frames (a closing mark
+// directly followed by the next opening one). So is a frame growing larger
+// than max_frame_size, after which the parser waits for the next mark.
+class FrameParser {
+public:
+  explicit FrameParser(int max_frame_size) : max_frame_size_(max_frame_size) {
+    frame_.reserve(max_frame_size);
+  }
+
+  // Parses received bytes, calling on_frame with each frame they complete,
+  // without its marks, and still escaped.
+  template <typename FrameFn>
+  void Feed(const char *data, int size, FrameFn &&on_frame) {
+    const char *end = data + size;
+    while (data < end) {
+      const char *mark = static_cast<const char *>(
+          memchr(data, FramingMark, end - data));
+      const char *stop = mark ? mark : end;
+      if (synchronized_) {
+        if (frame_.size() + (stop - data) > max_frame_size_) {
+          // Too long to be a frame, start over from the next mark.
+          frame_.resize(0);
+          synchronized_ = false;
+        } else {
+          frame_.append(data, static_cast<int>(stop - data));
+        }
+      }
+      if (!mark) {
+        break;
+      }
+      if (synchronized_ && !frame_.isEmpty()) {
+        on_frame(static_cast<const QByteArray &>(frame_));
+      }
+      frame_.resize(0);
+      synchronized_ = true;
+      data = mark + 1;
+    }
+  }
+
+private:
+  int max_frame_size_;
+  // Whether a FramingMark was received, after which frame_ holds the bytes of
+  // the frame being received.
+  bool synchronized_ = false;
+  QByteArray frame_;
+};
+
+#endif // FRAME_PARSER_H
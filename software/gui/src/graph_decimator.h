@@ -0,0 +1,115 @@
+#ifndef GRAPH_DECIMATOR_H_
+#define GRAPH_DECIMATOR_H_
+
+#include "graph_series.h"
+
+#include <QPointF>
+#include <QtMath>
+#include <algorithm>
+#include <deque>
+#include <limits>
+
+// Reduces a time series to what can be drawn of it: at most two points per
+// column of the graph, the lowest and highest of the column, in time order.
+// Lines between them then cover the same pixels as lines through all the
+// points would, peaks included.
+//
+// Columns are aligned on multiples of their duration rather than on the edges
+// of the graph, so that the points kept don't change as the graph scrolls.
+// The series is expected to only change by having points appended, and old
+// ones dropped from the front; only appended points are looked at, unless the
+// series starts over.
+//
+// Not thread-safe, needs external synchronization.
+class GraphDecimator {
+public:
+  // Sets the duration covered by a column, in the unit of the x of the points.
+  // Changing it starts the decimation over.
+  void SetColumnDuration(qreal duration) {
+    if (duration != column_duration_) {
+      column_duration_ = duration;
+      Clear();
+    }
+  }
+
+  // Adds the points of the series which weren't added yet.
+  void Update(const GraphSeries &series) {
+    if (series.isEmpty() || series.last().x() < last_x_) {
+      Clear();
+    }
+    // Binary search for the first point after the last one added.
+    int next = 0;
+    for (int count = series.size(); count > 0;) {
+      int half = count / 2;
+      if (series[next + half].x() <= last_x_) {
+        next += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    for (; next < series.size(); ++next) {
+      Add(series[next]);
+    }
+  }
+
+  // Drops the points before the given time, but for the last one of them,
+  // which the line to the points after starts from.
+  void DropBefore(qreal time) {
+    while (column_start_ > 0 && points_[1].x() < time) {
+      points_.pop_front();
+      column_start_--;
+    }
+  }
+
+  const std::deque<QPointF> &Points() const { return points_; }
+
+private:
+  void Clear() {
+    points_.clear();
+    column_start_ = 0;
+    last_x_ = -std::numeric_limits<qreal>::infinity();
+  }
+
+  void Add(const QPointF &point) {
+    qint64 column = qFloor(point.x() / column_duration_);
+    if (points_.empty() || column != column_) {
+      column_ = column;
+      column_start_ = static_cast<int>(points_.size());
+      min_ = point;
+      max_ = point;
+    } else {
+      if (point.y() < min_.y()) {
+        min_ = point;
+      }
+      if (point.y() > max_.y()) {
+        max_ = point;
+      }
+      points_.resize(column_start_);
+    }
+
+    if (min_.x() == max_.x()) {
+      points_.push_back(min_);
+    } else if (min_.x() < max_.x()) {
+      points_.push_back(min_);
+      points_.push_back(max_);
+    } else {
+      points_.push_back(max_);
+      points_.push_back(min_);
+    }
+    last_x_ = point.x();
+  }
+
+  qreal column_duration_ = 1;
+
+  // Points of the complete columns, followed by those of the last column,
+  // from index column_start_, which can still change.
+  std::deque<QPointF> points_;
+  int column_start_ = 0;
+  qint64 column_ = 0;
+  QPointF min_;
+  QPointF max_;
+  qreal last_x_ = -std::numeric_limits<qreal>::infinity();
+};
+
+#endif // GRAPH_DECIMATOR_H_
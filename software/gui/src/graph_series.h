@@ -0,0 +1,85 @@
+#ifndef GRAPH_SERIES_H_
+#define GRAPH_SERIES_H_
+
+#include <QMetaType>
+#include <QPointF>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+// A time series to graph, as of a given moment: a read-only copy of what a
+// GraphSeriesBuilder built so far.
+//
+// Points are stored in fixed size chunks, which all the copies containing them
+// share.  Making a copy only copies references to the chunks, and the builder
+// never changes the points a copy can see, so copies can be handed to other
+// threads, and kept for as long as needed, without ever being deep-copied.
+class GraphSeries {
+public:
+  static constexpr int ChunkSize = 256;
+
+  int size() const { return size_; }
+  bool isEmpty() const { return size_ == 0; }
+
+  const QPointF &at(int i) const {
+    int n = offset_ + i;
+    return (*chunks_[n / ChunkSize])[n % ChunkSize];
+  }
+  const QPointF &operator[](int i) const { return at(i); }
+  const QPointF &last() const { return at(size_ - 1); }
+
+private:
+  friend class GraphSeriesBuilder;
+  using Chunk = std::array<QPointF, ChunkSize>;
+
+  // The points, from index offset_ in the first chunk.
+  std::vector<std::shared_ptr<Chunk>> chunks_;
+  int offset_ = 0;
+  int size_ = 0;
+};
+
+Q_DECLARE_METATYPE(GraphSeries)
+
+// Builds a GraphSeries by appending points to it, and dropping old ones from
+// its front.
+//
+// Appending writes into the last chunk, past the end of the copies already
+// made, or into a new chunk; dropping points only drops the builder's
+// references to the chunks which don't hold any points anymore.
+//
+// Not thread-safe, needs external synchronization; copies must be handed to
+// other threads through something that synchronizes, such as a mutex or an
+// atomic exchange.
+class GraphSeriesBuilder {
+public:
+  void Append(const QPointF &point) {
+    GraphSeries &s = series_;
+    int n = s.offset_ + s.size_;
+    if (n == static_cast<int>(s.chunks_.size()) * GraphSeries::ChunkSize) {
+      s.chunks_.push_back(std::make_shared<GraphSeries::Chunk>());
+    }
+    (*s.chunks_.back())[n % GraphSeries::ChunkSize] = point;
+    s.size_++;
+  }
+
+  // Drops the count oldest points, or all of them if there are fewer.
+  void DropFront(int count) {
+    GraphSeries &s = series_;
+    count = std::min(count, s.size_);
+    s.offset_ += count;
+    s.size_ -= count;
+    int empty_chunks = s.offset_ / GraphSeries::ChunkSize;
+    s.offset_ -= empty_chunks * GraphSeries::ChunkSize;
+    s.chunks_.erase(s.chunks_.begin(), s.chunks_.begin() + empty_chunks);
+  }
+
+  // The series built so far.  Copies of it aren't affected by what's done to
+  // the builder afterwards.
+  const GraphSeries &Series() const { return series_; }
+
+private:
+  GraphSeries series_;
+};
+
+#endif // GRAPH_SERIES_H_
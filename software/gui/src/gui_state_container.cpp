@@ -1,28 +1,68 @@
 #include "gui_state_container.h"
 
-void GuiStateContainer::UpdateGraphs() {
-  auto now = SteadyClock::now();
-  QVector<QPointF> pressure_points, flow_points, tv_points;
-
-  int history_size = history_.Size();
+void GuiStateContainer::ApplySnapshot(
+    std::unique_ptr<const GuiSnapshot> snapshot) {
+  for (const ReceivedStatus &received : snapshot->statuses) {
+    alarm_manager_.Update(received.time, received.status,
+                          received.breath_signals);
+  }
 
-  pressure_points.reserve(history_size);
-  flow_points.reserve(history_size);
-  tv_points.reserve(history_size);
+  bool history_changed = snapshot->history_end != snapshot_->history_end;
+  snapshot_ = std::move(snapshot);
+  if (history_changed) {
+    readout_refresh_.Request();
+    graph_refresh_.Request();
+  }
+}
 
-  for (const auto &[time, controller_status] : GetControllerStatusHistory()) {
-    int neg_millis_ago = TimeAMinusB(time, now).count();
-    pressure_points.append(
-        QPointF(neg_millis_ago * 0.001,
-                controller_status.sensor_readings.patient_pressure_cm_h2o));
-    flow_points.append(
-        QPointF(neg_millis_ago * 0.001,
-                // The graph should be in L/min, but the data is ml/min
-                0.001 * controller_status.sensor_readings.flow_ml_per_min));
-    tv_points.append(QPointF(neg_millis_ago * 0.001,
-                             controller_status.sensor_readings.volume_ml));
+void GuiStateContainer::UpdateFromPipeline() {
+  std::unique_ptr<const GuiSnapshot> snapshot = pipeline_.Take();
+  if (snapshot != nullptr) {
+    ApplySnapshot(std::move(snapshot));
   }
-  SetPressureSeries(std::move(pressure_points));
-  SetFlowSeries(std::move(flow_points));
-  SetTidalSeries(std::move(tv_points));
+}
+
+GuiStateContainer::Readouts GuiStateContainer::ComputeReadouts() const {
+  const ControllerStatus &status = snapshot_->last_status;
+  const BreathSignals &breath_signals = snapshot_->breath_signals;
+
+  Readouts readouts;
+  readouts.pressure = status.sensor_readings.patient_pressure_cm_h2o;
+  readouts.flow = 0.001 * status.sensor_readings.flow_ml_per_min;
+  readouts.tv = status.sensor_readings.volume_ml;
+  readouts.rr = (commanded_mode_ == VentilationMode::PRESSURE_CONTROL)
+                    ? commanded_rr_
+                    : breath_signals.rr().value_or(commanded_rr_);
+  readouts.peep = breath_signals.peep().value_or(commanded_peep_);
+  readouts.pip = breath_signals.pip().value_or(commanded_pip_);
+  float breath_duration_sec = 60.0 / readouts.rr;
+  float commanded_e_time = breath_duration_sec - commanded_i_time_;
+  readouts.ier = commanded_i_time_ / commanded_e_time;
+  readouts.fio2_percent = 100 * status.sensor_readings.fio2;
+  return readouts;
+}
+
+void GuiStateContainer::UpdateReadouts() {
+  Readouts readouts = ComputeReadouts();
+  auto update = [this](qreal value, qreal *shown,
+                       void (GuiStateContainer::*changed)()) {
+    if (value != *shown) {
+      *shown = value;
+      emit(this->*changed)();
+    }
+  };
+  update(readouts.pressure, &readouts_.pressure,
+         &GuiStateContainer::measured_pressure_changed);
+  update(readouts.flow, &readouts_.flow,
+         &GuiStateContainer::measured_flow_changed);
+  update(readouts.tv, &readouts_.tv, &GuiStateContainer::measured_tv_changed);
+  update(readouts.rr, &readouts_.rr, &GuiStateContainer::measured_rr_changed);
+  update(readouts.peep, &readouts_.peep,
+         &GuiStateContainer::measured_peep_changed);
+  update(readouts.pip, &readouts_.pip,
+         &GuiStateContainer::measured_pip_changed);
+  update(readouts.ier, &readouts_.ier,
+         &GuiStateContainer::measured_ier_changed);
+  update(readouts.fio2_percent, &readouts_.fio2_percent,
+         &GuiStateContainer::measured_fio2_percent_changed);
 }
@@ -7,27 +7,40 @@
 #include "alarm_manager.h"
 #include "breath_signals.h"
 #include "chrono.h"
-#include "controller_history.h"
 #include "simple_clock.h"
+#include "status_pipeline.h"
+#include "update_throttle.h"
 
 #include <iostream>
+#include <memory>
 #include <tuple>
 #include <vector>
 
 #include "logger.h"
 #include <QPointF>
+#include <QTimer>
 #include <QVector>
 #include <QtCore/QObject>
 
 // A container for readable and writable state of the GUI.
 //
 // The rest of the GUI must bind itself to accessors and mutators
-// of this class - e.g. render graphs from GetControllerStatusHistory(),
+// of this class - e.g. render graphs from the *Series properties,
 // and when a parameter is changed in the UI, call a mutator on this
 // object.
 //
 // In other words, this is essentially an MVC "Model".
 //
+// Incoming ControllerStatus-es are processed on the worker thread of a
+// StatusPipeline, so the UI thread only picks up the snapshots it publishes:
+// it feeds the alarms, and tells the bound properties that they changed.
+//
+// Each change notification makes QML evaluate every binding to the
+// properties it is for, so they're sent sparingly: each measured parameter
+// has its own, sent only if its value changed, and the graphs share one.
+// Both are throttled (see Set*RefreshInterval()), so however many statuses
+// come in, each binding is evaluated at most once per refresh.
+//
 // TODO(jkff, paulovap): This class embodies the "God object" antipattern. We
 // should split it into several parts, with GuiStateContainer being only the
 // entry point for them.
@@ -35,6 +48,12 @@ class GuiStateContainer : public QObject {
   Q_OBJECT
 
 public:
+  // Readouts of measured parameters don't need to change faster than they
+  // can be read.
+  static constexpr DurationMs DefaultReadoutRefreshInterval = DurationMs(200);
+  // About a frame at 60Hz.
+  static constexpr DurationMs DefaultGraphRefreshInterval = DurationMs(16);
+
   enum VentilationMode {
     PRESSURE_CONTROL,
     PRESSURE_ASSIST,
@@ -46,7 +65,13 @@ public:
   // statuses in a given time window with given granularity.
   GuiStateContainer(DurationMs history_window, DurationMs granularity)
       : startup_time_(SteadyClock::now()),
-        history_(history_window, granularity) {
+        pipeline_(history_window, granularity, startup_time_),
+        snapshot_(std::make_unique<const GuiSnapshot>()),
+        readout_refresh_(DefaultReadoutRefreshInterval,
+                         [this] { UpdateReadouts(); }),
+        graph_refresh_(DefaultGraphRefreshInterval, [this] {
+          emit SeriesChanged();
+        }) {
     QObject::connect(this, &GuiStateContainer::params_changed, [this]() {
       // TODO: This could come from GUI alarm settings instead.
       // Source for +/-5 is this thread:
@@ -58,6 +83,23 @@ public:
     });
     // Set initial alarm parameters per above.
     params_changed();
+
+    // Some of the measured parameters fall back to the commanded ones.
+    readouts_ = ComputeReadouts();
+    QObject::connect(this, &GuiStateContainer::params_changed,
+                     [this]() { readout_refresh_.Request(); });
+
+    read_counter_.setInterval(1000);
+    QObject::connect(&read_counter_, &QTimer::timeout, this, [this] {
+      DBG("QML read {} properties of GuiStateContainer in the last second",
+          property_reads_ - property_reads_counted_);
+      property_reads_counted_ = property_reads_;
+    });
+    read_counter_.start();
+
+    pipeline_.Start([this] {
+      QMetaObject::invokeMethod(this, [this] { UpdateFromPipeline(); });
+    });
   }
 
   bool get_is_using_fake_data() const { return is_using_fake_data_; }
@@ -97,37 +139,38 @@ public:
     return status;
   }
 
-  // Returns the recent history of ControllerStatus.
-  std::vector<std::tuple<SteadyInstant, ControllerStatus>>
-  GetControllerStatusHistory() {
-    return history_.GetHistory();
-  }
-
   Q_PROPERTY(bool is_using_fake_data READ get_is_using_fake_data CONSTANT)
   // Measured parameters
   Q_PROPERTY(qreal measured_pressure READ get_measured_pressure NOTIFY
-                 measurements_changed)
+                 measured_pressure_changed)
   Q_PROPERTY(
-      qreal measured_flow READ get_measured_flow NOTIFY measurements_changed)
-  Q_PROPERTY(qreal measured_tv READ get_measured_tv NOTIFY measurements_changed)
+      qreal measured_flow READ get_measured_flow NOTIFY measured_flow_changed)
+  Q_PROPERTY(qreal measured_tv READ get_measured_tv NOTIFY measured_tv_changed)
   Q_PROPERTY(
-      quint32 measured_rr READ get_measured_rr NOTIFY measurements_changed)
+      quint32 measured_rr READ get_measured_rr NOTIFY measured_rr_changed)
   Q_PROPERTY(
-      quint32 measured_peep READ get_measured_peep NOTIFY measurements_changed)
+      quint32 measured_peep READ get_measured_peep NOTIFY measured_peep_changed)
   Q_PROPERTY(
-      quint32 measured_pip READ get_measured_pip NOTIFY measurements_changed)
+      quint32 measured_pip READ get_measured_pip NOTIFY measured_pip_changed)
   Q_PROPERTY(
-      qreal measured_ier READ get_measured_ier NOTIFY measurements_changed)
+      qreal measured_ier READ get_measured_ier NOTIFY measured_ier_changed)
   Q_PROPERTY(qreal measured_fio2_percent READ get_measured_fio2_percent NOTIFY
-                 measurements_changed)
+                 measured_fio2_percent_changed)
 
   // Graphs
-  Q_PROPERTY(QVector<QPointF> pressureSeries READ GetPressureSeries NOTIFY
-                 PressureSeriesChanged)
+  //
+  // Points are timed in seconds since startup, and seriesTimeOrigin is the
+  // time of the latest update, which the graphs show as their right edge.
+  // This way, updates only need to add and remove points at the ends of the
+  // series.
+  //
+  // They change together, so they share a change notification.
   Q_PROPERTY(
-      QVector<QPointF> flowSeries READ GetFlowSeries NOTIFY FlowSeriesChanged)
-  Q_PROPERTY(QVector<QPointF> tidalSeries READ GetTidalSeries NOTIFY
-                 TidalSeriesChanged)
+      qreal seriesTimeOrigin READ GetSeriesTimeOrigin NOTIFY SeriesChanged)
+  Q_PROPERTY(
+      GraphSeries pressureSeries READ GetPressureSeries NOTIFY SeriesChanged)
+  Q_PROPERTY(GraphSeries flowSeries READ GetFlowSeries NOTIFY SeriesChanged)
+  Q_PROPERTY(GraphSeries tidalSeries READ GetTidalSeries NOTIFY SeriesChanged)
   Q_PROPERTY(AlarmManager *alarmManager READ GetAlarmManager NOTIFY
                  AlarmManagerChanged)
 
@@ -149,7 +192,15 @@ public:
   Q_PROPERTY(SimpleClock *clock READ get_clock NOTIFY clock_changed)
   Q_PROPERTY(bool isDebugBuild READ IsDebugBuild NOTIFY IsDebugBuildChanged)
 
-  QVector<QPointF> GetPressureSeries() const { return pressure_series_; }
+  qreal GetSeriesTimeOrigin() const {
+    CountRead();
+    return snapshot_->series_time_origin;
+  }
+
+  GraphSeries GetPressureSeries() const {
+    CountRead();
+    return snapshot_->pressure_series;
+  }
 
   bool IsDebugBuild() const {
 #ifdef QT_DEBUG
@@ -158,53 +209,85 @@ public:
     return false;
 #endif
   }
-  void SetPressureSeries(QVector<QPointF> &&series) {
-    pressure_series_ = series;
-    emit PressureSeriesChanged();
+  GraphSeries GetFlowSeries() const {
+    CountRead();
+    return snapshot_->flow_series;
   }
 
-  QVector<QPointF> GetFlowSeries() const { return flow_series_; }
-
-  void SetFlowSeries(QVector<QPointF> &&series) {
-    flow_series_ = series;
-    emit FlowSeriesChanged();
+  GraphSeries GetTidalSeries() const {
+    CountRead();
+    return snapshot_->tidal_series;
   }
 
-  QVector<QPointF> GetTidalSeries() const { return tidal_series_; }
+  AlarmManager *GetAlarmManager() { return &alarm_manager_; }
 
-  void SetTidalSeries(QVector<QPointF> &&series) {
-    tidal_series_ = series;
-    emit TidalSeriesChanged();
+  // Sets how often the readouts of measured parameters, and the graphs, may
+  // be updated.
+  void SetReadoutRefreshInterval(DurationMs interval) {
+    readout_refresh_.SetInterval(interval);
+  }
+  void SetGraphRefreshInterval(DurationMs interval) {
+    graph_refresh_.SetInterval(interval);
   }
 
-  AlarmManager *GetAlarmManager() { return &alarm_manager_; }
+  // Returns how many times the measured parameters and the graphs were read
+  // since startup, which is how many times bindings to them were evaluated.
+  // The count per second is logged at debug level.
+  uint64_t GetPropertyReads() const { return property_reads_; }
 
 signals:
-  void measurements_changed();
+  void measured_pressure_changed();
+  void measured_flow_changed();
+  void measured_tv_changed();
+  void measured_rr_changed();
+  void measured_peep_changed();
+  void measured_pip_changed();
+  void measured_ier_changed();
+  void measured_fio2_percent_changed();
   void params_changed();
   void battery_percentage_changed();
   void clock_changed();
-  void PressureSeriesChanged();
-  void FlowSeriesChanged();
-  void TidalSeriesChanged();
+  void SeriesChanged();
   void IsDebugBuildChanged();
   void AlarmManagerChanged();
 
-public slots:
-  // Adds a data point of controller status to the history.
-  void controller_status_changed(SteadyInstant now,
-                                 const ControllerStatus &status) {
-    breath_signals_.Update(now, status);
-    alarm_manager_.Update(now, status, breath_signals_);
-    if (history_.Append(now, status)) {
-      UpdateGraphs();
-      measurements_changed();
-    }
+public:
+  // Queues the ControllerStatus-es which arrived together at a given time,
+  // oldest first, to be added to the history along with the waveform samples
+  // they carry.  Thread-safe; the UI is updated once they're processed.
+  void
+  ReceiveControllerStatuses(SteadyInstant received,
+                            const std::vector<ControllerStatus> &statuses) {
+    pipeline_.Push(received, statuses);
   }
 
-  void UpdateGraphs();
+  // Shows a snapshot of the processed statuses.  This is all the work the UI
+  // thread does for them.
+  void ApplySnapshot(std::unique_ptr<const GuiSnapshot> snapshot);
 
 private:
+  // Values of the measured parameters.
+  struct Readouts {
+    qreal pressure;
+    qreal flow;
+    qreal tv;
+    qreal rr;
+    qreal peep;
+    qreal pip;
+    qreal ier;
+    qreal fio2_percent;
+  };
+
+  // Applies the latest snapshot of the pipeline, if there is a new one.
+  void UpdateFromPipeline();
+
+  // Computes the measured parameters from the snapshot being shown.
+  Readouts ComputeReadouts() const;
+  // Updates the readouts, notifying those which changed.
+  void UpdateReadouts();
+
+  void CountRead() const { property_reads_++; }
+
   int get_battery_percentage() const {
     return battery_percentage_;
     // TODO: Figure our how battery will be implemented
@@ -214,45 +297,54 @@ private:
 
   // ====================== Measured parameters ========================
   qreal get_measured_pressure() const {
-    return history_.GetLastStatus().sensor_readings.patient_pressure_cm_h2o;
+    CountRead();
+    return readouts_.pressure;
   }
   qreal get_measured_flow() const {
-    return 0.001 * history_.GetLastStatus().sensor_readings.flow_ml_per_min;
+    CountRead();
+    return readouts_.flow;
   }
   qreal get_measured_tv() const {
-    return history_.GetLastStatus().sensor_readings.volume_ml;
+    CountRead();
+    return readouts_.tv;
   }
   qreal get_measured_rr() const {
-    return (commanded_mode_ == VentilationMode::PRESSURE_CONTROL)
-               ? commanded_rr_
-               : breath_signals_.rr().value_or(commanded_rr_);
+    CountRead();
+    return readouts_.rr;
   }
   qreal get_measured_peep() const {
-    return breath_signals_.peep().value_or(commanded_peep_);
+    CountRead();
+    return readouts_.peep;
   }
   qreal get_measured_pip() const {
-    return breath_signals_.pip().value_or(commanded_pip_);
+    CountRead();
+    return readouts_.pip;
   }
   qreal get_measured_ier() const {
-    float breath_duration_sec = 60.0 / get_measured_rr();
-    float commanded_e_time = breath_duration_sec - commanded_i_time_;
-    return commanded_i_time_ / commanded_e_time;
+    CountRead();
+    return readouts_.ier;
   }
   qreal get_measured_fio2_percent() const {
-    return 100 * history_.GetLastStatus().sensor_readings.fio2;
+    CountRead();
+    return readouts_.fio2_percent;
   }
 
   const SteadyInstant startup_time_ = SteadyClock::now();
   bool is_using_fake_data_ = false;
-  ControllerHistory history_;
-  BreathSignals breath_signals_;
+  StatusPipeline pipeline_;
+  // The snapshot being shown.
+  std::unique_ptr<const GuiSnapshot> snapshot_;
+  // The measured parameters as last notified.
+  Readouts readouts_ = {};
+  UpdateThrottle readout_refresh_;
+  UpdateThrottle graph_refresh_;
+
+  mutable uint64_t property_reads_ = 0;
+  uint64_t property_reads_counted_ = 0;
+  QTimer read_counter_;
   int battery_percentage_ = 70;
   SimpleClock clock_;
 
-  QVector<QPointF> pressure_series_;
-  QVector<QPointF> flow_series_;
-  QVector<QPointF> tidal_series_;
-
   // Commanded parameters
   // Initialize to default parameters like in
   // https://github.com/RespiraWorks/Ventilator/blob/89b817af/controller/src/main.cpp#L84
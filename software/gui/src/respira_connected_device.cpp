@@ -0,0 +1,168 @@
+#include "respira_connected_device.h"
+
+#include "framing.h"
+#include "logger.h"
+#include "pb_common.h"
+#include "pb_decode.h"
+#include "pb_encode.h"
+
+RespiraConnectedDevice::RespiraConnectedDevice(QString portName)
+    : serialPortName_(portName),
+      parser_(max_encoded_frame_size(ControllerStatus_size)) {
+  context_.moveToThread(&thread_);
+}
+
+RespiraConnectedDevice::~RespiraConnectedDevice() {
+  if (thread_.isRunning()) {
+    // The port and timer have to go away on the thread they live on.
+    QMetaObject::invokeMethod(
+        &context_,
+        [this] {
+          ClosePort();
+          frame_timeout_.reset();
+        },
+        Qt::BlockingQueuedConnection);
+    thread_.quit();
+    thread_.wait();
+  }
+}
+
+void RespiraConnectedDevice::Start(StatusesCallback on_statuses) {
+  on_statuses_ = std::move(on_statuses);
+  thread_.start();
+  QMetaObject::invokeMethod(&context_, [this] {
+    frame_timeout_ = std::make_unique<QTimer>();
+    frame_timeout_->setInterval(INTER_FRAME_TIMEOUT_MS.count());
+    QObject::connect(frame_timeout_.get(), &QTimer::timeout, &context_, [] {
+      // TODO Raise an Alert?
+      CRIT("Timeout while waiting for a serial frame from Cycle Controller");
+    });
+    OpenPort();
+  });
+}
+
+bool RespiraConnectedDevice::SendGuiStatus(const GuiStatus &gui_status) {
+  uint8_t tx_buffer[GuiStatus_size];
+
+  pb_ostream_t stream = pb_ostream_from_buffer(tx_buffer, sizeof(tx_buffer));
+  if (!pb_encode(&stream, GuiStatus_fields, &gui_status)) {
+    // TODO Raise an Alert?
+    CRIT("Could not serialize GuiStatus");
+    return false;
+  }
+
+  uint8_t frame[max_encoded_frame_size(GuiStatus_size)];
+  uint32_t frame_length =
+      encode_frame(tx_buffer, static_cast<uint32_t>(stream.bytes_written),
+                   frame, sizeof(frame));
+  if (frame_length == 0) {
+    CRIT("Could not frame GuiStatus");
+    return false;
+  }
+
+  QByteArray bytes(reinterpret_cast<const char *>(frame), frame_length);
+  QMetaObject::invokeMethod(&context_, [this, bytes] { Write(bytes); });
+  return true;
+}
+
+void RespiraConnectedDevice::OpenPort() {
+  serialPort_ = std::make_unique<QSerialPort>();
+  serialPort_->setPortName(serialPortName_);
+  serialPort_->setBaudRate(QSerialPort::Baud115200);
+  serialPort_->setDataBits(QSerialPort::Data8);
+  serialPort_->setParity(QSerialPort::NoParity);
+  serialPort_->setStopBits(QSerialPort::OneStop);
+  serialPort_->setFlowControl(QSerialPort::NoFlowControl);
+
+  if (!serialPort_->open(QIODevice::ReadWrite)) {
+    // TODO Raise an Alert?
+    CRIT("Could not open serial port {}", serialPortName_.toStdString());
+    serialPort_.reset();
+    QTimer::singleShot(REOPEN_INTERVAL_MS.count(), &context_,
+                       [this] { OpenPort(); });
+    return;
+  }
+
+  QObject::connect(serialPort_.get(), &QSerialPort::readyRead, &context_,
+                   [this] { OnReadyRead(); });
+  QObject::connect(
+      serialPort_.get(), &QSerialPort::errorOccurred, &context_,
+      [this](QSerialPort::SerialPortError error) {
+        if (error != QSerialPort::ResourceError) {
+          return;
+        }
+        // The port went away, e.g. the cable was unplugged.
+        CRIT("Lost serial port {}", serialPortName_.toStdString());
+        // Not from within the signal handler, as this deletes the port.
+        QTimer::singleShot(0, &context_, [this] {
+          ClosePort();
+          QTimer::singleShot(REOPEN_INTERVAL_MS.count(), &context_,
+                             [this] { OpenPort(); });
+        });
+      });
+  frame_timeout_->start();
+}
+
+void RespiraConnectedDevice::ClosePort() {
+  if (serialPort_ != nullptr) {
+    serialPort_->close();
+    serialPort_.reset();
+  }
+}
+
+void RespiraConnectedDevice::OnReadyRead() {
+  SteadyInstant now = SteadyClock::now();
+  QByteArray bytes = serialPort_->readAll();
+
+  // Decode every complete frame, since each of them carries its own
+  // waveform samples. The parser keeps whatever follows the last one, which
+  // is the beginning of the next frame.
+  std::vector<ControllerStatus> controller_statuses;
+  parser_.Feed(bytes.constData(), bytes.size(), [&](const QByteArray &frame) {
+    ControllerStatus controller_status = ControllerStatus_init_zero;
+    if (DecodeFrame(frame, &controller_status)) {
+      controller_statuses.push_back(controller_status);
+    }
+  });
+
+  if (!controller_statuses.empty()) {
+    frame_timeout_->start();
+    on_statuses_(now, controller_statuses);
+  }
+}
+
+void RespiraConnectedDevice::Write(const QByteArray &frame) {
+  if (serialPort_ == nullptr) {
+    CRIT("Could not open serial port for sending {}",
+         serialPortName_.toStdString());
+    // TODO Raise an Alert?
+    return;
+  }
+  if (serialPort_->bytesToWrite() > MAX_PENDING_WRITE_BYTES) {
+    // TODO Raise an Alert?
+    CRIT("Serial port is not sending, dropping GuiStatus");
+    return;
+  }
+  serialPort_->write(frame);
+}
+
+bool RespiraConnectedDevice::DecodeFrame(const QByteArray &frame,
+                                         ControllerStatus *controller_status) {
+  uint8_t payload[ControllerStatus_size];
+  uint32_t payload_length = decode_frame(
+      reinterpret_cast<const uint8_t *>(frame.constData()),
+      static_cast<uint32_t>(frame.size()), payload, sizeof(payload));
+  if (payload_length == 0) {
+    CRIT("Received an invalid frame from Cycle Controller");
+    // TODO: Raise an Alert?
+    return false;
+  }
+
+  pb_istream_t stream = pb_istream_from_buffer(payload, payload_length);
+  if (!pb_decode(&stream, ControllerStatus_fields, controller_status)) {
+    CRIT("Could not de-serialize received data as Controller Status");
+    // TODO: Raise an Alert?
+    return false;
+  }
+  return true;
+}
@@ -20,6 +20,9 @@ HEADERS += \
   chrono.h \
   connected_device.h \
   controller_history.h \
+  frame_parser.h \
+  graph_decimator.h \
+  graph_series.h \
   gui_state_container.h \
   latching_alarm.h \
   patient_detached_alarm.h \
@@ -28,11 +31,15 @@ HEADERS += \
   pip_not_reached_alarm.h \
   respira_connected_device.h \
   simple_clock.h \
+  status_pipeline.h \
   time_series_graph.h \
   time_series_graph_painter.h \
+  update_throttle.h \
   logger.h
 
 SOURCES += gui_state_container.cpp \
   periodic_closure.cpp \
+  respira_connected_device.cpp \
+  status_pipeline.cpp \
   time_series_graph_painter.cpp \
   logger.cpp
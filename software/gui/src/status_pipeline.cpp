@@ -0,0 +1,205 @@
+#include "status_pipeline.h"
+#include "sample_batch.h"
+
+#include <algorithm>
+
+StatusPipeline::StatusPipeline(DurationMs history_window,
+                               DurationMs granularity,
+                               SteadyInstant startup_time)
+    : startup_time_(startup_time), history_(history_window, granularity) {}
+
+StatusPipeline::~StatusPipeline() {
+  Stop();
+  delete slot_.exchange(nullptr);
+}
+
+void StatusPipeline::Start(std::function<void()> on_snapshot) {
+  on_snapshot_ = std::move(on_snapshot);
+  worker_thread_ = std::thread(&StatusPipeline::Loop, this);
+}
+
+void StatusPipeline::Stop() {
+  if (!worker_thread_.joinable()) {
+    // Already stopped.
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> l(mu_);
+    stop_requested_ = true;
+  }
+  // notify_one() should be called without holding the mutex.
+  queue_cv_.notify_one();
+  worker_thread_.join();
+}
+
+void StatusPipeline::Push(SteadyInstant received,
+                          const std::vector<ControllerStatus> &statuses) {
+  {
+    std::unique_lock<std::mutex> l(mu_);
+    queue_.push_back({received, statuses});
+  }
+  queue_cv_.notify_one();
+}
+
+void StatusPipeline::Process(SteadyInstant received,
+                             const std::vector<ControllerStatus> &statuses) {
+  ProcessStatuses(received, statuses);
+  Publish();
+}
+
+std::unique_ptr<const GuiSnapshot> StatusPipeline::Take() {
+  std::unique_ptr<GuiSnapshot> snapshot(slot_.exchange(nullptr));
+  if (snapshot == nullptr) {
+    return nullptr;
+  }
+
+  // The snapshot was put together before the worker knew how far the UI got,
+  // so it may repeat statuses which came with an earlier one.
+  std::vector<ReceivedStatus> &statuses = snapshot->statuses;
+  statuses.erase(std::remove_if(statuses.begin(), statuses.end(),
+                                [this](const ReceivedStatus &s) {
+                                  return s.seq < last_taken_seq_;
+                                }),
+                 statuses.end());
+  if (!statuses.empty()) {
+    last_taken_seq_ = statuses.back().seq + 1;
+    taken_seq_.store(last_taken_seq_);
+  }
+  return snapshot;
+}
+
+void StatusPipeline::Loop() {
+  while (true) {
+    std::vector<Received> received;
+    {
+      std::unique_lock<std::mutex> l(mu_);
+      queue_cv_.wait(l, [this] { return stop_requested_ || !queue_.empty(); });
+      if (stop_requested_) {
+        return;
+      }
+      received.swap(queue_);
+    }
+
+    // Whatever piled up while the previous snapshot was put together goes
+    // into a single new one.
+    for (const Received &r : received) {
+      ProcessStatuses(r.time, r.statuses);
+    }
+    if (Publish() && on_snapshot_) {
+      on_snapshot_();
+    }
+  }
+}
+
+void StatusPipeline::ProcessStatuses(
+    SteadyInstant received, const std::vector<ControllerStatus> &statuses) {
+  if (statuses.empty()) {
+    return;
+  }
+  uint64_t latest_uptime_ms = statuses.back().uptime_ms;
+  for (const ControllerStatus &status : statuses) {
+    // The latest status was received then; place the older ones according
+    // to the controller's uptime (unless it restarted).
+    DurationMs age(0);
+    if (status.uptime_ms <= latest_uptime_ms) {
+      age = DurationMs(latest_uptime_ms - status.uptime_ms);
+    }
+    ProcessStatus(received - age, status);
+  }
+}
+
+void StatusPipeline::ProcessStatus(SteadyInstant time,
+                                   const ControllerStatus &status) {
+  breath_signals_.Update(time, status);
+  AppendToHistory(time, status);
+
+  untaken_statuses_.push_back({next_seq_++, time, status, breath_signals_});
+  if (untaken_statuses_.size() > MaxUntakenStatuses) {
+    untaken_statuses_.pop_front();
+  }
+}
+
+void StatusPipeline::AppendToHistory(SteadyInstant time,
+                                     const ControllerStatus &status) {
+  WaveformSample samples[SampleBatchCapacity];
+  uint32_t count = unpack_samples(status.samples, samples, SampleBatchCapacity);
+  if (count == 0) {
+    history_.Append(time, status);
+    return;
+  }
+
+  // Samples are timed by the controller's uptime, and status was sent at
+  // status.uptime_ms, which corresponds to time.
+  int64_t status_us = static_cast<int64_t>(status.uptime_ms) * 1000;
+  for (uint32_t i = 0; i < count; ++i) {
+    const WaveformSample &sample = samples[i];
+    int64_t sample_us = static_cast<int64_t>(
+        status.samples.first_sample_uptime_us +
+        uint64_t{i} * status.samples.sample_period_us);
+    SteadyInstant sample_time =
+        time + std::chrono::duration_cast<SteadyClock::duration>(
+                   std::chrono::microseconds(sample_us - status_us));
+
+    ControllerStatus sample_status = status;
+    sample_status.sensor_readings.patient_pressure_cm_h2o =
+        sample.patient_pressure_cm_h2o;
+    sample_status.sensor_readings.flow_ml_per_min = sample.flow_ml_per_min;
+    sample_status.sensor_readings.volume_ml = sample.volume_ml;
+    sample_status.sensor_readings.breath_id = sample.breath_id;
+    sample_status.pressure_setpoint_cm_h2o = sample.pressure_setpoint_cm_h2o;
+    history_.Append(sample_time, sample_status);
+  }
+}
+
+void StatusPipeline::UpdateSeries() {
+  // Drop the points which were kicked out of the history since the last
+  // update, then add those appended to it.
+  uint64_t begin = history_.Begin();
+  uint64_t end = history_.End();
+  int dropped = static_cast<int>(
+      std::min<uint64_t>(begin - std::min(begin, series_begin_),
+                         pressure_series_.Series().size()));
+  pressure_series_.DropFront(dropped);
+  flow_series_.DropFront(dropped);
+  tidal_series_.DropFront(dropped);
+
+  for (uint64_t n = std::max(begin, series_end_); n < end; ++n) {
+    qreal seconds = SecondsSinceStartup(history_.Time(n));
+    pressure_series_.Append(
+        QPointF(seconds, history_.PatientPressureCmH2O(n)));
+    // The graph should be in L/min, but the data is ml/min
+    flow_series_.Append(QPointF(seconds, 0.001 * history_.FlowMlPerMin(n)));
+    tidal_series_.Append(QPointF(seconds, history_.VolumeMl(n)));
+  }
+  series_begin_ = begin;
+  series_end_ = end;
+}
+
+bool StatusPipeline::Publish() {
+  UpdateSeries();
+
+  uint64_t taken_seq = taken_seq_.load();
+  while (!untaken_statuses_.empty() &&
+         untaken_statuses_.front().seq < taken_seq) {
+    untaken_statuses_.pop_front();
+  }
+
+  auto snapshot = std::make_unique<GuiSnapshot>();
+  snapshot->statuses.assign(untaken_statuses_.begin(),
+                            untaken_statuses_.end());
+  snapshot->last_status = history_.GetLastStatus();
+  snapshot->breath_signals = breath_signals_;
+  // The snapshot shares the points of the series, which only ever get
+  // appended to past its end.
+  snapshot->pressure_series = pressure_series_.Series();
+  snapshot->flow_series = flow_series_.Series();
+  snapshot->tidal_series = tidal_series_.Series();
+  snapshot->series_time_origin = SecondsSinceStartup(SteadyClock::now());
+  snapshot->history_end = history_.End();
+
+  GuiSnapshot *replaced = slot_.exchange(snapshot.release());
+  bool was_empty = replaced == nullptr;
+  delete replaced;
+  return was_empty;
+}
@@ -0,0 +1,156 @@
+#ifndef STATUS_PIPELINE_H
+#define STATUS_PIPELINE_H
+
+#include "breath_signals.h"
+#include "chrono.h"
+#include "controller_history.h"
+#include "graph_series.h"
+#include "network_protocol.pb.h"
+
+#include <QPointF>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// A ControllerStatus along with what the alarms need to look at it.
+struct ReceivedStatus {
+  // Numbered in the order the statuses were received.
+  uint64_t seq;
+  // When the status was sent, in GUI time.
+  SteadyInstant time;
+  ControllerStatus status;
+  // The breath signals right after the status.
+  BreathSignals breath_signals;
+};
+
+// Everything the UI shows about the incoming ControllerStatus-es, as of a
+// given moment, ready to be rendered.  Never changes once published; the
+// series share their points with the pipeline's (see GraphSeries), so handing
+// them on doesn't copy them.
+struct GuiSnapshot {
+  // The statuses received since the previous snapshot which the UI took, so
+  // that the alarms see every one of them, even if the UI skipped some
+  // snapshots.
+  std::vector<ReceivedStatus> statuses;
+
+  // The latest point in the history, and the breath signals up to it.
+  ControllerStatus last_status = ControllerStatus_init_zero;
+  BreathSignals breath_signals;
+
+  // The history, graphed in seconds since startup (see GuiStateContainer).
+  // history_end tells whether it changed since an earlier snapshot.
+  GraphSeries pressure_series;
+  GraphSeries flow_series;
+  GraphSeries tidal_series;
+  qreal series_time_origin = 0;
+  uint64_t history_end = 0;
+};
+
+// Turns ControllerStatus-es into GuiSnapshot-s on a worker thread, so that
+// the UI thread only has to pick up the latest snapshot and show it.
+//
+// Received statuses are queued, and the worker thread feeds each of them
+// into the breath signals and the history, then graphs the points which came
+// and went, and publishes a new snapshot.  Snapshots are exchanged through a
+// single slot: publishing replaces the one the UI didn't take yet, if any,
+// and taking leaves the slot empty; neither of them ever waits on the other.
+class StatusPipeline {
+public:
+  // Keeps a history of given window and granularity (see ControllerHistory),
+  // with points timed relative to startup_time.
+  StatusPipeline(DurationMs history_window, DurationMs granularity,
+                 SteadyInstant startup_time);
+
+  // Calls Stop().
+  ~StatusPipeline();
+
+  // Starts processing pushed statuses on the worker thread.
+  //
+  // on_snapshot is called from the worker thread when a snapshot is
+  // published into an empty slot, i.e. when the UI should come and Take() it.
+  // While the UI hasn't done so, newer snapshots replace that one without
+  // calling on_snapshot again.
+  void Start(std::function<void()> on_snapshot);
+  // Stops the worker thread, and waits for it to finish. Statuses still in
+  // the queue are dropped.
+  void Stop();
+
+  // Queues the ControllerStatus-es which arrived together at a given time,
+  // oldest first.  Thread-safe.
+  void Push(SteadyInstant received,
+            const std::vector<ControllerStatus> &statuses);
+
+  // Processes the statuses like Push(), but on the calling thread, and
+  // publishes a snapshot right away.  For when the pipeline isn't started,
+  // e.g. in tests.
+  void Process(SteadyInstant received,
+               const std::vector<ControllerStatus> &statuses);
+
+  // Returns the latest snapshot, or nullptr if none was published since the
+  // last call.  Lock-free; call it from one thread only.
+  std::unique_ptr<const GuiSnapshot> Take();
+
+private:
+  struct Received {
+    SteadyInstant time;
+    std::vector<ControllerStatus> statuses;
+  };
+
+  void Loop();
+
+  void ProcessStatuses(SteadyInstant received,
+                       const std::vector<ControllerStatus> &statuses);
+  void ProcessStatus(SteadyInstant time, const ControllerStatus &status);
+  // Appends a point to the history for each of the waveform samples in
+  // status, or for status itself if it has none.
+  void AppendToHistory(SteadyInstant time, const ControllerStatus &status);
+  void UpdateSeries();
+  // Returns true if the slot was empty.
+  bool Publish();
+
+  // Returns the time of a history point as placed on the graphs.
+  qreal SecondsSinceStartup(SteadyInstant time) const {
+    return std::chrono::duration<qreal>(time - startup_time_).count();
+  }
+
+  // The statuses the UI may not have seen yet are kept for this many at most,
+  // in case it doesn't take any snapshots for a while.
+  static constexpr size_t MaxUntakenStatuses = 1000;
+
+  const SteadyInstant startup_time_;
+
+  // Only touched by the thread processing statuses.
+  ControllerHistory history_;
+  BreathSignals breath_signals_;
+  GraphSeriesBuilder pressure_series_;
+  GraphSeriesBuilder flow_series_;
+  GraphSeriesBuilder tidal_series_;
+  // Graphed history points are numbered from series_begin_ to
+  // series_end_ - 1 in the history.
+  uint64_t series_begin_ = 0;
+  uint64_t series_end_ = 0;
+  std::deque<ReceivedStatus> untaken_statuses_;
+  uint64_t next_seq_ = 0;
+
+  // The statuses up to this one (exclusive) made it to the UI.
+  std::atomic<uint64_t> taken_seq_{0};
+  // The published snapshot which the UI didn't take yet, owned by the slot.
+  std::atomic<GuiSnapshot *> slot_{nullptr};
+  // Only touched by Take().
+  uint64_t last_taken_seq_ = 0;
+
+  std::function<void()> on_snapshot_;
+  std::thread worker_thread_;
+  std::mutex mu_;
+  std::condition_variable queue_cv_;
+  std::vector<Received> queue_;
+  bool stop_requested_ = false;
+};
+
+#endif // STATUS_PIPELINE_H
@@ -1,11 +1,10 @@
 #ifndef TIME_SERIES_GRAPH_H_
 #define TIME_SERIES_GRAPH_H_
 
+#include "graph_series.h"
 #include "time_series_graph_painter.h"
 #include <QColor>
-#include <QPointF>
 #include <QQuickItem>
-#include <QVector>
 
 /**
  * @brief The TimeSeriesGraph is an QuickItem used to display a time series.
@@ -13,12 +12,14 @@
 class TimeSeriesGraph : public QNanoQuickItem {
   Q_OBJECT
 
-  Q_PROPERTY(QVector<QPointF> dataset READ GetDataset WRITE SetDataset NOTIFY
-                 DatasetChanged)
+  Q_PROPERTY(
+      GraphSeries dataset READ GetDataset WRITE SetDataset NOTIFY DatasetChanged)
   Q_PROPERTY(
       float minValue READ GetMinValue WRITE SetMinValue NOTIFY MinValueChanged)
   Q_PROPERTY(
       float maxValue READ GetMaxValue WRITE SetMaxValue NOTIFY MaxValueChanged)
+  Q_PROPERTY(qreal timeOrigin READ GetTimeOrigin WRITE SetTimeOrigin NOTIFY
+                 TimeOriginChanged)
   Q_PROPERTY(float rangeInSeconds READ GetRangeInSeconds WRITE SetRangeInSeconds
                  NOTIFY RangeInSecondsChanged)
   Q_PROPERTY(QColor lineColor READ GetLineColor WRITE SetLineColor NOTIFY
@@ -37,7 +38,9 @@ public:
     return new TimeSeriesGraphPainter();
   }
 
-  QVector<QPointF> GetDataset() const { return dataset_; };
+  GraphSeries GetDataset() const { return dataset_; };
+
+  qreal GetTimeOrigin() const { return time_origin_; };
 
   float GetRangeInSeconds() const { return range_in_secs_; };
 
@@ -64,6 +67,17 @@ public slots:
       emit BaselineValueChanged();
     }
   }
+
+  // Sets the time shown at the right edge of the graph, in the same unit as
+  // the x of the dataset points (seconds).
+  void SetTimeOrigin(qreal timeOrigin) {
+    if (time_origin_ != timeOrigin) {
+      time_origin_ = timeOrigin;
+      emit TimeOriginChanged();
+      this->update();
+    }
+  }
+
   void SetRangeInSeconds(float rangeInSeconds) {
     if (range_in_secs_ != rangeInSeconds) {
       range_in_secs_ = rangeInSeconds;
@@ -85,7 +99,7 @@ public slots:
     }
   }
 
-  void SetDataset(QVector<QPointF> &dataset) {
+  void SetDataset(const GraphSeries &dataset) {
     dataset_ = dataset;
     emit DatasetChanged();
     this->update();
@@ -115,17 +129,19 @@ signals:
   void MaxValueChanged();
   void LineColorChanged();
   void AreaColorChanged();
+  void TimeOriginChanged();
   void RangeInSecondsChanged();
   void ShowBaselineChanged();
   void BaselineValueChanged();
 
 private:
-  QVector<QPointF> dataset_;
+  GraphSeries dataset_;
 
   QColor line_color_ = QColor(255, 255, 255, 255);
   QColor area_color_ = QColor(255, 255, 255, 255);
   float max_value_ = 0;
   float min_value_ = 0;
+  qreal time_origin_ = 0;
   float range_in_secs_ = 30.0;
   bool show_baseline_ = true;
   float baseline_value_ = 0;
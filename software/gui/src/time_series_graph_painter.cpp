@@ -12,18 +12,22 @@ void TimeSeriesGraphPainter::paint(QNanoPainter *m_painter) {
   float w = width();
   float h = height();
 
-  int size = dataset_.size();
+  const std::deque<QPointF> &points = decimator_.Points();
+  int size = points.size();
 
   if (size < 2)
     return;
 
+  path_.resize(size);
+  for (int i = 0; i < size; i++)
+    path_[i] = QPointF(calculateRealX(points[i].x()),
+                       calculateRealY(points[i].y()));
+
   // Draw graph line
   m_painter->beginPath();
-  m_painter->moveTo(calculateRealX(dataset_[0].x()),
-                    calculateRealY(dataset_[0].y()));
+  m_painter->moveTo(path_[0].x(), path_[0].y());
   for (int i = 1; i < size; i++)
-    m_painter->lineTo(calculateRealX(dataset_[i].x()),
-                      calculateRealY(dataset_[i].y()));
+    m_painter->lineTo(path_[i].x(), path_[i].y());
 
   m_painter->setFillStyle(color_fill_);
   m_painter->setStrokeStyle(color_line_);
@@ -32,24 +36,20 @@ void TimeSeriesGraphPainter::paint(QNanoPainter *m_painter) {
 
   // Draw graph background area
   m_painter->beginPath();
-  m_painter->moveTo(calculateRealX(dataset_[0].x()),
-                    calculateRealY(dataset_[0].y()));
+  m_painter->moveTo(path_[0].x(), path_[0].y());
   for (int i = 1; i < size; i++)
-    m_painter->lineTo(calculateRealX(dataset_[i].x()),
-                      calculateRealY(dataset_[i].y()));
+    m_painter->lineTo(path_[i].x(), path_[i].y());
 
   m_painter->lineTo(w, h);
-  m_painter->lineTo(calculateRealX(dataset_[0].x()), h);
+  m_painter->lineTo(path_[0].x(), h);
 
   m_painter->fill();
 
   // Draw baseline
   if (show_baseline_) {
     m_painter->beginPath();
-    m_painter->moveTo(calculateRealX(dataset_[0].x()),
-                      calculateRealY(baseline_value_));
-    m_painter->lineTo(calculateRealX(dataset_[size - 1].x()),
-                      calculateRealY(baseline_value_));
+    m_painter->moveTo(path_[0].x(), calculateRealY(baseline_value_));
+    m_painter->lineTo(path_[size - 1].x(), calculateRealY(baseline_value_));
     m_painter->setLineWidth(1.0f);
     m_painter->setStrokeStyle(baseline_color_);
     m_painter->stroke();
@@ -62,11 +62,11 @@ void TimeSeriesGraphPainter::synchronize(QNanoQuickItem *item) {
   if (!realItem)
     return;
 
-  dataset_ = realItem->GetDataset();
   baseline_value_ = realItem->GetBaselineValue();
   show_baseline_ = realItem->GetShowBaseline();
   min_value_ = realItem->GetMinValue();
   max_value_ = realItem->GetMaxValue();
+  time_origin_ = realItem->GetTimeOrigin();
   range_in_sec = realItem->GetRangeInSeconds();
   color_line_ = QNanoColor(
       realItem->GetLineColor().red(), realItem->GetLineColor().green(),
@@ -74,4 +74,12 @@ void TimeSeriesGraphPainter::synchronize(QNanoQuickItem *item) {
   color_fill_ = QNanoColor(
       realItem->GetAreaColor().red(), realItem->GetAreaColor().green(),
       realItem->GetAreaColor().blue(), realItem->GetAreaColor().alpha());
+
+  // One column per pixel. Only the points appended to the dataset since the
+  // last frame get decimated, and those which scrolled out of the graph are
+  // dropped.
+  qreal columns = qMax<qreal>(realItem->width(), 1);
+  decimator_.SetColumnDuration(range_in_sec / columns);
+  decimator_.Update(realItem->GetDataset());
+  decimator_.DropBefore(time_origin_ - range_in_sec);
 }
@@ -1,6 +1,7 @@
 #ifndef TIME_SERIES_GRAPH_PAINTER_H_
 #define TIME_SERIES_GRAPH_PAINTER_H_
 
+#include "graph_decimator.h"
 #include "qnanoquickitem.h"
 #include "qnanoquickitempainter.h"
 #include <QQuickItem>
@@ -15,10 +16,15 @@ public:
   void synchronize(QNanoQuickItem *item);
 
 private:
-  QVector<QPointF> dataset_;
+  // The dataset, reduced to what can be drawn at the graph's width, kept from
+  // one frame to the next.
+  GraphDecimator decimator_;
+  // The points of the decimator, in pixels, reused for each frame.
+  QVector<QPointF> path_;
 
   float max_value_ = 100;
   float min_value_ = 0;
+  qreal time_origin_ = 0;
   float range_in_sec = 30;
   QNanoColor color_fill_ = QNanoColor(255, 255, 255, 90);
   QNanoColor color_gradient_end_ = QNanoColor(255, 255, 255, 90);
@@ -29,8 +35,8 @@ private:
 
   float baseline_value_ = 0;
 
-  float calculateRealX(float timeX) {
-    float result = width() * (1.0 + timeX / range_in_sec);
+  float calculateRealX(qreal timeX) {
+    float result = width() * (1.0 + (timeX - time_origin_) / range_in_sec);
     return result;
   }
 
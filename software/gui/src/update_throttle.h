@@ -0,0 +1,48 @@
+#ifndef UPDATE_THROTTLE_H
+#define UPDATE_THROTTLE_H
+
+#include "chrono.h"
+
+#include <QTimer>
+#include <algorithm>
+#include <functional>
+
+// Runs an update when requested, but at most once per interval: requests
+// made before the interval since the last update is over are batched into
+// one update at its end.  Updates run from the event loop, so all requests
+// made while handling the same event are batched too.
+//
+// Must be used from the thread which created it, which runs an event loop.
+class UpdateThrottle {
+public:
+  UpdateThrottle(DurationMs interval, std::function<void()> update)
+      : interval_(interval), update_(std::move(update)) {
+    timer_.setSingleShot(true);
+    QObject::connect(&timer_, &QTimer::timeout, &timer_, [this] {
+      last_update_ = SteadyClock::now();
+      update_();
+    });
+  }
+
+  DurationMs GetInterval() const { return interval_; }
+  // Takes effect from the next request on.
+  void SetInterval(DurationMs interval) { interval_ = interval; }
+
+  // Schedules an update, unless one is scheduled already.
+  void Request() {
+    if (timer_.isActive()) {
+      return;
+    }
+    DurationMs since_update = TimeAMinusB(SteadyClock::now(), last_update_);
+    DurationMs wait = std::max(interval_ - since_update, DurationMs(0));
+    timer_.start(static_cast<int>(wait.count()));
+  }
+
+private:
+  DurationMs interval_;
+  std::function<void()> update_;
+  QTimer timer_;
+  SteadyInstant last_update_;
+};
+
+#endif // UPDATE_THROTTLE_H
@@ -0,0 +1,85 @@
+#ifndef CONTROLLER_HISTORY_TEST_H_
+#define CONTROLLER_HISTORY_TEST_H_
+
+#include "controller_history.h"
+#include "network_protocol.pb.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+
+class ControllerHistoryTest : public QObject {
+  Q_OBJECT
+public:
+  ControllerHistoryTest() = default;
+  ~ControllerHistoryTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testWindowAndGranularity() {
+    SteadyInstant now = SteadyClock::now();
+    auto ms = [=](int millis) { return now + DurationMs(millis); };
+
+    ControllerHistory h(DurationMs(100), DurationMs(10));
+    QCOMPARE(h.Size(), 0);
+    QCOMPARE(h.GetLastStatus().sensor_readings.patient_pressure_cm_h2o, 0.0f);
+
+    QVERIFY(h.Append(ms(0), pressure(1)));
+    // Too close to the previous point.
+    QVERIFY(!h.Append(ms(5), pressure(2)));
+    QVERIFY(h.Append(ms(10), pressure(3)));
+    QCOMPARE(h.Size(), 2);
+    QCOMPARE(h.Begin(), uint64_t{0});
+    QCOMPARE(h.End(), uint64_t{2});
+    QCOMPARE(h.PatientPressureCmH2O(1), 3.0f);
+    QCOMPARE(h.GetLastStatus().sensor_readings.patient_pressure_cm_h2o, 3.0f);
+
+    // Points more than 100ms older than the latest one get kicked out.
+    for (int t = 20; t <= 110; t += 10) {
+      QVERIFY(h.Append(ms(t), pressure(t)));
+    }
+    QCOMPARE(h.Size(), 11);
+    QCOMPARE(h.Begin(), uint64_t{1});
+    QCOMPARE(h.End(), uint64_t{12});
+    QVERIFY(h.Time(h.Begin()) == ms(10));
+    QCOMPARE(h.PatientPressureCmH2O(h.Begin()), 3.0f);
+
+    // Going around the ring a few times.
+    for (int t = 120; t <= 1000; t += 10) {
+      QVERIFY(h.Append(ms(t), pressure(t)));
+    }
+    QCOMPARE(h.Size(), 11);
+    for (uint64_t n = h.Begin(); n < h.End(); ++n) {
+      int t = 1000 - 10 * static_cast<int>(h.End() - 1 - n);
+      QVERIFY(h.Time(n) == ms(t));
+      QCOMPARE(h.PatientPressureCmH2O(n), static_cast<float>(t));
+    }
+  }
+
+  void testColumns() {
+    ControllerStatus status = ControllerStatus_init_zero;
+    status.sensor_readings.patient_pressure_cm_h2o = 12;
+    status.sensor_readings.flow_ml_per_min = 3000;
+    status.sensor_readings.volume_ml = 250;
+    status.sensor_readings.breath_id = 42;
+    status.sensor_readings.fio2 = 0.21f;
+
+    ControllerHistory h(DurationMs(100), DurationMs(10));
+    QVERIFY(h.Append(SteadyClock::now(), status));
+    QCOMPARE(h.PatientPressureCmH2O(0), 12.0f);
+    QCOMPARE(h.FlowMlPerMin(0), 3000.0f);
+    QCOMPARE(h.VolumeMl(0), 250.0f);
+    QCOMPARE(h.BreathId(0), uint64_t{42});
+    QCOMPARE(h.GetLastStatus().sensor_readings.fio2, 0.21f);
+  }
+
+private:
+  static ControllerStatus pressure(float p) {
+    ControllerStatus res = ControllerStatus_init_zero;
+    res.sensor_readings.patient_pressure_cm_h2o = p;
+    return res;
+  }
+};
+
+#endif // CONTROLLER_HISTORY_TEST_H_
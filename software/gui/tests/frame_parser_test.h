@@ -0,0 +1,84 @@
+#ifndef FRAME_PARSER_TEST_H_
+#define FRAME_PARSER_TEST_H_
+
+#include "frame_parser.h"
+#include "framing.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+#include <algorithm>
+#include <vector>
+
+class FrameParserTest : public QObject {
+  Q_OBJECT
+public:
+  FrameParserTest() = default;
+  ~FrameParserTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testFrames() {
+    QByteArray bytes = mark() + "abc" + mark() + mark() + "de" + mark();
+    FrameParser parser(100);
+    QCOMPARE(feed(&parser, bytes), std::vector<QByteArray>({"abc", "de"}));
+  }
+
+  // Frames come out as soon as they're complete, however the bytes are split.
+  void testChunks() {
+    QByteArray bytes = mark() + "abc" + mark() + mark() + "defg" + mark() +
+                       mark() + "h" + mark();
+    for (int chunk = 1; chunk <= bytes.size(); chunk++) {
+      FrameParser parser(100);
+      std::vector<QByteArray> frames;
+      for (int i = 0; i < bytes.size(); i += chunk) {
+        std::vector<QByteArray> more = feed(&parser, bytes.mid(i, chunk));
+        frames.insert(frames.end(), more.begin(), more.end());
+        // All the frames ending within the chunk are out.
+        int end = std::min(i + chunk, bytes.size());
+        int expected = 0;
+        for (int j : {4, 10, 13}) {
+          expected += j < end ? 1 : 0;
+        }
+        QCOMPARE(static_cast<int>(frames.size()), expected);
+      }
+      QCOMPARE(frames, std::vector<QByteArray>({"abc", "defg", "h"}));
+    }
+  }
+
+  // Whatever comes before the first mark is the end of a frame which
+  // started before we were listening.
+  void testSynchronizes() {
+    FrameParser parser(100);
+    QCOMPARE(feed(&parser, "xyz" + mark() + "abc" + mark()),
+             std::vector<QByteArray>({"abc"}));
+  }
+
+  void testTooLong() {
+    FrameParser parser(4);
+    QByteArray bytes = mark() + "abcd" + mark() + mark() + "abcde" + mark() +
+                       mark() + "fg" + mark();
+    QCOMPARE(feed(&parser, bytes), std::vector<QByteArray>({"abcd", "fg"}));
+
+    // Also when split.
+    FrameParser split(4);
+    QCOMPARE(feed(&split, mark() + "abc"), std::vector<QByteArray>());
+    QCOMPARE(feed(&split, "de"), std::vector<QByteArray>());
+    QCOMPARE(feed(&split, "f" + mark() + mark() + "gh" + mark()),
+             std::vector<QByteArray>({"gh"}));
+  }
+
+private:
+  static QByteArray mark() { return QByteArray(1, char(FramingMark)); }
+
+  static std::vector<QByteArray> feed(FrameParser *parser,
+                                      const QByteArray &bytes) {
+    std::vector<QByteArray> frames;
+    parser->Feed(bytes.constData(), bytes.size(),
+                 [&](const QByteArray &frame) { frames.push_back(frame); });
+    return frames;
+  }
+};
+
+#endif // FRAME_PARSER_TEST_H_
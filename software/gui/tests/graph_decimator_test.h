@@ -0,0 +1,121 @@
+#ifndef GRAPH_DECIMATOR_TEST_H_
+#define GRAPH_DECIMATOR_TEST_H_
+
+#include "graph_decimator.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+#include <QVector>
+#include <vector>
+
+class GraphDecimatorTest : public QObject {
+  Q_OBJECT
+public:
+  GraphDecimatorTest() = default;
+  ~GraphDecimatorTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testKeepsPeaks() {
+    // 30s of pressure at 1kHz, on a 600 pixel wide graph, with a spike
+    // lasting a single sample.
+    QVector<QPointF> series;
+    for (int i = 0; i < 30000; i++) {
+      series.append(QPointF(0.001 * i, 5 + 10 * ((i / 500) % 2)));
+    }
+    series[12345].setY(42);
+    series[23456].setY(-3);
+
+    GraphDecimator d;
+    d.SetColumnDuration(30.0 / 600);
+    d.Update(graph_series(series));
+
+    const std::deque<QPointF> &points = d.Points();
+    QVERIFY(points.size() <= 2 * 600);
+    QVERIFY(points.front() == series.first());
+    QVERIFY(std::find(points.begin(), points.end(), series[12345]) !=
+            points.end());
+    QVERIFY(std::find(points.begin(), points.end(), series[23456]) !=
+            points.end());
+    for (size_t i = 1; i < points.size(); i++) {
+      QVERIFY(points[i - 1].x() < points[i].x());
+    }
+  }
+
+  void testSparseSeriesKeptAsIs() {
+    QVector<QPointF> series = {{0, 1}, {1, 2}, {2, 0}, {3, 5}};
+    GraphDecimator d;
+    d.SetColumnDuration(0.1);
+    d.Update(graph_series(series));
+    QCOMPARE(points(d), series);
+  }
+
+  // Adding points as they come gives the same result as adding them all at
+  // once.
+  void testIncremental() {
+    QVector<QPointF> all;
+    for (int i = 0; i < 2000; i++) {
+      all.append(QPointF(0.01 * i, qSin(0.37 * i) * 10));
+    }
+    GraphDecimator at_once;
+    at_once.SetColumnDuration(0.05);
+    at_once.Update(graph_series(all));
+
+    // As a history of the 500 most recent points, updated by 7 at a time.
+    GraphDecimator incremental;
+    incremental.SetColumnDuration(0.05);
+    GraphSeriesBuilder history;
+    for (int i = 0; i < all.size(); i++) {
+      history.Append(all[i]);
+      history.DropFront(qMax(0, history.Series().size() - 500));
+      if (i % 7 == 6 || i == all.size() - 1) {
+        incremental.Update(history.Series());
+      }
+    }
+    QCOMPARE(points(incremental), points(at_once));
+  }
+
+  void testDropBefore() {
+    GraphDecimator d;
+    d.SetColumnDuration(0.1);
+    d.Update(graph_series({{0, 1}, {1, 2}, {2, 3}, {3, 4}}));
+    d.DropBefore(1.5);
+    // The point before 1.5 is kept, for the line going to the next one.
+    QCOMPARE(points(d), QVector<QPointF>({{1, 2}, {2, 3}, {3, 4}}));
+    d.DropBefore(10);
+    QCOMPARE(points(d), QVector<QPointF>({{3, 4}}));
+  }
+
+  void testStartsOver() {
+    GraphDecimator d;
+    d.SetColumnDuration(0.1);
+    d.Update(graph_series({{5, 1}, {6, 2}}));
+
+    // A series which isn't a continuation of the previous one.
+    d.Update(graph_series({{1, 3}, {2, 4}}));
+    QCOMPARE(points(d), QVector<QPointF>({{1, 3}, {2, 4}}));
+
+    // A new column duration.
+    d.SetColumnDuration(10);
+    QVERIFY(d.Points().empty());
+    d.Update(graph_series({{1, 3}, {2, 4}, {3, 0}}));
+    QCOMPARE(points(d), QVector<QPointF>({{2, 4}, {3, 0}}));
+  }
+
+private:
+  static GraphSeries graph_series(const QVector<QPointF> &points) {
+    GraphSeriesBuilder builder;
+    for (const QPointF &point : points) {
+      builder.Append(point);
+    }
+    return builder.Series();
+  }
+
+  static QVector<QPointF> points(const GraphDecimator &d) {
+    return QVector<QPointF>(d.Points().begin(), d.Points().end());
+  }
+};
+
+#endif // GRAPH_DECIMATOR_TEST_H_
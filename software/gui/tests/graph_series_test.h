@@ -0,0 +1,63 @@
+#ifndef GRAPH_SERIES_TEST_H_
+#define GRAPH_SERIES_TEST_H_
+
+#include "graph_series.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+
+class GraphSeriesTest : public QObject {
+  Q_OBJECT
+public:
+  GraphSeriesTest() = default;
+  ~GraphSeriesTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testAppendAndDrop() {
+    GraphSeriesBuilder builder;
+    QVERIFY(builder.Series().isEmpty());
+
+    // Across a few chunks.
+    for (int i = 0; i < 1000; i++) {
+      builder.Append(QPointF(i, -i));
+    }
+    builder.DropFront(300);
+    const GraphSeries &series = builder.Series();
+    QCOMPARE(series.size(), 700);
+    for (int i = 0; i < series.size(); i++) {
+      QCOMPARE(series[i], QPointF(300 + i, -300 - i));
+    }
+    QCOMPARE(series.last(), QPointF(999, -999));
+
+    builder.DropFront(1000);
+    QVERIFY(builder.Series().isEmpty());
+    builder.Append(QPointF(1000, 0));
+    QCOMPARE(builder.Series().size(), 1);
+    QCOMPARE(builder.Series()[0], QPointF(1000, 0));
+  }
+
+  // Copies keep the points they had, and share them with the builder.
+  void testCopies() {
+    GraphSeriesBuilder builder;
+    for (int i = 0; i < 100; i++) {
+      builder.Append(QPointF(i, 0));
+    }
+    GraphSeries copy = builder.Series();
+    QCOMPARE(&copy[50], &builder.Series()[50]);
+
+    for (int i = 100; i < 1000; i++) {
+      builder.Append(QPointF(i, 0));
+      builder.DropFront(1);
+    }
+    QCOMPARE(copy.size(), 100);
+    for (int i = 0; i < copy.size(); i++) {
+      QCOMPARE(copy[i], QPointF(i, 0));
+    }
+    QCOMPARE(builder.Series()[0], QPointF(900, 0));
+  }
+};
+
+#endif // GRAPH_SERIES_TEST_H_
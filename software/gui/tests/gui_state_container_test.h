@@ -0,0 +1,105 @@
+#ifndef GUI_STATE_CONTAINER_TEST_H_
+#define GUI_STATE_CONTAINER_TEST_H_
+
+#include "gui_state_container.h"
+#include "network_protocol.pb.h"
+#include "status_pipeline.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+
+class GuiStateContainerTest : public QObject {
+  Q_OBJECT
+public:
+  GuiStateContainerTest() = default;
+  ~GuiStateContainerTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  // Only the measured parameters whose values changed are notified.
+  void testNotifiesChangedReadouts() {
+    GuiStateContainer c(DurationMs(1000), DurationMs(10));
+    QSignalSpy pressure(&c, &GuiStateContainer::measured_pressure_changed);
+    QSignalSpy tv(&c, &GuiStateContainer::measured_tv_changed);
+    QSignalSpy peep(&c, &GuiStateContainer::measured_peep_changed);
+    QSignalSpy series(&c, &GuiStateContainer::SeriesChanged);
+
+    SteadyInstant start = SteadyClock::now();
+    StatusPipeline p(DurationMs(1000), DurationMs(10), start);
+    p.Process(start, {status(/*pressure=*/10, /*volume=*/0)});
+    c.ApplySnapshot(p.Take());
+    QTRY_COMPARE(pressure.count(), 1);
+    QTRY_COMPARE(series.count(), 1);
+    QCOMPARE(c.property("measured_pressure").toReal(), 10.0);
+    // Neither the volume nor, without any breaths, the PEEP changed.
+    QCOMPARE(tv.count(), 0);
+    QCOMPARE(peep.count(), 0);
+
+    // The commanded PEEP is shown until one is measured.
+    c.setProperty("commanded_peep", 8);
+    QTRY_COMPARE(peep.count(), 1);
+    QCOMPARE(c.property("measured_peep").toUInt(), 8u);
+    QCOMPARE(pressure.count(), 1);
+  }
+
+  // However many snapshots come in, readouts and graphs are updated at most
+  // once per refresh interval.
+  void testThrottlesUpdates() {
+    GuiStateContainer c(DurationMs(1000), DurationMs(10));
+    c.SetReadoutRefreshInterval(DurationMs(300));
+    c.SetGraphRefreshInterval(DurationMs(300));
+    QSignalSpy pressure(&c, &GuiStateContainer::measured_pressure_changed);
+    QSignalSpy series(&c, &GuiStateContainer::SeriesChanged);
+
+    SteadyInstant start = SteadyClock::now();
+    StatusPipeline p(DurationMs(1000), DurationMs(10), start);
+    for (int i = 0; i < 10; i++) {
+      p.Process(start + DurationMs(10 * i), {status(i + 1, 0)});
+      c.ApplySnapshot(p.Take());
+    }
+    QTRY_COMPARE(pressure.count(), 1);
+    QCOMPARE(series.count(), 1);
+    QCOMPARE(c.property("measured_pressure").toReal(), 10.0);
+
+    for (int i = 10; i < 20; i++) {
+      p.Process(start + DurationMs(10 * i), {status(i + 1, 0)});
+      c.ApplySnapshot(p.Take());
+      QTest::qWait(10);
+    }
+    QCOMPARE(pressure.count(), 1);
+    QCOMPARE(series.count(), 1);
+    QTRY_COMPARE(pressure.count(), 2);
+    QTRY_COMPARE(series.count(), 2);
+    QCOMPARE(c.property("measured_pressure").toReal(), 20.0);
+  }
+
+  // Notifying doesn't read anything; bindings re-evaluated because of it do.
+  void testCountsPropertyReads() {
+    GuiStateContainer c(DurationMs(1000), DurationMs(10));
+    uint64_t reads = c.GetPropertyReads();
+    c.property("measured_pressure");
+    c.property("pressureSeries");
+    c.property("seriesTimeOrigin");
+    QCOMPARE(c.GetPropertyReads(), reads + 3);
+
+    SteadyInstant start = SteadyClock::now();
+    StatusPipeline p(DurationMs(1000), DurationMs(10), start);
+    QSignalSpy series(&c, &GuiStateContainer::SeriesChanged);
+    p.Process(start, {status(10, 20)});
+    c.ApplySnapshot(p.Take());
+    QTRY_COMPARE(series.count(), 1);
+    QCOMPARE(c.GetPropertyReads(), reads + 3);
+  }
+
+private:
+  static ControllerStatus status(float pressure, float volume) {
+    ControllerStatus res = ControllerStatus_init_zero;
+    res.sensor_readings.patient_pressure_cm_h2o = pressure;
+    res.sensor_readings.volume_ml = volume;
+    return res;
+  }
+};
+
+#endif // GUI_STATE_CONTAINER_TEST_H_
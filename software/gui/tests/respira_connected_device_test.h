@@ -0,0 +1,218 @@
+#ifndef RESPIRA_CONNECTED_DEVICE_TEST_H_
+#define RESPIRA_CONNECTED_DEVICE_TEST_H_
+
+#include "chrono.h"
+#include "framing.h"
+#include "gui_state_container.h"
+#include "network_protocol.pb.h"
+#include "pb_decode.h"
+#include "pb_encode.h"
+#include "respira_connected_device.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+#include <algorithm>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+#ifdef __APPLE__
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+// Runs RespiraConnectedDevice on one end of a pseudo terminal, the test
+// standing in for the controller on the other end.
+class RespiraConnectedDeviceTest : public QObject {
+  Q_OBJECT
+public:
+  RespiraConnectedDeviceTest() = default;
+  ~RespiraConnectedDeviceTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void init() {
+    char name[256];
+    QVERIFY(openpty(&controller_, &port_, name, nullptr, nullptr) == 0);
+    fcntl(controller_, F_SETFL, fcntl(controller_, F_GETFL) | O_NONBLOCK);
+    port_name_ = name;
+    received_.clear();
+  }
+
+  void cleanup() {
+    device_.reset();
+    close(controller_);
+    close(port_);
+  }
+
+  void testSendsGuiStatus() {
+    StartDevice([](SteadyInstant, const std::vector<ControllerStatus> &) {});
+
+    // Sending doesn't wait on anything being received.
+    for (uint64_t i = 0; i < 3; i++) {
+      GuiStatus gui_status = GuiStatus_init_zero;
+      gui_status.uptime_ms = i;
+      gui_status.desired_params.pip_cm_h2o = 25;
+      QVERIFY(device_->SendGuiStatus(gui_status));
+
+      QByteArray frame = ReadFrame(DurationMs(200));
+      uint8_t payload[GuiStatus_size];
+      uint32_t length = decode_frame(
+          reinterpret_cast<const uint8_t *>(frame.constData()),
+          static_cast<uint32_t>(frame.size()), payload, sizeof(payload));
+      QVERIFY(length > 0);
+      GuiStatus sent = GuiStatus_init_zero;
+      pb_istream_t stream = pb_istream_from_buffer(payload, length);
+      QVERIFY(pb_decode(&stream, GuiStatus_fields, &sent));
+      QCOMPARE(sent.uptime_ms, i);
+      QCOMPARE(sent.desired_params.pip_cm_h2o, uint32_t{25});
+    }
+  }
+
+  void testReceivesStatuses() {
+    StartDevice([this](SteadyInstant now,
+                       const std::vector<ControllerStatus> &statuses) {
+      std::unique_lock<std::mutex> l(mu_);
+      for (const ControllerStatus &status : statuses) {
+        received_.push_back({now, status});
+      }
+    });
+
+    // Two frames at once, and the beginning of a third one.
+    QByteArray third = ControllerFrame(3);
+    Write(ControllerFrame(1) + ControllerFrame(2) +
+          third.left(third.size() / 2));
+    QTRY_COMPARE(ReceivedCount(), 2);
+    QTest::qWait(50);
+    QCOMPARE(ReceivedCount(), 2);
+
+    Write(third.mid(third.size() / 2));
+    QTRY_COMPARE(ReceivedCount(), 3);
+    std::unique_lock<std::mutex> l(mu_);
+    for (int i = 0; i < 3; i++) {
+      QCOMPARE(received_[i].status.uptime_ms, uint64_t(i + 1));
+    }
+    // The frames which arrived together are passed on together.
+    QVERIFY(received_[0].time == received_[1].time);
+    QVERIFY(received_[1].time < received_[2].time);
+  }
+
+  // Time from a frame being written by the controller to its status being
+  // shown by GuiStateContainer on the UI thread, the way the app hands it
+  // over.
+  void testLatency() {
+    GuiStateContainer state(DurationMs(30000), DurationMs(10));
+    QEventLoop loop;
+    std::vector<std::chrono::microseconds> latencies;
+    SteadyInstant written;
+    QObject::connect(&state, &GuiStateContainer::SeriesChanged, &loop, [&] {
+      latencies.push_back(MicrosecondsSince(written));
+      loop.quit();
+    });
+    StartDevice([&](SteadyInstant now,
+                    const std::vector<ControllerStatus> &statuses) {
+      state.ReceiveControllerStatuses(now, statuses);
+    });
+
+    constexpr int Frames = 50;
+    for (int i = 0; i < Frames; i++) {
+      written = SteadyClock::now();
+      Write(ControllerFrame(i + 1));
+      QTimer::singleShot(1000, &loop, &QEventLoop::quit);
+      loop.exec();
+      QCOMPARE(static_cast<int>(latencies.size()), i + 1);
+      // Apart by more than the granularity of the history, so that every
+      // frame makes it there.
+      QTest::qWait(20);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    qInfo() << "Serial to UI thread latency (us): median"
+            << latencies[Frames / 2].count() << "max"
+            << latencies.back().count();
+    // The previous, polling reader took at least 8ms to notice a frame had
+    // ended.
+    QVERIFY(latencies[Frames / 2] < std::chrono::milliseconds(8));
+  }
+
+private:
+  struct Received {
+    SteadyInstant time;
+    ControllerStatus status;
+  };
+
+  static QByteArray ControllerFrame(uint64_t uptime_ms) {
+    ControllerStatus status = ControllerStatus_init_zero;
+    status.uptime_ms = uptime_ms;
+    uint8_t payload[ControllerStatus_size];
+    pb_ostream_t stream = pb_ostream_from_buffer(payload, sizeof(payload));
+    pb_encode(&stream, ControllerStatus_fields, &status);
+    uint8_t frame[max_encoded_frame_size(ControllerStatus_size)];
+    uint32_t length =
+        encode_frame(payload, static_cast<uint32_t>(stream.bytes_written),
+                     frame, sizeof(frame));
+    return QByteArray(reinterpret_cast<const char *>(frame), length);
+  }
+
+  static std::chrono::microseconds MicrosecondsSince(SteadyInstant time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        SteadyClock::now() - time);
+  }
+
+  // Starts the device on the port, and waits until it has opened it.
+  void StartDevice(ConnectedDevice::StatusesCallback on_statuses) {
+    device_ = std::make_unique<RespiraConnectedDevice>(port_name_);
+    device_->Start(std::move(on_statuses));
+
+    // Sending is queued up behind opening the port, so once a GuiStatus comes
+    // out, the port is open.
+    QVERIFY(device_->SendGuiStatus(GuiStatus_init_zero));
+    QVERIFY(!ReadFrame(DurationMs(2000)).isEmpty());
+  }
+
+  void Write(const QByteArray &bytes) {
+    QCOMPARE(write(controller_, bytes.constData(), bytes.size()),
+             ssize_t(bytes.size()));
+  }
+
+  // Reads a frame sent by the device, or returns an empty one on timeout.
+  QByteArray ReadFrame(DurationMs timeout) {
+    QByteArray bytes;
+    SteadyInstant deadline = SteadyClock::now() + timeout;
+    while (SteadyClock::now() < deadline) {
+      pollfd fd = {controller_, POLLIN, 0};
+      poll(&fd, 1, 10);
+      char buffer[256];
+      ssize_t n = read(controller_, buffer, sizeof(buffer));
+      if (n > 0) {
+        bytes.append(buffer, static_cast<int>(n));
+      }
+      // A frame starts and ends with a mark.
+      if (bytes.size() > 2 && bytes.endsWith(char(FramingMark))) {
+        return bytes;
+      }
+    }
+    return QByteArray();
+  }
+
+  int ReceivedCount() {
+    std::unique_lock<std::mutex> l(mu_);
+    return static_cast<int>(received_.size());
+  }
+
+  int controller_ = -1;
+  int port_ = -1;
+  QString port_name_;
+  std::unique_ptr<RespiraConnectedDevice> device_;
+
+  std::mutex mu_;
+  std::vector<Received> received_;
+};
+
+#endif // RESPIRA_CONNECTED_DEVICE_TEST_H_
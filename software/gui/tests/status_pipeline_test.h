@@ -0,0 +1,213 @@
+#ifndef STATUS_PIPELINE_TEST_H_
+#define STATUS_PIPELINE_TEST_H_
+
+#include "gui_state_container.h"
+#include "network_protocol.pb.h"
+#include "status_pipeline.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QtTest>
+#include <atomic>
+
+class StatusPipelineTest : public QObject {
+  Q_OBJECT
+public:
+  StatusPipelineTest() = default;
+  ~StatusPipelineTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  // The graphs, updated as points come and go, match the history.
+  void testIncrementalSeries() {
+    SteadyInstant start = SteadyClock::now();
+    StatusPipeline p(DurationMs(100), DurationMs(10), start);
+    for (int i = 0; i < 30; i++) {
+      ControllerStatus status = pressure(static_cast<float>(i));
+      status.sensor_readings.flow_ml_per_min = 1000.0f * i;
+      status.sensor_readings.volume_ml = 10.0f * i;
+      p.Process(start + DurationMs(10 * i), {status});
+
+      std::unique_ptr<const GuiSnapshot> snapshot = p.Take();
+      QVERIFY(snapshot != nullptr);
+      const GraphSeries &pressure_series = snapshot->pressure_series;
+      const GraphSeries &flow_series = snapshot->flow_series;
+      const GraphSeries &tidal_series = snapshot->tidal_series;
+      int size = std::min(i + 1, 11);
+      QCOMPARE(pressure_series.size(), size);
+      QCOMPARE(flow_series.size(), size);
+      QCOMPARE(tidal_series.size(), size);
+      for (int k = 0; k < size; k++) {
+        int j = i + 1 - size + k;
+        qreal x = pressure_series[k].x();
+        QVERIFY(qAbs(x - 0.01 * j) < 1e-6);
+        QCOMPARE(pressure_series[k].y(), qreal(j));
+        QCOMPARE(flow_series[k], QPointF(x, j));
+        QCOMPARE(tidal_series[k], QPointF(x, 10.0 * j));
+      }
+      QCOMPARE(snapshot->last_status.sensor_readings.patient_pressure_cm_h2o,
+               static_cast<float>(i));
+      QCOMPARE(snapshot->history_end, uint64_t(i + 1));
+    }
+  }
+
+  // Older statuses received together are placed by the controller's uptime.
+  void testPlacesStatusesReceivedTogether() {
+    SteadyInstant start = SteadyClock::now();
+    StatusPipeline p(DurationMs(1000), DurationMs(10), start);
+    ControllerStatus first = pressure(1);
+    first.uptime_ms = 100;
+    ControllerStatus second = pressure(2);
+    second.uptime_ms = 130;
+    p.Process(start + DurationMs(200), {first, second});
+
+    std::unique_ptr<const GuiSnapshot> snapshot = p.Take();
+    QCOMPARE(snapshot->statuses.size(), size_t{2});
+    QVERIFY(snapshot->statuses[0].time == start + DurationMs(170));
+    QVERIFY(snapshot->statuses[1].time == start + DurationMs(200));
+    QCOMPARE(snapshot->pressure_series.size(), 2);
+    QVERIFY(qAbs(snapshot->pressure_series[0].x() - 0.17) < 1e-6);
+  }
+
+  // Snapshots the UI doesn't take get replaced, but none of the statuses
+  // they carried for the alarms are lost, nor passed on twice.
+  void testTakesLatestSnapshot() {
+    SteadyInstant start = SteadyClock::now();
+    StatusPipeline p(DurationMs(1000), DurationMs(10), start);
+    QVERIFY(p.Take() == nullptr);
+
+    for (int i = 0; i < 3; i++) {
+      p.Process(start + DurationMs(10 * i), {pressure(i)});
+    }
+    std::unique_ptr<const GuiSnapshot> snapshot = p.Take();
+    QCOMPARE(snapshot->pressure_series.size(), 3);
+    QCOMPARE(snapshot->statuses.size(), size_t{3});
+    for (int i = 0; i < 3; i++) {
+      QCOMPARE(snapshot->statuses[i].seq, uint64_t(i));
+      QCOMPARE(
+          snapshot->statuses[i].status.sensor_readings.patient_pressure_cm_h2o,
+          static_cast<float>(i));
+    }
+    QVERIFY(p.Take() == nullptr);
+
+    p.Process(start + DurationMs(30), {pressure(3)});
+    snapshot = p.Take();
+    QCOMPARE(snapshot->pressure_series.size(), 4);
+    QCOMPARE(snapshot->statuses.size(), size_t{1});
+    QCOMPARE(snapshot->statuses[0].seq, uint64_t{3});
+  }
+
+  void testWorkerThread() {
+    SteadyInstant start = SteadyClock::now();
+    StatusPipeline p(DurationMs(1000), DurationMs(10), start);
+    std::atomic<int> notified{0};
+    p.Start([&] { notified++; });
+
+    int taken_statuses = 0;
+    int series_size = 0;
+    for (int i = 0; i < 20; i++) {
+      p.Push(start + DurationMs(10 * i), {pressure(i)});
+      if (i % 5 == 4) {
+        // Let a few snapshots pile up, then take the latest.
+        QTRY_VERIFY(series_size_in(p, &taken_statuses) == i + 1);
+        series_size = i + 1;
+      }
+    }
+    QCOMPARE(series_size, 20);
+    QCOMPARE(taken_statuses, 20);
+    // Notified at least once per snapshot taken, but not necessarily for
+    // every one published.
+    QVERIFY(notified >= 4);
+    p.Stop();
+  }
+
+  // The UI follows the statuses processed on the worker thread.
+  void testUpdatesGui() {
+    GuiStateContainer c(DurationMs(1000), DurationMs(10));
+    QSignalSpy measurements(&c, &GuiStateContainer::measured_pressure_changed);
+    QSignalSpy series(&c, &GuiStateContainer::SeriesChanged);
+
+    c.ReceiveControllerStatuses(SteadyClock::now(), {pressure(12)});
+    QTRY_COMPARE(measurements.count(), 1);
+    QTRY_COMPARE(series.count(), 1);
+    QCOMPARE(c.property("measured_pressure").toReal(), 12.0);
+    QCOMPARE(c.GetPressureSeries().size(), 1);
+  }
+
+  // Time to add a status to a full 30s history, with the graphs updated.
+  // This used to be on the UI thread, and is now on the worker thread.
+  //
+  // Like the UI, this keeps the latest snapshot, which shares the series with
+  // the pipeline, so that the cost of updating shared series shows.
+  void benchmarkProcessStatus() {
+    SteadyInstant t = SteadyClock::now();
+    StatusPipeline p(DurationMs(30000), DurationMs(10), t);
+    ControllerStatus status = pressure(0);
+    for (int i = 0; i < 3001; i++) {
+      t += DurationMs(10);
+      p.Process(t, {status});
+    }
+    std::unique_ptr<const GuiSnapshot> shown = p.Take();
+
+    QBENCHMARK {
+      t += DurationMs(10);
+      status.sensor_readings.patient_pressure_cm_h2o += 0.1f;
+      p.Process(t, {status});
+      shown = p.Take();
+    }
+    QCOMPARE(shown->pressure_series.size(), 3001);
+  }
+
+  // What's left on the UI thread for each status, to compare with the time
+  // it has for rendering a frame: applying the snapshot published for it.
+  void benchmarkUiThreadWorkPerStatus() {
+    GuiStateContainer c(DurationMs(30000), DurationMs(10));
+    SteadyInstant t = SteadyClock::now();
+    StatusPipeline p(DurationMs(30000), DurationMs(10), t);
+    ControllerStatus status = pressure(0);
+    for (int i = 0; i < 3001; i++) {
+      t += DurationMs(10);
+      p.Process(t, {status});
+    }
+    c.ApplySnapshot(p.Take());
+
+    constexpr int Statuses = 1000;
+    qint64 ui_thread_ns = 0;
+    QElapsedTimer timer;
+    for (int i = 0; i < Statuses; i++) {
+      t += DurationMs(10);
+      status.sensor_readings.patient_pressure_cm_h2o += 0.1f;
+      p.Process(t, {status});
+      std::unique_ptr<const GuiSnapshot> snapshot = p.Take();
+
+      timer.start();
+      c.ApplySnapshot(std::move(snapshot));
+      ui_thread_ns += timer.nsecsElapsed();
+    }
+    QTest::setBenchmarkResult(static_cast<qreal>(ui_thread_ns) / Statuses,
+                              QTest::WalltimeNanoseconds);
+    QCOMPARE(c.GetPressureSeries().size(), 3001);
+  }
+
+private:
+  static ControllerStatus pressure(float p) {
+    ControllerStatus res = ControllerStatus_init_zero;
+    res.sensor_readings.patient_pressure_cm_h2o = p;
+    return res;
+  }
+
+  // Takes the latest snapshot, if any, counting the statuses it carries.
+  // Returns the size of the series in it, or -1 if there was none.
+  static int series_size_in(StatusPipeline &p, int *taken_statuses) {
+    std::unique_ptr<const GuiSnapshot> snapshot = p.Take();
+    if (snapshot == nullptr) {
+      return -1;
+    }
+    *taken_statuses += static_cast<int>(snapshot->statuses.size());
+    return snapshot->pressure_series.size();
+  }
+};
+
+#endif // STATUS_PIPELINE_TEST_H_
@@ -4,7 +4,7 @@ include( ../defaults.pri )
 }
 TEMPLATE = app
 
-QT += testlib gui multimedia
+QT += testlib gui multimedia serialport
 CONFIG += qt warn_on depend_includepath testcase
 
 QMAKE_CXXFLAGS += --coverage
@@ -15,6 +15,16 @@ HEADERS += \
   logger_test.h \
   breath_signals_test.h \
   latching_alarm_test.h \
-  patient_detached_alarm_test.h
+  patient_detached_alarm_test.h \
+  controller_history_test.h \
+  graph_decimator_test.h \
+  graph_series_test.h \
+  frame_parser_test.h \
+  respira_connected_device_test.h \
+  status_pipeline_test.h \
+  update_throttle_test.h \
+  gui_state_container_test.h
 
 LIBS += -L../src -leverything
+# openpty(), for running RespiraConnectedDevice on a pseudo terminal.
+unix:!macx: LIBS += -lutil
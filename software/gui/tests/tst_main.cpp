@@ -2,9 +2,17 @@
 #include <QtTest>
 
 #include "breath_signals_test.h"
+#include "controller_history_test.h"
+#include "frame_parser_test.h"
+#include "graph_decimator_test.h"
+#include "graph_series_test.h"
+#include "gui_state_container_test.h"
 #include "latching_alarm_test.h"
 #include "logger_test.h"
 #include "patient_detached_alarm_test.h"
+#include "respira_connected_device_test.h"
+#include "status_pipeline_test.h"
+#include "update_throttle_test.h"
 
 int main(int argc, char *argv[]) {
   QGuiApplication app(argc, argv);
@@ -31,5 +39,45 @@ int main(int argc, char *argv[]) {
     status += QTest::qExec(&tc, argc, argv);
   }
 
+  {
+    ControllerHistoryTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    GraphDecimatorTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    GraphSeriesTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    FrameParserTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    RespiraConnectedDeviceTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    StatusPipelineTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    UpdateThrottleTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    GuiStateContainerTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
   return status;
 }
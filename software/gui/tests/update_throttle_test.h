@@ -0,0 +1,75 @@
+#ifndef UPDATE_THROTTLE_TEST_H_
+#define UPDATE_THROTTLE_TEST_H_
+
+#include "chrono.h"
+#include "update_throttle.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+#include <vector>
+
+class UpdateThrottleTest : public QObject {
+  Q_OBJECT
+public:
+  UpdateThrottleTest() = default;
+  ~UpdateThrottleTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testBatchesRequests() {
+    std::vector<SteadyInstant> updates;
+    UpdateThrottle throttle(DurationMs(100),
+                            [&] { updates.push_back(SteadyClock::now()); });
+
+    // Nothing runs until the event loop does, then everything requested by
+    // then is one update.
+    throttle.Request();
+    throttle.Request();
+    throttle.Request();
+    QCOMPARE(updates.size(), size_t{0});
+    QTRY_COMPARE(updates.size(), size_t{1});
+
+    // Requests made too soon wait for the interval to be over.
+    throttle.Request();
+    QTest::qWait(30);
+    throttle.Request();
+    QCOMPARE(updates.size(), size_t{1});
+    QTRY_COMPARE(updates.size(), size_t{2});
+    // QTimer may fire a few percent early.
+    QVERIFY(TimeAMinusB(updates[1], updates[0]) >= DurationMs(90));
+
+    QTest::qWait(200);
+    QCOMPARE(updates.size(), size_t{2});
+  }
+
+  // After a quiet interval, a request gets its update right away.
+  void testUpdatesRightAwayWhenIdle() {
+    int updates = 0;
+    UpdateThrottle throttle(DurationMs(100), [&] { updates++; });
+    throttle.Request();
+    QTRY_COMPARE(updates, 1);
+
+    QTest::qWait(150);
+    throttle.Request();
+    QCoreApplication::processEvents();
+    QCOMPARE(updates, 2);
+  }
+
+  void testSetInterval() {
+    int updates = 0;
+    UpdateThrottle throttle(DurationMs(1000), [&] { updates++; });
+    throttle.Request();
+    QTRY_COMPARE(updates, 1);
+
+    throttle.SetInterval(DurationMs(10));
+    QCOMPARE(throttle.GetInterval(), DurationMs(10));
+    QTest::qWait(20);
+    throttle.Request();
+    QCoreApplication::processEvents();
+    QCOMPARE(updates, 2);
+  }
+};
+
+#endif // UPDATE_THROTTLE_TEST_H_
@@ -20,6 +20,8 @@ __license__ = """
 
 """
 
+import csv
+import json
 import serial
 import threading
 import time
@@ -48,6 +50,10 @@ SUBCMD_VAR_INFO = 0x00
 SUBCMD_VAR_GET = 0x01
 SUBCMD_VAR_SET = 0x02
 SUBCMD_VAR_GET_COUNT = 0x03
+SUBCMD_VAR_GET_MULTIPLE = 0x04
+SUBCMD_VAR_SET_MULTIPLE = 0x05
+SUBCMD_VAR_GET_INFO_MULTIPLE = 0x06
+SUBCMD_VAR_GET_FINGERPRINT = 0x07
 
 SUBCMD_TRACE_FLUSH = 0x00
 SUBCMD_TRACE_GETDATA = 0x01
@@ -58,17 +64,43 @@ SUBCMD_TRACE_SET_VARID = 0x05
 SUBCMD_TRACE_GET_PERIOD = 0x06
 SUBCMD_TRACE_SET_PERIOD = 0x07
 SUBCMD_TRACE_GET_NUM_SAMPLES = 0x08
+SUBCMD_TRACE_START_STREAMING = 0x09
+SUBCMD_TRACE_GET_RESOLUTION = 0x0A
+SUBCMD_TRACE_SET_RESOLUTION = 0x0B
+SUBCMD_TRACE_SET_TRIGGER = 0x0C
+SUBCMD_TRACE_GET_TRIGGER = 0x0D
+SUBCMD_TRACE_SET_TRIGGER_POSITION = 0x0E
+SUBCMD_TRACE_GET_TRIGGER_POSITION = 0x0F
+SUBCMD_TRACE_GET_TRIGGER_STATUS = 0x10
 
 SUBCMD_EEPROM_READ = 0x00
 SUBCMD_EEPROM_WRITE = 0x01
 
+# Largest command data the controller accepts (its 500 byte request buffer,
+# less the op code and CRC), and most variable IDs we ask for in one batch.
+MAX_COMMAND_DATA = 497
+VAR_BATCH_SIZE = 200
+
+# Variable metadata read from the controller is cached there, in one file per
+# registry fingerprint.
+VAR_CACHE_DIR = Path.home() / ".cache" / "respiraworks" / "debug_vars"
+
 # Can trace this many variables at once.  Keep this in sync with
-# kMaxTraceVars in the controller.
-TRACE_VAR_CT = 4
+# Trace::MaxVars in the controller.
+TRACE_VAR_CT = 16
+
+# Trigger conditions and states, in the order of Trigger::Condition and
+# Trace::TriggerState in the controller.
+TRIGGER_CONDITIONS = ["none", "above", "below", "rising", "falling", "change"]
+TRIGGER_STATES = ["off", "armed", "triggered"]
 
 MODE_NORMAL = 0
 MODE_BOOT = 1
 
+# Packets the controller sends without being asked start with one of these
+# instead of an error code.
+STREAM_TRACE_DATA = 0x80
+
 ERROR_NONE = 0
 ERROR_CODES = [
     "None",
@@ -101,6 +133,9 @@ class ControllerDebugInterface:
     # send commands
     command_lock = threading.Lock()
 
+    # Receives the trace data streamed by the controller, see trace_stream
+    trace_stream_sink = None
+
     def connect(self, port):
         self.serial_port = serial.Serial(port=port, baudrate=115200)
         self.serial_port.timeout = 0.8
@@ -184,25 +219,78 @@ class ControllerDebugInterface:
         return value == "y" or value == "Y"
 
     # Read info about all the supported variables and load
-    # them in a map
+    # them in a map.
+    #
+    # Reading it takes a while, so it is cached on disk, keyed by the
+    # fingerprint of the controller's variable registry, and checked against
+    # the controller's version.  Reconnecting to a known build only takes a
+    # couple of commands.
     def variables_update_info(self):
         self.variable_metadata.clear()
+        data = self.send_command(OP_VAR, [SUBCMD_VAR_GET_FINGERPRINT])
+        fingerprint = debug_types.bytes_to_int32s(data)[0]
+        cache_file = VAR_CACHE_DIR / f"{fingerprint:08x}.json"
+
+        if cache_file.is_file():
+            try:
+                with open(cache_file) as f:
+                    cache = json.load(f)
+                for vid, info in cache["variables"]:
+                    self.variables_add_info(var_info.VarInfo(vid, info))
+                if self.controller_version() == cache["version"]:
+                    return
+            except (Error, KeyError, ValueError):
+                pass
+            self.variable_metadata.clear()
+
+        infos = self.variables_read_info()
+        cache = {"version": self.controller_version(), "variables": infos}
+        try:
+            VAR_CACHE_DIR.mkdir(parents=True, exist_ok=True)
+            with open(cache_file, "w") as f:
+                json.dump(cache, f)
+        except OSError as e:
+            print(orange(f"Could not cache variable info: {e}"))
+
+    # Read info about all the variables from the controller, as many as fit in
+    # each response.  Returns the [id, info] pairs read.
+    def variables_read_info(self):
         data = self.send_command(OP_VAR, [SUBCMD_VAR_GET_COUNT])
         var_count = debug_types.bytes_to_int32s(data)[0]
-        for vid in range(var_count):
+        infos = []
+        vid = 0
+        while vid < var_count:
             data = self.send_command(
-                OP_VAR, [SUBCMD_VAR_INFO] + debug_types.int16s_to_bytes(vid)
+                OP_VAR,
+                [SUBCMD_VAR_GET_INFO_MULTIPLE] + debug_types.int16s_to_bytes(vid),
             )
-            if data is None:
+            next_vid = debug_types.bytes_to_int16s(data[:2])[0]
+            if next_vid <= vid or next_vid > var_count:
                 raise Error(f"bad variable info retrieved for vid={vid}")
-            variable = var_info.VarInfo(vid, data)
-            if variable.name in self.variable_metadata.keys():
-                raise Error(
-                    f"variable name clash  \n"
-                    f" retrieved: {variable.verbose()}\n"
-                    f" existing:  {self.variable_metadata[variable.name].verbose()}"
-                )
-            self.variable_metadata[variable.name] = variable
+            n = 2
+            for i in range(vid, next_vid):
+                # Info starts with an 8 byte header ending with string lengths
+                length = 8 + sum(data[n + 4 : n + 8])
+                info = list(data[n : n + length])
+                self.variables_add_info(var_info.VarInfo(i, info))
+                infos.append([i, info])
+                n += length
+            vid = next_vid
+        return infos
+
+    def controller_version(self):
+        if "0_controller_version" not in self.variable_metadata:
+            return None
+        return self.variable_get("0_controller_version")
+
+    def variables_add_info(self, variable):
+        if variable.name in self.variable_metadata.keys():
+            raise Error(
+                f"variable name clash  \n"
+                f" retrieved: {variable.verbose()}\n"
+                f" existing:  {self.variable_metadata[variable.name].verbose()}"
+            )
+        self.variable_metadata[variable.name] = variable
 
     def variables_find(self, pattern="", access_filter=None):
         out = []
@@ -239,14 +327,57 @@ class ControllerDebugInterface:
         self.variable_set("forced_blower_power", -1)
         # todo unforce o2 psol?
 
+    # Sets several variables with as few commands as possible: the controller
+    # sets all the variables of a command, or none of them.
     def variables_set(self, pairs):
-        for var, val in pairs.items():
-            self.variable_set(var, val, verbose=True)
+        data = []
+        for name, value in pairs.items():
+            if not (name in self.variable_metadata):
+                raise Error(f"Cannot set unknown variable {name}")
+            variable = self.variable_metadata[name]
+            text = variable.print_value(value, show_access=False)
+            print(f"  applying {text}")
 
+            entry = debug_types.int16s_to_bytes(variable.id) + variable.to_bytes(value)
+            if 1 + len(data) + len(entry) > MAX_COMMAND_DATA:
+                self.send_command(OP_VAR, [SUBCMD_VAR_SET_MULTIPLE] + data)
+                data = []
+            data += entry
+        if data:
+            self.send_command(OP_VAR, [SUBCMD_VAR_SET_MULTIPLE] + data)
+
+    # Gets several variables with as few commands as possible: the controller
+    # packs as many values as fit in a response, and tells us where to resume.
     def variables_get(self, names, raw=False):
-        ret = {}
+        variables = []
         for name in names:
-            ret[name] = self.variable_get(name, raw=raw)
+            if not (name in self.variable_metadata):
+                raise Error(f"Cannot get unknown variable {name}")
+            variables.append(self.variable_metadata[name])
+
+        ret = {}
+        for start in range(0, len(variables), VAR_BATCH_SIZE):
+            batch = variables[start : start + VAR_BATCH_SIZE]
+            ids = debug_types.int16s_to_bytes([v.id for v in batch])
+            index = 0
+            while index < len(batch):
+                data = self.send_command(
+                    OP_VAR,
+                    [SUBCMD_VAR_GET_MULTIPLE]
+                    + debug_types.int16s_to_bytes(index)
+                    + ids,
+                )
+                next_index = debug_types.bytes_to_int16s(data[:2])[0]
+                if next_index <= index or next_index > len(batch):
+                    raise Error(f"bad variable batch index {next_index}")
+                n = 2
+                for variable in batch[index:next_index]:
+                    chunk = data[n : n + variable.byte_size]
+                    ret[variable.name] = variable.format_value(
+                        variable.from_bytes(chunk), raw
+                    )
+                    n += variable.byte_size
+                index = next_index
         return ret
 
     def variable_get(self, name, raw=False, fmt=None):
@@ -488,12 +619,23 @@ class ControllerDebugInterface:
         # Scale this by the loop period which is an integer in microseconds.
         return period * self.variable_get("loop_period", raw=True)
 
-    def trace_select(self, var_names):
+    def trace_select(self, var_names, resolutions=None):
+        """Selects the variables to trace.
+
+        resolutions optionally maps names of float variables to the resolution
+        they are traced with.  Traces of float variables are much more compact
+        with one, see trace_codec.h in the controller.
+        """
         if len(var_names) > TRACE_VAR_CT:
             raise Error(f"Can't trace more than {TRACE_VAR_CT} variables at once.")
         for name in var_names:
             if name not in self.variable_metadata.keys():
                 raise Error(f"Cannot select trace. Variable `{name}` does not exist.")
+        if resolutions is None:
+            resolutions = {}
+        for name in resolutions.keys():
+            if name not in var_names:
+                raise Error(f"Cannot set resolution. Variable `{name}` is not traced.")
         var_names += [""] * (TRACE_VAR_CT - len(var_names))
         for (i, var_name) in enumerate(var_names):
             var_id = var_info.VAR_INVALID_ID
@@ -501,6 +643,79 @@ class ControllerDebugInterface:
                 var_id = self.variable_metadata[var_name].id
             var = debug_types.int16s_to_bytes(var_id)
             self.send_command(OP_TRACE, [SUBCMD_TRACE_SET_VARID, i] + var)
+            if var_name in resolutions:
+                self.trace_set_resolution(i, resolutions[var_name])
+
+    def trace_set_resolution(self, index, resolution):
+        self.send_command(
+            OP_TRACE,
+            [SUBCMD_TRACE_SET_RESOLUTION, index]
+            + debug_types.float32s_to_bytes(float(resolution)),
+        )
+
+    def trace_get_resolution(self, index):
+        dat = self.send_command(OP_TRACE, [SUBCMD_TRACE_GET_RESOLUTION, index])
+        return debug_types.bytes_to_float32s(dat)[0]
+
+    def trace_set_trigger(self, var_name=None, condition="none", level=0):
+        """Sets up the trigger condition, which the next trace_start waits for.
+
+        condition is one of TRIGGER_CONDITIONS, "none" disables the trigger.
+        level is given in the variable's type, it is ignored by "change".
+        """
+        if condition not in TRIGGER_CONDITIONS:
+            raise Error(f"Invalid trigger condition `{condition}`")
+        var_id = var_info.VAR_INVALID_ID
+        level_bytes = [0] * 4
+        if condition != "none":
+            if var_name not in self.variable_metadata:
+                raise Error(f"Cannot set trigger. Variable `{var_name}` does not exist.")
+            var = self.variable_metadata[var_name]
+            var_id = var.id
+            level_bytes = var.to_bytes(level)
+        self.send_command(
+            OP_TRACE,
+            [SUBCMD_TRACE_SET_TRIGGER]
+            + debug_types.int16s_to_bytes(var_id)
+            + [TRIGGER_CONDITIONS.index(condition)]
+            + level_bytes,
+        )
+
+    def trace_get_trigger(self):
+        """Returns the trigger as (variable, condition, level), the variable
+        being None if the trigger is disabled."""
+        dat = self.send_command(OP_TRACE, [SUBCMD_TRACE_GET_TRIGGER])
+        var = self.variable_by_id(debug_types.bytes_to_int16s(dat[0:2])[0])
+        condition = TRIGGER_CONDITIONS[dat[2]]
+        level = debug_types.bytes_to_int32s(dat[3:7])[0]
+        if var is None:
+            return None, condition, level
+        return var, condition, var.convert_int(level)
+
+    def trace_set_trigger_position(self, pre_fraction, post_samples=0):
+        """Sets the fraction of the trace buffer holding samples recorded
+        before the trigger, and the number of samples to record after it (0 to
+        record until the buffer is full)."""
+        self.send_command(
+            OP_TRACE,
+            [SUBCMD_TRACE_SET_TRIGGER_POSITION]
+            + debug_types.float32s_to_bytes(float(pre_fraction))
+            + debug_types.int32s_to_bytes(post_samples),
+        )
+
+    def trace_get_trigger_position(self):
+        """Returns (pre-trigger fraction, post-trigger samples)"""
+        dat = self.send_command(OP_TRACE, [SUBCMD_TRACE_GET_TRIGGER_POSITION])
+        return (
+            debug_types.bytes_to_float32s(dat[0:4])[0],
+            debug_types.bytes_to_int32s(dat[4:8])[0],
+        )
+
+    def trace_trigger_status(self):
+        """Returns (state, index of the triggering sample in the buffer), state
+        being one of TRIGGER_STATES."""
+        dat = self.send_command(OP_TRACE, [SUBCMD_TRACE_GET_TRIGGER_STATUS])
+        return TRIGGER_STATES[dat[0]], debug_types.bytes_to_int32s(dat[1:5])[0]
 
     def trace_start(self):
         self.send_command(OP_TRACE, [SUBCMD_TRACE_START])
@@ -508,64 +723,121 @@ class ControllerDebugInterface:
     def trace_stop(self):
         self.send_command(OP_TRACE, [SUBCMD_TRACE_STOP])
 
+    def trace_stream(self, file_name, duration=None):
+        """Streams the trace to a CSV file, for `duration` seconds or until
+        interrupted (Ctrl+C).
+
+        Unlike trace_download, the length of the capture isn't limited by the
+        size of the controller's trace buffer: the controller sends samples as
+        it records them.  Samples it could not send in time are dropped, and
+        reported as they happen; the time column accounts for them.
+
+        Returns the stream, which holds the counts of samples written, dropped
+        and of lost packets.
+        """
+        slots = self.trace_active_slots()
+        if len(slots) < 1:
+            raise Error("No active traces to stream")
+        trace_vars = [var for (index, var) in slots]
+        resolutions = self.trace_active_resolutions(slots)
+        period = self.trace_get_period_us() * 1e-6
+
+        with open(file_name, "w", newline="") as out_file:
+            stream = TraceStream(out_file, trace_vars, resolutions, period)
+            self.trace_stream_sink = stream
+            try:
+                self.send_command(OP_TRACE, [SUBCMD_TRACE_START_STREAMING])
+                end = None if duration is None else time.monotonic() + duration
+                while end is None or time.monotonic() < end:
+                    with self.command_lock:
+                        packet = self.get_response()
+                    if not self.process_stream_packet(packet) and len(packet) > 0:
+                        self.debug_print("Ignoring unexpected data while streaming")
+            except KeyboardInterrupt:
+                # We may have been interrupted in the middle of a packet
+                with self.command_lock:
+                    self.process_stream_packet(self.get_response())
+            finally:
+                self.trace_stop()
+                self.trace_stream_sink = None
+
+            # Whatever the controller didn't get to send before stopping is
+            # still in its buffer.
+            while True:
+                data = self.send_command(OP_TRACE, [SUBCMD_TRACE_GETDATA])
+                if len(data) < 1:
+                    break
+                stream.write_samples(data)
+
+        return stream
+
     def trace_num_samples(self):
         dat = self.send_command(OP_TRACE, [SUBCMD_TRACE_GET_NUM_SAMPLES])
         return debug_types.bytes_to_int32s(dat)[0]
 
     def trace_active_variables_list(self):
         """Return a list of active trace variables"""
+        return [var for (index, var) in self.trace_active_slots()]
+
+    def trace_active_slots(self):
+        """Return a list of (index, variable) for each active trace variable"""
         ret = []
         for i in range(TRACE_VAR_CT):
             data = self.send_command(OP_TRACE, [SUBCMD_TRACE_GET_VARID, i])
             var_id = debug_types.bytes_to_int16s(data)[0]
             var = self.variable_by_id(var_id)
             if var is not None:
-                ret.append(var)
+                ret.append((i, var))
         return ret
 
+    def trace_active_resolutions(self, slots):
+        """Return the resolution of each of the given active trace slots"""
+        return [self.trace_get_resolution(index) for (index, var) in slots]
+
     def trace_download(self):
         """Fetches a trace from the controller.
 
         Returns a list of N+1 lists where N is the number of active trace variables.
         The first list gives the time in seconds of each sample relative to the
-        start of the trace, and the remaining N lists each holds the trace data
-        for one variable.
+        start of the trace (or to the trigger, if the trace was triggered), and
+        the remaining N lists each holds the trace data for one variable.
         """
-        trace_vars = self.trace_active_variables_list()
-        if len(trace_vars) < 1:
+        slots = self.trace_active_slots()
+        if len(slots) < 1:
             raise Error("No active traces to download")
+        trace_vars = [var for (index, var) in slots]
+        resolutions = self.trace_active_resolutions(slots)
         var_count = len(trace_vars)
 
-        # get samples count
+        # get samples count, and the position of the trigger before reading
+        # samples out of the buffer
         num_samples = self.trace_num_samples()
-        total_num_samples = num_samples * var_count
-        bytes_per_int32 = 4
-
-        data = []
-        while len(data) < bytes_per_int32 * total_num_samples:
-            byte = self.send_command(OP_TRACE, [SUBCMD_TRACE_GETDATA])
-            if len(byte) < 1:
+        trigger_state, trigger_index = self.trace_trigger_status()
+        if trigger_state != "triggered":
+            trigger_index = 0
+
+        # The data comes as a list of samples, each one holding len(trace_vars)
+        # values, encoded to save space (see decode_trace_samples).  Each
+        # response can be decoded on its own.
+        samples = []
+        while len(samples) < num_samples:
+            data = self.send_command(OP_TRACE, [SUBCMD_TRACE_GETDATA])
+            if len(data) < 1:
                 break
-            data += byte
-
-        # Convert the bytes into an array of unsigned 32-bit values
-        data = debug_types.bytes_to_int32s(data)
+            samples += debug_types.decode_trace_samples(data, var_count)
 
-        # The data comes as a list of of samples, where each sample contains
-        # len(trace_vars) uint32s: [a1, b1, c1, a2, b2, c2, ...].  Parse this into
-        # sublists [[a1', a2', ...], [b1', b2', ...], [c1', c2', ...]], where each
-        # of the variables is converted to the correct type.
+        # Parse the samples [[a1, b1, c1], [a2, b2, c2], ...] into sublists
+        # [[a1', a2', ...], [b1', b2', ...], [c1', c2', ...]], where each of the
+        # variables is converted to the correct type.
         ret = [Trace("time", "s")]
         for v in trace_vars:
             ret.append(Trace(v.name, v.units))
 
-        # The `zip` expression groups data into sublists of var_count elems.  See the
-        # "grouper" recipe:
-        # https://docs.python.org/3/library/itertools.html#itertools-recipes
-        iters = [iter(data)] * var_count
-        for sample in zip(*iters):
+        for sample in samples:
             for i, val in enumerate(sample):
-                ret[i + 1].data.append(trace_vars[i].convert_int(val))
+                ret[i + 1].data.append(
+                    trace_vars[i].convert_traced(val, resolutions[i])
+                )
 
         # this may be higher than the initially reported number because the buffer
         # may have filled with more while retrieving
@@ -574,7 +846,9 @@ class ControllerDebugInterface:
         # get trace period, multiply by 1e-6 (i.e. 1/1,000,000) to convert it to seconds.
         # todo: record actual clock ticks in controller instead of assuming?
         period = self.trace_get_period_us() * 1e-6
-        ret[0].data = [x * period for x in range(actual_number_of_samples)]
+        ret[0].data = [
+            (x - trigger_index) * period for x in range(actual_number_of_samples)
+        ]
 
         return ret
 
@@ -593,6 +867,19 @@ class ControllerDebugInterface:
             [SUBCMD_EEPROM_WRITE] + debug_types.int16s_to_bytes(int(address, 0)) + data,
         )
 
+    # Hands a trace data packet (as returned by get_response) over to the
+    # trace stream, if any.  Returns False if this isn't such a packet.
+    def process_stream_packet(self, packet):
+        if len(packet) < 3 or packet[0] != STREAM_TRACE_DATA:
+            return False
+        crc = debug_types.CRC16().calc(packet[:-2])
+        if crc != debug_types.bytes_to_int16s(packet[-2:])[0]:
+            # The stream will notice the missing sequence number
+            self.debug_print("CRC error on streamed trace data")
+        elif self.trace_stream_sink is not None:
+            self.trace_stream_sink.process_packet(packet[1:-2])
+        return True
+
     # Wait for a response from the controller to the last command
     # The binary format uses two special characters to frame a
     # command or response.  This function removes those characters
@@ -674,6 +961,9 @@ class ControllerDebugInterface:
                 self.serial_port.timeout = timeout
 
             response = self.get_response()
+            # While streaming, trace data may come ahead of the response
+            while self.process_stream_packet(response):
+                response = self.get_response()
             if timeout is not None:
                 self.serial_port.timeout = old_timeout
 
@@ -698,3 +988,53 @@ class ControllerDebugInterface:
                     )
 
             return response[1:-2]
+
+
+class TraceStream:
+    """Writes the trace data streamed by the controller to a CSV file.
+
+    Packets carry a sequence number and the count of samples the controller
+    dropped so far, which we use to report lost packets and dropped samples.
+    """
+
+    def __init__(self, out_file, trace_vars, resolutions, period):
+        self.writer = csv.writer(out_file)
+        self.trace_vars = trace_vars
+        self.resolutions = resolutions
+        self.period = period
+        self.next_sequence = None
+        self.sample_index = 0
+        self.samples = 0
+        self.dropped = 0
+        self.lost_packets = 0
+        self.writer.writerow(
+            ["time [s]"] + [f"{v.name} [{v.units}]" for v in trace_vars]
+        )
+
+    def process_packet(self, data):
+        sequence, dropped = debug_types.bytes_to_int32s(data[:8])
+        if self.next_sequence is not None and sequence != self.next_sequence:
+            lost = (sequence - self.next_sequence) & 0xFFFFFFFF
+            self.lost_packets += lost
+            print(orange(f"Lost {lost} trace packet(s), timing is off from here"))
+        self.next_sequence = (sequence + 1) & 0xFFFFFFFF
+
+        if dropped != self.dropped:
+            print(orange(f"Controller dropped {dropped - self.dropped} sample(s)"))
+            self.sample_index += dropped - self.dropped
+            self.dropped = dropped
+
+        self.write_samples(data[8:])
+
+    def write_samples(self, data):
+        var_count = len(self.trace_vars)
+        for sample in debug_types.decode_trace_samples(data, var_count):
+            self.writer.writerow(
+                [self.sample_index * self.period]
+                + [
+                    var.convert_traced(val, res)
+                    for var, val, res in zip(self.trace_vars, sample, self.resolutions)
+                ]
+            )
+            self.sample_index += 1
+            self.samples += 1
@@ -32,7 +32,7 @@ import traceback
 from lib.colors import *
 from lib.error import Error
 from lib.serial_detect import detect_stm32_ports, print_detected_ports
-from controller_debug import ControllerDebugInterface, MODE_BOOT
+from controller_debug import ControllerDebugInterface, MODE_BOOT, TRIGGER_CONDITIONS
 from var_info import VAR_ACCESS_READ_ONLY, VAR_ACCESS_WRITE
 import matplotlib.pyplot as plt
 import test_data
@@ -63,6 +63,21 @@ class CmdArgumentParser(argparse.ArgumentParser):
             raise ArgparseShowHelpError()
 
 
+# Parses the `var=resolution` arguments of the trace commands into a dict.
+def parse_trace_resolutions(args):
+    resolutions = {}
+    for arg in args:
+        name, sep, value = arg.partition("=")
+        try:
+            resolution = float(value)
+        except ValueError:
+            resolution = -1
+        if not sep or resolution < 0:
+            raise Error(f"Invalid resolution `{arg}`, expected var=resolution")
+        resolutions[name] = resolution
+    return resolutions
+
+
 # This class creates a simple command line interface using the standard
 # Python cmd module.
 #
@@ -632,7 +647,7 @@ level `test` self.interface for a more structured experiment control experience.
 
 A sub-command must be passed as an option:
 
-trace start [--period p] [var1 ... ]
+trace start [--period p] [--resolution var=r ...] [var1 ... ]
   Starts collecting trace data.
 
   You can specify the names of up to TRACE_VAR_CT debug variables to trace.  If
@@ -641,6 +656,37 @@ trace start [--period p] [var1 ... ]
   --period controls the sample period in units of one trip through the
   controller's high-priority loop.  If you don't specify a period, we use 1.
 
+  --resolution rounds the traced values of a float variable to multiples of r,
+  which makes their traces much more compact, so that the buffer holds more
+  samples.  It only applies along with the list of variables.
+
+trace stream [--period p] [--resolution var=r ...] [--duration s] file [var1 ... ]
+  Starts collecting trace data, and saves it to the given .csv file as the
+  controller sends it, until stopped with Ctrl+C or after --duration seconds.
+  This is meant for long captures, which wouldn't fit the trace buffer.
+
+  Variables, period and resolutions are as for `trace start`.  The link to the controller
+  has to keep up with the trace: any samples dropped by the controller, and any
+  packets lost along the way, are reported.
+
+trace trigger [--pre f] [--post n] var condition [level]
+trace trigger off
+  Sets up a trigger, which the next `trace start` waits for: like an oscilloscope,
+  the controller keeps recording, but only keeps the latest samples until the
+  condition is met, and stops once it has recorded the samples following it.
+  This lets you capture rare events, such as pressure overshoots.
+
+  The condition on the (int, uint or float) variable var is one of:
+    above/below      - var is above/below level
+    rising/falling   - var crosses level upwards/downwards
+    change           - var changes, e.g. breath_id on a new breath (no level)
+
+  --pre sets the fraction of the trace buffer holding samples recorded before the
+  trigger, between 0 and 1 (0.5 when the controller starts).
+  --post sets the number of samples recorded after the trigger, 0 (the default)
+  meaning until the buffer is full.
+  Downloaded traces are timed relative to the trigger.
+
 trace flush
   Flushes the trace buffer. If trace is ongoing, buffer will be filled with new data.
 
@@ -652,6 +698,7 @@ trace status
     - traced variables
     - trace period
     - number of samples in the trace buffer
+    - trigger and its state
 
 trace save [--verbose/-v] [--plot/-p] [--csv/-c]
   Downloads trace data and saves it as an "unplanned test". File will be named as
@@ -673,6 +720,7 @@ trace save [--verbose/-v] [--plot/-p] [--csv/-c]
         elif cl[0] == "start":
             parser = CmdArgumentParser("trace start")
             parser.add_argument("--period", type=int)
+            parser.add_argument("--resolution", action="append", default=[])
             parser.add_argument("var", nargs="*")
             args = parser.parse_args(cl[1:])
 
@@ -684,10 +732,53 @@ trace save [--verbose/-v] [--plot/-p] [--csv/-c]
                 self.interface.trace_set_period(1)
 
             if args.var:
-                self.interface.trace_select(args.var)
+                self.interface.trace_select(
+                    args.var, parse_trace_resolutions(args.resolution)
+                )
 
             self.interface.trace_start()
 
+        elif cl[0] == "stream":
+            parser = CmdArgumentParser("trace stream")
+            parser.add_argument("--period", type=int)
+            parser.add_argument("--resolution", action="append", default=[])
+            parser.add_argument("--duration", type=float)
+            parser.add_argument("file")
+            parser.add_argument("var", nargs="*")
+            args = parser.parse_args(cl[1:])
+
+            self.interface.trace_set_period(args.period if args.period else 1)
+            if args.var:
+                self.interface.trace_select(
+                    args.var, parse_trace_resolutions(args.resolution)
+                )
+
+            print("Streaming trace, press Ctrl+C to stop")
+            stream = self.interface.trace_stream(args.file, args.duration)
+            print(
+                f"Saved {stream.samples} samples to {args.file}, "
+                f"{stream.dropped} dropped, {stream.lost_packets} packets lost"
+            )
+
+        elif cl[0] == "trigger":
+            if cl[1:] == ["off"]:
+                self.interface.trace_set_trigger()
+                return
+            parser = CmdArgumentParser("trace trigger")
+            parser.add_argument("--pre", type=float)
+            parser.add_argument("--post", type=int, default=0)
+            parser.add_argument("var")
+            parser.add_argument("condition", choices=TRIGGER_CONDITIONS[1:])
+            parser.add_argument("level", nargs="?", default="0")
+            args = parser.parse_args(cl[1:])
+
+            if args.pre is not None:
+                self.interface.trace_set_trigger_position(args.pre, args.post)
+            else:
+                (pre, post) = self.interface.trace_get_trigger_position()
+                self.interface.trace_set_trigger_position(pre, args.post)
+            self.interface.trace_set_trigger(args.var, args.condition, args.level)
+
         elif cl[0] == "stop":
             self.interface.trace_stop()
 
@@ -712,19 +803,50 @@ trace save [--verbose/-v] [--plot/-p] [--csv/-c]
 
         elif cl[0] == "status":
             print("Traced variables:")
-            for var in self.interface.trace_active_variables_list():
-                print(f" - {var.name}")
+            for (index, var) in self.interface.trace_active_slots():
+                resolution = self.interface.trace_get_resolution(index)
+                if resolution > 0:
+                    print(f" - {var.name} (resolution {resolution:g} {var.units})")
+                else:
+                    print(f" - {var.name}")
             print(f"Trace period: {self.interface.trace_get_period_us()} \u03BCs")
             print(f"Samples in buffer: {self.interface.trace_num_samples()}")
+            (var, condition, level) = self.interface.trace_get_trigger()
+            if var is None:
+                print("Trigger: none")
+            else:
+                (pre, post) = self.interface.trace_get_trigger_position()
+                (state, index) = self.interface.trace_trigger_status()
+                post_text = f"{post} samples" if post else "until full"
+                print(
+                    f"Trigger: {var.name} {condition} {level}, "
+                    f"{pre:g} of buffer before, {post_text} after"
+                )
+                if state == "triggered":
+                    print(f"Trigger state: triggered at sample {index}")
+                else:
+                    print(f"Trigger state: {state}")
 
         else:
             print(f"Unknown trace sub-command {cl[0]}")
             return
 
     def complete_trace(self, text, line, begidx, endidx):
-        sub_commands = ["start", "flush", "stop", "status", "save"]
+        sub_commands = ["start", "stream", "trigger", "flush", "stop", "status", "save"]
         tokens = shlex.split(line)
-        if len(tokens) > 2 and tokens[1] == "start":
+        if tokens[1:2] == ["trigger"]:
+            # Number of the argument being completed (the variable being the first)
+            arg = len(tokens) - (2 if text == "" else 3)
+            if arg == 0:
+                return self.interface.variables_find(pattern=(text + "*"))
+            elif arg == 1:
+                return [c for c in TRIGGER_CONDITIONS[1:] if c.startswith(text)]
+            return []
+        if len(tokens) > 3 and tokens[1] == "stream":
+            return self.interface.variables_find(
+                pattern=(text + "*"), access_filter=VAR_ACCESS_READ_ONLY
+            )
+        elif len(tokens) > 2 and tokens[1] == "start":
             return self.interface.variables_find(
                 pattern=(text + "*"), access_filter=VAR_ACCESS_READ_ONLY
             )
@@ -737,6 +859,56 @@ trace save [--verbose/-v] [--plot/-p] [--csv/-c]
         elif len(tokens) == 1:
             return sub_commands
 
+    def do_timing(self, line):
+        """The `timing` command summarizes the control loop timing histograms
+(the loop_hist_* variables) collected by the controller.
+
+timing
+  Prints, for each histogram, the number of samples, the 50th, 99th and
+  99.9th percentiles and the largest sample.  Percentiles are rounded up to
+  the upper edge of the histogram bucket they fall into.
+
+timing reset [<bucket width>]
+  Clears all histograms, optionally changing their bucket width.
+"""
+        cl = shlex.split(line)
+        names = sorted(self.interface.variables_find(pattern="loop_hist_*"))
+        if len(cl) > 0 and cl[0] == "reset":
+            width = float(cl[1]) if len(cl) > 1 else 0
+            for name in names:
+                size = self.interface.variable_metadata[name].size()
+                self.interface.variable_set(name, [width] + [0] * (size - 1))
+            return
+        elif len(cl) > 0:
+            print(f"Unknown timing sub-command {cl[0]}")
+            return
+
+        print(
+            f"{'histogram':<24}{'count':>10}{'p50':>10}{'p99':>10}{'p99.9':>10}{'max':>10}"
+        )
+        for name in names:
+            units = self.interface.variable_metadata[name].units
+            histogram = self.interface.variable_get(name, raw=True)
+            width, maximum, counts = histogram[0], histogram[1], histogram[2:]
+            total = sum(counts)
+
+            def percentile(fraction):
+                target = fraction * total
+                if target <= 0:
+                    return 0
+                cumulated = 0
+                for i, count in enumerate(counts[:-1]):
+                    cumulated += count
+                    if cumulated >= target:
+                        return min((i + 1) * width, maximum)
+                return maximum
+
+            print(
+                f"{name:<24}{total:>10.0f}"
+                + "".join(f"{percentile(p):>10.0f}" for p in [0.5, 0.99, 0.999])
+                + f"{maximum:>10.0f} {units}"
+            )
+
     def do_eeprom(self, line):
         """The `eeprom` command allows you to read/write to the controller's
 non-volatile memory.
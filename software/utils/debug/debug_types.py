@@ -21,6 +21,7 @@ __license__ = """
 """
 
 import struct
+from lib.error import Error
 
 # Special characters used to frame commands
 ESC = 0xF1
@@ -184,6 +185,38 @@ def bytes_to_float32s(data):
     return [i_to_f(x) for x in tmp]
 
 
+# Decodes trace data, as the controller sends it (see trace_codec.h in the
+# controller).  Each sample holds one varint per traced variable: the
+# zig-zag encoded difference with the previous sample of that variable, the
+# first one being relative to 0.
+#
+# Returns a list of samples, each a list of var_count unsigned 32-bit values.
+# Raises an Error if data doesn't hold a whole number of samples.
+def decode_trace_samples(data, var_count):
+    samples = []
+    previous = [0] * var_count
+    i = 0
+    while i < len(data):
+        sample = []
+        for var in range(var_count):
+            encoded = 0
+            shift = 0
+            while True:
+                if i >= len(data) or shift > 28:
+                    raise Error("Invalid trace data")
+                byte = data[i]
+                i += 1
+                encoded |= (byte & 0x7F) << shift
+                shift += 7
+                if not byte & 0x80:
+                    break
+            delta = (encoded >> 1) ^ -(encoded & 1)
+            sample.append((previous[var] + delta) & 0xFFFFFFFF)
+        samples.append(sample)
+        previous = sample
+    return samples
+
+
 # Utility function which removes the first count elements from a list and returns them
 def pop_n_elements(data, count):
     if len(data) < count:
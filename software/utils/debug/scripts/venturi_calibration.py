@@ -0,0 +1,97 @@
+# Script used to calibrate the flow table of a venturi against a reference flow meter
+#
+# For each flow set by the operator (with the blower, a valve, or an external flow
+# source) and read on the reference flow meter, this records the mean differential
+# pressure measured across the venturi.  The resulting pressure -> flow table is
+# written to the venturi's flow_table debug variable, which the controller then
+# uses instead of the venturi formula, and saves to its non-volatile parameters.
+#
+# Flows in the reverse direction can be entered as negative values.
+
+import math
+import time
+import sys
+
+sys.path.append("..")
+
+from controller_debug import ControllerDebugInterface
+
+# Must match FlowTable::MaxPoints in the controller
+MAX_POINTS = 16
+KPA_PER_CMH2O = 0.0980665
+
+
+def venturi_calibration(interface: ControllerDebugInterface, cmdline: str = ""):
+
+    cl = cmdline.split()
+    if len(cl) < 1 or cl[0] == "help":
+        print("Syntax:")
+        print("  run venturi_calibration <venturi>")
+        print("    venturi - one of these:")
+        print("         air_influx")
+        print("         oxygen_influx")
+        print("         outflow")
+        return
+
+    dp_variable = f"{cl[0]}_dp"
+    table_variable = f"{cl[0]}_flow_table"
+    for variable in [dp_variable, table_variable]:
+        if variable not in interface.variable_metadata.keys():
+            print(f"Error: `{variable}` is not a valid variable")
+            return
+
+    sample_duration = 3
+    print("Venturi calibration routine:")
+    print(f"  pressure variable = {dp_variable}")
+    print(f"  table variable    = {table_variable}")
+    print(f"  up to {MAX_POINTS} points, zero flow included")
+    print()
+
+    input("Stop all flow through the venturi, then hit enter")
+    points = [(get_mean(interface, dp_variable, sample_duration) * KPA_PER_CMH2O, 0.0)]
+    print(f"zero flow: dp = {points[0][0]:.4f} kPa")
+
+    while len(points) < MAX_POINTS:
+        text = input(
+            "Set a flow, then enter the reference reading in L/min (empty to finish): "
+        )
+        if not text:
+            break
+        try:
+            flow = float(text) * 1000 / 60
+        except ValueError:
+            print(f"Error: `{text}` is not a number")
+            continue
+        dp = get_mean(interface, dp_variable, sample_duration) * KPA_PER_CMH2O
+        print(f"  {flow:.1f} mL/s: dp = {dp:.4f} kPa")
+        points.append((dp, flow))
+
+    points.sort()
+    for (dp0, _), (dp1, _) in zip(points, points[1:]):
+        if dp1 <= dp0:
+            print("Error: two flows gave the same pressure, table not written.")
+            print("     Please check the flow meter readings and try again.")
+            return
+    if len(points) < 2:
+        print("Error: at least one flow is needed, table not written.")
+        return
+
+    padding = [math.nan] * (MAX_POINTS - len(points))
+    table = [dp for dp, _ in points] + padding + [flow for _, flow in points] + padding
+    interface.variable_set(table_variable, table)
+
+    print("Results:")
+    for dp, flow in points:
+        print(f"  {dp:8.4f} kPa -> {flow:8.1f} mL/s")
+    print(f"Written to `{table_variable}`, and saved to non-volatile parameters.")
+
+
+def get_mean(interface: ControllerDebugInterface, variable, sample_duration):
+    interface.trace_stop()
+    interface.trace_select([variable])
+    interface.trace_start()
+
+    time.sleep(sample_duration)
+
+    dat = interface.trace_download()[1]
+    return sum(dat) / len(dat)
@@ -142,6 +142,16 @@ class VarInfo:
             return data
         return data
 
+    # Convert a traced value into the correct type for this variable.  Float
+    # variables traced with a resolution are traced as a signed multiple of it
+    # (see trace_codec.h in the controller).
+    def convert_traced(self, data, resolution=0):
+        if self.type == VAR_FLOAT and resolution > 0:
+            if data & 0x80000000:
+                data -= 1 << 32
+            return data * resolution
+        return self.convert_int(data)
+
     def from_bytes(self, data):
         if self.name == "forced_mode":
             value = debug_types.bytes_to_int32s(data)[0]
@@ -1,11 +1,10 @@
 # -*- coding: utf-8 -*-
 # Generated by the protocol buffer compiler.  DO NOT EDIT!
 # source: network_protocol.proto
-
-from google.protobuf.internal import enum_type_wrapper
+"""Generated protocol buffer code."""
+from google.protobuf.internal import builder as _builder
 from google.protobuf import descriptor as _descriptor
-from google.protobuf import message as _message
-from google.protobuf import reflection as _reflection
+from google.protobuf import descriptor_pool as _descriptor_pool
 from google.protobuf import symbol_database as _symbol_database
 # @@protoc_insertion_point(imports)
 
@@ -15,350 +14,33 @@ _sym_db = _symbol_database.Default()
 import nanopb_pb2 as nanopb__pb2
 
 
-DESCRIPTOR = _descriptor.FileDescriptor(
-  name='network_protocol.proto',
-  package='',
-  syntax='proto2',
-  serialized_options=None,
-  create_key=_descriptor._internal_create_key,
-  serialized_pb=b'\n\x16network_protocol.proto\x1a\x0cnanopb.proto\"C\n\tGuiStatus\x12\x11\n\tuptime_ms\x18\x01 \x02(\x04\x12#\n\x0e\x64\x65sired_params\x18\x02 \x02(\x0b\x32\x0b.VentParams\"\xa6\x01\n\x10\x43ontrollerStatus\x12\x11\n\tuptime_ms\x18\x01 \x02(\x04\x12\"\n\ractive_params\x18\x02 \x02(\x0b\x32\x0b.VentParams\x12&\n\x0fsensor_readings\x18\x03 \x02(\x0b\x32\r.SensorsProto\x12 \n\x18pressure_setpoint_cm_h2o\x18\x05 \x02(\x02\x12\x11\n\tfan_power\x18\x06 \x02(\x02\"\xe6\x01\n\nVentParams\x12\x17\n\x04mode\x18\x01 \x02(\x0e\x32\t.VentMode\x12\x13\n\x0bpeep_cm_h2o\x18\x03 \x02(\r\x12\x17\n\x0f\x62reaths_per_min\x18\x04 \x02(\r\x12\x12\n\npip_cm_h2o\x18\x05 \x02(\r\x12$\n\x1cinspiratory_expiratory_ratio\x18\x06 \x02(\x02\x12\"\n\x1ainspiratory_trigger_cm_h2o\x18\x08 \x02(\r\x12%\n\x1d\x65xpiratory_trigger_ml_per_min\x18\t \x02(\r\x12\x0c\n\x04\x66io2\x18\n \x02(\x02\"\xdd\x01\n\x0cSensorsProto\x12\x1f\n\x17patient_pressure_cm_h2o\x18\x01 \x02(\x02\x12\x11\n\tvolume_ml\x18\x02 \x02(\x02\x12\x17\n\x0f\x66low_ml_per_min\x18\x03 \x02(\x02\x12#\n\x1binflow_pressure_diff_cm_h2o\x18\x04 \x02(\x02\x12$\n\x1coutflow_pressure_diff_cm_h2o\x18\x05 \x02(\x02\x12\x11\n\tbreath_id\x18\x06 \x02(\x04\x12\"\n\x1a\x66low_correction_ml_per_min\x18\x07 \x02(\x02*[\n\x08VentMode\x12\x07\n\x03OFF\x10\x00\x12\x14\n\x10PRESSURE_CONTROL\x10\x01\x12\x13\n\x0fPRESSURE_ASSIST\x10\x02\x12\x1b\n\x17HIGH_FLOW_NASAL_CANNULA\x10\x03'
-  ,
-  dependencies=[nanopb__pb2.DESCRIPTOR,])
-
-_VENTMODE = _descriptor.EnumDescriptor(
-  name='VentMode',
-  full_name='VentMode',
-  filename=None,
-  file=DESCRIPTOR,
-  create_key=_descriptor._internal_create_key,
-  values=[
-    _descriptor.EnumValueDescriptor(
-      name='OFF', index=0, number=0,
-      serialized_options=None,
-      type=None,
-      create_key=_descriptor._internal_create_key),
-    _descriptor.EnumValueDescriptor(
-      name='PRESSURE_CONTROL', index=1, number=1,
-      serialized_options=None,
-      type=None,
-      create_key=_descriptor._internal_create_key),
-    _descriptor.EnumValueDescriptor(
-      name='PRESSURE_ASSIST', index=2, number=2,
-      serialized_options=None,
-      type=None,
-      create_key=_descriptor._internal_create_key),
-    _descriptor.EnumValueDescriptor(
-      name='HIGH_FLOW_NASAL_CANNULA', index=3, number=3,
-      serialized_options=None,
-      type=None,
-      create_key=_descriptor._internal_create_key),
-  ],
-  containing_type=None,
-  serialized_options=None,
-  serialized_start=735,
-  serialized_end=826,
-)
-_sym_db.RegisterEnumDescriptor(_VENTMODE)
-
-VentMode = enum_type_wrapper.EnumTypeWrapper(_VENTMODE)
-OFF = 0
-PRESSURE_CONTROL = 1
-PRESSURE_ASSIST = 2
-HIGH_FLOW_NASAL_CANNULA = 3
-
-
-
-_GUISTATUS = _descriptor.Descriptor(
-  name='GuiStatus',
-  full_name='GuiStatus',
-  filename=None,
-  file=DESCRIPTOR,
-  containing_type=None,
-  create_key=_descriptor._internal_create_key,
-  fields=[
-    _descriptor.FieldDescriptor(
-      name='uptime_ms', full_name='GuiStatus.uptime_ms', index=0,
-      number=1, type=4, cpp_type=4, label=2,
-      has_default_value=False, default_value=0,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='desired_params', full_name='GuiStatus.desired_params', index=1,
-      number=2, type=11, cpp_type=10, label=2,
-      has_default_value=False, default_value=None,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-  ],
-  extensions=[
-  ],
-  nested_types=[],
-  enum_types=[
-  ],
-  serialized_options=None,
-  is_extendable=False,
-  syntax='proto2',
-  extension_ranges=[],
-  oneofs=[
-  ],
-  serialized_start=40,
-  serialized_end=107,
-)
-
-
-_CONTROLLERSTATUS = _descriptor.Descriptor(
-  name='ControllerStatus',
-  full_name='ControllerStatus',
-  filename=None,
-  file=DESCRIPTOR,
-  containing_type=None,
-  create_key=_descriptor._internal_create_key,
-  fields=[
-    _descriptor.FieldDescriptor(
-      name='uptime_ms', full_name='ControllerStatus.uptime_ms', index=0,
-      number=1, type=4, cpp_type=4, label=2,
-      has_default_value=False, default_value=0,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='active_params', full_name='ControllerStatus.active_params', index=1,
-      number=2, type=11, cpp_type=10, label=2,
-      has_default_value=False, default_value=None,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='sensor_readings', full_name='ControllerStatus.sensor_readings', index=2,
-      number=3, type=11, cpp_type=10, label=2,
-      has_default_value=False, default_value=None,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='pressure_setpoint_cm_h2o', full_name='ControllerStatus.pressure_setpoint_cm_h2o', index=3,
-      number=5, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='fan_power', full_name='ControllerStatus.fan_power', index=4,
-      number=6, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-  ],
-  extensions=[
-  ],
-  nested_types=[],
-  enum_types=[
-  ],
-  serialized_options=None,
-  is_extendable=False,
-  syntax='proto2',
-  extension_ranges=[],
-  oneofs=[
-  ],
-  serialized_start=110,
-  serialized_end=276,
-)
-
-
-_VENTPARAMS = _descriptor.Descriptor(
-  name='VentParams',
-  full_name='VentParams',
-  filename=None,
-  file=DESCRIPTOR,
-  containing_type=None,
-  create_key=_descriptor._internal_create_key,
-  fields=[
-    _descriptor.FieldDescriptor(
-      name='mode', full_name='VentParams.mode', index=0,
-      number=1, type=14, cpp_type=8, label=2,
-      has_default_value=False, default_value=0,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='peep_cm_h2o', full_name='VentParams.peep_cm_h2o', index=1,
-      number=3, type=13, cpp_type=3, label=2,
-      has_default_value=False, default_value=0,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='breaths_per_min', full_name='VentParams.breaths_per_min', index=2,
-      number=4, type=13, cpp_type=3, label=2,
-      has_default_value=False, default_value=0,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='pip_cm_h2o', full_name='VentParams.pip_cm_h2o', index=3,
-      number=5, type=13, cpp_type=3, label=2,
-      has_default_value=False, default_value=0,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='inspiratory_expiratory_ratio', full_name='VentParams.inspiratory_expiratory_ratio', index=4,
-      number=6, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='inspiratory_trigger_cm_h2o', full_name='VentParams.inspiratory_trigger_cm_h2o', index=5,
-      number=8, type=13, cpp_type=3, label=2,
-      has_default_value=False, default_value=0,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='expiratory_trigger_ml_per_min', full_name='VentParams.expiratory_trigger_ml_per_min', index=6,
-      number=9, type=13, cpp_type=3, label=2,
-      has_default_value=False, default_value=0,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='fio2', full_name='VentParams.fio2', index=7,
-      number=10, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-  ],
-  extensions=[
-  ],
-  nested_types=[],
-  enum_types=[
-  ],
-  serialized_options=None,
-  is_extendable=False,
-  syntax='proto2',
-  extension_ranges=[],
-  oneofs=[
-  ],
-  serialized_start=279,
-  serialized_end=509,
-)
-
-
-_SENSORSPROTO = _descriptor.Descriptor(
-  name='SensorsProto',
-  full_name='SensorsProto',
-  filename=None,
-  file=DESCRIPTOR,
-  containing_type=None,
-  create_key=_descriptor._internal_create_key,
-  fields=[
-    _descriptor.FieldDescriptor(
-      name='patient_pressure_cm_h2o', full_name='SensorsProto.patient_pressure_cm_h2o', index=0,
-      number=1, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='volume_ml', full_name='SensorsProto.volume_ml', index=1,
-      number=2, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='flow_ml_per_min', full_name='SensorsProto.flow_ml_per_min', index=2,
-      number=3, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='inflow_pressure_diff_cm_h2o', full_name='SensorsProto.inflow_pressure_diff_cm_h2o', index=3,
-      number=4, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='outflow_pressure_diff_cm_h2o', full_name='SensorsProto.outflow_pressure_diff_cm_h2o', index=4,
-      number=5, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='breath_id', full_name='SensorsProto.breath_id', index=5,
-      number=6, type=4, cpp_type=4, label=2,
-      has_default_value=False, default_value=0,
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-    _descriptor.FieldDescriptor(
-      name='flow_correction_ml_per_min', full_name='SensorsProto.flow_correction_ml_per_min', index=6,
-      number=7, type=2, cpp_type=6, label=2,
-      has_default_value=False, default_value=float(0),
-      message_type=None, enum_type=None, containing_type=None,
-      is_extension=False, extension_scope=None,
-      serialized_options=None, file=DESCRIPTOR,  create_key=_descriptor._internal_create_key),
-  ],
-  extensions=[
-  ],
-  nested_types=[],
-  enum_types=[
-  ],
-  serialized_options=None,
-  is_extendable=False,
-  syntax='proto2',
-  extension_ranges=[],
-  oneofs=[
-  ],
-  serialized_start=512,
-  serialized_end=733,
-)
-
-_GUISTATUS.fields_by_name['desired_params'].message_type = _VENTPARAMS
-_CONTROLLERSTATUS.fields_by_name['active_params'].message_type = _VENTPARAMS
-_CONTROLLERSTATUS.fields_by_name['sensor_readings'].message_type = _SENSORSPROTO
-_VENTPARAMS.fields_by_name['mode'].enum_type = _VENTMODE
-DESCRIPTOR.message_types_by_name['GuiStatus'] = _GUISTATUS
-DESCRIPTOR.message_types_by_name['ControllerStatus'] = _CONTROLLERSTATUS
-DESCRIPTOR.message_types_by_name['VentParams'] = _VENTPARAMS
-DESCRIPTOR.message_types_by_name['SensorsProto'] = _SENSORSPROTO
-DESCRIPTOR.enum_types_by_name['VentMode'] = _VENTMODE
-_sym_db.RegisterFileDescriptor(DESCRIPTOR)
-
-GuiStatus = _reflection.GeneratedProtocolMessageType('GuiStatus', (_message.Message,), {
-  'DESCRIPTOR' : _GUISTATUS,
-  '__module__' : 'network_protocol_pb2'
-  # @@protoc_insertion_point(class_scope:GuiStatus)
-  })
-_sym_db.RegisterMessage(GuiStatus)
-
-ControllerStatus = _reflection.GeneratedProtocolMessageType('ControllerStatus', (_message.Message,), {
-  'DESCRIPTOR' : _CONTROLLERSTATUS,
-  '__module__' : 'network_protocol_pb2'
-  # @@protoc_insertion_point(class_scope:ControllerStatus)
-  })
-_sym_db.RegisterMessage(ControllerStatus)
-
-VentParams = _reflection.GeneratedProtocolMessageType('VentParams', (_message.Message,), {
-  'DESCRIPTOR' : _VENTPARAMS,
-  '__module__' : 'network_protocol_pb2'
-  # @@protoc_insertion_point(class_scope:VentParams)
-  })
-_sym_db.RegisterMessage(VentParams)
-
-SensorsProto = _reflection.GeneratedProtocolMessageType('SensorsProto', (_message.Message,), {
-  'DESCRIPTOR' : _SENSORSPROTO,
-  '__module__' : 'network_protocol_pb2'
-  # @@protoc_insertion_point(class_scope:SensorsProto)
-  })
-_sym_db.RegisterMessage(SensorsProto)
-
-
+DESCRIPTOR = _descriptor_pool.Default().AddSerializedFile(b'\n\x16network_protocol.proto\x1a\x0cnanopb.proto\"C\n\tGuiStatus\x12\x11\n\tuptime_ms\x18\x01 \x02(\x04\x12#\n\x0e\x64\x65sired_params\x18\x02 \x02(\x0b\x32\x0b.VentParams\"\xc5\x01\n\x10\x43ontrollerStatus\x12\x11\n\tuptime_ms\x18\x01 \x02(\x04\x12\"\n\ractive_params\x18\x02 \x02(\x0b\x32\x0b.VentParams\x12&\n\x0fsensor_readings\x18\x03 \x02(\x0b\x32\r.SensorsProto\x12 \n\x18pressure_setpoint_cm_h2o\x18\x05 \x02(\x02\x12\x11\n\tfan_power\x18\x06 \x02(\x02\x12\x1d\n\x07samples\x18\x07 \x02(\x0b\x32\x0c.SampleBatch\"\xe9\x01\n\x0bSampleBatch\x12\x1e\n\x16\x66irst_sample_uptime_us\x18\x01 \x02(\x04\x12\x18\n\x10sample_period_us\x18\x02 \x02(\r\x12\x17\n\x0f\x66irst_breath_id\x18\x03 \x02(\x04\x12\x1f\n\x10patient_pressure\x18\x04 \x03(\x11\x42\x05\x92?\x02\x10\x10\x12\x13\n\x04\x66low\x18\x05 \x03(\x11\x42\x05\x92?\x02\x10\x10\x12\x15\n\x06volume\x18\x06 \x03(\x11\x42\x05\x92?\x02\x10\x10\x12 \n\x11pressure_setpoint\x18\x07 \x03(\x11\x42\x05\x92?\x02\x10\x10\x12\x18\n\tbreath_id\x18\x08 \x03(\x11\x42\x05\x92?\x02\x10\x10\"\xe6\x01\n\nVentParams\x12\x17\n\x04mode\x18\x01 \x02(\x0e\x32\t.VentMode\x12\x13\n\x0bpeep_cm_h2o\x18\x03 \x02(\r\x12\x17\n\x0f\x62reaths_per_min\x18\x04 \x02(\r\x12\x12\n\npip_cm_h2o\x18\x05 \x02(\r\x12$\n\x1cinspiratory_expiratory_ratio\x18\x06 \x02(\x02\x12\"\n\x1ainspiratory_trigger_cm_h2o\x18\x08 \x02(\r\x12%\n\x1d\x65xpiratory_trigger_ml_per_min\x18\t \x02(\r\x12\x0c\n\x04\x66io2\x18\n \x02(\x02\"\xeb\x01\n\x0cSensorsProto\x12\x1f\n\x17patient_pressure_cm_h2o\x18\x01 \x02(\x02\x12\x11\n\tvolume_ml\x18\x02 \x02(\x02\x12\x17\n\x0f\x66low_ml_per_min\x18\x03 \x02(\x02\x12#\n\x1binflow_pressure_diff_cm_h2o\x18\x04 \x02(\x02\x12$\n\x1coutflow_pressure_diff_cm_h2o\x18\x05 \x02(\x02\x12\x11\n\tbreath_id\x18\x06 \x02(\x04\x12\"\n\x1a\x66low_correction_ml_per_min\x18\x07 \x02(\x02\x12\x0c\n\x04\x66io2\x18\x08 \x02(\x02*[\n\x08VentMode\x12\x07\n\x03OFF\x10\x00\x12\x14\n\x10PRESSURE_CONTROL\x10\x01\x12\x13\n\x0fPRESSURE_ASSIST\x10\x02\x12\x1b\n\x17HIGH_FLOW_NASAL_CANNULA\x10\x03')
+
+_builder.BuildMessageAndEnumDescriptors(DESCRIPTOR, globals())
+_builder.BuildTopDescriptorsAndMessages(DESCRIPTOR, 'network_protocol_pb2', globals())
+if _descriptor._USE_C_DESCRIPTORS == False:
+
+  DESCRIPTOR._options = None
+  _SAMPLEBATCH.fields_by_name['patient_pressure']._options = None
+  _SAMPLEBATCH.fields_by_name['patient_pressure']._serialized_options = b'\222?\002\020\020'
+  _SAMPLEBATCH.fields_by_name['flow']._options = None
+  _SAMPLEBATCH.fields_by_name['flow']._serialized_options = b'\222?\002\020\020'
+  _SAMPLEBATCH.fields_by_name['volume']._options = None
+  _SAMPLEBATCH.fields_by_name['volume']._serialized_options = b'\222?\002\020\020'
+  _SAMPLEBATCH.fields_by_name['pressure_setpoint']._options = None
+  _SAMPLEBATCH.fields_by_name['pressure_setpoint']._serialized_options = b'\222?\002\020\020'
+  _SAMPLEBATCH.fields_by_name['breath_id']._options = None
+  _SAMPLEBATCH.fields_by_name['breath_id']._serialized_options = b'\222?\002\020\020'
+  _VENTMODE._serialized_start=1016
+  _VENTMODE._serialized_end=1107
+  _GUISTATUS._serialized_start=40
+  _GUISTATUS._serialized_end=107
+  _CONTROLLERSTATUS._serialized_start=110
+  _CONTROLLERSTATUS._serialized_end=307
+  _SAMPLEBATCH._serialized_start=310
+  _SAMPLEBATCH._serialized_end=543
+  _VENTPARAMS._serialized_start=546
+  _VENTPARAMS._serialized_end=776
+  _SENSORSPROTO._serialized_start=779
+  _SENSORSPROTO._serialized_end=1014
 # @@protoc_insertion_point(module_scope)